@@ -11,14 +11,29 @@
 #include "applock.h"
 
 #include <QtScript>
+#include <QHash>
 #include <QMessageBox>
 #include <QSqlError>
 #include <QVariant>
 #include <QWidget>
 
+#include <algorithm>
+
 #include "errorReporter.h"
 #include "xsqlquery.h"
 
+/* Orders documents by relation oid, then record id, so every session
+   takes the locks of a batch in the same order.
+ */
+class AppLockOrder
+{
+  public:
+    bool operator()(const QPair<int, int> &a, const QPair<int, int> &b) const
+    {
+      return a.first < b.first || (a.first == b.first && a.second < b.second);
+    }
+};
+
 class AppLockPrivate
 {
   public:
@@ -51,6 +66,125 @@ class AppLockPrivate
       updateLockStatus();
     }
 
+    /* Return the pg_class oid of pTable, looking it up only the first time
+       the session asks for it. Return -1 if there is no such table.
+     */
+    int relationOid(const QString &pTable)
+    {
+      if (! _oids.contains(pTable))
+        resolveOids(QStringList() << pTable);
+      return _oids.value(pTable, -1);
+    }
+
+    /* Look up the oids of every table in pTables the session has not seen
+       yet in one query. A table visible on the search path wins over one
+       of the same name in another schema.
+     */
+    bool resolveOids(const QStringList &pTables)
+    {
+      QStringList missing;
+      foreach (QString table, pTables)
+      {
+        if (! _oids.contains(table) && ! missing.contains(table))
+          missing << table;
+      }
+      if (missing.isEmpty())
+        return true;
+
+      XSqlQuery q;
+      q.prepare("SELECT relname, CAST(oid AS INTEGER) AS oid"
+                "  FROM pg_class"
+                " WHERE relname = ANY(:tables::TEXT[])"
+                " ORDER BY pg_table_is_visible(oid);");
+      q.bindValue(":tables", "{" + missing.join(",") + "}");
+      q.exec();
+      while (q.next())
+        _oids.insert(q.value("relname").toString(), q.value("oid").toInt());
+
+      return ! ErrorReporter::error(QtCriticalMsg,
+                                    qobject_cast<QWidget*>(_parent->parent()),
+                                    _parent->tr("Locking Error"),
+                                    q, __FILE__, __LINE__);
+    }
+
+    /* Return the documents in pDocs as two PostgreSQL array literals,
+       relation oids and record ids, for unnest().
+     */
+    static void arrays(const QList<QPair<int, int> > &pDocs,
+                       QString &pOids, QString &pIds)
+    {
+      QStringList oids;
+      QStringList ids;
+      for (int i = 0; i < pDocs.size(); i++)
+      {
+        oids << QString::number(pDocs.at(i).first);
+        ids  << QString::number(pDocs.at(i).second);
+      }
+      pOids = "{" + oids.join(",") + "}";
+      pIds  = "{" + ids.join(",")  + "}";
+    }
+
+    bool unlockAll(const QList<QPair<int, int> > &pDocs)
+    {
+      if (pDocs.isEmpty())
+        return true;
+
+      QString oids;
+      QString ids;
+      arrays(pDocs, oids, ids);
+
+      XSqlQuery q;
+      q.prepare("SELECT pg_advisory_unlock(doc.oid, doc.id)"
+                "  FROM unnest(:oids::INTEGER[], :ids::INTEGER[]) AS doc(oid, id);");
+      q.bindValue(":oids", oids);
+      q.bindValue(":ids",  ids);
+      q.exec();
+      if (ErrorReporter::error(QtCriticalMsg,
+                               qobject_cast<QWidget*>(_parent->parent()),
+                               _parent->tr("Unlocking Error"),
+                               q, __FILE__, __LINE__))
+      {
+        _error = q.lastError().text();
+        return false;
+      }
+      return true;
+    }
+
+    /* Return the names of the users holding locks on any of pDocs. */
+    QStringList lockOwners(const QList<QPair<int, int> > &pDocs)
+    {
+      QString oids;
+      QString ids;
+      arrays(pDocs, oids, ids);
+
+      XSqlQuery q;
+      if (_isWebEnabled.toBool())
+        q.prepare("SELECT DISTINCT lock_username"
+                  "  FROM xt.lock"
+                  "  JOIN unnest(:oids::INTEGER[], :ids::INTEGER[]) AS doc(oid, id)"
+                  "    ON lock_table_oid = doc.oid AND lock_record_id = doc.id"
+                  " WHERE lock_pid != pg_backend_pid();");
+      else
+        q.prepare("SELECT DISTINCT usename AS lock_username"
+                  "  FROM pg_locks l"
+                  "  JOIN pg_database d on database = d.oid"
+                  "  JOIN pg_stat_activity a ON l.pid = a.pid"
+                  "  JOIN unnest(:oids::INTEGER[], :ids::INTEGER[]) AS doc(oid, id)"
+                  "    ON CAST(classid AS INTEGER) = doc.oid"
+                  "   AND CAST(objid AS INTEGER)   = doc.id"
+                  " WHERE d.datname = current_database()"
+                  "   AND l.pid != pg_backend_pid()"
+                  "   AND locktype = 'advisory';");
+      q.bindValue(":oids", oids);
+      q.bindValue(":ids",  ids);
+      q.exec();
+
+      QStringList result;
+      while (q.next())
+        result << q.value("lock_username").toString();
+      return result;
+    }
+
     void updateLockStatus()
     {
       if (! _dbIsOpen || _id < 0)
@@ -60,22 +194,20 @@ class AppLockPrivate
       if (_isWebEnabled.toBool())
         q.prepare("SELECT lock_pid = pg_backend_pid() AS mylock, lock_username"
                   "  FROM xt.lock"
-                  "  JOIN pg_class c ON lock_table_oid = c.oid"
-                  " WHERE relname = :table"
+                  " WHERE lock_table_oid = :oid"
                   "   AND lock_record_id = :id;");
       else
         q.prepare("SELECT l.pid = pg_backend_pid() AS mylock, usename AS lock_username"
                   "  FROM pg_locks l"
-                  "  JOIN pg_class c    on classid = c.oid"
                   "  JOIN pg_database d on database = d.oid"
                   "  JOIN pg_stat_activity a ON l.pid = a.pid"
                   " WHERE d.datname = current_database()"
-                  "   AND relname = :table"
+                  "   AND classid = :oid"
                   "   AND objid   = :id"
                   "   AND locktype = 'advisory';");
 
-      q.bindValue(":table", _table);
-      q.bindValue(":id",    _id);
+      q.bindValue(":oid", relationOid(_table));
+      q.bindValue(":id",  _id);
       q.exec();
       if (q.first())
       {
@@ -97,6 +229,7 @@ class AppLockPrivate
     }
 
     QString  _error;
+    QList<QPair<int, int> > _held;  // documents locked by acquireAll()
     int      _id;
     bool     _dbIsOpen;
     bool     _myLock;
@@ -105,10 +238,12 @@ class AppLockPrivate
     QString  _table;
     QString  _username;
 
-    static QVariant _isWebEnabled;
+    static QVariant           _isWebEnabled;
+    static QHash<QString,int> _oids;
 };
 
-QVariant AppLockPrivate::_isWebEnabled;
+QVariant           AppLockPrivate::_isWebEnabled;
+QHash<QString,int> AppLockPrivate::_oids;
 
 AppLock::AppLock(QObject *parent)
   : QObject(parent)
@@ -155,12 +290,20 @@ bool AppLock::acquire(AppLock::AcquireMode mode)
 
   bool result = false;
   _p->_error.clear();
+  int oid = _p->relationOid(_p->_table);
+  if (oid < 0)
+  {
+    _p->_error = tr("Cannot acquire a lock on %1 because there is no such table.")
+                   .arg(_p->_table);
+    if (mode == Interactive)
+      QMessageBox::critical(0, tr("Cannot Acquire Lock"), _p->_error);
+    return false;
+  }
+
   XSqlQuery q;
-  q.prepare("SELECT tryLock(CAST(oid AS INTEGER), :id) AS locked"
-            "  FROM pg_class"
-            " WHERE relname=:table;");
-  q.bindValue(":id",    _p->_id);
-  q.bindValue(":table", _p->_table);
+  q.prepare("SELECT tryLock(:oid, :id) AS locked;");
+  q.bindValue(":oid", oid);
+  q.bindValue(":id",  _p->_id);
   q.exec();
   if (q.first())
   {
@@ -195,7 +338,7 @@ bool AppLock::acquire(AppLock::AcquireMode mode)
 
 bool AppLock::acquire(QString table, int id, AppLock::AcquireMode mode)
 {
-  if (_p->_myLock && id != _p->_id && table != _p->_table)
+  if ((_p->_myLock && id != _p->_id && table != _p->_table) || ! _p->_held.isEmpty())
   {
     _p->_error = tr("Cannot change the description of a locked object.");
     return false;
@@ -206,10 +349,115 @@ bool AppLock::acquire(QString table, int id, AppLock::AcquireMode mode)
   return acquire(mode);
 }
 
+/** Try to lock every document in docs, each a table name and record id,
+    with a single query.
+
+    The locks are taken in order of relation and record id so two sessions
+    locking overlapping selections cannot each end up holding part of the
+    other's. Either every document is locked or none is: if another user
+    holds any of them, the ones this call did get are released again.
+    release() unlocks the whole set.
+
+   @return true if this AppLock now holds every lock in docs
+   @return false if any of them could not be acquired
+
+   @see lastError()
+ */
+bool AppLock::acquireAll(const QList<QPair<QString, int> > &docs, AppLock::AcquireMode mode)
+{
+  if (! _p->_dbIsOpen)
+    return false;
+
+  _p->_error.clear();
+  if (_p->_myLock || ! _p->_held.isEmpty())
+  {
+    _p->_error = tr("Cannot change the description of a locked object.");
+    return false;
+  }
+
+  QStringList tables;
+  for (int i = 0; i < docs.size(); i++)
+    tables << docs.at(i).first;
+  if (! _p->resolveOids(tables))
+    return false;
+
+  QList<QPair<int, int> > wanted;
+  for (int i = 0; i < docs.size(); i++)
+  {
+    QPair<int, int> doc(_p->_oids.value(docs.at(i).first, -1), docs.at(i).second);
+    if (doc.first < 0 || doc.second < 0)
+    {
+      _p->_error = tr("Cannot acquire a lock without a table and record id.");
+      if (mode == Interactive)
+        QMessageBox::critical(0, tr("Cannot Acquire Lock"), _p->_error);
+      return false;
+    }
+    if (! wanted.contains(doc))
+      wanted << doc;
+  }
+  if (wanted.isEmpty())
+    return true;
+  std::sort(wanted.begin(), wanted.end(), AppLockOrder());
+
+  QString oids;
+  QString ids;
+  AppLockPrivate::arrays(wanted, oids, ids);
+
+  XSqlQuery q;
+  q.prepare("SELECT doc.oid, doc.id, tryLock(doc.oid, doc.id) AS locked"
+            "  FROM unnest(:oids::INTEGER[], :ids::INTEGER[]) AS doc(oid, id);");
+  q.bindValue(":oids", oids);
+  q.bindValue(":ids",  ids);
+  q.exec();
+
+  QList<QPair<int, int> > locked;
+  QList<QPair<int, int> > blocked;
+  while (q.next())
+  {
+    QPair<int, int> doc(q.value("oid").toInt(), q.value("id").toInt());
+    if (q.value("locked").toBool())
+      locked << doc;
+    else
+      blocked << doc;
+  }
+  if (ErrorReporter::error(QtCriticalMsg, qobject_cast<QWidget*>(parent()),
+                           tr("Locking Error"),
+                           q, __FILE__, __LINE__))
+  {
+    _p->_error = q.lastError().databaseText();
+    return false;
+  }
+
+  if (blocked.isEmpty())
+  {
+    _p->_held = locked;
+    return true;
+  }
+
+  (void)_p->unlockAll(locked);
+  _p->_error = tr("%n of the records you selected are currently being edited "
+                  "by other users (%1).", 0, blocked.size())
+                 .arg(_p->lockOwners(blocked).join(", "));
+  if (mode == Interactive)
+    QMessageBox::critical(0, tr("Cannot Acquire Lock"), _p->_error);
+  return false;
+}
+
+/** Try to lock the records in table with the given ids.
+    This is acquireAll(docs, mode) for documents that share a table.
+ */
+bool AppLock::acquireAll(QString table, QVariantList ids, AppLock::AcquireMode mode)
+{
+  QList<QPair<QString, int> > docs;
+  foreach (QVariant id, ids)
+    docs << qMakePair(table, id.toInt());
+  return acquireAll(docs, mode);
+}
+
 /** @return true if _this_ instance of AppLock holds the lock */
 bool AppLock::holdsLock() const
 {
-  return _p->_myLock;
+  return _p->_myLock || ! _p->_held.isEmpty();
 }
 
 /** @return true if the object appears locked by some other entity */
@@ -222,18 +470,26 @@ bool AppLock::isLockedOut() const
 // we don't care _how_ the lock gets cleared, just _that_ it gets cleared
 bool AppLock::release()
 {
-  if (_p->_id < 0 || _p->_table.isEmpty() || ! _p->_dbIsOpen)
+  if (! _p->_dbIsOpen)
     return true;
 
   _p->_error.clear();
+  if (! _p->_held.isEmpty())
+  {
+    if (! _p->unlockAll(_p->_held))
+      return false;
+    _p->_held.clear();
+  }
+
+  if (_p->_id < 0 || _p->_table.isEmpty())
+    return true;
+
   if (_p->_myLock)
   {
     XSqlQuery q;
-    q.prepare("SELECT pg_advisory_unlock(CAST(oid AS INTEGER), :id)"
-              "  FROM pg_class"
-              " WHERE relname = :table;");
-    q.bindValue(":id",    _p->_id);
-    q.bindValue(":table", _p->_table);
+    q.prepare("SELECT pg_advisory_unlock(:oid, :id);");
+    q.bindValue(":oid", _p->relationOid(_p->_table));
+    q.bindValue(":id",  _p->_id);
     q.exec();
     if (q.first())
     {
@@ -333,6 +589,14 @@ bool AppLockProto::acquire(QString table, int id, enum AppLock::AcquireMode mode
   return false;
 }
 
+bool AppLockProto::acquireAll(QString table, QVariantList ids, enum AppLock::AcquireMode mode)
+{
+  AppLock *lock = qscriptvalue_cast<AppLock*>(thisObject());
+  if (lock)
+    return lock->acquireAll(table, ids, mode);
+  return false;
+}
+
 bool AppLockProto::holdsLock() const
 {
   AppLock *lock = qscriptvalue_cast<AppLock*>(thisObject());
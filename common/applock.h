@@ -11,8 +11,10 @@
 #ifndef __APPLOCK_H__
 #define __APPLOCK_H__
 
+#include <QList>
 #include <QMetaType>
 #include <QObject>
+#include <QPair>
 #include <QtScript>
 
 class AppLockPrivate;
@@ -33,6 +35,8 @@ class AppLock : public QObject
 
     Q_INVOKABLE bool    acquire(AcquireMode mode = Silent);
     Q_INVOKABLE bool    acquire(QString table, int id, AcquireMode mode = Silent);
+                bool    acquireAll(const QList<QPair<QString, int> > &docs, AcquireMode mode = Silent);
+    Q_INVOKABLE bool    acquireAll(QString table, QVariantList ids, AcquireMode mode = Silent);
     Q_INVOKABLE bool    holdsLock()   const;
     Q_INVOKABLE bool    isLockedOut() const;
     Q_INVOKABLE QString lastError()   const;
@@ -57,6 +61,7 @@ class AppLockProto : public QObject, public QScriptable
 
     Q_INVOKABLE bool    acquire(AppLock::AcquireMode mode);
     Q_INVOKABLE bool    acquire(QString table, int id, AppLock::AcquireMode mode);
+    Q_INVOKABLE bool    acquireAll(QString table, QVariantList ids, AppLock::AcquireMode mode);
     Q_INVOKABLE bool    holdsLock()   const;
     Q_INVOKABLE bool    isLockedOut() const;
     Q_INVOKABLE QString lastError()   const;
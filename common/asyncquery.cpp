@@ -0,0 +1,393 @@
+/*
+ * This file is part of the xTuple ERP: PostBooks Edition, a free and
+ * open source Enterprise Resource Planning software suite,
+ * Copyright (c) 1999-2019 by OpenMFG LLC, d/b/a xTuple.
+ * It is licensed to you under the Common Public Attribution License
+ * version 1.0, the full text of which (including xTuple-specific Exhibits)
+ * is available at www.xtuple.com/CPAL.  By using this software, you agree
+ * to be bound by its terms.
+ */
+
+#include "asyncquery.h"
+
+#include <QCoreApplication>
+#include <QList>
+#include <QMap>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QPair>
+#include <QRunnable>
+#include <QSqlDatabase>
+#include <QSqlDriver>
+#include <QSqlRecord>
+#include <QSqlResult>
+#include <QThreadPool>
+#include <QTimerEvent>
+#include <QVariant>
+#include <QVector>
+
+#include "connectionpool.h"
+
+#define DEBUG false
+
+// how many display queries may run at once, each on its own connection
+#define MAXTHREADS    2
+// how long an idle worker keeps its connection, in milliseconds
+#define THREADEXPIRY  300000
+// how often to repeat a cancel request the server may have missed, in milliseconds
+#define CANCELRETRY   250
+
+class AsyncQueryJob
+{
+  public:
+    AsyncQueryJob(AsyncQuery *pOwner, int pSerial, const QSqlQuery &pQuery)
+      : cancelled(false),
+        owner(pOwner),
+        pid(0),
+        serial(pSerial),
+        sql(pQuery.lastQuery())
+    {
+      QMap<QString, QVariant> values = pQuery.boundValues();
+      for (QMap<QString, QVariant>::const_iterator it = values.constBegin();
+           it != values.constEnd(); ++it)
+        bound.append(qMakePair(it.key(), it.value()));
+    }
+
+    // guards cancelled, owner and pid, which both threads use
+    QMutex      lock;
+    bool        cancelled;
+    AsyncQuery *owner;
+    int         pid;          // server process running the statement, 0 if none
+
+    int                                serial;
+    QString                            sql;
+    QList<QPair<QString, QVariant> >   bound;
+
+    // written by the worker, read by the GUI thread after finished()
+    QSqlError                   error;
+    QSqlRecord                  record;
+    QVector<QVector<QVariant> > rows;
+};
+
+/* A read-only, scrollable result over the rows a job read into memory. */
+class AsyncQueryResult : public QSqlResult
+{
+  public:
+    AsyncQueryResult(const QSqlDriver *pDriver, QSharedPointer<AsyncQueryJob> pJob)
+      : QSqlResult(pDriver),
+        _job(pJob)
+    {
+      // keep the bound values so boundValues() still reports them, for
+      // the QueryProfiler among others; the base prepare() only notes
+      // where the placeholders are
+      QSqlResult::prepare(pJob->sql);
+      for (int i = 0; i < pJob->bound.size(); i++)
+        bindValue(pJob->bound.at(i).first, pJob->bound.at(i).second, QSql::In);
+
+      setQuery(pJob->sql);
+      setSelect(true);
+      setActive(true);
+      setAt(QSql::BeforeFirstRow);
+    }
+
+    virtual QSqlRecord record() const { return _job->record; }
+
+  protected:
+    virtual QVariant data(int i)
+    {
+      const QVector<QVariant> &row = _job->rows.at(at());
+      return i >= 0 && i < row.size() ? row.at(i) : QVariant();
+    }
+
+    virtual bool isNull(int i)
+    {
+      return data(i).isNull();
+    }
+
+    virtual bool fetch(int i)
+    {
+      if (i < 0 || i >= _job->rows.size())
+        return false;
+      setAt(i);
+      return true;
+    }
+
+    virtual bool fetchFirst()      { return fetch(0); }
+    virtual bool fetchLast()       { return fetch(_job->rows.size() - 1); }
+    virtual int  numRowsAffected() { return 0; }
+    virtual bool reset(const QString &) { return false; }
+    virtual int  size()            { return _job->rows.size(); }
+
+    QSharedPointer<AsyncQueryJob> _job;
+};
+
+class AsyncQueryRunnable : public QRunnable
+{
+  public:
+    AsyncQueryRunnable(QSharedPointer<AsyncQueryJob> pJob)
+      : _job(pJob)
+    {
+    }
+
+    /* QSqlQuery rather than XSqlQuery: a cancelled statement is not an
+       error to log, and the error listeners belong to the GUI thread.
+     */
+    virtual void run()
+    {
+      QString      errmsg;
+      QSqlDatabase db = ConnectionPool::connection(&errmsg);
+      if (! db.isValid() || ! db.isOpen())
+        _job->error = QSqlError(errmsg, QString(), QSqlError::ConnectionError);
+      else
+        execute(db);
+
+      QMutexLocker locker(&_job->lock);
+      if (_job->owner)
+        QMetaObject::invokeMethod(_job->owner, "sFinished", Qt::QueuedConnection,
+                                  Q_ARG(int, _job->serial));
+    }
+
+  protected:
+    void execute(QSqlDatabase db)
+    {
+      QSqlQuery pidq(db);
+      pidq.exec("SELECT pg_backend_pid() AS pid;");
+
+      QSqlQuery query(db);
+      query.setForwardOnly(true);
+      if (! query.prepare(_job->sql))
+      {
+        _job->error = query.lastError();
+        return;
+      }
+      for (int i = 0; i < _job->bound.size(); i++)
+        query.bindValue(_job->bound.at(i).first, _job->bound.at(i).second);
+
+      {
+        QMutexLocker locker(&_job->lock);
+        if (_job->cancelled)
+          return;
+        if (pidq.first())
+          _job->pid = pidq.value("pid").toInt();
+      }
+
+      query.exec();
+
+      {
+        QMutexLocker locker(&_job->lock);
+        _job->pid = 0;
+        if (_job->cancelled)
+          return;
+      }
+
+      if (query.lastError().type() != QSqlError::NoError)
+      {
+        _job->error = query.lastError();
+        return;
+      }
+
+      _job->record = query.record();
+      int columns  = _job->record.count();
+      if (query.size() > 0)
+        _job->rows.reserve(query.size());
+      while (query.next())
+      {
+        QVector<QVariant> row(columns);
+        for (int i = 0; i < columns; i++)
+          row[i] = query.value(i);
+        _job->rows.append(row);
+      }
+    }
+
+    QSharedPointer<AsyncQueryJob> _job;
+};
+
+/* pg_cancel_backend() only stops a statement that is already running. The
+   worker publishes its backend pid just before it sends the statement, so
+   a cancel request can reach the server first and be ignored. Keep
+   repeating it until the worker reports the statement has returned, so a
+   cancelled query doesn't hold one of the few workers until it finishes.
+   This outlives the AsyncQuery that abandoned the job.
+ */
+class AsyncQueryCanceller : public QObject
+{
+  public:
+    AsyncQueryCanceller(QObject *pParent)
+      : QObject(pParent),
+        _timerId(0)
+    {
+    }
+
+    void add(QSharedPointer<AsyncQueryJob> pJob)
+    {
+      _jobs.append(pJob);
+      if (! _timerId)
+        _timerId = startTimer(CANCELRETRY);
+    }
+
+    // call with pJob->lock held
+    static void cancel(AsyncQueryJob *pJob)
+    {
+      if (DEBUG)
+        qDebug("AsyncQueryCanceller cancelling job %d on backend %d",
+               pJob->serial, pJob->pid);
+      XSqlQuery cancelq;
+      cancelq.prepare("SELECT pg_cancel_backend(:pid);");
+      cancelq.bindValue(":pid", pJob->pid);
+      cancelq.exec();
+    }
+
+  protected:
+    virtual void timerEvent(QTimerEvent *)
+    {
+      for (int i = 0; i < _jobs.size(); )
+      {
+        QMutexLocker locker(&_jobs.at(i)->lock);
+        if (_jobs.at(i)->pid > 0)
+        {
+          cancel(_jobs.at(i).data());
+          i++;
+        }
+        else
+        {
+          locker.unlock();
+          _jobs.removeAt(i);
+        }
+      }
+
+      if (_jobs.isEmpty())
+      {
+        killTimer(_timerId);
+        _timerId = 0;
+      }
+    }
+
+    QList<QSharedPointer<AsyncQueryJob> > _jobs;
+    int                                   _timerId;
+};
+
+static AsyncQueryCanceller *asyncQueryCanceller()
+{
+  static AsyncQueryCanceller *canceller = 0;
+  if (! canceller)
+    canceller = new AsyncQueryCanceller(QCoreApplication::instance());
+  return canceller;
+}
+
+static QThreadPool *asyncQueryPool()
+{
+  static QThreadPool *pool = 0;
+  if (! pool)
+  {
+    pool = new QThreadPool(QCoreApplication::instance());
+    pool->setMaxThreadCount(MAXTHREADS);
+    pool->setExpiryTimeout(THREADEXPIRY);
+  }
+  return pool;
+}
+
+AsyncQuery::AsyncQuery(QObject *pParent)
+  : QObject(pParent),
+    _serial(0)
+{
+}
+
+AsyncQuery::~AsyncQuery()
+{
+  abandon();
+}
+
+/** \brief Whether worker connections can be opened. If not, callers should
+           run their queries on the main connection as before.
+  */
+bool AsyncQuery::isAvailable()
+{
+  return ConnectionPool::isCaptured() || ConnectionPool::capture();
+}
+
+bool AsyncQuery::isRunning() const
+{
+  return ! _job.isNull();
+}
+
+/** \brief The error from the last query that finished, if it failed. */
+QSqlError AsyncQuery::lastError() const
+{
+  return _done.isNull() ? QSqlError() : _done->error;
+}
+
+/** \brief The rows returned by the last query that finished. */
+XSqlQuery AsyncQuery::result() const
+{
+  if (_done.isNull() || _done->error.type() != QSqlError::NoError)
+    return XSqlQuery();
+  return XSqlQuery(new AsyncQueryResult(QSqlDatabase::database().driver(), _done));
+}
+
+/** \brief Stop the running query, if any. Nothing it returns will be
+           reported.
+  */
+void AsyncQuery::cancel()
+{
+  if (_job.isNull())
+    return;
+
+  abandon();
+  emit cancelled();
+}
+
+/** \brief Run pQuery in the background, cancelling any query this object
+           is already running.
+
+    \param pQuery A query prepared and bound on the main connection but
+                  not executed.
+    \return false if worker connections are not available
+  */
+bool AsyncQuery::start(const QSqlQuery &pQuery)
+{
+  abandon();
+  _done.clear();
+  if (! isAvailable())
+    return false;
+
+  _job = QSharedPointer<AsyncQueryJob>(new AsyncQueryJob(this, ++_serial, pQuery));
+  asyncQueryPool()->start(new AsyncQueryRunnable(_job));
+
+  if (DEBUG)
+    qDebug("AsyncQuery::start() job %d", _serial);
+  return true;
+}
+
+/* Let go of the running job. If its statement may have reached the
+   server, ask the server to stop it, and keep asking until it does; the
+   worker skips the rest once it sees the job was cancelled. The lock
+   keeps the worker from moving on to another statement on the same
+   connection while a cancel request is being sent.
+ */
+void AsyncQuery::abandon()
+{
+  if (_job.isNull())
+    return;
+
+  QSharedPointer<AsyncQueryJob> job = _job;
+  _job.clear();
+
+  QMutexLocker locker(&job->lock);
+  job->cancelled = true;
+  job->owner     = 0;
+  if (job->pid > 0)
+  {
+    AsyncQueryCanceller::cancel(job.data());
+    asyncQueryCanceller()->add(job);
+  }
+}
+
+void AsyncQuery::sFinished(int pSerial)
+{
+  if (_job.isNull() || _job->serial != pSerial)
+    return;
+
+  _done = _job;
+  _job.clear();
+  emit finished();
+}
@@ -0,0 +1,77 @@
+/*
+ * This file is part of the xTuple ERP: PostBooks Edition, a free and
+ * open source Enterprise Resource Planning software suite,
+ * Copyright (c) 1999-2019 by OpenMFG LLC, d/b/a xTuple.
+ * It is licensed to you under the Common Public Attribution License
+ * version 1.0, the full text of which (including xTuple-specific Exhibits)
+ * is available at www.xtuple.com/CPAL.  By using this software, you agree
+ * to be bound by its terms.
+ */
+
+#ifndef __ASYNCQUERY_H__
+#define __ASYNCQUERY_H__
+
+#include <QObject>
+#include <QSharedPointer>
+#include <QSqlError>
+#include <QSqlQuery>
+
+#include <xsqlquery.h>
+
+class AsyncQueryJob;
+
+/**
+  @class AsyncQuery
+
+  @brief Runs a prepared query on a ConnectionPool connection so the GUI
+         thread does not wait for it.
+
+  start() takes a query that has been prepared and bound on the main
+  connection but not executed. The statement and its bound values are
+  run again on a worker thread's own connection and the rows are read
+  into memory there. finished() is emitted on the GUI thread when they
+  are ready, and result() returns them as an XSqlQuery that can be passed
+  to XTreeWidget::populate() like any other.
+
+  Only one query runs at a time. Calling start() while one is running
+  cancels it, so the last request wins. cancel() asks the server to stop
+  the statement with pg_cancel_backend() and drops whatever it returns.
+
+  Session state set up on the main connection, such as temporary tables
+  or a transaction in progress, is not visible to the worker connection;
+  queries that depend on it must keep running on the GUI thread.
+ */
+class AsyncQuery : public QObject
+{
+  Q_OBJECT
+
+  public:
+    AsyncQuery(QObject *pParent = 0);
+    virtual ~AsyncQuery();
+
+    static bool isAvailable();
+
+    Q_INVOKABLE bool      isRunning() const;
+    Q_INVOKABLE QSqlError lastError() const;
+    Q_INVOKABLE XSqlQuery result()    const;
+
+  public slots:
+    virtual void cancel();
+    virtual bool start(const QSqlQuery &pQuery);
+
+  signals:
+    void cancelled();
+    void finished();
+
+  protected slots:
+    virtual void sFinished(int pSerial);
+
+  protected:
+    void abandon();
+
+    QSharedPointer<AsyncQueryJob> _job;
+    QSharedPointer<AsyncQueryJob> _done;
+    int                           _serial;
+};
+
+#endif
@@ -14,24 +14,70 @@
 #include <QCursor>
 #include <QMessageBox>
 #include <QtNetwork>
-#include <QNetworkAccessManager>
 #include <QUrl>
 #include <QHostInfo>
 #include <QJsonDocument>
 #include <QJsonObject>
 
 #include "errorReporter.h"
+#include "xtNetworkRequestManager.h"
 
-AvalaraIntegration::AvalaraIntegration(bool listen) : TaxIntegration(listen)
+class AvalaraRequest
 {
-  restclient = new QNetworkAccessManager;
-  connect(restclient, SIGNAL(finished(QNetworkReply*)), this, SLOT(handleResponse(QNetworkReply*)));
+  public:
+    AvalaraRequest(QString pType, QString pOrderType, int pOrderId, QString pPayload,
+                   QStringList pConfig, QString pOrderNumber)
+      : config(pConfig),
+        orderId(pOrderId),
+        orderNumber(pOrderNumber),
+        orderType(pOrderType),
+        payload(pPayload),
+        type(pType)
+    {
+    }
+
+    // does a request for these arguments make this one obsolete?
+    bool supersededBy(QString pType, QString pOrderType, int pOrderId, QStringList pConfig) const
+    {
+      return type == pType &&
+             ((type == "test" && config == pConfig) ||
+              type == "taxcodes" ||
+              type == "taxexempt" ||
+              ((type == "createtransaction" ||
+                type == "committransaction" ||
+                type == "voidtransaction" ||
+                type == "refundtransaction") &&
+               orderType == pOrderType &&
+               orderId == pOrderId));
+    }
+
+    QStringList config;
+    int         orderId;
+    QString     orderNumber;
+    QString     orderType;
+    QString     payload;
+    QString     type;
+};
+
+#define MAXINFLIGHT   4
+#define URLCACHESIZE  64
+
+AvalaraIntegration::AvalaraIntegration(bool listen, QSqlDatabase pDb)
+  : TaxIntegration(listen, pDb),
+    _maxInFlight(MAXINFLIGHT),
+    _orderUrls(URLCACHESIZE)
+{
+  // the manager is shared with other callers in this thread, so
+  // handleResponse() ignores requests that aren't in replies
+  restclient = xtNetworkRequestManager::instance();
+  connect(restclient, SIGNAL(finished(xtNetworkRequest*)), this, SLOT(handleResponse(xtNetworkRequest*)));
 
   // Can't access metrics from here, but only queries once at startup and in setup
-  XSqlQuery service("SELECT fetchMetricText('ServerVersion') AS ServerVersion, "
-                    "       fetchMetricBool('NoAvaTaxCommit') AS NoAvaTaxCommit, "
-                    "       fetchMetricBool('LogTaxService') AS LogTaxService, "
-                    "       fetchMetricText('TaxServiceLogFile') AS TaxServiceLogFile;");
+  XSqlQuery service(_db);
+  service.exec("SELECT fetchMetricText('ServerVersion') AS ServerVersion, "
+               "       fetchMetricBool('NoAvaTaxCommit') AS NoAvaTaxCommit, "
+               "       fetchMetricBool('LogTaxService') AS LogTaxService, "
+               "       fetchMetricText('TaxServiceLogFile') AS TaxServiceLogFile;");
   if (service.first())
   {
     _ServerVersion = service.value("ServerVersion").toString();
@@ -48,101 +94,169 @@ AvalaraIntegration::AvalaraIntegration(bool listen) : TaxIntegration(listen)
   }
 }
 
+AvalaraIntegration::~AvalaraIntegration()
+{
+  qDeleteAll(_backlog);
+}
+
+int AvalaraIntegration::maxInFlight() const
+{
+  return _maxInFlight;
+}
+
+void AvalaraIntegration::setMaxInFlight(int pMax)
+{
+  _maxInFlight = qMax(1, pMax);
+  sendBacklog();
+}
+
+bool AvalaraIntegration::cachesResults() const
+{
+  return true;
+}
+
 void AvalaraIntegration::sendRequest(QString type, QString orderType, int orderId, QString payload, QStringList config, QString orderNumber)
 {
   if (_NoAvaTaxCommit &&
       (type == "committransaction" || type == "voidtransaction" || type == "refundtransaction"))
     return;
 
-  XSqlQuery build;
-  build.prepare("SELECT buildAvalaraUrl(:type, :orderType, :orderId, :url, :orderNumber) AS url, "
-                "       buildAvalaraHeaders(:account, :key) AS headers;");
-  build.bindValue(":type", type);
-  build.bindValue(":orderType", orderType);
-  build.bindValue(":orderId", orderId);
-  if (config.size() >= 3)
+  for (int i = 0; i < _backlog.size(); )
   {
-    build.bindValue(":account", config[0]);
-    build.bindValue(":key", config[1]);
-    build.bindValue(":url", config[2]);
+    if (_backlog.at(i)->supersededBy(type, orderType, orderId, config))
+      delete _backlog.takeAt(i);
+    else
+      i++;
   }
-  if (!orderNumber.isEmpty())
-    build.bindValue(":orderNumber", orderNumber);
-  build.exec();
 
-  if (build.first())
-  {
-    QNetworkRequest netrequest;
-    QJsonDocument doc = QJsonDocument::fromJson(payload.toUtf8());
+  AvalaraRequest request(type, orderType, orderId, payload, config, orderNumber);
+  if (replies.size() >= _maxInFlight)
+    _backlog.append(new AvalaraRequest(request));
+  else
+    startRequest(request);
+}
 
-    netrequest.setUrl(build.value("url").toString());
+void AvalaraIntegration::sendBacklog()
+{
+  while (replies.size() < _maxInFlight && ! _backlog.isEmpty())
+  {
+    AvalaraRequest *request = _backlog.takeFirst();
+    startRequest(*request);
+    delete request;
+  }
+}
 
-    foreach(QString header, build.value("headers").toString().split(","))
+void AvalaraIntegration::startRequest(const AvalaraRequest &request)
+{
+  // requests using the configured account build the same headers every
+  // time, and the same URL for the same order, so don't ask the database
+  // again while the order's URL is remembered
+  QString urlKey = (QStringList() << request.type << request.orderType
+                                  << QString::number(request.orderId)
+                                  << request.orderNumber).join("|");
+  QString url;
+  QString headers;
+  if (request.config.isEmpty() && _orderUrls.contains(urlKey) && ! _headers.isNull())
+  {
+    url     = *_orderUrls.object(urlKey);
+    headers = _headers;
+  }
+  else
+  {
+    XSqlQuery build(_db);
+    build.prepare("SELECT buildAvalaraUrl(:type, :orderType, :orderId, :url, :orderNumber) AS url, "
+                  "       buildAvalaraHeaders(:account, :key) AS headers;");
+    build.bindValue(":type", request.type);
+    build.bindValue(":orderType", request.orderType);
+    build.bindValue(":orderId", request.orderId);
+    if (request.config.size() >= 3)
     {
-      if (header.split(": ").size() > 1)
-        netrequest.setRawHeader(header.split(": ")[0].toUtf8(), header.split(": ")[1].toUtf8());
+      build.bindValue(":account", request.config[0]);
+      build.bindValue(":key", request.config[1]);
+      build.bindValue(":url", request.config[2]);
     }
-
-    netrequest.setRawHeader("X-Avalara-UID", QByteArray("a0o0b000003PfVt"));
-    netrequest.setRawHeader("X-Avalara-Client",
-                            (QString("xTuple; %1; REST; V2; %2")
-                             .arg(_ServerVersion)
-                             .arg(QHostInfo::localHostName())).toUtf8());
-
-    foreach (QNetworkReply* other, replies)
+    if (!request.orderNumber.isEmpty())
+      build.bindValue(":orderNumber", request.orderNumber);
+    build.exec();
+    if (!build.first())
     {
-      if (other->property("type") == type &&
-          ((other->property("type") == "test" &&
-            other->property("config") == config) ||
-           (other->property("type") == "taxcodes") ||
-           (other->property("type") == "taxexempt") ||
-           ((other->property("type") == "createtransaction" ||
-             other->property("type") == "committransaction" ||
-             other->property("type") == "voidtransaction" ||
-             other->property("type") == "refundtransaction") &&
-            other->property("orderType") == orderType &&
-            other->property("orderId") == orderId)))
-      {
-        other->abort();
-        replies.removeOne(other);
-      }
+      reportError(tr("Error building request"), build, __FILE__, __LINE__);
+      return;
     }
 
-    QNetworkReply* reply;
-    QDateTime time;
-    if (type == "test" || type == "taxcodes" || type == "taxexempt")
+    url     = build.value("url").toString();
+    headers = build.value("headers").toString();
+    if (request.config.isEmpty())
     {
-      timer.start();
-      time = QDateTime::currentDateTime();
-      reply = restclient->get(netrequest);
+      _orderUrls.insert(urlKey, new QString(url));
+      _headers = headers;
     }
-    else
+  }
+
+  QNetworkRequest netrequest;
+  QJsonDocument doc = QJsonDocument::fromJson(request.payload.toUtf8());
+
+  netrequest.setUrl(url);
+
+  foreach(QString header, headers.split(","))
+  {
+    if (header.split(": ").size() > 1)
+      netrequest.setRawHeader(header.split(": ")[0].toUtf8(), header.split(": ")[1].toUtf8());
+  }
+
+  netrequest.setRawHeader("X-Avalara-UID", QByteArray("a0o0b000003PfVt"));
+  netrequest.setRawHeader("X-Avalara-Client",
+                          (QString("xTuple; %1; REST; V2; %2")
+                           .arg(_ServerVersion)
+                           .arg(QHostInfo::localHostName())).toUtf8());
+
+  foreach (xtNetworkRequest* other, replies)
+  {
+    AvalaraRequest prior(other->property("type").toString(),
+                         other->property("orderType").toString(),
+                         other->property("orderId").toInt(), QString(),
+                         other->property("config").toStringList(), QString());
+    if (prior.supersededBy(request.type, request.orderType, request.orderId, request.config))
     {
-      timer.start();
-      time = QDateTime::currentDateTime();
-      reply = restclient->post(netrequest, doc.toJson(QJsonDocument::Compact));
+      replies.removeOne(other);
+      other->abort();
     }
-    reply->setProperty("type", type);
-    reply->setProperty("orderType", orderType);
-    reply->setProperty("orderId", orderId);
-    reply->setProperty("config", config);
-    reply->setProperty("request", QString::fromUtf8(doc.toJson(QJsonDocument::Compact)));
-    reply->setProperty("time", time);
-    replies.append(reply);
   }
 
-  ErrorReporter::error(QtCriticalMsg, 0, tr("Error building request"),
-                       build, __FILE__, __LINE__);
+  xtNetworkRequest* reply;
+  QDateTime time;
+  if (request.type == "test" || request.type == "taxcodes" || request.type == "taxexempt")
+  {
+    timer.start();
+    time = QDateTime::currentDateTime();
+    reply = restclient->get(netrequest);
+  }
+  else
+  {
+    timer.start();
+    time = QDateTime::currentDateTime();
+    reply = restclient->post(netrequest, doc.toJson(QJsonDocument::Compact));
+  }
+  reply->setProperty("type", request.type);
+  reply->setProperty("orderType", request.orderType);
+  reply->setProperty("orderId", request.orderId);
+  reply->setProperty("config", request.config);
+  reply->setProperty("request", QString::fromUtf8(doc.toJson(QJsonDocument::Compact)));
+  reply->setProperty("time", time);
+  replies.append(reply);
 }
 
-void AvalaraIntegration::handleResponse(QNetworkReply* reply)
+void AvalaraIntegration::handleResponse(xtNetworkRequest* reply)
 {
+  if (! replies.contains(reply))
+    return;
+
   int elapsed = timer.nsecsElapsed();
   QString orderType = reply->property("orderType").toString();
   int orderId = reply->property("orderId").toInt();
   QString type = reply->property("type").toString();
   QByteArray request = reply->property("request").toByteArray();
-  QByteArray response = reply->readAll();
+  QByteArray response = reply->response();
 
   if (_LogTaxService)
   {
@@ -180,17 +294,13 @@ void AvalaraIntegration::handleResponse(QNetworkReply* reply)
     log.close();
   }
 
-  if (reply->error() != QNetworkReply::OperationCanceledError)
-  {
-    QJsonObject responseJson = QJsonDocument::fromJson(response).object();
-    replies.removeOne(reply);
-    TaxIntegration::handleResponse(type, orderType, orderId, QString::fromUtf8(response), error(type, reply, responseJson));
-  }
-
-  reply->deleteLater();
+  QJsonObject responseJson = QJsonDocument::fromJson(response).object();
+  replies.removeOne(reply);
+  sendBacklog();
+  TaxIntegration::handleResponse(type, orderType, orderId, QString::fromUtf8(response), error(type, reply, responseJson));
 }
 
-QString AvalaraIntegration::error(QString type, QNetworkReply* reply, QJsonObject response)
+QString AvalaraIntegration::error(QString type, xtNetworkRequest* reply, QJsonObject response)
 {
   if (type == "test")
   {
@@ -201,7 +311,9 @@ QString AvalaraIntegration::error(QString type, QNetworkReply* reply, QJsonObjec
   }
   else if (type == "createtransaction")
   {
-    if (reply->error() != QNetworkReply::NoError)
+    if (reply->isTimedOut())
+      return reply->errorString();
+    else if (reply->error() != QNetworkReply::NoError)
     {
       QJsonObject err = response["error"].toObject();
       QString errcode = err["code"].toString();
@@ -223,18 +335,20 @@ QString AvalaraIntegration::error(QString type, QNetworkReply* reply, QJsonObjec
 
 void AvalaraIntegration::wait()
 {
-  if (!eventLoop.isRunning() && replies.size())
+  if (!eventLoop.isRunning() && (replies.size() || _backlog.size()))
   {
-    qApp->setOverrideCursor(Qt::WaitCursor);
+    if (isGuiThread())
+      qApp->setOverrideCursor(Qt::WaitCursor);
     eventLoop.exec();
   }
 }
 
 void AvalaraIntegration::done()
 {
-  if (replies.isEmpty())
+  if (replies.isEmpty() && _backlog.isEmpty() && eventLoop.isRunning())
   {
     eventLoop.quit();
-    qApp->restoreOverrideCursor();
+    if (isGuiThread())
+      qApp->restoreOverrideCursor();
   }
 }
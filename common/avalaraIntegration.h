@@ -13,31 +13,64 @@
 
 #include "taxIntegration.h"
 
-#include <QNetworkAccessManager>
+#include <QCache>
 #include <QEventLoop>
 
+class AvalaraRequest;
+class xtNetworkRequest;
+class xtNetworkRequestManager;
+
+/**
+  @class AvalaraIntegration
+
+  @brief Talks to the AvaTax REST service.
+
+  Requests are sent without blocking. At most maxInFlight() requests are
+  on the wire at once; the rest wait in a backlog, where a newer request
+  for the same order replaces an older one. wait() runs an event loop until
+  both the wire and the backlog are empty. Requests go through the
+  calling thread's xtNetworkRequestManager, so they share its keep-alive
+  connections and time out instead of waiting forever on a dead server.
+
+  The headers built by the database for the configured account are kept
+  for the life of the object. The URL depends on the request type and the
+  order, so the most recent URLCACHESIZE of those are kept, which covers
+  recalculating the documents being edited. The TaxIntegration result
+  cache answers repeated estimates for unchanged documents.
+ */
 class AvalaraIntegration : public TaxIntegration
 {
   Q_OBJECT
 
   public:
-    AvalaraIntegration(bool = false);
+    AvalaraIntegration(bool = false, QSqlDatabase = QSqlDatabase::database());
+    virtual ~AvalaraIntegration();
     void wait();
 
+    Q_INVOKABLE virtual int  maxInFlight() const;
+    Q_INVOKABLE virtual void setMaxInFlight(int);
+
   protected:
     using TaxIntegration::error;
     using TaxIntegration::handleResponse;
 
+    virtual bool        cachesResults() const;
     virtual void        sendRequest(QString, QString, int, QString, QStringList, QString);
-    virtual QString     error(QString, QNetworkReply*, QJsonObject);
+    virtual void        sendBacklog();
+    virtual void        startRequest(const AvalaraRequest &);
+    virtual QString     error(QString, xtNetworkRequest*, QJsonObject);
     virtual void        done();
 
   protected slots:
-    virtual void        handleResponse(QNetworkReply*);
+    virtual void        handleResponse(xtNetworkRequest*);
 
   private:
-    QNetworkAccessManager * restclient;
-    QList<QNetworkReply*> replies;
+    xtNetworkRequestManager * restclient;
+    QList<xtNetworkRequest*> replies;
+    QList<AvalaraRequest*> _backlog;
+    QString _headers;
+    int _maxInFlight;
+    QCache<QString, QString> _orderUrls;  // built URLs by type, order and number
     QEventLoop eventLoop;
     QString _ServerVersion;
     bool _NoAvaTaxCommit;
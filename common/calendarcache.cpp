@@ -0,0 +1,299 @@
+/*
+ * This file is part of the xTuple ERP: PostBooks Edition, a free and
+ * open source Enterprise Resource Planning software suite,
+ * Copyright (c) 1999-2019 by OpenMFG LLC, d/b/a xTuple.
+ * It is licensed to you under the Common Public Attribution License
+ * version 1.0, the full text of which (including xTuple-specific Exhibits)
+ * is available at www.xtuple.com/CPAL.  By using this software, you agree
+ * to be bound by its terms.
+ */
+
+#include "calendarcache.h"
+
+#include <QCoreApplication>
+#include <QSqlDriver>
+#include <QSqlError>
+#include <QStringList>
+#include <QVariant>
+#include <QtScript>
+
+#include "xsqlquery.h"
+
+#define DEBUG false
+
+// number of days of working-day answers fetched in one round-trip
+#define WORKDAYWINDOW 184
+
+// how long to trust the server date offset
+#define SERVERDATEAGE (60 * 60 * 1000)
+
+static CalendarCache *_calendarCache = 0;
+
+CalendarCache *CalendarCache::instance()
+{
+  if (! _calendarCache)
+    _calendarCache = new CalendarCache(QCoreApplication::instance());
+  return _calendarCache;
+}
+
+CalendarCache::CalendarCache(QObject *pParent)
+  : XCachedHashQObject(pParent),
+    _calendarsLoaded(false),
+    _serverOffset(0)
+{
+  _notice << "calhead" << "acalitem" << "rcalitem" << "whsweek" << "whscal";
+
+  QSqlDatabase db = QSqlDatabase::database();
+  if (db.isValid() && db.driver())
+  {
+    foreach (QString notice, _notice)
+    {
+      if (! db.driver()->subscribedToNotifications().contains(notice))
+        db.driver()->subscribeToNotification(notice);
+    }
+  }
+  _cachedOn = QDate::currentDate();
+}
+
+void CalendarCache::clear()
+{
+  if (DEBUG)
+    qDebug("CalendarCache::clear()");
+
+  _calendars.clear();
+  _calendarsLoaded = false;
+  _calendarType.clear();
+  _periods.clear();
+  _workingDays.clear();
+  _serverOffsetAge.invalidate();
+  _cachedOn = QDate::currentDate();
+
+  emit cleared();
+}
+
+QString CalendarCache::lastError() const
+{
+  return _lastError;
+}
+
+// relative calendars and working-day windows are anchored on today
+bool CalendarCache::checkToday()
+{
+  if (_cachedOn != QDate::currentDate())
+  {
+    clear();
+    return false;
+  }
+  return true;
+}
+
+/** \brief Return the server's current_date without asking the server
+           more than once an hour.
+
+    \return the date, or a null QDate if the server could not be asked
+  */
+QDate CalendarCache::currentDate()
+{
+  checkToday();
+  if (! _serverOffsetAge.isValid() || _serverOffsetAge.elapsed() > SERVERDATEAGE)
+  {
+    XSqlQuery dateq;
+    dateq.exec("SELECT current_date AS result;");
+    if (! dateq.first())
+    {
+      _lastError = dateq.lastError().text();
+      return QDate();
+    }
+    _serverOffset = QDate::currentDate().daysTo(dateq.value("result").toDate());
+    _serverOffsetAge.start();
+  }
+  return QDate::currentDate().addDays(_serverOffset);
+}
+
+/* Fetch the window of working-day answers containing pDate for one site.
+   calculatenextworkingdate() stays the single source of truth; we just
+   ask it about a whole window of days at once.
+ */
+bool CalendarCache::loadWorkingDays(int pSiteId, const QDate &pDate)
+{
+  qint64 julian = pDate.toJulianDay();
+  QDate start = QDate::fromJulianDay(julian - (julian % WORKDAYWINDOW));
+  QDate end   = start.addDays(WORKDAYWINDOW - 1);
+
+  XSqlQuery workq;
+  workq.prepare("SELECT day::DATE AS day,"
+                "       calculatenextworkingdate(:whsid, day::DATE, 0) AS result"
+                "  FROM generate_series(:start::DATE, :end::DATE,"
+                "                       INTERVAL '1 day') AS day;");
+  workq.bindValue(":whsid", pSiteId);
+  workq.bindValue(":start", start);
+  workq.bindValue(":end",   end);
+  workq.exec();
+
+  QMap<QDate, QDate> &days = _workingDays[pSiteId];
+  while (workq.next())
+    days.insert(workq.value("day").toDate(), workq.value("result").toDate());
+
+  if (workq.lastError().type() != QSqlError::NoError)
+  {
+    _lastError = workq.lastError().text();
+    return false;
+  }
+
+  if (DEBUG)
+    qDebug("CalendarCache loaded site %d from %s to %s", pSiteId,
+           qPrintable(start.toString(Qt::ISODate)),
+           qPrintable(end.toString(Qt::ISODate)));
+  return days.contains(pDate);
+}
+
+/** \brief Return the first working day at site pSiteId on or after pDate,
+           as calculatenextworkingdate(pSiteId, pDate, pDesired) would.
+
+    Only pDesired == 0 is answered from the cache; other offsets are rare
+    and are passed straight to the server.
+
+    \return the working date, or a null QDate on error (see lastError())
+  */
+QDate CalendarCache::nextWorkingDate(int pSiteId, const QDate &pDate, int pDesired)
+{
+  if (pSiteId < 0 || ! pDate.isValid())
+    return pDate;
+
+  if (pDesired != 0)
+  {
+    XSqlQuery workq;
+    workq.prepare("SELECT calculatenextworkingdate(:whsid, :date, :desired) AS result;");
+    workq.bindValue(":whsid",   pSiteId);
+    workq.bindValue(":date",    pDate);
+    workq.bindValue(":desired", pDesired);
+    workq.exec();
+    if (workq.first())
+      return checkWorkingDate(pSiteId, pDate, workq.value("result").toDate());
+    _lastError = workq.lastError().text();
+    return QDate();
+  }
+
+  checkToday();
+  QHash<int, QMap<QDate, QDate> >::const_iterator site = _workingDays.constFind(pSiteId);
+  if (site != _workingDays.constEnd())
+  {
+    QMap<QDate, QDate>::const_iterator day = site.value().constFind(pDate);
+    if (day != site.value().constEnd())
+      return day.value();
+  }
+
+  if (! loadWorkingDays(pSiteId, pDate))
+    return QDate();
+
+  return checkWorkingDate(pSiteId, pDate, _workingDays.value(pSiteId).value(pDate));
+}
+
+/* calculatenextworkingdate() returns NULL when a site's calendar has no
+   working day to offer, which is not a database error; say so.
+ */
+QDate CalendarCache::checkWorkingDate(int pSiteId, const QDate &pDate, const QDate &pResult)
+{
+  if (! pResult.isValid())
+    _lastError = tr("The work week calendar for site %1 has no working day "
+                    "on or after %2.").arg(pSiteId).arg(pDate.toString(Qt::ISODate));
+  return pResult;
+}
+
+bool CalendarCache::isWorkingDay(int pSiteId, const QDate &pDate)
+{
+  return nextWorkingDate(pSiteId, pDate) == pDate;
+}
+
+QList<QPair<int, QString> > CalendarCache::calendars()
+{
+  checkToday();
+  if (! _calendarsLoaded)
+  {
+    XSqlQuery calq;
+    calq.exec("SELECT calhead_id, calhead_name, calhead_type"
+              "  FROM calhead"
+              " ORDER BY calhead_name;");
+    while (calq.next())
+    {
+      _calendars.append(qMakePair(calq.value("calhead_id").toInt(),
+                                  calq.value("calhead_name").toString()));
+      _calendarType.insert(calq.value("calhead_id").toInt(),
+                           calq.value("calhead_type").toString());
+    }
+    if (calq.lastError().type() != QSqlError::NoError)
+      _lastError = calq.lastError().text();
+    else
+      _calendarsLoaded = true;
+  }
+  return _calendars;
+}
+
+/** \brief Return A for an absolute calendar, R for a relative one,
+           or an empty string if pCalheadId does not exist.
+  */
+QString CalendarCache::calendarType(int pCalheadId)
+{
+  (void)calendars();
+  return _calendarType.value(pCalheadId);
+}
+
+bool CalendarCache::loadPeriods(int pCalheadId)
+{
+  XSqlQuery periodq;
+  periodq.prepare("SELECT calitem_id, periodstart, periodend, periodname,"
+                  "       (formatDate(periodstart) || ' - ' || formatDate(periodend)) AS periodrange"
+                  "  FROM (SELECT acalitem_id AS calitem_id, acalitem_name AS periodname,"
+                  "               findPeriodStart(acalitem_id) AS periodstart,"
+                  "               findPeriodEnd(acalitem_id) AS periodend"
+                  "          FROM acalitem"
+                  "          JOIN calhead ON (acalitem_calhead_id=calhead_id AND calhead_type='A')"
+                  "         WHERE (acalitem_calhead_id=:calhead_id)"
+                  "         UNION ALL"
+                  "        SELECT rcalitem_id, rcalitem_name,"
+                  "               findPeriodStart(rcalitem_id),"
+                  "               findPeriodEnd(rcalitem_id)"
+                  "          FROM rcalitem"
+                  "          JOIN calhead ON (rcalitem_calhead_id=calhead_id AND calhead_type='R')"
+                  "         WHERE (rcalitem_calhead_id=:calhead_id)) AS data"
+                  " ORDER BY periodstart;");
+  periodq.bindValue(":calhead_id", pCalheadId);
+  periodq.exec();
+
+  QList<CalendarPeriod> periods;
+  while (periodq.next())
+  {
+    CalendarPeriod period;
+    period.id    = periodq.value("calitem_id").toInt();
+    period.start = periodq.value("periodstart").toDate();
+    period.end   = periodq.value("periodend").toDate();
+    period.name  = periodq.value("periodname").toString();
+    period.range = periodq.value("periodrange").toString();
+    periods.append(period);
+  }
+  if (periodq.lastError().type() != QSqlError::NoError)
+  {
+    _lastError = periodq.lastError().text();
+    return false;
+  }
+
+  _periods.insert(pCalheadId, periods);
+  return true;
+}
+
+/** \brief Return the periods of calendar pCalheadId in date order.
+  */
+QList<CalendarPeriod> CalendarCache::periods(int pCalheadId)
+{
+  checkToday();
+  if (! _periods.contains(pCalheadId))
+    (void)loadPeriods(pCalheadId);
+  return _periods.value(pCalheadId);
+}
+
+void setupCalendarCache(QScriptEngine *engine)
+{
+  engine->globalObject().setProperty("CalendarCache",
+                                     engine->newQObject(CalendarCache::instance()),
+                                     QScriptValue::ReadOnly | QScriptValue::Undeletable);
+}
@@ -0,0 +1,97 @@
+/*
+ * This file is part of the xTuple ERP: PostBooks Edition, a free and
+ * open source Enterprise Resource Planning software suite,
+ * Copyright (c) 1999-2019 by OpenMFG LLC, d/b/a xTuple.
+ * It is licensed to you under the Common Public Attribution License
+ * version 1.0, the full text of which (including xTuple-specific Exhibits)
+ * is available at www.xtuple.com/CPAL.  By using this software, you agree
+ * to be bound by its terms.
+ */
+
+#ifndef __CALENDARCACHE_H__
+#define __CALENDARCACHE_H__
+
+#include <QDate>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QList>
+#include <QMap>
+#include <QPair>
+#include <QString>
+
+#include "xcachedhash.h"
+
+class QScriptEngine;
+
+class CalendarPeriod
+{
+  public:
+    CalendarPeriod() : id(-1) { }
+
+    int     id;
+    QDate   start;
+    QDate   end;
+    QString name;
+    QString range;
+};
+
+/**
+  @class CalendarCache
+
+  @brief Client-side copy of site working calendars and calendar periods.
+
+  Site working days are fetched from the server's calculatenextworkingdate()
+  a window of days at a time, so the answers always match the server and a
+  form that sets many dates costs one round-trip per site and window.
+  Calendar lists and period ranges are fetched once per calendar.
+
+  The server date is fetched once an hour and tracked against the local
+  clock in between. Everything is dropped when a calendar table sends a
+  notification, when the GUI client reports the connection lost, or when
+  the date changes
+  (relative calendars are anchored on today).
+ */
+class CalendarCache : public XCachedHashQObject
+{
+  Q_OBJECT
+
+  public:
+    static CalendarCache *instance();
+
+    Q_INVOKABLE QString calendarType(int pCalheadId);
+    Q_INVOKABLE QDate   currentDate();
+    Q_INVOKABLE bool    isWorkingDay(int pSiteId, const QDate &pDate);
+    Q_INVOKABLE QDate   nextWorkingDate(int pSiteId, const QDate &pDate, int pDesired = 0);
+
+    QList<QPair<int, QString> > calendars();
+    QList<CalendarPeriod>       periods(int pCalheadId);
+    QString                     lastError() const;
+
+  public slots:
+    virtual void clear();
+
+  signals:
+    void cleared();
+
+  protected:
+    CalendarCache(QObject *pParent = 0);
+
+    bool  checkToday();
+    QDate checkWorkingDate(int pSiteId, const QDate &pDate, const QDate &pResult);
+    bool loadPeriods(int pCalheadId);
+    bool loadWorkingDays(int pSiteId, const QDate &pDate);
+
+    QList<QPair<int, QString> >          _calendars;
+    bool                                 _calendarsLoaded;
+    QHash<int, QString>                  _calendarType;
+    QDate                                _cachedOn;
+    QString                              _lastError;
+    QHash<int, QList<CalendarPeriod> >   _periods;
+    int                                  _serverOffset;
+    QElapsedTimer                        _serverOffsetAge;
+    QHash<int, QMap<QDate, QDate> >      _workingDays;
+};
+
+void setupCalendarCache(QScriptEngine *engine);
+
+#endif
@@ -28,15 +28,21 @@ QMAKE_LIBDIR += $${OPENRPT_LIBDIR}
 LIBS += -lopenrptcommon -lMetaSQL -lz
 
 SOURCES = applock.cpp              \
+          asyncquery.cpp \
           avalaraIntegration.cpp \
+          calendarcache.cpp        \
           calendarcontrol.cpp      \
           calendargraphicsitem.cpp \
           checkForUpdates.cpp      \
           cmdlinemessagehandler.cpp \
+          connectionpool.cpp \
           errorReporter.cpp        \
           exporthelper.cpp \
           guimessagehandler.cpp \
           importhelper.cpp \
+          importscheduler.cpp \
+          invoiceposter.cpp \
+          itembundle.cpp \
           format.cpp \
           graphicstextbuttonitem.cpp \
           gunzip.cpp \
@@ -47,6 +53,7 @@ SOURCES = applock.cpp              \
           noIntegration.cpp \
           qbase64encode.cpp \
           qmd5.cpp \
+          queryprofiler.cpp \
           shortcuts.cpp \
           statusbarmessagehandler.cpp \
           storedProcErrorLookup.cpp \
@@ -60,14 +67,20 @@ SOURCES = applock.cpp              \
           xtsettings.cpp
 
 HEADERS = applock.h              \
+          asyncquery.h \
           avalaraIntegration.h \
+          calendarcache.h        \
           calendarcontrol.h      \
           calendargraphicsitem.h \
           cmdlinemessagehandler.h \
           checkForUpdates.h      \
+          connectionpool.h \
           errorReporter.h        \
           exporthelper.h \
           importhelper.h \
+          importscheduler.h \
+          invoiceposter.h \
+          itembundle.h \
           format.h \
           graphicstextbuttonitem.h \
           guimessagehandler.h \
@@ -79,6 +92,7 @@ HEADERS = applock.h              \
           noIntegration.h \
           qbase64encode.h \
           qmd5.h \
+          queryprofiler.h \
           shortcuts.h \
           statusbarmessagehandler.h \
           storedProcErrorLookup.h \
@@ -0,0 +1,174 @@
+/*
+ * This file is part of the xTuple ERP: PostBooks Edition, a free and
+ * open source Enterprise Resource Planning software suite,
+ * Copyright (c) 1999-2019 by OpenMFG LLC, d/b/a xTuple.
+ * It is licensed to you under the Common Public Attribution License
+ * version 1.0, the full text of which (including xTuple-specific Exhibits)
+ * is available at www.xtuple.com/CPAL.  By using this software, you agree
+ * to be bound by its terms.
+ */
+
+#include "connectionpool.h"
+
+#include <QCoreApplication>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QSqlError>
+#include <QSqlQuery>
+#include <QThread>
+#include <QThreadStorage>
+#include <QVariant>
+
+#define DEBUG false
+
+struct ConnectionParams
+{
+  ConnectionParams() : port(-1), captured(false) { }
+
+  QString driver;
+  QString host;
+  QString database;
+  QString user;
+  QString password;
+  QString options;
+  int     port;
+  QString searchPath;
+  QString timeZone;
+  bool    captured;
+};
+
+static QMutex           _paramLock;
+static ConnectionParams _params;
+
+/* Owned by QThreadStorage, which deletes it when the worker thread exits.
+   The QSqlDatabase handle must go out of scope before removeDatabase().
+ */
+class WorkerConnection
+{
+  public:
+    WorkerConnection(const QString &pName) : name(pName) { }
+    ~WorkerConnection()
+    {
+      {
+        QSqlDatabase db = QSqlDatabase::database(name, false);
+        if (db.isOpen())
+          db.close();
+      }
+      QSqlDatabase::removeDatabase(name);
+      if (DEBUG)
+        qDebug("ConnectionPool removed %s", qPrintable(name));
+    }
+
+    QString name;
+};
+
+static QThreadStorage<WorkerConnection*> _worker;
+
+/** \brief Remember how the main connection was opened so worker threads
+           can open their own.
+
+    This must be called from the thread that owns pSource, normally the
+    GUI thread right after login2 accepts.
+  */
+bool ConnectionPool::capture(QSqlDatabase pSource)
+{
+  if (! pSource.isValid() || ! pSource.isOpen())
+    return false;
+
+  ConnectionParams params;
+  params.driver   = pSource.driverName();
+  params.host     = pSource.hostName();
+  params.database = pSource.databaseName();
+  params.user     = pSource.userName();
+  params.password = pSource.password();
+  params.options  = pSource.connectOptions();
+  params.port     = pSource.port();
+
+  QSqlQuery sessq(pSource);
+  sessq.exec("SELECT current_setting('search_path') AS searchpath,"
+             "       current_setting('TimeZone')    AS timezone;");
+  if (sessq.first())
+  {
+    params.searchPath = sessq.value("searchpath").toString();
+    params.timeZone   = sessq.value("timezone").toString();
+  }
+  params.captured = true;
+
+  QMutexLocker locker(&_paramLock);
+  _params = params;
+  return true;
+}
+
+bool ConnectionPool::isCaptured()
+{
+  QMutexLocker locker(&_paramLock);
+  return _params.captured;
+}
+
+QSqlDatabase ConnectionPool::connection(QString *pErrMsg)
+{
+  QCoreApplication *app = QCoreApplication::instance();
+  if (! app || QThread::currentThread() == app->thread())
+    return QSqlDatabase::database();
+
+  if (_worker.hasLocalData())
+  {
+    QSqlDatabase db = QSqlDatabase::database(_worker.localData()->name);
+    if (db.isOpen())
+      return db;
+  }
+
+  ConnectionParams params;
+  {
+    QMutexLocker locker(&_paramLock);
+    params = _params;
+  }
+  if (! params.captured)
+  {
+    if (pErrMsg)
+      *pErrMsg = QObject::tr("The worker database connection was requested "
+                             "before the main connection was captured.");
+    return QSqlDatabase();
+  }
+
+  QString name = QString("xtworker%1").arg((quintptr)QThread::currentThreadId());
+  if (! _worker.hasLocalData())
+    _worker.setLocalData(new WorkerConnection(name));
+
+  QSqlDatabase db = QSqlDatabase::contains(name)
+                  ? QSqlDatabase::database(name, false)
+                  : QSqlDatabase::addDatabase(params.driver, name);
+  db.setHostName(params.host);
+  db.setDatabaseName(params.database);
+  db.setUserName(params.user);
+  db.setPassword(params.password);
+  db.setConnectOptions(params.options);
+  db.setPort(params.port);
+  if (! db.open())
+  {
+    if (pErrMsg)
+      *pErrMsg = db.lastError().text();
+    return QSqlDatabase();
+  }
+
+  // QSqlQuery rather than XSqlQuery: this runs on the worker thread
+  QSqlQuery setupq(db);
+  setupq.exec("SELECT login(false) AS result;");
+  setupq.prepare("SELECT set_config('search_path', :path, false),"
+                 "       set_config('TimeZone',    :tz,   false);");
+  setupq.bindValue(":path", params.searchPath);
+  setupq.bindValue(":tz",   params.timeZone);
+  setupq.exec();
+  if (setupq.lastError().type() != QSqlError::NoError)
+  {
+    if (pErrMsg)
+      *pErrMsg = setupq.lastError().databaseText();
+    db.close();
+    return QSqlDatabase();
+  }
+
+  if (DEBUG)
+    qDebug("ConnectionPool opened %s", qPrintable(name));
+
+  return db;
+}
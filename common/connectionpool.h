@@ -0,0 +1,38 @@
+/*
+ * This file is part of the xTuple ERP: PostBooks Edition, a free and
+ * open source Enterprise Resource Planning software suite,
+ * Copyright (c) 1999-2019 by OpenMFG LLC, d/b/a xTuple.
+ * It is licensed to you under the Common Public Attribution License
+ * version 1.0, the full text of which (including xTuple-specific Exhibits)
+ * is available at www.xtuple.com/CPAL.  By using this software, you agree
+ * to be bound by its terms.
+ */
+
+#ifndef __CONNECTIONPOOL_H__
+#define __CONNECTIONPOOL_H__
+
+#include <QSqlDatabase>
+#include <QString>
+
+/**
+  @class ConnectionPool
+
+  @brief Hands out one database connection per thread, all logged in as the
+         same user as the application's main connection.
+
+  QSqlDatabase connections may only be used by the thread that opened them,
+  so code running on a QThreadPool worker cannot share the default
+  connection. Call capture() once on the GUI thread after login; after
+  that connection() may be called from any thread. On the GUI thread it
+  returns the default connection. On any other thread it opens a private
+  connection the first time it is asked and closes it when the thread exits.
+ */
+class ConnectionPool
+{
+  public:
+    static bool         capture(QSqlDatabase pSource = QSqlDatabase::database());
+    static bool         isCaptured();
+    static QSqlDatabase connection(QString *pErrMsg = 0);
+};
+
+#endif
@@ -522,12 +522,12 @@ bool ExportHelper::XSLTConvertFile(QString inputfilename, QString outputfilename
   return returnVal;
 }
 
-bool ExportHelper::XSLTConvertFile(QString inputfilename, QString outputfilename, QString xsltfilename, QString &errmsg)
+bool ExportHelper::XSLTConvertFile(QString inputfilename, QString outputfilename, QString xsltfilename, QString &errmsg, QSqlDatabase db)
 {
   QString xsltdir;
   QString xsltcmd;
 
-  XSqlQuery q;
+  XSqlQuery q(db);
   q.prepare("SELECT fetchMetricText(:xsltdir) AS dir,"
             "       fetchMetricText(:xsltcmd) AS cmd;");
 #if defined Q_OS_MAC
@@ -15,6 +15,7 @@
 #include <QDomNode>
 #include <QFile>
 #include <QObject>
+#include <QSqlDatabase>
 #include <QString>
 
 #include <parameter.h>
@@ -36,7 +37,7 @@ class ExportHelper : public QObject
     static QString generateHTML(QString qtext, ParameterList &params, QString &errmsg);
     static QString generateXML(const int qryheadid, ParameterList &params, QString &errmsg, int xsltmapid = -1);
     static QString generateXML(QString qtext, QString tableElemName, ParameterList &params, QString &errmsg, int xsltmapid = -1);
-    static bool    XSLTConvertFile(QString inputfilename, QString outputfilename, QString xsltfilename, QString &errmsg);
+    static bool    XSLTConvertFile(QString inputfilename, QString outputfilename, QString xsltfilename, QString &errmsg, QSqlDatabase db = QSqlDatabase::database());
     static bool    XSLTConvertFile(QString inputfilename, QString outputfilename, int xsltmapid, QString &errmsg);
     static QString XSLTConvertString(QString input, int xsltmapid, QString &errmsg);
     static QStringList parseDelim(QString delim);
@@ -122,7 +122,7 @@ CSVImpPluginInterface *ImportHelper::getCSVImpPlugin(QObject *parent)
     \return true if the file was handled successfully, false if there was an
                  error moving or deleting the file.
   */
-bool ImportHelper::handleFilePostImport(const QString &pfilename, bool success, QString &errmsg, const QString &saveToErrorFile)
+bool ImportHelper::handleFilePostImport(const QString &pfilename, bool success, QString &errmsg, const QString &saveToErrorFile, QSqlDatabase db)
 {
   if (DEBUG)
     qDebug("handleFilePostImport(%s, %d, errmsg, %s)",
@@ -137,7 +137,7 @@ bool ImportHelper::handleFilePostImport(const QString &pfilename, bool success,
   QString errfiledir;
   QString errfilesuffix;
   QString errtreatment;
-  XSqlQuery q;
+  XSqlQuery q(db);
 
   q.prepare("SELECT fetchMetricText(:xmldir)               AS xmldir,"
             "       fetchMetricText('XMLSuccessDir')       AS successdir,"
@@ -359,7 +359,7 @@ bool ImportHelper::importCSV(const QString &pFileName, QString &errmsg)
   return errmsg.isEmpty();
 }
 
-bool ImportHelper::importXML(const QString &pFileName, QString &errmsg, QString &warnmsg)
+bool ImportHelper::importXML(const QString &pFileName, QString &errmsg, QString &warnmsg, QSqlDatabase db)
 {
   if (DEBUG)
     qDebug("ImportHelper::importXML(%s, errmsg)", qPrintable(pFileName));
@@ -371,7 +371,7 @@ bool ImportHelper::importXML(const QString &pFileName, QString &errmsg, QString
   QStringList warnings;
   bool        saveErrorXML = false;
 
-  XSqlQuery q;
+  XSqlQuery q(db);
   q.prepare("SELECT fetchMetricText(:xmldir)  AS xmldir,"
             "       fetchMetricText(:xsltdir) AS xsltdir,"
             "       fetchMetricText(:xsltcmd) AS xsltcmd,"
@@ -427,7 +427,7 @@ bool ImportHelper::importXML(const QString &pFileName, QString &errmsg, QString
   if (doctype != "xtupleimport")
   {
     QString xsltfile;
-    XSqlQuery q;
+    XSqlQuery q(db);
     q.prepare("SELECT xsltmap_import FROM xsltmap "
               "WHERE ((xsltmap_doctype=:doctype OR xsltmap_doctype='')"
               "   AND (xsltmap_system=:system   OR xsltmap_system=''));");
@@ -454,7 +454,7 @@ bool ImportHelper::importXML(const QString &pFileName, QString &errmsg, QString
 
     if (! ExportHelper::XSLTConvertFile(pFileName, tmpfileName,
                                         q.value("xsltmap_import").toString(),
-                                        errmsg))
+                                        errmsg, db))
       return false;
 
     if (! openDomDocument(tmpfileName, doc, errmsg))
@@ -486,7 +486,7 @@ bool ImportHelper::importXML(const QString &pFileName, QString &errmsg, QString
     return false;
   }
 
-  XSqlQuery rollback;
+  XSqlQuery rollback(db);
   rollback.prepare("ROLLBACK;");
 
   QRegExp apos("\\\\*'");
@@ -519,7 +519,7 @@ bool ImportHelper::importXML(const QString &pFileName, QString &errmsg, QString
 
     QString savepointName = viewName;
     savepointName.remove(".");
-    XSqlQuery rollbacktosavepoint;
+    XSqlQuery rollbacktosavepoint(db);
     if (ignoreErr || saveErrorXML)
     {
       q.exec("SAVEPOINT " + savepointName + ";");
@@ -659,7 +659,8 @@ bool ImportHelper::importXML(const QString &pFileName, QString &errmsg, QString
                              errors.size() == 0,
                              fileerrmsg,
                              errorRoot.hasChildNodes() ? errorDoc.toString()
-                                                       : QString()))
+                                                       : QString(),
+                             db))
   {
     errors.append(fileerrmsg);
     return false;
@@ -14,6 +14,7 @@
 
 #include <QDomDocument>
 #include <QObject>
+#include <QSqlDatabase>
 #include <QString>
 
 #include <parameter.h>
@@ -28,9 +29,9 @@ class ImportHelper : public QObject
 
   public:
     static CSVImpPluginInterface *getCSVImpPlugin(QObject *parent = 0);
-    static bool handleFilePostImport(const QString &pFileName, bool success, QString &errmsg, const QString &saveToErrorFile = QString::null);
+    static bool handleFilePostImport(const QString &pFileName, bool success, QString &errmsg, const QString &saveToErrorFile = QString::null, QSqlDatabase db = QSqlDatabase::database());
     static bool importCSV(const QString &pFileName, QString &errmsg);
-    static bool importXML(const QString &pFileName, QString &errmsg, QString &warnmsg);
+    static bool importXML(const QString &pFileName, QString &errmsg, QString &warnmsg, QSqlDatabase db = QSqlDatabase::database());
     static bool openDomDocument(const QString &pFileName, QDomDocument &pDoc, QString &errmsg);
 
   protected:
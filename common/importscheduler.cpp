@@ -0,0 +1,549 @@
+/*
+ * This file is part of the xTuple ERP: PostBooks Edition, a free and
+ * open source Enterprise Resource Planning software suite,
+ * Copyright (c) 1999-2019 by OpenMFG LLC, d/b/a xTuple.
+ * It is licensed to you under the Common Public Attribution License
+ * version 1.0, the full text of which (including xTuple-specific Exhibits)
+ * is available at www.xtuple.com/CPAL.  By using this software, you agree
+ * to be bound by its terms.
+ */
+
+#include "importscheduler.h"
+
+#include <QCoreApplication>
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+#include <QFileSystemWatcher>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QRegExp>
+#include <QRunnable>
+#include <QSqlDatabase>
+#include <QThread>
+#include <QTimer>
+#include <QXmlStreamReader>
+
+#include "connectionpool.h"
+#include "importhelper.h"
+
+#define DEBUG false
+
+// wait this long after the last directory change before looking for files
+#define RESCANDELAY 250
+
+class ImportJob
+{
+  public:
+    ImportJob(const QString &pFileName, int pType)
+      : attempts(0),
+        fileName(pFileName),
+        status(ImportScheduler::Queued),
+        type(pType)
+    {
+      size    = QFileInfo(pFileName).size();
+      targets = ImportScheduler::targets(pFileName, pType);
+    }
+
+    int         attempts;
+    QString     fileName;
+    QString     message;
+    qint64      size;
+    int         status;
+    QStringList targets;
+    int         type;
+};
+
+/* Lets a running import find out whether its scheduler is still there.
+   The scheduler clears it when it is destroyed instead of waiting for
+   imports that are already running.
+ */
+class ImportSchedulerLink
+{
+  public:
+    ImportSchedulerLink(ImportScheduler *pScheduler)
+      : scheduler(pScheduler)
+    {
+    }
+
+    QMutex           lock;
+    ImportScheduler *scheduler;
+};
+
+class ImportRunnable : public QRunnable
+{
+  public:
+    ImportRunnable(QSharedPointer<ImportSchedulerLink> pLink, const QString &pFileName)
+      : _fileName(pFileName),
+        _link(pLink)
+    {
+    }
+
+    virtual void run()
+    {
+      QString errmsg;
+      QString warnmsg;
+      bool    success   = false;
+      QSqlDatabase db   = ConnectionPool::connection(&errmsg);
+      bool    connected = db.isValid() && db.isOpen();
+      if (connected)
+        success = ImportHelper::importXML(_fileName, errmsg, warnmsg, db);
+
+      QMutexLocker locker(&_link->lock);
+      if (_link->scheduler)
+        QMetaObject::invokeMethod(_link->scheduler, "sFinished", Qt::QueuedConnection,
+                                  Q_ARG(QString, _fileName),
+                                  Q_ARG(bool,    connected),
+                                  Q_ARG(bool,    success),
+                                  Q_ARG(QString, errmsg),
+                                  Q_ARG(QString, warnmsg));
+    }
+
+  protected:
+    QString                             _fileName;
+    QSharedPointer<ImportSchedulerLink> _link;
+};
+
+ImportScheduler::ImportScheduler(QObject *parent)
+  : QObject(parent),
+    _autoImport(false),
+    _bytes(0),
+    _done(0),
+    _errors(0),
+    _link(new ImportSchedulerLink(this)),
+    _maxAttempts(3),
+    _running(0),
+    _watcher(0)
+{
+  _nameFilters << "*.xml" << "*.XML";
+  _pool = new QThreadPool();
+  _pool->setMaxThreadCount(qBound(1, QThread::idealThreadCount(), 4));
+  ConnectionPool::capture();
+
+  _rescanTimer = new QTimer(this);
+  _rescanTimer->setSingleShot(true);
+  _rescanTimer->setInterval(RESCANDELAY);
+  connect(_rescanTimer, SIGNAL(timeout()), this, SLOT(rescan()));
+}
+
+/* Drop the imports that haven't started. Imports already running finish
+   on their own connections without reporting back; the pool is only
+   deleted here if none are left, since deleting it waits for them.
+ */
+ImportScheduler::~ImportScheduler()
+{
+  _queue.clear();
+  _pool->clear();
+  {
+    QMutexLocker locker(&_link->lock);
+    _link->scheduler = 0;
+  }
+  if (_pool->activeThreadCount() == 0)
+    delete _pool;
+  else
+    _pool->setParent(QCoreApplication::instance());
+  qDeleteAll(_jobs);
+}
+
+QString ImportScheduler::directory() const
+{
+  return _directory;
+}
+
+bool ImportScheduler::isAutoImport() const
+{
+  return _autoImport;
+}
+
+bool ImportScheduler::isIdle() const
+{
+  return _running == 0 && _queue.isEmpty();
+}
+
+bool ImportScheduler::isWatching() const
+{
+  return _watcher != 0;
+}
+
+int ImportScheduler::maxAttempts() const
+{
+  return _maxAttempts;
+}
+
+int ImportScheduler::maxConnections() const
+{
+  return _pool->maxThreadCount();
+}
+
+QString ImportScheduler::message(const QString &pFileName) const
+{
+  ImportJob *job = _jobs.value(pFileName);
+  return job ? job->message : QString();
+}
+
+QStringList ImportScheduler::nameFilters() const
+{
+  return _nameFilters;
+}
+
+int ImportScheduler::status(const QString &pFileName) const
+{
+  ImportJob *job = _jobs.value(pFileName);
+  return job ? job->status : -1;
+}
+
+int ImportScheduler::doneCount() const
+{
+  return _done;
+}
+
+int ImportScheduler::errorCount() const
+{
+  return _errors;
+}
+
+double ImportScheduler::filesPerMinute() const
+{
+  if (! _elapsed.isValid() || _elapsed.elapsed() <= 0)
+    return 0;
+  return (_done + _errors) * 60000.0 / _elapsed.elapsed();
+}
+
+qint64 ImportScheduler::bytesImported() const
+{
+  return _bytes;
+}
+
+int ImportScheduler::pendingCount() const
+{
+  return _queue.size() + _running;
+}
+
+/** \brief Guess whether a file holds XML or CSV/TSV data from its suffix.
+ */
+int ImportScheduler::fileType(const QString &pFileName)
+{
+  QString suffix = QFileInfo(pFileName).suffix().toUpper();
+  if (suffix == "XML")
+    return Xml;
+  else if (suffix == "CSV" || suffix == "TSV")
+    return Csv;
+  return Unknown;
+}
+
+/** \brief Return the names of the views or document types pFileName writes to.
+
+    Two files that share a target are never imported at the same time.
+    xtupleimport documents name their views directly. Other XML documents
+    go through an XSLT map first, so the best we can do is serialize on the
+    document type. All CSV imports share the CSVImp plugin and so share
+    a single target.
+  */
+QStringList ImportScheduler::targets(const QString &pFileName, int pType)
+{
+  QStringList result;
+  if (pType != Xml)
+  {
+    result << "csv";
+    return result;
+  }
+
+  QFile file(pFileName);
+  if (! file.open(QIODevice::ReadOnly))
+  {
+    result << "file:" + pFileName;
+    return result;
+  }
+
+  QXmlStreamReader xml(&file);
+  QString doctype;
+  while (! xml.atEnd() && ! xml.isStartElement())
+  {
+    xml.readNext();
+    if (xml.isDTD() && ! xml.dtdName().isEmpty())
+      doctype = xml.dtdName().toString();
+  }
+  if (doctype.isEmpty())
+    doctype = xml.name().toString();
+
+  if (doctype != "xtupleimport")
+    result << "doctype:" + doctype;
+  else
+  {
+    while (xml.readNextStartElement())
+    {
+      QString viewName = xml.name().toString();
+      if (viewName.indexOf(".") > 0)
+        ;
+      else if (! xml.attributes().value("schema").isEmpty())
+        viewName = xml.attributes().value("schema").toString() + "." + viewName;
+      else
+        viewName = "api." + viewName;
+
+      if (! result.contains(viewName))
+        result << viewName;
+      xml.skipCurrentElement();
+    }
+  }
+
+  if (result.isEmpty() || xml.hasError())
+    result << "file:" + pFileName;
+
+  if (DEBUG)
+    qDebug("ImportScheduler::targets(%s) returning %s",
+           qPrintable(pFileName), qPrintable(result.join(", ")));
+  return result;
+}
+
+/** \brief Add pFileName to the import queue.
+
+    The file is ignored if it is already queued or being imported, or if
+    it was imported successfully and has not been forgotten.
+    \return true if the file was queued.
+  */
+bool ImportScheduler::enqueue(const QString &pFileName, int pType)
+{
+  if (pType == Unknown)
+    pType = fileType(pFileName);
+  if (pType == Unknown)
+    return false;
+
+  ImportJob *job = _jobs.value(pFileName);
+  if (job && job->status != Error)
+    return false;
+
+  if (! job)
+  {
+    job = new ImportJob(pFileName, pType);
+    _jobs.insert(pFileName, job);
+  }
+  else
+  {
+    job->attempts = 0;
+    job->size     = QFileInfo(pFileName).size();
+    job->targets  = targets(pFileName, pType);
+  }
+
+  if (isIdle())
+  {
+    resetStatistics();
+    _elapsed.start();
+  }
+
+  _queue.append(job);
+  setStatus(job, Queued);
+  QMetaObject::invokeMethod(this, "sDispatch", Qt::QueuedConnection);
+  return true;
+}
+
+/** \brief Drop what we know about pFileName so it can be queued again.
+    Files that are waiting or running are left alone.
+  */
+void ImportScheduler::forget(const QString &pFileName)
+{
+  ImportJob *job = _jobs.value(pFileName);
+  if (job && job->status != Queued && job->status != Running)
+  {
+    _jobs.remove(pFileName);
+    delete job;
+  }
+}
+
+void ImportScheduler::rescan()
+{
+  if (_directory.isEmpty())
+    return;
+
+  QDirIterator iterator(_directory, _nameFilters, QDir::Files);
+  while (iterator.hasNext())
+  {
+    QString filename = iterator.next();
+    if (_jobs.contains(filename))
+      continue;
+
+    int type = fileType(filename);
+    emit fileFound(filename, type);
+    if (_autoImport)
+      enqueue(filename, type);
+  }
+}
+
+void ImportScheduler::resetStatistics()
+{
+  _done   = 0;
+  _errors = 0;
+  _bytes  = 0;
+  _elapsed.invalidate();
+  emit statisticsChanged();
+}
+
+/** \brief Queue every file whose last import failed, provided it is still
+           where it was.  Files moved aside by the failure treatment are
+           skipped.
+    \return the number of files queued.
+  */
+int ImportScheduler::retryErrors()
+{
+  int count = 0;
+  foreach (ImportJob *job, _jobs)
+  {
+    if (job->status == Error && QFile::exists(job->fileName) &&
+        enqueue(job->fileName, job->type))
+      count++;
+  }
+  return count;
+}
+
+void ImportScheduler::setAutoImport(bool pAuto)
+{
+  _autoImport = pAuto;
+  if (_autoImport && isWatching())
+    _rescanTimer->start();
+}
+
+void ImportScheduler::setDirectory(const QString &pDir)
+{
+  if (_watcher && ! _directory.isEmpty())
+    _watcher->removePath(_directory);
+  _directory = pDir;
+  if (_watcher && ! _directory.isEmpty())
+    _watcher->addPath(_directory);
+}
+
+void ImportScheduler::setMaxAttempts(int pAttempts)
+{
+  _maxAttempts = qMax(1, pAttempts);
+}
+
+void ImportScheduler::setMaxConnections(int pConnections)
+{
+  _pool->setMaxThreadCount(qMax(1, pConnections));
+  QMetaObject::invokeMethod(this, "sDispatch", Qt::QueuedConnection);
+}
+
+void ImportScheduler::setNameFilters(const QStringList &pFilters)
+{
+  _nameFilters = pFilters;
+}
+
+void ImportScheduler::setWatching(bool pWatch)
+{
+  if (pWatch && ! _watcher)
+  {
+    _watcher = new QFileSystemWatcher(this);
+    if (! _directory.isEmpty())
+      _watcher->addPath(_directory);
+    connect(_watcher, SIGNAL(directoryChanged(QString)), this, SLOT(sDirectoryChanged()));
+    _rescanTimer->start();
+  }
+  else if (! pWatch && _watcher)
+  {
+    _rescanTimer->stop();
+    _watcher->deleteLater();
+    _watcher = 0;
+  }
+}
+
+// a file being copied in fires several changes, so let them settle first
+void ImportScheduler::sDirectoryChanged()
+{
+  _rescanTimer->start();
+}
+
+/* Start every queued job whose targets are not in use.  A job also waits
+   behind any earlier queued job that shares a target so files for the
+   same view are applied in the order they arrived.
+ */
+void ImportScheduler::sDispatch()
+{
+  QSet<QString> blocked = _busy;
+  QList<ImportJob*>::iterator it = _queue.begin();
+  while (it != _queue.end())
+  {
+    ImportJob *job = *it;
+    bool canRun = true;
+    foreach (QString target, job->targets)
+    {
+      if (blocked.contains(target))
+      {
+        canRun = false;
+        break;
+      }
+    }
+
+    if (! canRun || (job->type == Xml && _running >= _pool->maxThreadCount()))
+    {
+      foreach (QString target, job->targets)
+        blocked.insert(target);
+      ++it;
+      continue;
+    }
+
+    it = _queue.erase(it);
+    foreach (QString target, job->targets)
+    {
+      _busy.insert(target);
+      blocked.insert(target);
+    }
+    job->attempts++;
+    _running++;
+    setStatus(job, Running);
+
+    if (job->type == Xml)
+      _pool->start(new ImportRunnable(_link, job->fileName));
+    else
+      QMetaObject::invokeMethod(this, "sRunCsv", Qt::QueuedConnection,
+                                Q_ARG(QString, job->fileName));
+  }
+}
+
+void ImportScheduler::sFinished(const QString &pFileName, bool pConnected, bool pSuccess, const QString &pErrMsg, const QString &pWarnMsg)
+{
+  ImportJob *job = _jobs.value(pFileName);
+  if (! job)
+    return;
+
+  _running--;
+  foreach (QString target, job->targets)
+    _busy.remove(target);
+
+  if (! pConnected && job->attempts < _maxAttempts)
+  {
+    if (DEBUG)
+      qDebug("ImportScheduler retrying %s after connection failure: %s",
+             qPrintable(pFileName), qPrintable(pErrMsg));
+    _queue.append(job);
+    setStatus(job, Queued, pErrMsg);
+  }
+  else if (pSuccess)
+  {
+    _done++;
+    _bytes += job->size;
+    setStatus(job, pWarnMsg.isEmpty() ? Done : Warning, pWarnMsg);
+  }
+  else
+  {
+    _errors++;
+    setStatus(job, Error, pErrMsg);
+  }
+  emit statisticsChanged();
+
+  if (isIdle())
+    emit finished();
+  else
+    sDispatch();
+}
+
+void ImportScheduler::sRunCsv(const QString &pFileName)
+{
+  QString errmsg;
+  bool success = ImportHelper::importCSV(pFileName, errmsg);
+  sFinished(pFileName, true, success, errmsg, QString());
+}
+
+void ImportScheduler::setStatus(ImportJob *pJob, int pStatus, const QString &pMessage)
+{
+  pJob->status  = pStatus;
+  pJob->message = pMessage;
+  emit statusChanged(pJob->fileName, pStatus, pMessage);
+}
@@ -0,0 +1,126 @@
+/*
+ * This file is part of the xTuple ERP: PostBooks Edition, a free and
+ * open source Enterprise Resource Planning software suite,
+ * Copyright (c) 1999-2019 by OpenMFG LLC, d/b/a xTuple.
+ * It is licensed to you under the Common Public Attribution License
+ * version 1.0, the full text of which (including xTuple-specific Exhibits)
+ * is available at www.xtuple.com/CPAL.  By using this software, you agree
+ * to be bound by its terms.
+ */
+
+#ifndef __IMPORTSCHEDULER_H__
+#define __IMPORTSCHEDULER_H__
+
+#include <QElapsedTimer>
+#include <QHash>
+#include <QList>
+#include <QObject>
+#include <QSet>
+#include <QSharedPointer>
+#include <QString>
+#include <QStringList>
+#include <QThreadPool>
+
+class QFileSystemWatcher;
+class QTimer;
+class ImportJob;
+class ImportSchedulerLink;
+
+/**
+  @class ImportScheduler
+
+  @brief Runs data imports in parallel on worker database connections.
+
+  Files are queued with enqueue() or picked up automatically from the
+  watched directory. Each file is mapped to the set of target views it
+  writes to. Files that share a target are imported in the order they were
+  queued while unrelated files run concurrently, up to maxConnections() at a
+  time, each on its own ConnectionPool connection.
+
+  CSV files go through the CSVImp plugin, which keeps its atlas state in a
+  single object, so they are serialized and run on the GUI thread.
+
+  A file that fails because its connection could not be opened is retried
+  automatically up to maxAttempts() times. Files whose import reported an
+  error can be queued again with retryErrors().
+
+  Destroying the scheduler drops the files still waiting in the queue but
+  does not wait for imports that are already running.
+ */
+class ImportScheduler : public QObject
+{
+  Q_OBJECT
+
+  public:
+    enum FileType { Unknown = -1, Csv, Xml };
+    enum Status   { Queued, Running, Done, Warning, Error };
+
+    ImportScheduler(QObject *parent = 0);
+    virtual ~ImportScheduler();
+
+    Q_INVOKABLE virtual QString     directory()      const;
+    Q_INVOKABLE virtual bool        isAutoImport()   const;
+    Q_INVOKABLE virtual bool        isIdle()         const;
+    Q_INVOKABLE virtual bool        isWatching()     const;
+    Q_INVOKABLE virtual int         maxAttempts()    const;
+    Q_INVOKABLE virtual int         maxConnections() const;
+    Q_INVOKABLE virtual QString     message(const QString &pFileName) const;
+    Q_INVOKABLE virtual QStringList nameFilters()    const;
+    Q_INVOKABLE virtual int         status(const QString &pFileName) const;
+
+    Q_INVOKABLE virtual int     doneCount()      const;
+    Q_INVOKABLE virtual int     errorCount()     const;
+    Q_INVOKABLE virtual double  filesPerMinute() const;
+    Q_INVOKABLE virtual qint64  bytesImported()  const;
+    Q_INVOKABLE virtual int     pendingCount()   const;
+
+    static int         fileType(const QString &pFileName);
+    static QStringList targets(const QString &pFileName, int pType);
+
+  public slots:
+    virtual bool enqueue(const QString &pFileName, int pType = Unknown);
+    virtual void forget(const QString &pFileName);
+    virtual void rescan();
+    virtual void resetStatistics();
+    virtual int  retryErrors();
+    virtual void setAutoImport(bool pAuto);
+    virtual void setDirectory(const QString &pDir);
+    virtual void setMaxAttempts(int pAttempts);
+    virtual void setMaxConnections(int pConnections);
+    virtual void setNameFilters(const QStringList &pFilters);
+    virtual void setWatching(bool pWatch);
+
+  signals:
+    void fileFound(const QString &pFileName, int pType);
+    void finished();
+    void statisticsChanged();
+    void statusChanged(const QString &pFileName, int pStatus, const QString &pMessage);
+
+  protected slots:
+    virtual void sDirectoryChanged();
+    virtual void sDispatch();
+    virtual void sFinished(const QString &pFileName, bool pConnected, bool pSuccess, const QString &pErrMsg, const QString &pWarnMsg);
+    virtual void sRunCsv(const QString &pFileName);
+
+  protected:
+    void setStatus(ImportJob *pJob, int pStatus, const QString &pMessage = QString());
+
+    bool                       _autoImport;
+    QSet<QString>              _busy;
+    qint64                     _bytes;
+    QString                    _directory;
+    int                        _done;
+    int                        _errors;
+    QElapsedTimer              _elapsed;
+    QHash<QString, ImportJob*> _jobs;
+    QSharedPointer<ImportSchedulerLink> _link;
+    int                        _maxAttempts;
+    QStringList                _nameFilters;
+    QThreadPool               *_pool;
+    QList<ImportJob*>          _queue;
+    QTimer                    *_rescanTimer;
+    int                        _running;
+    QFileSystemWatcher        *_watcher;
+};
+
+#endif
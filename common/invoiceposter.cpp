@@ -0,0 +1,447 @@
+/*
+ * This file is part of the xTuple ERP: PostBooks Edition, a free and
+ * open source Enterprise Resource Planning software suite,
+ * Copyright (c) 1999-2019 by OpenMFG LLC, d/b/a xTuple.
+ * It is licensed to you under the Common Public Attribution License
+ * version 1.0, the full text of which (including xTuple-specific Exhibits)
+ * is available at www.xtuple.com/CPAL.  By using this software, you agree
+ * to be bound by its terms.
+ */
+
+#include "invoiceposter.h"
+
+#include <QRunnable>
+#include <QSqlDatabase>
+#include <QSqlError>
+#include <QSqlQuery>
+#include <QThread>
+#include <QVariant>
+
+#include "connectionpool.h"
+#include "storedProcErrorLookup.h"
+#include "taxIntegration.h"
+
+#define DEBUG false
+
+class InvoicePostJob
+{
+  public:
+    InvoicePostJob(int pId, const QString &pNumber, int pSeries)
+      : attempts(0),
+        id(pId),
+        number(pNumber),
+        series(pSeries),
+        status(InvoicePoster::Queued),
+        taxPending(false)
+    {
+    }
+
+    int     attempts;
+    int     id;
+    QString message;
+    QString number;
+    int     series;
+    int     status;
+    bool    taxPending;   // posted, but the tax service hasn't committed it
+};
+
+static bool isTransient(const QSqlError &pError)
+{
+  return pError.type() == QSqlError::ConnectionError ||
+         pError.nativeErrorCode() == "40001"         ||     // serialization_failure
+         pError.nativeErrorCode() == "40P01";               // deadlock_detected
+}
+
+static void deleteSeries(int pSeries, QSqlDatabase pDb)
+{
+  if (pSeries <= 0)
+    return;
+
+  QSqlQuery cleanup(pDb);
+  cleanup.prepare("SELECT deleteitemlocseries(:itemlocSeries, TRUE);");
+  cleanup.bindValue(":itemlocSeries", pSeries);
+  cleanup.exec();
+}
+
+class InvoicePostRunnable : public QRunnable
+{
+  public:
+    InvoicePostRunnable(InvoicePoster *pPoster, int pId, int pJournal, int pSeries)
+      : _id(pId),
+        _journal(pJournal),
+        _poster(pPoster),
+        _series(pSeries)
+    {
+    }
+
+    virtual void run()
+    {
+      QString errmsg;
+      bool    transient = false;
+      bool    posted    = false;
+      QSqlDatabase db   = ConnectionPool::connection(&errmsg);
+      if (! db.isValid() || ! db.isOpen())
+        transient = true;
+      else
+        posted = post(db, errmsg, transient);
+
+      QMetaObject::invokeMethod(_poster, "sFinished", Qt::QueuedConnection,
+                                Q_ARG(int,     _id),
+                                Q_ARG(bool,    posted),
+                                Q_ARG(bool,    transient),
+                                Q_ARG(QString, errmsg));
+    }
+
+  protected:
+    /* The SQL steps postInvoices used to take on the GUI thread. QSqlQuery
+       rather than XSqlQuery, and no tax service: both belong to the GUI
+       thread, so InvoicePoster commits the tax there once this is done.
+     */
+    bool post(QSqlDatabase db, QString &errmsg, bool &transient)
+    {
+      QSqlQuery rollback(db);
+      rollback.prepare("ROLLBACK;");
+
+      int series = _series;
+      QSqlQuery postq(db);
+      postq.exec("BEGIN;");
+      if (series <= 0)
+      {
+        postq.exec("SELECT NEXTVAL('itemloc_series_seq') AS itemlocSeries;");
+        if (postq.first())
+          series = postq.value("itemlocSeries").toInt();
+        else
+        {
+          errmsg    = postq.lastError().text();
+          transient = isTransient(postq.lastError());
+          rollback.exec();
+          return false;
+        }
+      }
+
+      postq.prepare("SELECT postInvoice(:invchead_id, :journal, :itemlocSeries, true) AS result;");
+      postq.bindValue(":invchead_id",   _id);
+      postq.bindValue(":journal",       _journal);
+      postq.bindValue(":itemlocSeries", series);
+      postq.exec();
+      if (! postq.first())
+      {
+        errmsg    = postq.lastError().text();
+        transient = isTransient(postq.lastError());
+        return fail(db, rollback, series, transient);
+      }
+
+      int result = postq.value("result").toInt();
+      if (result < 0)
+      {
+        errmsg = QObject::tr("Error Posting Invoice. %1")
+                   .arg(storedProcErrorLookup("postInvoice", result));
+        return fail(db, rollback, series, false);
+      }
+      else if (result != series)
+      {
+        errmsg = QObject::tr("Error Posting Invoice. Expected: %1, returned: %2")
+                   .arg(series).arg(result);
+        return fail(db, rollback, series, false);
+      }
+
+      postq.exec("COMMIT;");
+      if (postq.lastError().type() != QSqlError::NoError)
+      {
+        errmsg    = postq.lastError().text();
+        transient = isTransient(postq.lastError());
+        return fail(db, rollback, series, transient);
+      }
+
+      return true;
+    }
+
+    /* A transient failure of a pre-distributed invoice keeps its series so
+       the retry can use the detail the user already entered.
+     */
+    bool fail(QSqlDatabase db, QSqlQuery &rollback, int series, bool transient)
+    {
+      rollback.exec();
+      if (! transient || _series <= 0)
+        deleteSeries(series, db);
+      return false;
+    }
+
+    int            _id;
+    int            _journal;
+    InvoicePoster *_poster;
+    int            _series;
+};
+
+InvoicePoster::InvoicePoster(int pJournal, QObject *parent)
+  : QObject(parent),
+    _errors(0),
+    _journal(pJournal),
+    _maxAttempts(3),
+    _posted(0),
+    _running(0),
+    _tax(0),
+    _taxBusy(false)
+{
+  _pool.setMaxThreadCount(qBound(1, QThread::idealThreadCount(), 4));
+  ConnectionPool::capture();
+}
+
+InvoicePoster::~InvoicePoster()
+{
+  blockSignals(true);
+  cancel();
+  _pool.waitForDone();
+  qDeleteAll(_jobs);
+}
+
+bool InvoicePoster::isIdle() const
+{
+  return _running == 0 && _queue.isEmpty() && _taxQueue.isEmpty();
+}
+
+/** \brief Return whether the invoice was posted but its tax has not been
+           committed, so retrying it needs no new distribution.
+  */
+bool InvoicePoster::isTaxPending(int pInvcheadId) const
+{
+  InvoicePostJob *job = _jobs.value(pInvcheadId);
+  return job && job->taxPending;
+}
+
+int InvoicePoster::journal() const
+{
+  return _journal;
+}
+
+int InvoicePoster::maxAttempts() const
+{
+  return _maxAttempts;
+}
+
+int InvoicePoster::maxConnections() const
+{
+  return _pool.maxThreadCount();
+}
+
+QString InvoicePoster::message(int pInvcheadId) const
+{
+  InvoicePostJob *job = _jobs.value(pInvcheadId);
+  return job ? job->message : QString();
+}
+
+int InvoicePoster::status(int pInvcheadId) const
+{
+  InvoicePostJob *job = _jobs.value(pInvcheadId);
+  return job ? job->status : -1;
+}
+
+int InvoicePoster::errorCount() const
+{
+  return _errors;
+}
+
+double InvoicePoster::invoicesPerMinute() const
+{
+  if (! _elapsed.isValid() || _elapsed.elapsed() <= 0)
+    return 0;
+  return _posted * 60000.0 / _elapsed.elapsed();
+}
+
+int InvoicePoster::pendingCount() const
+{
+  return _queue.size() + _running + _taxQueue.size();
+}
+
+int InvoicePoster::postedCount() const
+{
+  return _posted;
+}
+
+int InvoicePoster::totalCount() const
+{
+  return _jobs.size();
+}
+
+/** \brief Stop posting.  Invoices already being posted are allowed to
+           finish; the rest are marked Cancelled and their distribution
+           detail, if any, is deleted.
+  */
+void InvoicePoster::cancel()
+{
+  QList<InvoicePostJob*> queue = _queue;
+  _queue.clear();
+  foreach (InvoicePostJob *job, queue)
+  {
+    deleteSeries(job->series, QSqlDatabase::database());
+    job->series = 0;
+    setStatus(job, Cancelled);
+  }
+
+  if (! queue.isEmpty())
+  {
+    emit progress(totalCount() - pendingCount(), totalCount());
+    if (isIdle())
+      emit finished();
+  }
+}
+
+/** \brief Queue an invoice to be posted.
+
+    An invoice that was posted or is already waiting is ignored. One that
+    failed or was cancelled is queued again with the new pItemlocSeries.
+    One that was posted but whose tax could not be committed only has its
+    tax committed again.
+    \return true if the invoice was queued.
+  */
+bool InvoicePoster::enqueue(int pInvcheadId, const QString &pNumber, int pItemlocSeries)
+{
+  InvoicePostJob *job = _jobs.value(pInvcheadId);
+  if (job && job->status != Error && job->status != Cancelled)
+    return false;
+
+  if (! job)
+  {
+    job = new InvoicePostJob(pInvcheadId, pNumber, pItemlocSeries);
+    _jobs.insert(pInvcheadId, job);
+  }
+  else
+  {
+    if (job->status == Error)
+      _errors--;
+    job->attempts = 0;
+    job->series   = pItemlocSeries;
+  }
+
+  if (! _elapsed.isValid())
+    _elapsed.start();
+
+  if (job->taxPending)
+  {
+    _taxQueue.append(job);
+    setStatus(job, Running);
+    emit progress(totalCount() - pendingCount(), totalCount());
+    QMetaObject::invokeMethod(this, "sCommitTax", Qt::QueuedConnection);
+    return true;
+  }
+
+  _queue.append(job);
+  setStatus(job, Queued);
+  emit progress(totalCount() - pendingCount(), totalCount());
+  QMetaObject::invokeMethod(this, "sDispatch", Qt::QueuedConnection);
+  return true;
+}
+
+void InvoicePoster::setMaxAttempts(int pAttempts)
+{
+  _maxAttempts = qMax(1, pAttempts);
+}
+
+void InvoicePoster::setMaxConnections(int pConnections)
+{
+  _pool.setMaxThreadCount(qMax(1, pConnections));
+  QMetaObject::invokeMethod(this, "sDispatch", Qt::QueuedConnection);
+}
+
+void InvoicePoster::sDispatch()
+{
+  while (_running < _pool.maxThreadCount() && ! _queue.isEmpty())
+  {
+    InvoicePostJob *job = _queue.takeFirst();
+    job->attempts++;
+    _running++;
+    setStatus(job, Running);
+    _pool.start(new InvoicePostRunnable(this, job->id, _journal, job->series));
+  }
+}
+
+void InvoicePoster::sFinished(int pInvcheadId, bool pPosted, bool pTransient, const QString &pMessage)
+{
+  _running--;
+
+  InvoicePostJob *job = _jobs.value(pInvcheadId);
+  if (! job)
+    return;
+
+  if (DEBUG)
+    qDebug("InvoicePoster::sFinished(%d, %d, %d, %s) attempt %d",
+           pInvcheadId, pPosted, pTransient, qPrintable(pMessage), job->attempts);
+
+  if (pPosted)
+  {
+    job->series     = 0;
+    job->taxPending = true;
+    _taxQueue.append(job);
+  }
+  else if (pTransient && job->attempts < _maxAttempts)
+  {
+    _queue.append(job);
+    setStatus(job, Queued, pMessage);
+  }
+  else
+  {
+    if (pTransient)
+      deleteSeries(job->series, QSqlDatabase::database());
+    job->series = 0;
+    _errors++;
+    setStatus(job, Error, pMessage.isEmpty() ? tr("Could not connect to the database.")
+                                             : pMessage);
+  }
+
+  emit progress(totalCount() - pendingCount(), totalCount());
+  sDispatch();
+  sCommitTax();   // also says when the batch is finished
+}
+
+/* The tax service waits for its replies in a nested event loop, so more
+   invoices can finish while one is being committed. They wait their turn
+   in _taxQueue; the first caller works through it.
+
+   The invoice is already posted by the time its tax is committed, so a
+   failure here can't roll it back. It is reported as an error, and
+   enqueue() retries just the tax commit.
+ */
+void InvoicePoster::sCommitTax()
+{
+  if (_taxBusy)
+    return;
+  _taxBusy = true;
+
+  if (! _tax && ! _taxQueue.isEmpty())
+  {
+    _tax = TaxIntegration::getTaxIntegration(false);
+    _tax->setParent(this);
+  }
+
+  while (! _taxQueue.isEmpty())
+  {
+    InvoicePostJob *job = _taxQueue.first();
+    bool committed = _tax->commit("INV", job->id);
+    _taxQueue.removeFirst();
+
+    if (committed)
+    {
+      job->taxPending = false;
+      _posted++;
+      setStatus(job, Posted);
+    }
+    else
+    {
+      _errors++;
+      setStatus(job, Error, tr("The invoice was posted but its tax was not "
+                               "committed: %1").arg(_tax->error()));
+    }
+    emit progress(totalCount() - pendingCount(), totalCount());
+  }
+
+  _taxBusy = false;
+  if (isIdle())
+    emit finished();
+}
+
+void InvoicePoster::setStatus(InvoicePostJob *pJob, int pStatus, const QString &pMessage)
+{
+  pJob->status  = pStatus;
+  pJob->message = pMessage;
+  emit statusChanged(pJob->id, pJob->number, pStatus, pMessage);
+}
@@ -0,0 +1,105 @@
+/*
+ * This file is part of the xTuple ERP: PostBooks Edition, a free and
+ * open source Enterprise Resource Planning software suite,
+ * Copyright (c) 1999-2019 by OpenMFG LLC, d/b/a xTuple.
+ * It is licensed to you under the Common Public Attribution License
+ * version 1.0, the full text of which (including xTuple-specific Exhibits)
+ * is available at www.xtuple.com/CPAL.  By using this software, you agree
+ * to be bound by its terms.
+ */
+
+#ifndef __INVOICEPOSTER_H__
+#define __INVOICEPOSTER_H__
+
+#include <QElapsedTimer>
+#include <QHash>
+#include <QList>
+#include <QObject>
+#include <QString>
+#include <QThreadPool>
+
+class InvoicePostJob;
+class TaxIntegration;
+
+/**
+  @class InvoicePoster
+
+  @brief Posts invoices in the background, each in its own transaction on
+         its own ConnectionPool connection.
+
+  Invoices are queued with enqueue() and posted by up to maxConnections()
+  worker threads at a time. Each invoice is posted with postInvoice() in its
+  own transaction, and a failed invoice is rolled back without touching the
+  rest of the batch. The tax service is not safe to use off the GUI thread,
+  so the tax of each posted invoice is committed there afterwards, one
+  invoice at a time.
+
+  An invoice that failed because its connection could not be opened, or
+  because the database aborted the transaction for a deadlock or
+  serialization failure, is queued again automatically up to maxAttempts()
+  times. Other failures are left for the caller to skip or to retry by
+  calling enqueue() again.
+
+  Invoices that need lot, serial, or location detail must be distributed
+  on the GUI thread before they are queued. Pass the itemloc series used
+  for the distribution to enqueue(); the poster deletes that series if the
+  invoice fails for a reason that retrying will not fix.
+ */
+class InvoicePoster : public QObject
+{
+  Q_OBJECT
+
+  public:
+    enum Status { Queued, Running, Posted, Error, Cancelled };
+
+    InvoicePoster(int pJournal, QObject *parent = 0);
+    virtual ~InvoicePoster();
+
+    Q_INVOKABLE virtual bool    isIdle()         const;
+    Q_INVOKABLE virtual bool    isTaxPending(int pInvcheadId) const;
+    Q_INVOKABLE virtual int     journal()        const;
+    Q_INVOKABLE virtual int     maxAttempts()    const;
+    Q_INVOKABLE virtual int     maxConnections() const;
+    Q_INVOKABLE virtual QString message(int pInvcheadId) const;
+    Q_INVOKABLE virtual int     status(int pInvcheadId)  const;
+
+    Q_INVOKABLE virtual int     errorCount()       const;
+    Q_INVOKABLE virtual double  invoicesPerMinute() const;
+    Q_INVOKABLE virtual int     pendingCount()     const;
+    Q_INVOKABLE virtual int     postedCount()      const;
+    Q_INVOKABLE virtual int     totalCount()       const;
+
+  public slots:
+    virtual void cancel();
+    virtual bool enqueue(int pInvcheadId, const QString &pNumber, int pItemlocSeries = 0);
+    virtual void setMaxAttempts(int pAttempts);
+    virtual void setMaxConnections(int pConnections);
+
+  signals:
+    void finished();
+    void progress(int pDone, int pTotal);
+    void statusChanged(int pInvcheadId, const QString &pNumber, int pStatus, const QString &pMessage);
+
+  protected slots:
+    virtual void sCommitTax();
+    virtual void sDispatch();
+    virtual void sFinished(int pInvcheadId, bool pPosted, bool pTransient, const QString &pMessage);
+
+  protected:
+    void setStatus(InvoicePostJob *pJob, int pStatus, const QString &pMessage = QString());
+
+    int                         _errors;
+    QElapsedTimer               _elapsed;
+    QHash<int, InvoicePostJob*> _jobs;
+    int                         _journal;
+    int                         _maxAttempts;
+    QThreadPool                 _pool;
+    int                         _posted;
+    QList<InvoicePostJob*>      _queue;
+    int                         _running;
+    TaxIntegration             *_tax;
+    bool                        _taxBusy;
+    QList<InvoicePostJob*>      _taxQueue;
+};
+
+#endif
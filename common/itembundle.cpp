@@ -0,0 +1,397 @@
+/*
+ * This file is part of the xTuple ERP: PostBooks Edition, a free and
+ * open source Enterprise Resource Planning software suite,
+ * Copyright (c) 1999-2019 by OpenMFG LLC, d/b/a xTuple.
+ * It is licensed to you under the Common Public Attribution License
+ * version 1.0, the full text of which (including xTuple-specific Exhibits)
+ * is available at www.xtuple.com/CPAL.  By using this software, you agree
+ * to be bound by its terms.
+ */
+
+#include "itembundle.h"
+
+#include <QCoreApplication>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QRunnable>
+#include <QSqlDriver>
+#include <QSqlError>
+#include <QSqlQuery>
+#include <QSqlRecord>
+#include <QStringList>
+#include <QWaitCondition>
+
+#include "xsqlquery.h"
+
+#include "connectionpool.h"
+
+#define DEBUG false
+
+// milliseconds a bundle is trusted
+#define BUNDLEAGE    60000
+
+// milliseconds the costs, item sources, aliases and tax type are trusted
+#define VOLATILEAGE  2000
+
+// milliseconds bundle() waits for a prefetch before asking again itself
+#define PREFETCHWAIT 500
+
+static ItemBundleCache *_itemBundleCache = 0;
+
+ItemBundleRequest::ItemBundleRequest(int pItemid, int pWarehousid)
+  : itemid(pItemid),
+    warehousid(pWarehousid),
+    custid(-1),
+    vendid(-1),
+    taxzoneid(-1)
+{
+}
+
+QString ItemBundleRequest::key() const
+{
+  return QString("%1|%2|%3|%4|%5|%6").arg(itemid).arg(warehousid)
+                                     .arg(custid).arg(vendid).arg(taxzoneid)
+                                     .arg(effective.toString(Qt::ISODate));
+}
+
+ItemBundle::ItemBundle()
+{
+}
+
+bool ItemBundle::hasItemsite() const
+{
+  return ! _values.value("itemsite_id").isNull();
+}
+
+bool ItemBundle::isValid() const
+{
+  return ! _values.isEmpty();
+}
+
+QList<int> ItemBundle::itemsrcIds() const
+{
+  QList<int> result;
+  foreach (QString id, _values.value("vend_itemsrc_ids").toString().split(",", QString::SkipEmptyParts))
+    result.append(id.toInt());
+  return result;
+}
+
+QString ItemBundle::lastError() const
+{
+  return _lastError;
+}
+
+QVariant ItemBundle::value(const QString &pName) const
+{
+  return _values.value(pName);
+}
+
+/* What a prefetch shares between the worker thread that runs the query and
+   the GUI thread that may be waiting for it.
+ */
+class ItemBundleJob
+{
+  public:
+    ItemBundleJob(const ItemBundleRequest &pRequest)
+      : _done(false),
+        _request(pRequest)
+    {
+    }
+
+    // on the main connection, where XSqlQuery reports errors as usual
+    static ItemBundle load(const ItemBundleRequest &pRequest)
+    {
+      XSqlQuery bundleq;
+      return load(pRequest, bundleq);
+    }
+
+    /* On a worker connection. XSqlQuery's error listener updates GUI
+       widgets, so it must not see queries run from a pool thread.
+     */
+    static ItemBundle load(const ItemBundleRequest &pRequest, QSqlDatabase pDb)
+    {
+      QSqlQuery bundleq(pDb);
+      return load(pRequest, bundleq);
+    }
+
+    static ItemBundle load(const ItemBundleRequest &pRequest, QSqlQuery &pQuery)
+    {
+      ItemBundle result;
+      pQuery.prepare(QString("SELECT item_id, item_type, item_config, item_fractional,"
+                             "       item_inv_uom_id, item_price_uom_id, uom_name,"
+                             "       iteminvpricerat(item_id) AS invpricerat,"
+                             "       COALESCE(item_maxcost, 0.0) AS maxcost,"
+                             "       item_tax_recoverable,"
+                             "       itemsite_id, itemsite_leadtime, itemsite_costmethod,"
+                             "       itemsite_createsopo, itemsite_createsopr,"
+                             "       itemsite_createwo, itemsite_dropship, itemsite_autoord,"
+                             "       %1"
+                             "  FROM item"
+                             "  JOIN uom ON (item_inv_uom_id=uom_id)"
+                             "  LEFT OUTER JOIN itemsite ON (itemsite_item_id=item_id"
+                             "                           AND itemsite_warehous_id=:warehous_id)"
+                             " WHERE item_id=:item_id;").arg(volatileColumns()));
+      bind(pQuery, pRequest);
+      pQuery.exec();
+      if (pQuery.first())
+      {
+        QSqlRecord row = pQuery.record();
+        for (int i = 0; i < row.count(); i++)
+          result._values.insert(row.fieldName(i), row.value(i));
+        result._loaded.start();
+        result._volatileLoaded.start();
+      }
+      else if (pQuery.lastError().type() != QSqlError::NoError)
+        result._lastError = pQuery.lastError().text();
+
+      return result;
+    }
+
+    /* Reread the values that change without an item or itemsite
+       notification: costs, item sources, aliases and tax types.
+     */
+    static bool reloadVolatile(const ItemBundleRequest &pRequest, ItemBundle &pBundle)
+    {
+      XSqlQuery volatileq;
+      volatileq.prepare(QString("SELECT %1 FROM item WHERE item_id=:item_id;")
+                        .arg(volatileColumns()));
+      bind(volatileq, pRequest);
+      volatileq.exec();
+      if (! volatileq.first())
+        return false;
+
+      QSqlRecord row = volatileq.record();
+      for (int i = 0; i < row.count(); i++)
+        pBundle._values.insert(row.fieldName(i), row.value(i));
+      pBundle._volatileLoaded.start();
+      return true;
+    }
+
+    ItemBundle wait(int pMsecs)
+    {
+      QMutexLocker locker(&_lock);
+      if (! _done)
+        _finished.wait(&_lock, pMsecs);
+      return _done ? _bundle : ItemBundle();
+    }
+
+    void finish(const ItemBundle &pBundle)
+    {
+      QMutexLocker locker(&_lock);
+      _bundle = pBundle;
+      _done   = true;
+      _finished.wakeAll();
+    }
+
+    const ItemBundleRequest &request() const { return _request; }
+
+  protected:
+    static QString volatileColumns()
+    {
+      return "stdCost(item_id) AS stdcost,"
+             " getItemTaxType(item_id, :taxzone_id) AS taxtype_id,"
+             " EXISTS(SELECT 1 FROM itemsrc"
+             "         WHERE itemsrc_item_id=item_id"
+             "           AND itemsrc_active) AS has_itemsrc,"
+             " (SELECT itemalias_number"
+             "    FROM itemalias"
+             "    LEFT OUTER JOIN crmacct ON (itemalias_crmacct_id=crmacct_id)"
+             "    LEFT OUTER JOIN custinfo ON (cust_crmacct_id=crmacct_id)"
+             "   WHERE itemalias_item_id=item_id"
+             "     AND (cust_id=:cust_id OR itemalias_crmacct_id IS NULL)"
+             "   ORDER BY CASE WHEN itemalias_crmacct_id IS NOT NULL THEN 0"
+             "                 ELSE 1 END, itemalias_number"
+             "   LIMIT 1) AS itemalias_number,"
+             " (SELECT string_agg(itemsrc_id::TEXT, ',')"
+             "    FROM itemsrc"
+             "   WHERE itemsrc_item_id=item_id"
+             "     AND itemsrc_vend_id=:vend_id"
+             "     AND :effective BETWEEN itemsrc_effective AND (itemsrc_expires - 1)"
+             "     AND itemsrc_active) AS vend_itemsrc_ids";
+    }
+
+    static void bind(QSqlQuery &pQuery, const ItemBundleRequest &pRequest)
+    {
+      pQuery.bindValue(":item_id",     pRequest.itemid);
+      pQuery.bindValue(":warehous_id", pRequest.warehousid);
+      pQuery.bindValue(":cust_id",     pRequest.custid);
+      pQuery.bindValue(":vend_id",     pRequest.vendid);
+      pQuery.bindValue(":taxzone_id",  pRequest.taxzoneid);
+      pQuery.bindValue(":effective",   pRequest.effective.isValid() ? pRequest.effective
+                                                                     : QDate::currentDate());
+    }
+
+    ItemBundle        _bundle;
+    bool              _done;
+    QWaitCondition    _finished;
+    QMutex            _lock;
+    ItemBundleRequest _request;
+};
+
+class ItemBundleRunnable : public QRunnable
+{
+  public:
+    ItemBundleRunnable(ItemBundleCache *pCache, QSharedPointer<ItemBundleJob> pJob)
+      : _cache(pCache),
+        _job(pJob)
+    {
+    }
+
+    virtual void run()
+    {
+      QString      errmsg;
+      ItemBundle   result;
+      QSqlDatabase db = ConnectionPool::connection(&errmsg);
+      if (db.isValid() && db.isOpen())
+        result = ItemBundleJob::load(_job->request(), db);
+
+      _job->finish(result);
+      QMetaObject::invokeMethod(_cache, "sPrefetched", Qt::QueuedConnection,
+                                Q_ARG(QString, _job->request().key()));
+    }
+
+  protected:
+    ItemBundleCache               *_cache;
+    QSharedPointer<ItemBundleJob>  _job;
+};
+
+ItemBundleCache *ItemBundleCache::instance()
+{
+  if (! _itemBundleCache)
+    _itemBundleCache = new ItemBundleCache(QCoreApplication::instance());
+  return _itemBundleCache;
+}
+
+ItemBundleCache::ItemBundleCache(QObject *pParent)
+  : XCachedHashQObject(pParent),
+    _hits(0),
+    _misses(0)
+{
+  _pool.setMaxThreadCount(2);
+  _notice << "item" << "itemsite" << "itemsrc" << "itemcost" << "itemalias";
+
+  QSqlDatabase db = QSqlDatabase::database();
+  if (db.isValid() && db.driver())
+  {
+    foreach (QString notice, _notice)
+    {
+      if (! db.driver()->subscribedToNotifications().contains(notice))
+        db.driver()->subscribeToNotification(notice);
+    }
+  }
+}
+
+void ItemBundleCache::clear()
+{
+  if (DEBUG)
+    qDebug("ItemBundleCache::clear() after %d hits, %d misses", _hits, _misses);
+
+  _bundles.clear();
+  _inFlight.clear();
+}
+
+int ItemBundleCache::hits() const
+{
+  return _hits;
+}
+
+int ItemBundleCache::misses() const
+{
+  return _misses;
+}
+
+/** \brief Return the bundle for pRequest, from the cache, from a prefetch
+           already under way, or by asking the database.
+
+    \return the bundle. If it is not valid, either the item does not exist
+            or lastError() says what went wrong.
+  */
+ItemBundle ItemBundleCache::bundle(const ItemBundleRequest &pRequest)
+{
+  if (pRequest.itemid < 0)
+    return ItemBundle();
+
+  QString key = pRequest.key();
+  QHash<QString, ItemBundle>::const_iterator cached = _bundles.constFind(key);
+  if (cached != _bundles.constEnd() && cached.value()._loaded.elapsed() < BUNDLEAGE)
+  {
+    _hits++;
+    return fresh(pRequest, key);
+  }
+
+  if (_inFlight.contains(key))
+  {
+    QSharedPointer<ItemBundleJob> job = _inFlight.value(key);
+    if (job->wait(PREFETCHWAIT).isValid())
+    {
+      adopt(key, job);
+      _hits++;
+      return fresh(pRequest, key);
+    }
+    _inFlight.remove(key);
+  }
+
+  _misses++;
+  ItemBundle result = ItemBundleJob::load(pRequest);
+  if (result.isValid())
+    _bundles.insert(key, result);
+  return result;
+}
+
+/** \brief Start loading the bundle for pRequest in the background.
+
+    Nothing happens if a fresh bundle is already cached or being loaded, or
+    if worker connections are not available; bundle() then loads it on the
+    main connection as usual.
+  */
+void ItemBundleCache::prefetch(const ItemBundleRequest &pRequest)
+{
+  if (pRequest.itemid < 0)
+    return;
+
+  QString key = pRequest.key();
+  QHash<QString, ItemBundle>::const_iterator cached = _bundles.constFind(key);
+  if ((cached != _bundles.constEnd() && cached.value()._loaded.elapsed() < BUNDLEAGE) ||
+      _inFlight.contains(key))
+    return;
+
+  if (! ConnectionPool::isCaptured() && ! ConnectionPool::capture())
+    return;
+
+  QSharedPointer<ItemBundleJob> job(new ItemBundleJob(pRequest));
+  _inFlight.insert(key, job);
+  _pool.start(new ItemBundleRunnable(this, job));
+}
+
+/* A bundle can come from the cache without a round-trip only if its
+   volatile values were read a moment ago, as they are when a prefetch for
+   the same selection has just finished. Otherwise reread those values.
+ */
+ItemBundle ItemBundleCache::fresh(const ItemBundleRequest &pRequest, const QString &pKey)
+{
+  ItemBundle &bundle = _bundles[pKey];
+  if (bundle._volatileLoaded.elapsed() >= VOLATILEAGE &&
+      ! ItemBundleJob::reloadVolatile(pRequest, bundle))
+  {
+    _bundles.remove(pKey);
+    ItemBundle result = ItemBundleJob::load(pRequest);
+    if (result.isValid())
+      _bundles.insert(pKey, result);
+    return result;
+  }
+  return bundle;
+}
+
+void ItemBundleCache::sPrefetched(const QString &pKey)
+{
+  if (_inFlight.contains(pKey))
+    adopt(pKey, _inFlight.value(pKey));
+}
+
+void ItemBundleCache::adopt(const QString &pKey, QSharedPointer<ItemBundleJob> pJob)
+{
+  _inFlight.remove(pKey);
+  ItemBundle result = pJob->wait(0);
+  if (result.isValid())
+    _bundles.insert(pKey, result);
+}
@@ -0,0 +1,143 @@
+/*
+ * This file is part of the xTuple ERP: PostBooks Edition, a free and
+ * open source Enterprise Resource Planning software suite,
+ * Copyright (c) 1999-2019 by OpenMFG LLC, d/b/a xTuple.
+ * It is licensed to you under the Common Public Attribution License
+ * version 1.0, the full text of which (including xTuple-specific Exhibits)
+ * is available at www.xtuple.com/CPAL.  By using this software, you agree
+ * to be bound by its terms.
+ */
+
+#ifndef __ITEMBUNDLE_H__
+#define __ITEMBUNDLE_H__
+
+#include <QDate>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QList>
+#include <QSharedPointer>
+#include <QString>
+#include <QThreadPool>
+#include <QVariant>
+
+#include "xcachedhash.h"
+
+class ItemBundleJob;
+
+/**
+  @class ItemBundleRequest
+
+  @brief Says which item a bundle describes and from whose point of view.
+
+  Only itemid is required. The other ids select the itemsite, the tax type,
+  the customer's item alias, and the vendor's item sources; leave them at
+  -1 when the form does not need those parts.
+ */
+class ItemBundleRequest
+{
+  public:
+    ItemBundleRequest(int pItemid = -1, int pWarehousid = -1);
+
+    QString key() const;
+
+    int   itemid;
+    int   warehousid;
+    int   custid;
+    int   vendid;
+    int   taxzoneid;
+    QDate effective;
+};
+
+/**
+  @class ItemBundle
+
+  @brief Everything an order line entry form needs to know about an item
+         when it is selected, fetched in one round-trip.
+
+  The values are the columns of one row: item attributes (item_type,
+  item_config, item_fractional, item_inv_uom_id, item_price_uom_id,
+  uom_name, invpricerat, stdcost, maxcost, item_tax_recoverable,
+  taxtype_id), itemsite attributes for the requested site (itemsite_id,
+  itemsite_leadtime, itemsite_costmethod, itemsite_createsopo,
+  itemsite_createsopr, itemsite_createwo, itemsite_dropship,
+  itemsite_autoord), whether the item has any active item source
+  (has_itemsrc), the customer's item alias (itemalias_number), and the
+  requested vendor's item sources effective on the requested date
+  (itemsrcIds()).
+ */
+class ItemBundle
+{
+  public:
+    ItemBundle();
+
+    bool       hasItemsite()  const;
+    bool       isValid()      const;
+    QList<int> itemsrcIds()   const;
+    QString    lastError()    const;
+    QVariant   value(const QString &pName) const;
+
+  protected:
+    friend class ItemBundleCache;
+    friend class ItemBundleJob;
+
+    QString                  _lastError;
+    QElapsedTimer            _loaded;
+    QHash<QString, QVariant> _values;
+    QElapsedTimer            _volatileLoaded;
+};
+
+/**
+  @class ItemBundleCache
+
+  @brief Fetches and remembers ItemBundle objects.
+
+  bundle() returns a bundle loaded in the last minute if there is one and
+  otherwise fetches it with one query. prefetch() starts that query on a
+  ConnectionPool connection in the background, so a form can ask for the
+  bundle as soon as it knows the item, run its other queries on the main
+  connection, and then pick up the bundle from bundle() without waiting
+  for a second round-trip.
+
+  Bundles are dropped after a minute and whenever the item, itemsite,
+  item source, item cost or item alias tables send a notification or the
+  GUI client reports the connection lost. Costs, item sources, aliases
+  and the tax type can change without any of those, so a cached bundle
+  more than a moment old has them read again in one small query before it
+  is returned.
+
+  bundle() waits briefly for a prefetch that has not finished and then
+  reads the bundle on the main connection itself.
+ */
+class ItemBundleCache : public XCachedHashQObject
+{
+  Q_OBJECT
+
+  public:
+    static ItemBundleCache *instance();
+
+    ItemBundle bundle(const ItemBundleRequest &pRequest);
+    void       prefetch(const ItemBundleRequest &pRequest);
+
+    Q_INVOKABLE int hits()    const;
+    Q_INVOKABLE int misses()  const;
+
+  public slots:
+    virtual void clear();
+
+  protected slots:
+    virtual void sPrefetched(const QString &pKey);
+
+  protected:
+    ItemBundleCache(QObject *pParent = 0);
+
+    void       adopt(const QString &pKey, QSharedPointer<ItemBundleJob> pJob);
+    ItemBundle fresh(const ItemBundleRequest &pRequest, const QString &pKey);
+
+    QHash<QString, ItemBundle>                     _bundles;
+    int                                            _hits;
+    QHash<QString, QSharedPointer<ItemBundleJob> > _inFlight;
+    int                                            _misses;
+    QThreadPool                                    _pool;
+};
+
+#endif
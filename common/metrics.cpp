@@ -10,9 +10,13 @@
 
 #include "metrics.h"
 
+#include <QCoreApplication>
+#include <QJsonDocument>
+#include <QJsonObject>
 #include <QSqlDatabase>
 #include <QSqlDriver>
 #include <QSqlError>
+#include <QTimer>
 #include <QVariant>
 #include <QtScript>
 
@@ -23,25 +27,52 @@ Parameters::Parameters(QObject * parent)
   : QObject(parent)
 {
   _dirty = false;
+  _readLog = 0;
+
+  _flushTimer = new QTimer(this);
+  _flushTimer->setSingleShot(true);
+  _flushTimer->setInterval(0);
+  connect(_flushTimer, SIGNAL(timeout()), this, SLOT(flush()));
+  if (QCoreApplication::instance())
+    connect(QCoreApplication::instance(), SIGNAL(aboutToQuit()), this, SLOT(flush()));
+}
+
+Parameters::~Parameters()
+{
+  flush();
 }
 
 void Parameters::load()
 {
+  flush();
   _values.clear();
 
+  MetricMap values;
   XSqlQuery q;
   q.prepare(_readSql);
   q.bindValue(":username", _username);
   q.exec();
   while (q.next())
-    _values[q.value("key").toString()] = q.value("value").toString();
+    values[q.value("key").toString()] = q.value("value").toString();
   if (ErrorReporter::error(QtCriticalMsg, 0,
                            tr("Error loading %1").arg(metaObject()->className()),
                            q, __FILE__, __LINE__))
     return;
 
-  _dirty = false;
+  load(values);
+}
+
+/** \brief Take values already read from the database, for example as part
+           of a larger query, instead of reading them with _readSql.
+  */
+void Parameters::load(const MetricMap &pValues)
+{
+  _values = pValues;
+  for (MetricMap::const_iterator it = _pending.constBegin(); it != _pending.constEnd(); ++it)
+    _values.insert(it.key(), it.value());
+  _dirty  = false;
 
+  valuesLoaded();
   emit loaded();
 }
 
@@ -58,6 +89,9 @@ QString Parameters::value(const char *pName)
 
 QString Parameters::value(const QString &pName)
 {
+  if (_readLog)
+    _readLog->insert(pName);
+
   MetricMap::iterator it = _values.find(pName);
   if (it == _values.end())
     return QString::null;
@@ -72,6 +106,9 @@ bool Parameters::boolean(const char *pName)
 
 bool Parameters::boolean(const QString &pName)
 {
+  if (_readLog)
+    _readLog->insert(pName);
+
   MetricMap::iterator it = _values.find(pName);
   if (it == _values.end())
     return false;
@@ -119,7 +156,56 @@ void Parameters::set(const QString &pName, const QString &pValue)
   else
     _values[pName] = pValue;
 
-  _set(pName, pValue);
+  if (_batchSql.isEmpty())
+    _set(pName, pValue);
+  else
+  {
+    _pending.insert(pName, pValue);
+    _flushTimer->start();
+  }
+  emit valueChanged(pName);
+}
+
+/** \brief Write the values given to set() since the last flush to the
+           database in one statement.
+
+    If the batch statement fails, for example on a database too old to
+    run it, each value is written with _setSql instead.
+
+    \return true if the batch statement succeeded
+  */
+bool Parameters::flush()
+{
+  _flushTimer->stop();
+  if (_pending.isEmpty())
+    return true;
+
+  MetricMap pending = _pending;
+  _pending.clear();
+
+  QJsonObject values;
+  for (MetricMap::const_iterator it = pending.constBegin(); it != pending.constEnd(); ++it)
+    values.insert(it.key(), it.value());
+
+  XSqlQuery q;
+  q.prepare(_batchSql);
+  q.bindValue(":username", _username);
+  q.bindValue(":values", QString(QJsonDocument(values).toJson(QJsonDocument::Compact)));
+  q.exec();
+  if (q.lastError().type() == QSqlError::NoError)
+  {
+    _dirty = true;
+    return true;
+  }
+
+  qWarning("%s::flush() batch of %d failed, writing one at a time: %s",
+           metaObject()->className(), pending.size(),
+           qPrintable(q.lastError().text()));
+
+  for (MetricMap::const_iterator it = pending.constBegin(); it != pending.constEnd(); ++it)
+    _set(it.key(), it.value());
+
+  return false;
 }
 
 void Parameters::_set(const QString &pName, QVariant pValue)
@@ -143,15 +229,34 @@ QString Parameters::parent(const QString &pValue)
   return QString::null;
 }
 
+/** @brief Record the name of every value read from now on in pLog, or
+           stop recording if pLog is 0.
+  */
+void Parameters::setReadLog(QSet<QString> *pLog)
+{
+  _readLog = pLog;
+}
+
 Metrics::Metrics()
 {
   _notifyName = "metricsUpdated";
   _readSql = "SELECT metric_name AS key, metric_value AS value FROM metric;";
   _setSql  = "SELECT setMetric(:name, :value);";
+  _batchSql = "SELECT setMetric(key, value) FROM json_each_text(:values::JSON);";
 
   load();
 }
 
+Metrics::Metrics(const MetricMap &pValues)
+{
+  _notifyName = "metricsUpdated";
+  _readSql = "SELECT metric_name AS key, metric_value AS value FROM metric;";
+  _setSql  = "SELECT setMetric(:name, :value);";
+  _batchSql = "SELECT setMetric(key, value) FROM json_each_text(:values::JSON);";
+
+  load(pValues);
+}
+
 Preferences::Preferences(const QString &pUsername)
 {
   _notifyName = "preferencesUpdated";
@@ -159,13 +264,31 @@ Preferences::Preferences(const QString &pUsername)
               "FROM usrpref "
               "WHERE (usrpref_username=:username);";
   _setSql   = "SELECT setUserPreference(:username, :name, :value);";
+  _batchSql = "SELECT setUserPreference(:username, key, value)"
+              "  FROM json_each_text(:values::JSON);";
   _username = pUsername;
 
   load();
 }
 
+Preferences::Preferences(const QString &pUsername, const MetricMap &pValues)
+{
+  _notifyName = "preferencesUpdated";
+  _readSql  = "SELECT usrpref_name AS key, usrpref_value AS value "
+              "FROM usrpref "
+              "WHERE (usrpref_username=:username);";
+  _setSql   = "SELECT setUserPreference(:username, :name, :value);";
+  _batchSql = "SELECT setUserPreference(:username, key, value)"
+              "  FROM json_each_text(:values::JSON);";
+  _username = pUsername;
+
+  load(pValues);
+}
+
 void Preferences::remove(const QString &pPrefName)
 {
+  _pending.remove(pPrefName);
+
   XSqlQuery q;
   q.prepare("SELECT deleteUserPreference(:prefname);");
   q.bindValue(":prefname", pPrefName);
@@ -176,7 +299,6 @@ void Preferences::remove(const QString &pPrefName)
 
 Privileges::Privileges()
 {
-  _notifyName = "usrprivUpdated";
   QString user;
   XSqlQuery userq("SELECT getEffectiveXtUser() AS user;");
   if (userq.lastError().type() != QSqlError::NoError)
@@ -184,6 +306,22 @@ Privileges::Privileges()
   if (userq.first())
     user = userq.value("user").toString();
 
+  init(user);
+  load();
+}
+
+/** \brief Create the privileges for pUser from names already read from the
+           database. Each granted privilege maps to "t".
+  */
+Privileges::Privileges(const QString &pUser, const MetricMap &pValues)
+{
+  init(pUser);
+  load(pValues);
+}
+
+void Privileges::init(const QString &user)
+{
+  _notifyName = "usrprivUpdated";
   _readSql = QString("SELECT priv_name AS key, TEXT('t') AS value "
              "  FROM usrpriv, priv "
              " WHERE((usrpriv_priv_id=priv_id)"
@@ -198,40 +336,181 @@ Privileges::Privileges()
   QSqlDatabase::database().driver()->subscribeToNotification("usrprivUpdated");
   QObject::connect(QSqlDatabase::database().driver(), SIGNAL(notification(const QString&)),
            this, SLOT(sSetDirty(const QString &)));
+}
 
-  load();
+/* The interned names are shared by every Privileges object
+   so compiled expressions and change sets can be compared freely.
+ */
+static QHash<QString, int> _privIds;
+static QStringList         _privNames;
+
+int Privileges::id(const QString &pName)
+{
+  QHash<QString, int>::const_iterator it = _privIds.constFind(pName);
+  if (it != _privIds.constEnd())
+    return it.value();
+
+  int result = _privNames.size();
+  _privIds.insert(pName, result);
+  _privNames.append(pName);
+  return result;
 }
 
-bool Privileges::check(const QString &pName)
+QString Privileges::name(int pId)
+{
+  return _privNames.value(pId);
+}
+
+/** @class PrivilegeExpression
+
+    @brief A privilege string compiled to a tree of privilege ids.
+
+    Evaluation follows the rules check() has always used: the string is
+    true if it names a granted privilege, or if any of its space-separated
+    parts is true, or, failing both, if it contains a + and all of its
+    +-separated parts are true.
+ */
+class PrivilegeExpression
 {
-    if (pName == "#superuser")
-      return isDba();
+  public:
+    PrivilegeExpression() : superuser(false), hasAnd(false), leaf(-1) { }
+    ~PrivilegeExpression()
+    {
+      qDeleteAll(anyOf);
+      qDeleteAll(allOf);
+    }
 
-    if(_dirty)
-      load();
+    bool evaluate(const QBitArray &pGranted, Privileges *pPrivs) const
+    {
+      if (superuser)
+        return pPrivs->isDba();
 
-    MetricMap::iterator it = _values.find(pName);
-    if (it != _values.end())
-      return true;
+      if (leaf >= 0 && leaf < pGranted.size() && pGranted.testBit(leaf))
+        return true;
 
-    if (pName.contains(" ")) {
-      QStringList privlist = pName.split(' ', QString::SkipEmptyParts);
-      foreach (QString priv, privlist) {
-        if (check(priv))
+      foreach (PrivilegeExpression *part, anyOf)
+        if (part->evaluate(pGranted, pPrivs))
           return true;
+
+      if (hasAnd)
+      {
+        foreach (PrivilegeExpression *part, allOf)
+          if (! part->evaluate(pGranted, pPrivs))
+            return false;
+        return true;
       }
+
+      return false;
     }
 
-    if (pName.contains("+")) {
-      bool anded = true;
-      QStringList privlist = pName.split('+', QString::SkipEmptyParts);
-      foreach (QString priv, privlist) {
-        anded = anded && check(priv);
-      }
-      return anded;
+    bool references(const QBitArray &pChanged) const
+    {
+      foreach (int privid, ids)
+        if (privid < pChanged.size() && pChanged.testBit(privid))
+          return true;
+      return false;
+    }
+
+    bool                        superuser;
+    bool                        hasAnd;
+    int                         leaf;
+    QList<PrivilegeExpression*> anyOf;
+    QList<PrivilegeExpression*> allOf;
+    QList<int>                  ids;   // every id used anywhere in the tree
+};
+
+static PrivilegeExpression *compileExpression(const QString &pName)
+{
+  PrivilegeExpression *expr = new PrivilegeExpression();
+  if (pName == "#superuser")
+  {
+    expr->superuser = true;
+    return expr;
+  }
+
+  expr->leaf = Privileges::id(pName);
+  expr->ids.append(expr->leaf);
+
+  if (pName.contains(" "))
+  {
+    foreach (QString priv, pName.split(' ', QString::SkipEmptyParts))
+    {
+      PrivilegeExpression *part = compileExpression(priv);
+      expr->anyOf.append(part);
+      expr->ids.append(part->ids);
     }
+  }
 
- return false;
+  if (pName.contains("+"))
+  {
+    expr->hasAnd = true;
+    foreach (QString priv, pName.split('+', QString::SkipEmptyParts))
+    {
+      PrivilegeExpression *part = compileExpression(priv);
+      expr->allOf.append(part);
+      expr->ids.append(part->ids);
+    }
+  }
+
+  return expr;
+}
+
+Privileges::~Privileges()
+{
+  qDeleteAll(_compiled);
+}
+
+PrivilegeExpression *Privileges::compile(const QString &pName)
+{
+  QHash<QString, PrivilegeExpression*>::const_iterator it = _compiled.constFind(pName);
+  if (it != _compiled.constEnd())
+    return it.value();
+
+  PrivilegeExpression *expr = compileExpression(pName);
+  _compiled.insert(pName, expr);
+  return expr;
+}
+
+/* Rebuild the granted bits from the freshly loaded values and tell
+   anyone who cares which privileges were granted or revoked.
+ */
+void Privileges::valuesLoaded()
+{
+  QBitArray granted(_privNames.size() + _values.size());
+  for (MetricMap::const_iterator it = _values.constBegin(); it != _values.constEnd(); ++it)
+  {
+    int privid = id(it.key());
+    if (privid >= granted.size())
+      granted.resize(_privNames.size());
+    granted.setBit(privid);
+  }
+  granted.resize(_privNames.size());
+
+  QBitArray old = _granted;
+  old.resize(granted.size());
+  _granted = granted;
+
+  QBitArray changed = old ^ granted;
+  if (changed.count(true) > 0)
+    emit privilegesChanged(changed);
+}
+
+bool Privileges::check(const QString &pName)
+{
+  if(_dirty)
+    load();
+
+  return compile(pName)->evaluate(_granted, this);
+}
+
+/** @brief Return true if the privilege expression pName depends on any of
+           the privilege ids set in pChanged.
+
+    Expressions that require superuser access never change this way.
+ */
+bool Privileges::references(const QString &pName, const QBitArray &pChanged)
+{
+  return compile(pName)->references(pChanged);
 }
 
 bool Privileges::isDba()
@@ -12,31 +12,61 @@
 #ifndef metrics_h
 #define metrics_h
 
+#include <QBitArray>
+#include <QHash>
 #include <QObject>
+#include <QSet>
 #include <QString>
 #include <QMap>
 
+class PrivilegeExpression;
 class QScriptEngine;
+class QTimer;
 
 typedef QMap<QString, QString> MetricMap;
 
+/**
+  @class Parameters
+
+  @brief A set of named values read from and written to the database.
+
+  If the subclass sets _batchSql, set() does not write to the database
+  right away. New values are kept in memory, where value() and boolean()
+  see them at once, and flush() writes all of them with one statement:
+  when control returns to the event loop, before load() rereads the
+  values, and when the application quits. Because the batch is a single
+  transaction, the database sends one notification for it instead of one
+  per value. Call flush() directly if a query you are about to run needs
+  to see the new values.
+
+  Without _batchSql each set() runs _setSql immediately.
+
+  setReadLog() makes value() and boolean() add each name they are asked
+  for to a caller's set, so the caller can tell later whether a change
+  matters to it.
+ */
 class Parameters : public QObject
 {
   Q_OBJECT
 
   protected:
     MetricMap _values;
+    MetricMap _pending;
     QString   _readSql;
     QString   _setSql;
+    QString   _batchSql;
     QString   _username;
     bool      _dirty;
     QString   _notifyName;
+    QTimer   *_flushTimer;
+    QSet<QString> *_readLog;
 
   public:
     Parameters(QObject * parent = 0);
-    virtual ~Parameters() {};
+    virtual ~Parameters();
 
     virtual void load();
+    virtual void load(const MetricMap &);
 
     virtual QString value(const char *);
     virtual bool    boolean(const char *);
@@ -50,16 +80,21 @@ class Parameters : public QObject
 
     virtual QString parent(const QString &);
 
+    void setReadLog(QSet<QString> *);
+
   public slots:
     virtual QString value(const QString &);
     virtual bool    boolean(const QString &);
     virtual void    sSetDirty(const QString &);
+    bool            flush();
 
   protected:
     virtual void _set(const QString &, QVariant);
+    virtual void valuesLoaded() {};
 
   signals:
     void loaded();
+    void valueChanged(const QString &pName);
 
 };
 
@@ -69,6 +104,7 @@ class Metrics : public Parameters
 
   public:
     Metrics();
+    Metrics(const MetricMap &);
 };
 
 class Preferences : public Parameters
@@ -78,20 +114,52 @@ class Preferences : public Parameters
   public:
     Preferences() {};
     Preferences(const QString &);
+    Preferences(const QString &, const MetricMap &);
 
     void remove(const QString &);
 };
 
+/**
+  @class Privileges
+
+  @brief The set of privileges granted to the current user.
+
+  Privilege names are interned to small integer ids and the granted set is
+  kept as a bit array. Each distinct expression passed to check() is
+  compiled once into a PrivilegeExpression and cached, so repeated checks
+  cost a hash lookup and a few bit tests.
+
+  When the privileges are reloaded, privilegesChanged() reports the ids
+  that were granted or revoked. Use references() to find out whether a
+  given expression depends on any of them.
+ */
 class Privileges : public Parameters
 {
   Q_OBJECT
 
   public:
     Privileges();
+    Privileges(const QString &, const MetricMap &);
+    virtual ~Privileges();
+
+    static int     id(const QString &);
+    static QString name(int);
 
   public slots:
     bool check(const QString &);
     bool isDba();
+    bool references(const QString &, const QBitArray &);
+
+  signals:
+    void privilegesChanged(const QBitArray &);
+
+  protected:
+    virtual void valuesLoaded();
+    PrivilegeExpression *compile(const QString &);
+    void init(const QString &);
+
+    QHash<QString, PrivilegeExpression*> _compiled;
+    QBitArray                            _granted;
 };
 
 void setupParameters(QScriptEngine *engine, QString name, Parameters *params);
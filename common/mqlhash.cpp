@@ -12,14 +12,81 @@
 
 #include <QVariant>
 
+#include <metasql.h>
+
 #include "xsqlquery.h"
 
+#define DEBUG false
+
 MqlHash::MqlHash(QObject *pParent, QSqlDatabase pDb)
-  : XCachedHash<QString, QString>(pParent, QString(), pDb)
+  : XCachedHash<QString, QString>(pParent, QString(), pDb),
+    _generation(0),
+    _parseCount(0),
+    _reuseCount(0)
 {
   setNotification(QStringList() << "metasql" << "pkgmetasql");
 }
 
+MqlHash::~MqlHash()
+{
+  qDeleteAll(_parsed);
+}
+
+void MqlHash::clear()
+{
+  XCachedHash<QString, QString>::clear();
+  qDeleteAll(_parsed);
+  _parsed.clear();
+  _generation++;
+  if (DEBUG)
+    qDebug("MqlHash::clear() generation %d after %d parses, %d reuses",
+           _generation, _parseCount, _reuseCount);
+}
+
+/** \brief Incremented every time the cache is cleared.  */
+int MqlHash::generation() const
+{
+  return _generation;
+}
+
+/** \brief The number of times a MetaSQL statement was parsed by query().  */
+int MqlHash::parseCount() const
+{
+  return _parseCount;
+}
+
+/** \brief The number of times query() returned an already-parsed template.  */
+int MqlHash::reuseCount() const
+{
+  return _reuseCount;
+}
+
+/** \brief Return the parsed template for the given group and name.
+
+    The statement is parsed the first time it is asked for and the
+    MetaSQLQuery is kept until the metasql table changes.
+    Returns 0 if the statement does not exist.
+  */
+MetaSQLQuery *MqlHash::query(const QString &pGroup, const QString &pName)
+{
+  QString key = pGroup + "%" + pName;   // must match value(pGroup, pName)
+  MetaSQLQuery *mql = _parsed.value(key, 0);
+  if (mql)
+  {
+    _reuseCount++;
+    return mql;
+  }
+
+  QString text = value(key);
+  if (text.isEmpty())
+    return 0;
+
+  mql = new MetaSQLQuery(text);
+  _parsed.insert(key, mql);
+  _parseCount++;
+  return mql;
+}
+
 bool MqlHash::refresh(const QString &key)
 {
   QStringList parts = key.split("%");   // must match value(pGroup, pName) below
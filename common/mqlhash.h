@@ -13,16 +13,42 @@
 
 #include "xcachedhash.h"
 
+class MetaSQLQuery;
+
+/**
+  @class MqlHash
+
+  @brief Caches MetaSQL statements from the metasql table, both as text and
+         as parsed MetaSQLQuery templates.
+
+  The text is returned by value(). query() returns a parsed template that
+  belongs to the hash; it can be expanded with MetaSQLQuery::toQuery() as
+  often as needed but must not be kept past the next clear(). Callers that
+  hold on to something derived from a template, such as a prepared query,
+  should compare generation() to tell whether the templates were reloaded.
+ */
 class MqlHash : public XCachedHash<QString, QString>
 {
   Q_OBJECT
 
   public:
     MqlHash(QObject *pParent = 0, QSqlDatabase pDb = QSqlDatabase::database());
+    virtual ~MqlHash();
     using XCachedHash::value;
 
-    virtual       bool    refresh(const QString &key);
-    virtual const QString value(const QString &pGroup, const QString &pName);
+    virtual       void          clear();
+    virtual       int           generation() const;
+    virtual       int           parseCount() const;
+    virtual       MetaSQLQuery *query(const QString &pGroup, const QString &pName);
+    virtual       bool          refresh(const QString &key);
+    virtual       int           reuseCount() const;
+    virtual const QString       value(const QString &pGroup, const QString &pName);
+
+  protected:
+    int                           _generation;
+    QHash<QString, MetaSQLQuery*> _parsed;
+    int                           _parseCount;
+    int                           _reuseCount;
 };
 
 #endif
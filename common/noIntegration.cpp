@@ -13,7 +13,8 @@
 #include <QJsonDocument>
 #include <QJsonObject>
 
-NoIntegration::NoIntegration(bool listen) : TaxIntegration(listen)
+NoIntegration::NoIntegration(bool listen, QSqlDatabase pDb)
+  : TaxIntegration(listen, pDb)
 {
 }
 
@@ -18,7 +18,7 @@ class NoIntegration : public TaxIntegration
   Q_OBJECT
 
   public:
-    NoIntegration(bool = false);
+    NoIntegration(bool = false, QSqlDatabase = QSqlDatabase::database());
 
   protected:
     virtual void sendRequest(QString, QString, int, QString, QStringList, QString);
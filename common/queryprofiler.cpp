@@ -0,0 +1,226 @@
+/*
+ * This file is part of the xTuple ERP: PostBooks Edition, a free and
+ * open source Enterprise Resource Planning software suite,
+ * Copyright (c) 1999-2019 by OpenMFG LLC, d/b/a xTuple.
+ * It is licensed to you under the Common Public Attribution License
+ * version 1.0, the full text of which (including xTuple-specific Exhibits)
+ * is available at www.xtuple.com/CPAL.  By using this software, you agree
+ * to be bound by its terms.
+ */
+
+#include "queryprofiler.h"
+
+#include <QApplication>
+#include <QFileInfo>
+#include <QMap>
+#include <QMdiSubWindow>
+#include <QRegExp>
+#include <QSqlQuery>
+#include <QStringList>
+#include <QTimer>
+#include <QVariant>
+#include <QWidget>
+
+#define DEBUG false
+
+// how many records to keep before dropping the oldest
+#define MAXPROFILES       10000
+// how many same-shaped statements from one line in one turn look like N+1
+#define REPEATTHRESHOLD   5
+// how much of each parameter value to keep
+#define MAXPARAMLENGTH    60
+
+bool QueryProfiler::_enabled = false;
+
+QueryProfile::QueryProfile()
+  : serial(-1),
+    turn(-1),
+    elapsed(-1),
+    rows(-1),
+    duplicate(false),
+    repeated(false)
+{
+}
+
+QueryProfiler::QueryProfiler(QObject *pParent)
+  : QObject(pParent),
+    _firstSerial(0),
+    _turn(0),
+    _turnPending(false)
+{
+  setObjectName("queryProfiler");
+}
+
+QueryProfiler *QueryProfiler::instance()
+{
+  static QueryProfiler *profiler = 0;
+  if (! profiler)
+    profiler = new QueryProfiler(QCoreApplication::instance());
+  return profiler;
+}
+
+QList<QueryProfile> QueryProfiler::profiles() const
+{
+  return _profiles;
+}
+
+/** @brief Return the record with the given serial number, or an empty
+           record if it has been cleared or dropped.
+  */
+QueryProfile QueryProfiler::profile(int pSerial) const
+{
+  int index = pSerial - _firstSerial;
+  if (index >= 0 && index < _profiles.size())
+    return _profiles.at(index);
+  return QueryProfile();
+}
+
+void QueryProfiler::record(const QSqlQuery &pQuery, qint64 pElapsed,
+                           QObject *pContext, const char *pFile, int pLine)
+{
+  if (! _enabled)
+    return;
+
+  QueryProfile profile;
+  profile.serial  = _firstSerial + _profiles.size();
+  profile.turn    = _turn;
+  profile.when    = QDateTime::currentDateTime();
+  profile.elapsed = pElapsed;
+  profile.window  = windowOf(pContext);
+  profile.source  = QString("%1:%2").arg(QFileInfo(pFile).fileName()).arg(pLine);
+  profile.sql     = pQuery.lastQuery().simplified();
+
+  if (pQuery.isActive())
+    profile.rows = pQuery.isSelect() ? pQuery.size() : pQuery.numRowsAffected();
+
+  QStringList params;
+  QMap<QString, QVariant> bound = pQuery.boundValues();
+  for (QMap<QString, QVariant>::const_iterator it = bound.constBegin();
+       it != bound.constEnd(); ++it)
+  {
+    QString value = it.value().isNull() ? QString("NULL") : it.value().toString();
+    if (value.length() > MAXPARAMLENGTH)
+      value = value.left(MAXPARAMLENGTH) + "...";
+    params << QString("%1=%2").arg(it.key(), value);
+  }
+  profile.params = params.join(", ");
+
+  QString signature = profile.sql + "\n" + profile.params;
+  profile.duplicate = _seen.contains(signature);
+  _seen[signature]++;
+
+  QString shape = profile.source + "\n" + shapeOf(profile.sql);
+  _shapes[shape].append(profile.serial);
+  int sameShape = _shapes.value(shape).size();
+  profile.repeated = sameShape >= REPEATTHRESHOLD;
+
+  _profiles.append(profile);
+  if (_profiles.size() > MAXPROFILES)
+  {
+    _profiles.removeFirst();
+    emit dropped(_firstSerial++);
+  }
+  emit recorded(profile.serial);
+
+  // the ones before the threshold was reached are part of the loop too
+  if (sameShape == REPEATTHRESHOLD)
+  {
+    foreach (int serial, _shapes.value(shape))
+    {
+      int index = serial - _firstSerial;
+      if (serial != profile.serial && index >= 0 && index < _profiles.size())
+      {
+        _profiles[index].repeated = true;
+        emit flagged(serial);
+      }
+    }
+  }
+
+  if (! _turnPending)
+  {
+    _turnPending = true;
+    QTimer::singleShot(0, this, SLOT(sEndTurn()));
+  }
+}
+
+void QueryProfiler::clear()
+{
+  _firstSerial += _profiles.size();
+  _profiles.clear();
+  _seen.clear();
+  _shapes.clear();
+  emit cleared();
+}
+
+void QueryProfiler::setEnabled(bool pEnabled)
+{
+  if (DEBUG)
+    qDebug("QueryProfiler::setEnabled(%d)", pEnabled);
+  _enabled = pEnabled;
+}
+
+/* Reduce pSql to its structure: every literal string and number becomes
+   ?, so statements that differ only in the values they were built with
+   look the same.
+ */
+QString QueryProfiler::shapeOf(const QString &pSql)
+{
+  QString shape(pSql);
+  shape.replace(QRegExp("'([^']|'')*'"), "?");
+  shape.replace(QRegExp("\\b\\d+(\\.\\d+)?\\b"), "?");
+  return shape;
+}
+
+/* Describe the window pContext belongs to, or the one with focus if
+   pContext is not a widget. In the workspace that is the widget inside
+   the QMdiSubWindow, not the main window.
+ */
+QString QueryProfiler::windowOf(QObject *pContext)
+{
+  QWidget *widget = qobject_cast<QWidget*>(pContext);
+  if (! widget)
+    widget = QApplication::focusWidget();
+  if (! widget)
+    widget = QApplication::activeWindow();
+
+  for ( ; widget; widget = widget->parentWidget())
+  {
+    if (widget->isWindow() || qobject_cast<QMdiSubWindow*>(widget->parentWidget()))
+      break;
+  }
+  if (! widget)
+    return QString();
+
+  if (widget->windowTitle().isEmpty())
+    return widget->metaObject()->className();
+  return QString("%1 (%2)").arg(widget->metaObject()->className(),
+                                widget->windowTitle());
+}
+
+void QueryProfiler::sEndTurn()
+{
+  _turn++;
+  _turnPending = false;
+  _seen.clear();
+  _shapes.clear();
+}
+
+/** @brief Start timing a query run on behalf of pContext from pFile at
+           pLine. Nothing is timed while the profiler is off.
+  */
+QueryProbe::QueryProbe(QObject *pContext, const char *pFile, int pLine)
+  : _context(pContext),
+    _file(pFile),
+    _line(pLine)
+{
+  if (QueryProfiler::isEnabled())
+    _timer.start();
+}
+
+void QueryProbe::record(const QSqlQuery &pQuery)
+{
+  if (QueryProfiler::isEnabled())
+    QueryProfiler::instance()->record(pQuery,
+                                      _timer.isValid() ? _timer.elapsed() : -1,
+                                      _context, _file, _line);
+}
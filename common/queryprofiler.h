@@ -0,0 +1,127 @@
+/*
+ * This file is part of the xTuple ERP: PostBooks Edition, a free and
+ * open source Enterprise Resource Planning software suite,
+ * Copyright (c) 1999-2019 by OpenMFG LLC, d/b/a xTuple.
+ * It is licensed to you under the Common Public Attribution License
+ * version 1.0, the full text of which (including xTuple-specific Exhibits)
+ * is available at www.xtuple.com/CPAL.  By using this software, you agree
+ * to be bound by its terms.
+ */
+
+#ifndef __QUERYPROFILER_H__
+#define __QUERYPROFILER_H__
+
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QList>
+#include <QObject>
+#include <QString>
+
+class QSqlQuery;
+
+/** @brief One query execution seen by the QueryProfiler. */
+class QueryProfile
+{
+  public:
+    QueryProfile();
+
+    int       serial;     // increases by one per execution recorded
+    int       turn;       // event loop turn the query ran in
+    QDateTime when;
+    qint64    elapsed;    // milliseconds, -1 if not timed
+    int       rows;       // rows returned or affected, -1 if unknown
+    QString   window;     // class and title of the window it ran for
+    QString   source;     // file:line that ran it
+    QString   sql;
+    QString   params;
+    bool      duplicate;  // identical sql and parameters already ran this turn
+    bool      repeated;   // one of many same-shaped statements this turn
+};
+
+/**
+  @class QueryProfiler
+
+  @brief Records the queries run by instrumented code so round-trip waste
+         can be found.
+
+  The profiler is off until setEnabled(true); until then recording costs
+  one test of a static flag. Each record notes the window the query ran
+  for, the source line that ran it, how long it took and how many rows it
+  touched.
+
+  Records are grouped into event loop turns: a turn ends the next time the
+  event loop gets control. A query is flagged as a duplicate if the same
+  SQL with the same parameters already ran in the same turn. It is flagged
+  as repeated when the same statement, ignoring parameters and literal
+  values, runs from the same source line REPEATTHRESHOLD or more times in
+  one turn. That is the shape of an N+1 loop that should be a single query.
+
+  Use a QueryProbe around an execution to time it and record it:
+
+  @code
+    QueryProbe probe(this, __FILE__, __LINE__);
+    XSqlQuery query = mql.toQuery(params);
+    probe.record(query);
+  @endcode
+ */
+class QueryProfiler : public QObject
+{
+  Q_OBJECT
+
+  public:
+    static QueryProfiler *instance();
+    static bool isEnabled() { return _enabled; }
+
+    QList<QueryProfile> profiles() const;
+    QueryProfile        profile(int pSerial) const;
+
+    void record(const QSqlQuery &pQuery, qint64 pElapsed, QObject *pContext,
+                const char *pFile, int pLine);
+
+  public slots:
+    virtual void clear();
+    virtual void setEnabled(bool pEnabled);
+
+  signals:
+    void cleared();
+    void dropped(int pSerial);
+    void flagged(int pSerial);
+    void recorded(int pSerial);
+
+  protected:
+    QueryProfiler(QObject *pParent = 0);
+
+    static QString shapeOf(const QString &pSql);
+    static QString windowOf(QObject *pContext);
+
+  protected slots:
+    virtual void sEndTurn();
+
+  private:
+    static bool _enabled;
+
+    int                         _firstSerial;
+    QList<QueryProfile>         _profiles;
+    QHash<QString, QList<int> > _shapes;  // this turn's serials by source and shape
+    QHash<QString, int>         _seen;    // this turn's sql and parameters
+    int                         _turn;
+    bool                        _turnPending;
+};
+
+/** @brief Times one query execution and hands it to the QueryProfiler. */
+class QueryProbe
+{
+  public:
+    QueryProbe(QObject *pContext, const char *pFile, int pLine);
+
+    void record(const QSqlQuery &pQuery);
+
+  private:
+    QObject      *_context;
+    const char   *_file;
+    int           _line;
+    QElapsedTimer _timer;
+};
+
+#endif
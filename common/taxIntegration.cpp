@@ -10,8 +10,11 @@
 
 #include "taxIntegration.h"
 
+#include <QCoreApplication>
+#include <QCryptographicHash>
 #include <QJsonDocument>
 #include <QJsonObject>
+#include <QThread>
 #include <QtScript>
 
 #include "errorReporter.h"
@@ -19,24 +22,41 @@
 #include "noIntegration.h"
 
 TaxIntegration* TaxIntegration::getTaxIntegration(bool listen)
+{
+  return getTaxIntegration(listen, QSqlDatabase::database());
+}
+
+/** \brief Get a TaxIntegration that talks to the database through pDb.
+
+    Code running on a worker thread must pass its own connection and create
+    the TaxIntegration on that thread.
+  */
+TaxIntegration* TaxIntegration::getTaxIntegration(bool listen, QSqlDatabase pDb)
 {
   // Can't access _metrics from here, but only queries once at startup and in setup
-  XSqlQuery service("SELECT fetchMetricText('TaxService') AS TaxService;");
+  XSqlQuery service(pDb);
+  service.exec("SELECT fetchMetricText('TaxService') AS TaxService;");
 
   if (service.first() && service.value("TaxService") == "A")
-    return new AvalaraIntegration(listen);
+    return new AvalaraIntegration(listen, pDb);
   else
-    return new NoIntegration(listen);
+    return new NoIntegration(listen, pDb);
 }
 
-TaxIntegration::TaxIntegration(bool listen)
+#define RESULTCACHESIZE 256
+
+TaxIntegration::TaxIntegration(bool listen, QSqlDatabase pDb)
+  : _db(pDb),
+    _results(RESULTCACHESIZE),
+    _cacheHits(0),
+    _cacheMisses(0)
 {
   if (listen)
   {
-    if (!QSqlDatabase::database().driver()->subscribedToNotifications().contains("calculatetax"))
-      QSqlDatabase::database().driver()->subscribeToNotification("calculatetax");
+    if (!_db.driver()->subscribedToNotifications().contains("calculatetax"))
+      _db.driver()->subscribeToNotification("calculatetax");
 
-    connect(QSqlDatabase::database().driver(),
+    connect(_db.driver(),
             SIGNAL(notification(const QString&, QSqlDriver::NotificationSource, const QVariant&)),
             this,
             SLOT(sNotified(const QString&, QSqlDriver::NotificationSource, const QVariant&))
@@ -61,25 +81,98 @@ void TaxIntegration::test(QStringList config)
 
 bool TaxIntegration::calculateTax(QString orderType, int orderId, bool record)
 {
-  XSqlQuery qry;
+  if (!startCalculation(orderType, orderId, record))
+    return false;
+
+  wait();
+  return _error.isEmpty();
+}
+
+/** \brief Start calculating tax for an order and return without waiting.
+
+    The result arrives through the taxCalculated and orderTaxCalculated
+    signals. Call wait() to block until every outstanding request is done.
+  */
+void TaxIntegration::calculateTaxAsync(QString orderType, int orderId, bool record)
+{
+  (void)startCalculation(orderType, orderId, record);
+}
+
+/* The tax service gives the same answer for the same document, so when an
+   estimate for an order matches one already answered the saved response is
+   used instead of calling the service again. Recording a document always
+   goes to the service: it has to know the document before it can commit it.
+ */
+bool TaxIntegration::startCalculation(QString orderType, int orderId, bool record)
+{
+  XSqlQuery qry(_db);
   qry.prepare("SELECT calculateOrderTax(:orderType, :orderId, :record) AS request;");
   qry.bindValue(":orderType", orderType);
   qry.bindValue(":orderId", orderId);
   qry.bindValue(":record", record);
   qry.exec();
-  if (qry.first())
-    if (qry.value("request").isNull())
-      emit taxCalculated(0.0, "");
-    else
-      sendRequest("createtransaction", orderType, orderId, qry.value("request").toString());
-  else
+  if (!qry.first())
   {
     _error = qry.lastError().text();
     return false;
   }
 
-  wait();
-  return _error.isEmpty();
+  if (qry.value("request").isNull())
+  {
+    emit taxCalculated(0.0, "");
+    emit orderTaxCalculated(orderType, orderId, 0.0, "");
+    return true;
+  }
+
+  QString request = qry.value("request").toString();
+  if (record)
+    forgetResult(orderType, orderId);
+  else if (cachesResults())
+  {
+    QJsonDocument doc = QJsonDocument::fromJson(request.toUtf8());
+    QByteArray normalized = doc.isNull() ? request.toUtf8()
+                                         : doc.toJson(QJsonDocument::Compact);
+    QByteArray key = QCryptographicHash::hash(normalized, QCryptographicHash::Sha1);
+    QString orderKey = orderType + "%" + QString::number(orderId);
+    _resultKeys.insert(orderKey, key);
+
+    QString *response = _results.object(key);
+    if (response)
+    {
+      _cacheHits++;
+      handleResponse("createtransaction", orderType, orderId, *response, QString());
+      return true;
+    }
+    _cacheMisses++;
+  }
+
+  sendRequest("createtransaction", orderType, orderId, request);
+  return true;
+}
+
+bool TaxIntegration::cachesResults() const
+{
+  return false;
+}
+
+/** \brief Drop the saved response for an order so the next calculation
+           goes to the tax service.
+  */
+void TaxIntegration::forgetResult(QString orderType, int orderId)
+{
+  QByteArray key = _resultKeys.take(orderType + "%" + QString::number(orderId));
+  if (! key.isEmpty())
+    _results.remove(key);
+}
+
+int TaxIntegration::cacheHits() const
+{
+  return _cacheHits;
+}
+
+int TaxIntegration::cacheMisses() const
+{
+  return _cacheMisses;
 }
 
 bool TaxIntegration::commit(QString orderType, int orderId)
@@ -90,7 +183,7 @@ bool TaxIntegration::commit(QString orderType, int orderId)
   if (!_error.isEmpty())
     return false;
 
-  XSqlQuery qry;
+  XSqlQuery qry(_db);
   qry.prepare("SELECT postTax(:orderType, :orderId) AS request;");
   qry.bindValue(":orderType", orderType);
   qry.bindValue(":orderId", orderId);
@@ -109,7 +202,9 @@ bool TaxIntegration::commit(QString orderType, int orderId)
 
 bool TaxIntegration::cancel(QString orderType, int orderId, QString orderNumber)
 {
-  XSqlQuery qry;
+  forgetResult(orderType, orderId);
+
+  XSqlQuery qry(_db);
   qry.prepare("SELECT voidTax(:orderType, :orderId) AS request;");
   qry.bindValue(":orderType", orderType);
   qry.bindValue(":orderId", orderId);
@@ -129,7 +224,9 @@ bool TaxIntegration::cancel(QString orderType, int orderId, QString orderNumber)
 
 void TaxIntegration::refund(int invcheadId, QDate refundDate)
 {
-  XSqlQuery qry;
+  forgetResult("INV", invcheadId);
+
+  XSqlQuery qry(_db);
   qry.prepare("SELECT refundTax(:invcheadId, :refundDate) AS request;");
   qry.bindValue(":invcheadId", invcheadId);
   qry.bindValue(":refundDate", refundDate);
@@ -137,8 +234,7 @@ void TaxIntegration::refund(int invcheadId, QDate refundDate)
   if (qry.first() && !qry.value("request").isNull())
     sendRequest("refundtransaction", "INV", invcheadId, qry.value("request").toString());
   else
-    ErrorReporter::error(QtCriticalMsg, 0, tr("Error refunding tax"),
-                         qry, __FILE__, __LINE__);
+    reportError(tr("Error refunding tax"), qry, __FILE__, __LINE__);
 }
 
 void TaxIntegration::handleResponse(QString type, QString orderType, int orderId, QString response, QString error)
@@ -164,7 +260,7 @@ void TaxIntegration::handleResponse(QString type, QString orderType, int orderId
   {
     if (error.isEmpty())
     {
-      XSqlQuery qry;
+      XSqlQuery qry(_db);
       qry.prepare("SELECT saveTax(:orderType, :orderId, :response) AS tax;");
       qry.bindValue(":orderType", orderType);
       qry.bindValue(":orderId", orderId);
@@ -172,20 +268,27 @@ void TaxIntegration::handleResponse(QString type, QString orderType, int orderId
       qry.exec();
       if (qry.first())
       {
+        QByteArray key = _resultKeys.value(orderType + "%" + QString::number(orderId));
+        if (cachesResults() && ! key.isEmpty() && ! _results.contains(key))
+          _results.insert(key, new QString(response));
+
         done();
         emit taxCalculated(qry.value("tax").toDouble(), error);
+        emit orderTaxCalculated(orderType, orderId, qry.value("tax").toDouble(), error);
       }
       else
       {
+        forgetResult(orderType, orderId);
         done();
-        ErrorReporter::error(QtCriticalMsg, 0, tr("Error calculating tax"),
-                             qry, __FILE__, __LINE__);
+        reportError(tr("Error calculating tax"), qry, __FILE__, __LINE__);
       }
     }
     else
     {
+      forgetResult(orderType, orderId);
       done();
       emit taxCalculated(0.0, error);
+      emit orderTaxCalculated(orderType, orderId, 0.0, error);
     }
   }
   else
@@ -202,9 +305,9 @@ void TaxIntegration::sNotified(const QString& name, QSqlDriver::NotificationSour
   if (name == "calculatetax" && args.size() >= 2)
   {
     if (args.size() == 2)
-      calculateTax(args[0], args[1].toInt());
+      calculateTaxAsync(args[0], args[1].toInt());
     else
-      calculateTax(args[0], args[1].toInt(), true);
+      calculateTaxAsync(args[0], args[1].toInt(), true);
   }
 }
 
@@ -216,6 +319,28 @@ void TaxIntegration::done()
 {
 }
 
+bool TaxIntegration::isGuiThread() const
+{
+  QCoreApplication *app = QCoreApplication::instance();
+  return ! app || QThread::currentThread() == app->thread();
+}
+
+/* A TaxIntegration working for a background thread has no window to show
+   errors in, so keep the message for error() instead.
+ */
+bool TaxIntegration::reportError(const QString &title, const XSqlQuery &qry,
+                                 const QString &file, int line)
+{
+  if (isGuiThread())
+    return ErrorReporter::error(QtCriticalMsg, 0, title, qry, file, line);
+
+  if (qry.lastError().type() == QSqlError::NoError)
+    return false;
+
+  _error = qry.lastError().text();
+  return true;
+}
+
 QString TaxIntegration::error()
 {
   return _error;
@@ -273,6 +398,21 @@ QScriptValue calculateTax(QScriptContext *context, QScriptEngine *engine)
   return QScriptValue();
 }
 
+QScriptValue calculateTaxAsync(QScriptContext *context, QScriptEngine *engine)
+{
+  Q_UNUSED(engine);
+  TaxIntegration *ti = qscriptvalue_cast<TaxIntegration*>(context->thisObject());
+  if (! ti)
+    context->throwError(QScriptContext::UnknownError, "calculateTaxAsync() called on an invalid object");
+  else if (context->argumentCount() >= 3)
+    ti->calculateTaxAsync(context->argument(0).toString(), context->argument(1).toInt32(), context->argument(2).toBool());
+  else if (context->argumentCount() == 2)
+    ti->calculateTaxAsync(context->argument(0).toString(), context->argument(1).toInt32());
+  else
+    context->throwError(QScriptContext::UnknownError, "calculateTaxAsync(string, integer, optional boolean) requires at least 2 arguments");
+  return QScriptValue();
+}
+
 QScriptValue cancel(QScriptContext *context, QScriptEngine *engine)
 {
   Q_UNUSED(engine);
@@ -303,5 +443,6 @@ void setupTaxIntegration(QScriptEngine *engine)
   proto.setProperty("getTaxIntegration",      engine->newFunction(getTaxIntegration), propflags);
   proto.setProperty("getTaxExemptCategories", engine->newFunction(getTaxExemptCategories), propflags);
   proto.setProperty("calculateTax",           engine->newFunction(calculateTax), propflags);
+  proto.setProperty("calculateTaxAsync",      engine->newFunction(calculateTaxAsync), propflags);
   proto.setProperty("cancel",                 engine->newFunction(cancel), propflags);
 }
@@ -11,7 +11,9 @@
 #ifndef TAXINTEGRATION_H
 #define TAXINTEGRATION_H
 
+#include <QCache>
 #include <QElapsedTimer>
+#include <QHash>
 #include <QObject>
 #include <QDate>
 #include <QSqlDriver>
@@ -26,32 +28,50 @@ class TaxIntegration : public QObject
   Q_OBJECT
 
   public:
-    TaxIntegration(bool = false);
+    TaxIntegration(bool = false, QSqlDatabase = QSqlDatabase::database());
 
     Q_INVOKABLE static TaxIntegration* getTaxIntegration(bool = false);
+    static TaxIntegration* getTaxIntegration(bool, QSqlDatabase);
     Q_INVOKABLE virtual void test(QStringList);
     Q_INVOKABLE virtual void getTaxCodes();
     Q_INVOKABLE virtual void getTaxExemptCategories(QStringList = QStringList());
     Q_INVOKABLE virtual bool calculateTax(QString, int, bool = false);
+    Q_INVOKABLE virtual void calculateTaxAsync(QString, int, bool = false);
     Q_INVOKABLE virtual bool commit(QString, int);
     Q_INVOKABLE virtual bool cancel(QString, int, QString = QString());
     Q_INVOKABLE virtual void refund(int, QDate);
     Q_INVOKABLE virtual void wait();
 
     Q_INVOKABLE virtual QString error();
+    Q_INVOKABLE virtual int     cacheHits() const;
+    Q_INVOKABLE virtual int     cacheMisses() const;
 
   signals:
     void connectionTested(QString);
     void taxCodesFetched(QJsonObject, QString);
     void taxExemptCategoriesFetched(QJsonObject, QString);
     void taxCalculated(double, QString);
+    void orderTaxCalculated(QString, int, double, QString);
 
   protected:
     virtual void sendRequest(QString, QString = QString(), int = 0, QString = QString(), QStringList = QStringList(), QString = QString()) = 0;
     virtual void done();
+    virtual bool isGuiThread() const;
+    virtual bool reportError(const QString &, const XSqlQuery &, const QString &, int);
+    virtual bool cachesResults() const;
+    virtual void forgetResult(QString, int);
+    virtual bool startCalculation(QString, int, bool);
 
     QElapsedTimer timer;
     QString _error;
+    QSqlDatabase _db;
+
+    // estimate (not recorded) createtransaction responses keyed by a hash
+    // of the normalized request
+    QCache<QByteArray, QString> _results;
+    QHash<QString, QByteArray>  _resultKeys;  // orderType%orderId -> _results key
+    int                         _cacheHits;
+    int                         _cacheMisses;
 
   protected slots:
     virtual void handleResponse(QString, QString, int, QString, QString);
@@ -9,61 +9,294 @@
  */
 
 #include "xtNetworkRequestManager.h"
+#include <QCoreApplication>
+#include <QDebug>
+#include <QEventLoop>
 #include <QNetworkAccessManager>
-#include <QNetworkRequest>
 #include <QNetworkReply>
-#include <QMutex>
-#include <QMutexLocker>
-#include <QObject>
-#include <QDebug>
+#include <QNetworkRequest>
+#include <QPointer>
+#include <QThread>
+#include <QThreadStorage>
+#include <QTimer>
 
 #define DEBUG false
 
-xtNetworkRequestManager::xtNetworkRequestManager(const QUrl & url, QMutex &mutex) {
-  nwam = new QNetworkAccessManager;
-  _nwrep = 0;
-  _response = 0;
-  _url = url;
-  _mutex = &mutex;
-  _mutex->lock();
-  _loop = new QEventLoop;
-  startRequest(_url);
-}
-void xtNetworkRequestManager::startRequest(const QUrl & url) {
-    _nwrep = nwam->get(QNetworkRequest(url));
-    connect(_nwrep, SIGNAL(finished()), SLOT(requestCompleted()));
-    connect(nwam, SIGNAL(sslErrors(QNetworkReply*,QList<QSslError>)), this, SLOT(sslErrors(QNetworkReply*,QList<QSslError>)));
-#if QT_VERSION < 0x050000 //this feels hackish, ignore error or provide root cert, we'll ignore for now
-    connect(nwam, SIGNAL(sslErrors(QNetworkReply*,QList<QSslError>)), _nwrep, SLOT(ignoreSslErrors()));
-#endif
-    connect(nwam, SIGNAL(finished(QNetworkReply*)), _loop, SLOT(quit()));
-    _loop->exec();
-}
-void xtNetworkRequestManager::requestCompleted() {
-  _response = _nwrep->readAll(); //we don't really care here but store it anyways
-  _nwrep->close();
-  QVariant possibleRedirect = _nwrep->attribute(QNetworkRequest::RedirectionTargetAttribute);
-  if(DEBUG){
-      qDebug() << "redirect=" << possibleRedirect.isValid();
-      qDebug() << "replyError=" << _nwrep->errorString();
-      qDebug() << "replyErrorCode=" << _nwrep->error();
+// milliseconds
+#define DEFAULTTIMEOUT 30000
+#define MAXREDIRECTS   5
+
+static QPointer<xtNetworkRequestManager>        _guiManager;
+static QThreadStorage<xtNetworkRequestManager*> _threadManager;
+
+xtNetworkRequest::xtNetworkRequest(xtNetworkRequestManager *pManager, const QNetworkRequest &pRequest,
+                                   const QByteArray &pVerb, const QByteArray &pData, int pTimeout)
+  : QObject(pManager),
+    _autoDelete(true),
+    _data(pData),
+    _error(QNetworkReply::NoError),
+    _finished(false),
+    _manager(pManager),
+    _redirects(0),
+    _reply(0),
+    _request(pRequest),
+    _statusCode(0),
+    _timedOut(false),
+    _timer(0),
+    _verb(pVerb)
+{
+  if (pTimeout > 0)
+  {
+    _timer = new QTimer(this);
+    _timer->setSingleShot(true);
+    _timer->setInterval(pTimeout);
+    connect(_timer, SIGNAL(timeout()), this, SLOT(sTimedOut()));
   }
-  if(_nwrep->error() != QNetworkReply::NoError){
-      qDebug() << "network reply error on request" << _nwrep->error() << _nwrep->errorString();
-      _nwrep->deleteLater();
-      _mutex->unlock();
+}
+
+xtNetworkRequest::~xtNetworkRequest()
+{
+  if (_manager)
+    _manager->_pending.removeOne(this);
+  if (_reply)
+  {
+    _reply->disconnect(this);
+    _reply->abort();
+    _reply->deleteLater();
   }
-  if(_nwrep->error() == QNetworkReply::NoError && !possibleRedirect.isValid()){
-      //success and no redirect
-      _nwrep->deleteLater();
-      _mutex->unlock();
+}
+
+int xtNetworkRequest::error() const
+{
+  return _error;
+}
+
+QString xtNetworkRequest::errorString() const
+{
+  return _errorString;
+}
+
+bool xtNetworkRequest::isFinished() const
+{
+  return _finished;
+}
+
+bool xtNetworkRequest::isTimedOut() const
+{
+  return _timedOut;
+}
+
+QByteArray xtNetworkRequest::response() const
+{
+  return _response;
+}
+
+int xtNetworkRequest::statusCode() const
+{
+  return _statusCode;
+}
+
+QUrl xtNetworkRequest::url() const
+{
+  return _request.url();
+}
+
+/** \brief Block until the request finishes or pMsecs milliseconds pass.
+
+    This runs a local event loop, so use it only where the caller really
+    cannot go on without the answer. After calling waitForFinished() the
+    caller owns the request and must delete it.
+    \return true if the request finished.
+  */
+bool xtNetworkRequest::waitForFinished(int pMsecs)
+{
+  _autoDelete = false;
+  if (_finished)
+    return true;
+
+  QEventLoop loop;
+  connect(this, SIGNAL(finished()), &loop, SLOT(quit()));
+  if (pMsecs >= 0)
+    QTimer::singleShot(pMsecs, &loop, SLOT(quit()));
+  loop.exec();
+
+  return _finished;
+}
+
+void xtNetworkRequest::abort()
+{
+  if (_reply)
+    _reply->abort();
+}
+
+void xtNetworkRequest::start()
+{
+  QNetworkAccessManager *nwam = _manager->networkAccessManager();
+  if (_verb == "POST")
+    _reply = nwam->post(_request, _data);
+  else
+    _reply = nwam->get(_request);
+
+  connect(_reply, SIGNAL(finished()), this, SLOT(sFinished()));
+  connect(_reply, SIGNAL(downloadProgress(qint64, qint64)), this, SIGNAL(progress(qint64, qint64)));
+  if (_timer && ! _timer->isActive())
+    _timer->start();
+}
+
+void xtNetworkRequest::sFinished()
+{
+  QNetworkReply *reply = _reply;
+  _reply = 0;
+  if (! reply)
+    return;
+
+  QVariant redirect = reply->attribute(QNetworkRequest::RedirectionTargetAttribute);
+  if (DEBUG)
+    qDebug() << "xtNetworkRequest" << _request.url()
+             << "redirect=" << redirect.isValid()
+             << "replyError=" << reply->error() << reply->errorString();
+
+  if (! _timedOut && reply->error() == QNetworkReply::NoError &&
+      redirect.isValid() && _redirects < MAXREDIRECTS)
+  {
+    _request.setUrl(_request.url().resolved(redirect.toUrl()));
+    _redirects++;
+    _verb = "GET";
+    _data.clear();
+    reply->deleteLater();
+    start();
+    return;
   }
-  else {
-      QUrl newUrl = _url.resolved(possibleRedirect.toUrl());
-      _nwrep->deleteLater();
-      startRequest(newUrl);
+
+  if (_timer)
+    _timer->stop();
+
+  _response   = reply->readAll();
+  _statusCode = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+  _error      = reply->error();
+  if (_timedOut)
+    _errorString = tr("The request to %1 timed out.").arg(_request.url().host());
+  else if (_error != QNetworkReply::NoError)
+    _errorString = reply->errorString();
+  reply->deleteLater();
+
+  if (_error != QNetworkReply::NoError && _error != QNetworkReply::OperationCanceledError)
+    qDebug() << "network reply error on request" << _error << _errorString;
+
+  _finished = true;
+  emit finished();
+  if (_manager)
+    _manager->requestFinished(this);
+}
+
+void xtNetworkRequest::sTimedOut()
+{
+  _timedOut = true;
+  abort();
+}
+
+xtNetworkRequestManager::xtNetworkRequestManager(QObject *parent)
+  : QObject(parent),
+    _timeout(DEFAULTTIMEOUT)
+{
+  nwam = new QNetworkAccessManager(this);
+  connect(nwam, SIGNAL(sslErrors(QNetworkReply*,QList<QSslError>)), this, SLOT(sslErrors(QNetworkReply*,QList<QSslError>)));
+}
+
+/* The requests are children of the manager and outlive its members, so
+   detach them before QObject deletes them.
+ */
+xtNetworkRequestManager::~xtNetworkRequestManager()
+{
+  cancelAll();
+  foreach (xtNetworkRequest *request,
+           findChildren<xtNetworkRequest*>(QString(), Qt::FindDirectChildrenOnly))
+    request->_manager = 0;
+  _pending.clear();
+}
+
+/** \brief Return the manager for the calling thread, creating it if needed.
+
+    The GUI thread's manager lives as long as the application. Other threads
+    get their own, deleted when the thread exits.
+  */
+xtNetworkRequestManager *xtNetworkRequestManager::instance()
+{
+  QCoreApplication *app = QCoreApplication::instance();
+  if (app && QThread::currentThread() == app->thread())
+  {
+    if (! _guiManager)
+      _guiManager = new xtNetworkRequestManager(app);
+    return _guiManager;
   }
+
+  if (! _threadManager.hasLocalData())
+    _threadManager.setLocalData(new xtNetworkRequestManager());
+  return _threadManager.localData();
 }
+
+int xtNetworkRequestManager::defaultTimeout() const
+{
+  return _timeout;
+}
+
+int xtNetworkRequestManager::pendingCount() const
+{
+  return _pending.size();
+}
+
+/** \brief Set the timeout used when a request does not give its own.
+    0 means requests never time out.
+  */
+void xtNetworkRequestManager::setDefaultTimeout(int pMsecs)
+{
+  _timeout = qMax(0, pMsecs);
+}
+
+QNetworkAccessManager *xtNetworkRequestManager::networkAccessManager() const
+{
+  return nwam;
+}
+
+xtNetworkRequest *xtNetworkRequestManager::get(const QUrl &pUrl, int pTimeout)
+{
+  return send(QNetworkRequest(pUrl), "GET", QByteArray(), pTimeout);
+}
+
+xtNetworkRequest *xtNetworkRequestManager::get(const QNetworkRequest &pRequest, int pTimeout)
+{
+  return send(pRequest, "GET", QByteArray(), pTimeout);
+}
+
+xtNetworkRequest *xtNetworkRequestManager::post(const QNetworkRequest &pRequest, const QByteArray &pData, int pTimeout)
+{
+  return send(pRequest, "POST", pData, pTimeout);
+}
+
+void xtNetworkRequestManager::cancelAll()
+{
+  foreach (xtNetworkRequest *request, _pending)
+    request->abort();
+}
+
+xtNetworkRequest *xtNetworkRequestManager::send(const QNetworkRequest &pRequest, const QByteArray &pVerb,
+                                                const QByteArray &pData, int pTimeout)
+{
+  xtNetworkRequest *request = new xtNetworkRequest(this, pRequest, pVerb, pData,
+                                                   pTimeout < 0 ? _timeout : pTimeout);
+  _pending.append(request);
+  request->start();
+  return request;
+}
+
+void xtNetworkRequestManager::requestFinished(xtNetworkRequest *pRequest)
+{
+  _pending.removeOne(pRequest);
+  emit finished(pRequest);
+  if (pRequest->_autoDelete)
+    pRequest->deleteLater();
+}
+
 void xtNetworkRequestManager::sslErrors(QNetworkReply*, const QList<QSslError> &errors) {
 #if QT_VERSION >= 0x050000
     QString errorString;
@@ -75,8 +308,3 @@ void xtNetworkRequestManager::sslErrors(QNetworkReply*, const QList<QSslError> &
    qDebug() << "errorString= " << errorString;
 #endif
 }
-xtNetworkRequestManager::~xtNetworkRequestManager() {
-    nwam->deleteLater();
-    nwam = 0;
-}
-
@@ -11,39 +11,133 @@
 #ifndef __XTNETWORKREQUESTMANAGER_H__
 #define __XTNETWORKREQUESTMANAGER_H__
 
+#include <QByteArray>
+#include <QList>
+#include <QNetworkReply>
+#include <QNetworkRequest>
 #include <QObject>
-#include <QThread>
+#include <QSslError>
 #include <QString>
 #include <QUrl>
-#include <QNetworkAccessManager>
-#include <QEventLoop>
-#include <QMutex>
 
 class QNetworkAccessManager;
-class QNetworkReply;
+class QTimer;
+class xtNetworkRequestManager;
 
+/**
+  @class xtNetworkRequest
+
+  @brief One request started by an xtNetworkRequestManager.
+
+  The request runs in the background. Connect to finished() or call
+  waitForFinished() to get the result. The manager deletes the request
+  with deleteLater() after finished() has been emitted, so copy anything
+  you need out of it in the slot connected to finished(). A request that
+  has been waited on with waitForFinished() is not deleted by the manager;
+  the caller must delete it.
+ */
+class xtNetworkRequest : public QObject
+{
+  Q_OBJECT
+
+  friend class xtNetworkRequestManager;
+
+  public:
+    virtual ~xtNetworkRequest();
+
+    Q_INVOKABLE int        error()       const;
+    Q_INVOKABLE QString    errorString() const;
+    Q_INVOKABLE bool       isFinished()  const;
+    Q_INVOKABLE bool       isTimedOut()  const;
+    Q_INVOKABLE QByteArray response()    const;
+    Q_INVOKABLE int        statusCode()  const;
+    Q_INVOKABLE QUrl       url()         const;
+
+    Q_INVOKABLE bool waitForFinished(int pMsecs = -1);
+
+  public slots:
+    void abort();
+
+  signals:
+    void finished();
+    void progress(qint64 pReceived, qint64 pTotal);
+
+  protected slots:
+    void sFinished();
+    void sTimedOut();
+
+  protected:
+    xtNetworkRequest(xtNetworkRequestManager *pManager, const QNetworkRequest &pRequest,
+                     const QByteArray &pVerb, const QByteArray &pData, int pTimeout);
+    void start();
+
+    bool                     _autoDelete;
+    QByteArray               _data;
+    int                      _error;
+    QString                  _errorString;
+    bool                     _finished;
+    xtNetworkRequestManager *_manager;
+    int                      _redirects;
+    QNetworkReply           *_reply;
+    QNetworkRequest          _request;
+    QByteArray               _response;
+    int                      _statusCode;
+    bool                     _timedOut;
+    QTimer                  *_timer;
+    QByteArray               _verb;
+};
+
+/**
+  @class xtNetworkRequestManager
+
+  @brief Starts HTTP requests without blocking the caller.
+
+  All requests made through one manager share a QNetworkAccessManager, so
+  connections to the same host are kept alive and reused, and several
+  requests can be in progress at once. Each request gets a timeout and can
+  be cancelled with xtNetworkRequest::abort() or cancelAll().
+
+  instance() returns a manager for the calling thread.
+ */
 class xtNetworkRequestManager : public QObject
 {
-    Q_OBJECT
+  Q_OBJECT
+
+  friend class xtNetworkRequest;
 
-public:
-    xtNetworkRequestManager(const QUrl &, QMutex &);
+  public:
+    xtNetworkRequestManager(QObject *parent = 0);
     virtual ~xtNetworkRequestManager();
 
+    static xtNetworkRequestManager *instance();
 
-protected slots:
-    virtual void startRequest(const QUrl &);
-    virtual void requestCompleted();
+    Q_INVOKABLE virtual int  defaultTimeout() const;
+    Q_INVOKABLE virtual int  pendingCount()   const;
+    Q_INVOKABLE virtual void setDefaultTimeout(int pMsecs);
+
+    virtual QNetworkAccessManager *networkAccessManager() const;
+
+    Q_INVOKABLE virtual xtNetworkRequest *get(const QUrl &pUrl, int pTimeout = -1);
+    virtual xtNetworkRequest *get(const QNetworkRequest &pRequest, int pTimeout = -1);
+    virtual xtNetworkRequest *post(const QNetworkRequest &pRequest, const QByteArray &pData, int pTimeout = -1);
+
+  public slots:
+    virtual void cancelAll();
+
+  signals:
+    void finished(xtNetworkRequest *pRequest);
+
+  protected slots:
     virtual void sslErrors(QNetworkReply*, const QList<QSslError> &errors);
 
-private:
-    QNetworkAccessManager * nwam;
-    QNetworkReply * _nwrep;
-    QNetworkRequest * _request;
-    QByteArray _response;
-    QMutex * _mutex;
-    QEventLoop *_loop;
-    QUrl _url;
+  protected:
+    virtual xtNetworkRequest *send(const QNetworkRequest &pRequest, const QByteArray &pVerb,
+                                   const QByteArray &pData, int pTimeout);
+    void requestFinished(xtNetworkRequest *pRequest);
+
+    QList<xtNetworkRequest*> _pending;
+    int                      _timeout;
+    QNetworkAccessManager   *nwam;
 };
 
 #endif
@@ -10,33 +10,213 @@
 
 #include "xtsettings.h"
 
+#include <QCoreApplication>
+#include <QMutexLocker>
+#include <QRunnable>
 #include <QSettings>
+#include <QStringList>
+#include <QThreadPool>
+#include <QTimer>
 
-QVariant xtsettingsValue(const QString & key, const QVariant & defaultValue)
+#define DEBUG false
+
+// how long to wait after the last change before writing to disk
+#define FLUSHDELAY 2000
+
+#define MIGRATEDKEY "xTuple/LegacySettingsMigrated"
+
+class XtSettingsWriter : public QRunnable
+{
+  public:
+    XtSettingsWriter(XtSettingsStore *pStore)
+      : _store(pStore)
+    {
+    }
+
+    virtual void run()
+    {
+      _store->write();
+    }
+
+  protected:
+    XtSettingsStore *_store;
+};
+
+static XtSettingsStore *_store = 0;
+
+static void flushOnExit()
+{
+  if (_store)
+    _store->flush(true);
+}
+
+XtSettingsStore *XtSettingsStore::instance()
+{
+  static QMutex creationLock;
+  QMutexLocker locker(&creationLock);
+  if (! _store)
+  {
+    _store = new XtSettingsStore();
+    qAddPostRoutine(flushOnExit);
+  }
+  return _store;
+}
+
+XtSettingsStore::XtSettingsStore()
+  : QObject(0)
+{
+  if (QCoreApplication::instance())
+    moveToThread(QCoreApplication::instance()->thread());
+
+  _flushTimer = new QTimer(this);
+  _flushTimer->setSingleShot(true);
+  _flushTimer->setInterval(FLUSHDELAY);
+  connect(_flushTimer, SIGNAL(timeout()), this, SLOT(flush()));
+
+  load();
+}
+
+/* QSettings treats /a//b/, a/b and a\b as the same key.
+   The cache has to as well.
+ */
+QString XtSettingsStore::normalize(const QString &pKey)
+{
+  QString key = pKey;
+  key.replace('\\', '/');
+  return key.split('/', QString::SkipEmptyParts).join("/");
+}
+
+void XtSettingsStore::load()
 {
   QSettings settings(QSettings::UserScope, "xTuple.com", "xTuple");
-  QString key2 = key;
-  if(key.startsWith("/xTuple/"))
-    key2 = key2.replace(0, 8, QString("/OpenMFG/"));
-  if(settings.contains(key))
-    return settings.value(key, defaultValue);
-  else
+  foreach (QString key, settings.allKeys())
+    _values.insert(normalize(key), settings.value(key));
+
+  if (_values.value(MIGRATEDKEY).toBool())
+    return;
+
+  QSettings oldsettings(QSettings::UserScope, "OpenMFG.com", "OpenMFG");
+  foreach (QString oldkey, oldsettings.allKeys())
   {
-    QSettings oldsettings(QSettings::UserScope, "OpenMFG.com", "OpenMFG");
-    if(oldsettings.contains(key2))
+    QString key = normalize(oldkey);
+    if (key.startsWith("OpenMFG/"))
+      key.replace(0, 8, QString("xTuple/"));
+    if (! _values.contains(key))
     {
-      QVariant val = oldsettings.value(key2, defaultValue);
-      xtsettingsSetValue(key, val);
-      return val;
+      QVariant val = oldsettings.value(oldkey);
+      _values.insert(key, val);
+      _dirty.insert(key, val);
     }
   }
-  return defaultValue;
+  _values.insert(MIGRATEDKEY, true);
+  _dirty.insert(MIGRATEDKEY, true);
+
+  if (DEBUG)
+    qDebug("xtsettings migrated %d legacy values", _dirty.size() - 1);
+
+  QMetaObject::invokeMethod(this, "sScheduleFlush", Qt::QueuedConnection);
 }
 
-void xtsettingsSetValue(const QString & key, const QVariant & value)
+bool XtSettingsStore::contains(const QString &pKey)
 {
+  QMutexLocker locker(&_lock);
+  return _values.contains(normalize(pKey));
+}
+
+QVariant XtSettingsStore::value(const QString &pKey, const QVariant &pDefault)
+{
+  QMutexLocker locker(&_lock);
+  return _values.value(normalize(pKey), pDefault);
+}
+
+void XtSettingsStore::setValue(const QString &pKey, const QVariant &pValue)
+{
+  QString key = normalize(pKey);
+  {
+    QMutexLocker locker(&_lock);
+    QHash<QString, QVariant>::const_iterator it = _values.constFind(key);
+    if (it != _values.constEnd() && it.value() == pValue)
+      return;
+    _values.insert(key, pValue);
+    _dirty.insert(key, pValue);
+  }
+  QMetaObject::invokeMethod(this, "sScheduleFlush", Qt::QueuedConnection);
+}
+
+/** \brief Write pending changes to the settings file.
+
+    \param pWait If true, write in the calling thread and return when the
+                 file is up to date. Otherwise hand the write to a worker.
+  */
+void XtSettingsStore::flush(bool pWait)
+{
+  if (pWait)
+    write();
+  else
+    QThreadPool::globalInstance()->start(new XtSettingsWriter(this));
+}
+
+/* Taking the pending values and writing them happen under one lock so
+   an older batch can never land on top of a newer one.
+ */
+void XtSettingsStore::write()
+{
+  QMutexLocker writeLocker(&_writeLock);
+
+  QHash<QString, QVariant> pending;
+  {
+    QMutexLocker locker(&_lock);
+    pending = _dirty;
+    _dirty.clear();
+  }
+  if (pending.isEmpty())
+    return;
+
   QSettings settings(QSettings::UserScope, "xTuple.com", "xTuple");
-  settings.setValue(key, value);
+  QHash<QString, QVariant>::const_iterator it;
+  for (it = pending.constBegin(); it != pending.constEnd(); ++it)
+    settings.setValue(it.key(), it.value());
+  settings.sync();
+
+  if (DEBUG)
+    qDebug("xtsettings wrote %d values", pending.size());
+}
+
+void XtSettingsStore::sScheduleFlush()
+{
+  _flushTimer->start();
+}
+
+QVariant xtsettingsValue(const QString & key, const QVariant & defaultValue)
+{
+  return XtSettingsStore::instance()->value(key, defaultValue);
+}
+
+void xtsettingsSetValue(const QString & key, const QVariant & value)
+{
+  XtSettingsStore::instance()->setValue(key, value);
+}
+
+bool xtsettingsBool(const QString & key, bool defaultValue)
+{
+  return xtsettingsValue(key, defaultValue).toBool();
+}
+
+int xtsettingsInt(const QString & key, int defaultValue)
+{
+  bool ok = false;
+  int result = xtsettingsValue(key, defaultValue).toInt(&ok);
+  return ok ? result : defaultValue;
+}
+
+QString xtsettingsString(const QString & key, const QString & defaultValue)
+{
+  return xtsettingsValue(key, defaultValue).toString();
+}
+
+void xtsettingsFlush()
+{
+  XtSettingsStore::instance()->flush(true);
 }
 
 QScriptValue xtsettingsValueProto(QScriptContext *context, QScriptEngine *engine)
@@ -12,14 +12,71 @@
 #ifndef __XTSETTINGS_H__
 #define __XTSETTINGS_H__
 
+#include <QHash>
+#include <QMutex>
+#include <QObject>
 #include <QString>
 #include <QVariant>
 #include <QtScript>
 
+class QTimer;
+
 QVariant xtsettingsValue(const QString & key, const QVariant & defaultValue = QVariant());
 void xtsettingsSetValue(const QString & key, const QVariant & value);
 
+bool    xtsettingsBool(const QString & key, bool defaultValue = false);
+int     xtsettingsInt(const QString & key, int defaultValue = 0);
+QString xtsettingsString(const QString & key, const QString & defaultValue = QString());
+void    xtsettingsFlush();
+
 void setupXtSettings(QScriptEngine *engine);
 
+/**
+  @class XtSettingsStore
+
+  @brief Process-wide copy of the user's xTuple settings.
+
+  The settings file is read once, the first time any setting is requested.
+  Keys that only exist in the legacy OpenMFG settings are copied over at the
+  same time and the migration is recorded so it never runs again.
+
+  Changes go to the in-memory copy immediately and are written back to disk
+  in a batch a short time after the last change, on a worker thread. Pending
+  changes are written synchronously when the application quits.
+
+  Use the xtsettings* functions rather than this class directly.
+ */
+class XtSettingsStore : public QObject
+{
+  Q_OBJECT
+
+  public:
+    static XtSettingsStore *instance();
+
+    bool     contains(const QString &pKey);
+    QVariant value(const QString &pKey, const QVariant &pDefault = QVariant());
+    void     setValue(const QString &pKey, const QVariant &pValue);
+
+    void     write();
+
+  public slots:
+    void flush(bool pWait = false);
+
+  protected slots:
+    void sScheduleFlush();
+
+  protected:
+    XtSettingsStore();
+
+    static QString normalize(const QString &pKey);
+    void           load();
+
+    QHash<QString, QVariant> _dirty;
+    QTimer                  *_flushTimer;
+    QMutex                   _lock;
+    QMutex                   _writeLock;
+    QHash<QString, QVariant> _values;
+};
+
 #endif
 
@@ -758,6 +758,7 @@ bool configureGL::sSave()
   _metrics->set("AutoCloseARIncident", _closeARIncdt->isChecked());
   
   // GL
+  omfgThis->buildMenu("menu.accnt");
   QAction *profitcenter = omfgThis->findChild<QAction*>("gl.profitCenterNumber");
   QAction *subaccounts  = omfgThis->findChild<QAction*>("gl.subaccountNumbers");
   QAction *companyseg   = omfgThis->findChild<QAction*>("gl.companies");
@@ -16,6 +16,8 @@
 #include <QMessageBox>
 #include <QPrinter>
 #include <QPrintDialog>
+#include <QProgressBar>
+#include <QScrollBar>
 #include <QShortcut>
 #include <QToolButton>
 
@@ -27,9 +29,14 @@
 #include <parameter.h>
 #include <previewdialog.h>
 
+#include "asyncquery.h"
 #include "parameterlistsetup.h"
 #include "errorReporter.h"
 #include "displayprivate.h"
+#include "queryprofiler.h"
+
+// rows fetched per page when a page key is set
+#define PAGESIZE 500
 
 displayPrivate::displayPrivate(::display *parent)
     : QObject(parent),
@@ -37,6 +44,18 @@ displayPrivate::displayPrivate(::display *parent)
       _queryOnStartEnabled(false),
       _autoUpdateEnabled(false),
       _filterChanged(false),
+      _preparedGeneration(-1),
+      _parsesSaved(0),
+      _preparesSaved(0),
+      _pageDescending(false),
+      _pageSize(PAGESIZE),
+      _pageRows(0),
+      _pageTotal(0),
+      _pageDone(true),
+      _pageFetching(false),
+      _queryAsync(false),
+      _asyncItemId(-1),
+      _asyncProbe(0),
       _parent(parent)
 {
   setupUi(_parent);
@@ -140,6 +159,27 @@ displayPrivate::displayPrivate(::display *parent)
   _statusBar = new QStatusBar();
   _statusBarLayout->addWidget(_statusBar);
 
+  // Busy indicator for queries running in the background
+  _busy = new QProgressBar(_statusBar);
+  _busy->setRange(0, 0);
+  _busy->setMaximumWidth(100);
+  _busy->hide();
+  _statusBar->addPermanentWidget(_busy);
+
+  _cancelBtn = new QToolButton(_statusBar);
+  _cancelBtn->setObjectName("_cancelBtn");
+  _cancelBtn->setFocusPolicy(Qt::NoFocus);
+  _cancelBtn->hide();
+  _statusBar->addPermanentWidget(_cancelBtn);
+
+  _async = new AsyncQuery(this);
+  connect(_async,     SIGNAL(finished()),  this,   SLOT(sAsyncFinished()));
+  connect(_async,     SIGNAL(cancelled()), this,   SLOT(sAsyncCancelled()));
+  connect(_cancelBtn, SIGNAL(clicked()),   _async, SLOT(cancel()));
+
+  connect(_list->verticalScrollBar(), SIGNAL(valueChanged(int)), this, SLOT(sListScrolled(int)));
+  connect(_list, SIGNAL(aboutToExport()), this, SLOT(sFetchRemainingPages()));
+  connect(omfgThis, SIGNAL(dbConnectionLost()), this, SLOT(sConnectionLost()));
 }
 
 void displayPrivate::sFilterChanged()
@@ -314,6 +354,291 @@ void displayPrivate::setupCharacteristics(QStringList uses)
   }
 }
 
+void displayPrivate::bindCharacteristics(XSqlQuery &xq, ParameterList &pParams)
+{
+  QString column;
+  QVariant param;
+  bool valid;
+
+  foreach (QVariant columnid, _charidstext)
+  {
+    column = QString("char%1").arg(columnid.toString());
+    param = pParams.value(column, &valid);
+    if (valid)
+      xq.bindValue(QString(":%1").arg(column), param.toString());
+  }
+
+  foreach (QVariant columnid, _charidslist)
+  {
+    column = QString("char%1").arg(columnid.toString());
+    param = pParams.value(column, &valid);
+    if (valid)
+    {
+      QStringList list = param.toStringList();
+      for (int j = 0; j < list.count(); j++)
+        xq.bindValue(QString(":%1_%2").arg(column).arg(j), list.at(j));
+    }
+  }
+
+  foreach (QVariant columnid, _charidsdate)
+  {
+    // Look for start date
+    column = QString("char%1startDate").arg(columnid.toString());
+    param = pParams.value(column, &valid);
+    if (valid)
+      xq.bindValue(QString(":%1").arg(column), param.toString());
+
+    // Look for end date
+    column = QString("char%1endDate").arg(columnid.toString());
+    param = pParams.value(column, &valid);
+    if (valid)
+      xq.bindValue(QString(":%1").arg(column), param.toString());
+  }
+}
+
+/* MetaSQL expansion depends only on the template and the parameters, so if
+   neither changed since the last fill the query prepared then is still good.
+ */
+bool displayPrivate::canReusePrepared(ParameterList &params)
+{
+  if (_preparedKey != metasqlGroup + "%" + metasqlName ||
+      _preparedGeneration != omfgThis->_mqlhash->generation() ||
+      _preparedParams.count() != params.count())
+    return false;
+
+  for (int i = 0; i < params.count(); i++)
+  {
+    if (_preparedParams.name(i)  != params.name(i) ||
+        _preparedParams.value(i) != params.value(i))
+      return false;
+  }
+
+  return true;
+}
+
+/* Wrap the query sFillList just prepared so it can be read a page at a
+   time: one statement for the first page, which also counts every row
+   the query would return, and one for the page after a given key. The
+   wrapped statements share the parameters already bound to base.
+ */
+bool displayPrivate::preparePages(XSqlQuery &base)
+{
+  QString sql = base.lastQuery().trimmed();
+  while (sql.endsWith(";"))
+  {
+    sql.chop(1);
+    sql = sql.trimmed();
+  }
+
+  QStringList order;
+  QStringList placeholders;
+  for (int i = 0; i < _pageKey.size(); i++)
+  {
+    order << _pageKey.at(i) + (_pageDescending ? " DESC" : "");
+    placeholders << QString(":_pagekey%1").arg(i);
+  }
+
+  QList<XSqlQuery*> queries;
+  queries << &_firstPage << &_nextPage;
+  QStringList statements;
+  statements << QString("SELECT *, COUNT(*) OVER () AS _pagetotal"
+                        "  FROM (%1) AS dsppage"
+                        " ORDER BY %2 LIMIT :_pagelimit;")
+                .arg(sql, order.join(", "))
+             << QString("SELECT *"
+                        "  FROM (%1) AS dsppage"
+                        " WHERE (%2) %3 (%4)"
+                        " ORDER BY %5 LIMIT :_pagelimit;")
+                .arg(sql, _pageKey.join(", "), _pageDescending ? "<" : ">",
+                     placeholders.join(", "), order.join(", "));
+  for (int i = 0; i < queries.size(); i++)
+  {
+    *queries.at(i) = XSqlQuery();
+    if (! queries.at(i)->prepare(statements.at(i)))
+    {
+      ErrorReporter::error(QtCriticalMsg, _parent,
+                           ::display::tr("Error Retrieving Information"),
+                           *queries.at(i), __FILE__, __LINE__);
+      return false;
+    }
+  }
+
+  QMap<QString, QVariant> bound = base.boundValues();
+  for (QMap<QString, QVariant>::const_iterator it = bound.constBegin();
+       it != bound.constEnd(); ++it)
+  {
+    foreach (XSqlQuery *query, queries)
+      query->bindValue(it.key(), it.value());
+  }
+  return true;
+}
+
+/* Start paging over and return the query for the first page. The rows
+   shown so far belong to the previous query, so they go now; otherwise a
+   cancelled or failed query would leave them on screen with the paging
+   state of the new one, and scrolling or exporting would read the wrong
+   pages.
+ */
+XSqlQuery &displayPrivate::firstPage()
+{
+  _list->clear();
+  _pageRows  = 0;
+  _pageTotal = 0;
+  _pageDone  = false;
+  _pageLastKey.clear();
+
+  _firstPage.bindValue(":_pagelimit", _pageSize);
+  return _firstPage;
+}
+
+/* Append the page after the last one shown, or everything left if pAll. */
+bool displayPrivate::fetchPage(bool pAll)
+{
+  if (_pageFetching)
+    return true;
+  _pageFetching = true;
+
+  for (int i = 0; i < _pageLastKey.size(); i++)
+    _nextPage.bindValue(QString(":_pagekey%1").arg(i), _pageLastKey.at(i));
+  _nextPage.bindValue(":_pagelimit", pAll ? QVariant() : QVariant(_pageSize));
+
+  QueryProbe probe(_parent, __FILE__, __LINE__);
+  _nextPage.exec();
+  probe.record(_nextPage);
+  if (ErrorReporter::error(QtCriticalMsg, _parent,
+                           ::display::tr("Error Retrieving Information"),
+                           _nextPage, __FILE__, __LINE__))
+  {
+    _pageDone     = true;
+    _pageFetching = false;
+    return false;
+  }
+
+  addPage(_nextPage, -1, false, pAll);
+  _nextPage.finish();
+  _pageFetching = false;
+  return true;
+}
+
+/* Pages are small, so they are added to the list in one go rather than
+   in the background; that keeps a page from landing in the middle of
+   another.
+ */
+void displayPrivate::addPage(XSqlQuery &pPage, int pItemId, bool pFirst, bool pAll)
+{
+  int rows = pPage.size();
+  if (pPage.last())
+  {
+    if (pFirst)
+      _pageTotal = pPage.value("_pagetotal").toInt();
+    _pageLastKey.clear();
+    foreach (QString column, _pageKey)
+      _pageLastKey.append(pPage.value(column));
+  }
+
+  bool linear = _list->populateLinear();
+  _list->setPopulateLinear(true);
+  _list->populate(pPage, pItemId, _useAltId,
+                  pFirst ? XTreeWidget::Replace : XTreeWidget::Append);
+  _list->setPopulateLinear(linear);
+
+  _pageRows += rows;
+  _pageDone  = pAll || rows < _pageSize;
+  showRecordCount();
+}
+
+void displayPrivate::showRecordCount()
+{
+  if (_pageKey.isEmpty() || _pageDone)
+    _statusBar->showMessage(::display::tr("Records found: %1").arg(qMax(_pageTotal, _pageRows)));
+  else
+    _statusBar->showMessage(::display::tr("Records found: %1, showing %2")
+                            .arg(_pageTotal).arg(_pageRows));
+}
+
+/* Show what sFillList's query returned, whether it ran here or in the
+   background.
+ */
+void displayPrivate::showResult(XSqlQuery &pResult, const QSqlError &pError, int pItemId)
+{
+  if (pError.type() != QSqlError::NoError)
+  {
+    _list->clear();
+    _pageDone = true;
+    _preparedKey.clear();
+    ErrorReporter::error(QtCriticalMsg, _parent,
+                         ::display::tr("Error Retrieving Information"),
+                         pError, __FILE__, __LINE__);
+    return;
+  }
+
+  if (_pageKey.isEmpty())
+  {
+    _list->populate(pResult, pItemId, _useAltId);
+    _statusBar->showMessage(::display::tr("Records found: %1").arg(pResult.size()));
+  }
+  else
+    addPage(pResult, pItemId, true, false);
+
+  // the rows are in the list now; don't keep a second copy in the
+  // prepared query until the next fill
+  pResult.finish();
+
+  emit _parent->fillListAfter();
+}
+
+void displayPrivate::setBusy(bool pBusy)
+{
+  _busy->setVisible(pBusy);
+  _cancelBtn->setVisible(pBusy);
+  if (pBusy)
+    _statusBar->showMessage(::display::tr("Querying..."));
+}
+
+/* The prepared queries belong to the connection that just went away. */
+void displayPrivate::sConnectionLost()
+{
+  _preparedKey.clear();
+}
+
+void displayPrivate::sAsyncCancelled()
+{
+  delete _asyncProbe;
+  _asyncProbe = 0;
+  setBusy(false);
+  _statusBar->showMessage(::display::tr("Query cancelled"));
+}
+
+void displayPrivate::sAsyncFinished()
+{
+  setBusy(false);
+  XSqlQuery result = _async->result();
+  if (_asyncProbe)
+  {
+    _asyncProbe->record(result);
+    delete _asyncProbe;
+    _asyncProbe = 0;
+  }
+  showResult(result, _async->lastError(), _asyncItemId);
+}
+
+/* Export works from the list, so it needs every row in it. */
+void displayPrivate::sFetchRemainingPages()
+{
+  if (! _pageKey.isEmpty() && ! _pageDone && _pageRows > 0)
+    fetchPage(true);
+}
+
+void displayPrivate::sListScrolled(int pValue)
+{
+  if (_pageKey.isEmpty() || _pageDone || _pageRows == 0)
+    return;
+
+  QScrollBar *bar = _list->verticalScrollBar();
+  if (pValue >= bar->maximum() - bar->pageStep())
+    fetchPage();
+}
+
 bool displayPrivate::setParams(ParameterList &params)
 {
   QString filter = _parameterWidget->filter();
@@ -406,6 +731,7 @@ display::display(QWidget* parent, const char* name, Qt::WindowFlags flags)
   _data->_printBtn->setText(tr("Print"));
   _data->_previewBtn->setText(tr("Preview"));
   _data->_queryBtn->setText(tr("Query"));
+  _data->_cancelBtn->setText(tr("Cancel"));
   _data->_queryOnStartAct->setText(tr("Query on start"));
   _data->_autoUpdateAct->setText(tr("Automatically Update"));
 
@@ -461,6 +787,7 @@ display::display(QWidget* parent, const char* name, Qt::WindowFlags flags)
 
 display::~display()
 {
+  delete _data->_asyncProbe;
   delete _data;
   _data = 0;
 }
@@ -621,6 +948,105 @@ void display::setMetaSQLOptions(const QString & group, const QString & name)
 {
   _data->metasqlName = name;
   _data->metasqlGroup = group;
+  _data->_preparedKey.clear();
+}
+
+/** \brief The number of times sFillList used an already-parsed MetaSQL
+           template instead of parsing it again.
+  */
+int display::parsesSaved() const
+{
+  return _data->_parsesSaved;
+}
+
+/** \brief The number of times sFillList executed the query it prepared
+           on a previous fill instead of expanding and preparing it again.
+  */
+int display::preparesSaved() const
+{
+  return _data->_preparesSaved;
+}
+
+/** \brief Read the list a page at a time instead of all at once.
+
+    The first page is shown after a fill; the next is fetched when the
+    user scrolls to the bottom of the list, and everything left is fetched
+    before the list is exported. The status bar shows the total number of
+    records the query would return. Printing runs the report's own query
+    so it always covers the whole set.
+
+    Pages are read with keyset pagination: each page starts after the key
+    of the last row of the one before, so the server never has to skip
+    over rows it has already sent.
+
+    \param pColumns    A comma-separated list of result columns that
+                       identify a row and that the query can be ordered by.
+                       The list is shown in this order. An empty string
+                       turns paging off. The key values are read back into
+                       the client and bound into the next page's query, so
+                       they must survive that unchanged; timestamps lose
+                       their microseconds on the way and rows sharing the
+                       last row's time would be skipped.
+    \param pDescending Order by the key from highest to lowest.
+
+    Only use this for flat lists; a page boundary can split a parent from
+    its children.
+  */
+void display::setPageKey(const QString &pColumns, bool pDescending)
+{
+  QStringList columns;
+  foreach (QString column, pColumns.split(",", QString::SkipEmptyParts))
+    columns.append(column.trimmed());
+
+  if (columns == _data->_pageKey && pDescending == _data->_pageDescending)
+    return;
+
+  _data->_pageKey        = columns;
+  _data->_pageDescending = pDescending;
+  _data->_pageDone       = true;
+  _data->_preparedKey.clear();
+}
+
+QString display::pageKey() const
+{
+  return _data->_pageKey.join(",");
+}
+
+void display::setPageSize(int pRows)
+{
+  _data->_pageSize = pRows > 0 ? pRows : PAGESIZE;
+}
+
+int display::pageSize() const
+{
+  return _data->_pageSize;
+}
+
+/** \brief Run sFillList's query in the background.
+
+    The query runs on a connection of its own so the application stays
+    responsive while it works. A busy indicator and a Cancel button
+    appear in the status bar until the results arrive; Cancel asks the
+    server to stop the query. Querying again before the results arrive
+    cancels the earlier query, so the list always shows the last request.
+
+    The list is filled when the results arrive, after sFillList has
+    returned. Subclasses that do more work with the list after calling
+    display::sFillList, or whose query depends on state created on the
+    main connection such as a temporary table or a workset, should leave
+    this off or use the fillListAfter() signal. If worker connections are
+    not available the query runs on the main connection as before.
+  */
+void display::setQueryAsync(bool on)
+{
+  _data->_queryAsync = on;
+  if (! on)
+    _data->_async->cancel();
+}
+
+bool display::queryAsync() const
+{
+  return _data->_queryAsync;
 }
 
 void display::setListLabel(const QString & pText)
@@ -824,59 +1250,57 @@ void display::sFillList(ParameterList pParams, bool forceSetParams)
       return;
   }
   int itemid = _data->_list->id();
-  MetaSQLQuery mql(omfgThis->_mqlhash->value(_data->metasqlGroup, _data->metasqlName));
-  XSqlQuery xq = mql.toQuery(pParams, QSqlDatabase(), false);
-
-  QString column;
-  QVariant param;
-  bool valid;
-
-  foreach (QVariant columnid, _data->_charidstext)
+  XSqlQuery xq;
+  if (_data->canReusePrepared(pParams))
   {
-    column = QString("char%1").arg(columnid.toString());
-    param = pParams.value(column, &valid);
-    if (valid)
-      xq.bindValue(QString(":%1").arg(column), param.toString());
+    xq = _data->_prepared;
+    _data->_parsesSaved++;
+    _data->_preparesSaved++;
   }
-
-  foreach (QVariant columnid, _data->_charidslist)
+  else
   {
-    column = QString("char%1").arg(columnid.toString());
-    param = pParams.value(column, &valid);
-    if (valid)
+    int reused = omfgThis->_mqlhash->reuseCount();
+    MetaSQLQuery *mql = omfgThis->_mqlhash->query(_data->metasqlGroup, _data->metasqlName);
+    if (omfgThis->_mqlhash->reuseCount() > reused)
+      _data->_parsesSaved++;
+    if (mql)
+      xq = mql->toQuery(pParams, QSqlDatabase(), false);
+    else
+      xq = MetaSQLQuery(QString()).toQuery(pParams, QSqlDatabase(), false);
+    _data->bindCharacteristics(xq, pParams);
+
+    _data->_prepared           = xq;
+    _data->_preparedGeneration = omfgThis->_mqlhash->generation();
+    _data->_preparedKey        = _data->metasqlGroup + "%" + _data->metasqlName;
+    _data->_preparedParams     = pParams;
+
+    if (! _data->_pageKey.isEmpty() && ! _data->preparePages(xq))
     {
-      QStringList list = param.toStringList();
-      for (int j = 0; j < list.count(); j++)
-        xq.bindValue(QString(":%1_%2").arg(column).arg(j), list.at(j));
+      _data->_preparedKey.clear();
+      return;
     }
   }
 
-  foreach (QVariant columnid, _data->_charidsdate)
-  {
-    // Look for start date
-    column = QString("char%1startDate").arg(columnid.toString());
-    param = pParams.value(column, &valid);
-    if (valid)
-      xq.bindValue(QString(":%1").arg(column), param.toString());
+  XSqlQuery &query = _data->_pageKey.isEmpty() ? xq : _data->firstPage();
 
-    // Look for end date
-    column = QString("char%1endDate").arg(columnid.toString());
-    param = pParams.value(column, &valid);
-    if (valid)
-      xq.bindValue(QString(":%1").arg(column), param.toString());
-  }
-
-  xq.exec();
-
-  _data->_list->populate(xq, itemid, _data->_useAltId);
-  if (xq.lastError().type() != QSqlError::NoError)
+  if (_data->_queryAsync)
   {
-    ErrorReporter::error(QtCriticalMsg, this, tr("Error Retrieving Information"),
-                           xq, __FILE__, __LINE__);
-    return;
+    QueryProbe *probe = new QueryProbe(this, __FILE__, __LINE__);
+    if (_data->_async->start(query))
+    {
+      delete _data->_asyncProbe;
+      _data->_asyncProbe  = probe;
+      _data->_asyncItemId = itemid;
+      _data->setBusy(true);
+      return;     // sAsyncFinished() picks it up from here
+    }
+    delete probe;
   }
-  _data->_statusBar->showMessage(tr("Records found: %1").arg(xq.size()));
-  emit fillListAfter();
+
+  QueryProbe probe(this, __FILE__, __LINE__);
+  query.exec();
+  probe.record(query);
+  _data->showResult(query, query.lastError(), itemid);
 }
 
 void display::sPopulateMenu(QMenu *, QTreeWidgetItem *, int)
@@ -35,6 +35,17 @@ public:
     Q_INVOKABLE void setMetaSQLOptions(const QString &, const QString &);
     Q_INVOKABLE void setListLabel(const QString &);
 
+    Q_INVOKABLE int  parsesSaved() const;
+    Q_INVOKABLE int  preparesSaved() const;
+
+    Q_INVOKABLE void    setPageKey(const QString &, bool = false);
+    Q_INVOKABLE QString pageKey() const;
+    Q_INVOKABLE void    setPageSize(int);
+    Q_INVOKABLE int     pageSize() const;
+
+    Q_INVOKABLE void setQueryAsync(bool);
+    Q_INVOKABLE bool queryAsync() const;
+
     Q_INVOKABLE void setUseAltId(bool);
     Q_INVOKABLE bool useAltId() const;
 
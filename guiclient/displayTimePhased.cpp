@@ -11,11 +11,22 @@
 #include "displayTimePhased.h"
 #include "ui_displayTimePhased.h"
 
+#include <QHash>
 #include <QSqlError>
+#include <QSqlRecord>
 #include <QMessageBox>
 
+#include <metasql.h>
 #include <parameter.h>
 
+#include "errorReporter.h"
+#include "format.h"
+#include "guiclient.h"
+#include "mqlhash.h"
+#include "timePhasedAggregator.h"
+
+#define DEBUG false
+
 
 class displayTimePhasedPrivate : public Ui::displayTimePhased
 {
@@ -24,9 +35,30 @@ public:
   {
     setupUi(_parent->display::optionsWidget());
     _baseColumns = -1;
+    _aggregator  = new TimePhasedAggregator(_parent);
+  }
+
+  bool sameFactsParams(const ParameterList &params) const
+  {
+    if (_factsParams.count() != params.count())
+      return false;
+
+    for (int i = 0; i < params.count(); i++)
+    {
+      if (_factsParams.name(i)  != params.name(i) ||
+          _factsParams.value(i) != params.value(i))
+        return false;
+    }
+    return true;
   }
 
-  int _baseColumns;
+  TimePhasedAggregator                 *_aggregator;
+  int                                   _baseColumns;
+  QSharedPointer<const TimePhasedFacts> _facts;
+  ParameterList                         _factsParams;
+  QString                               _factsGroup;
+  QString                               _factsName;
+  QString                               _factsDefault;
 
 private:
   ::displayTimePhased * _parent;
@@ -39,6 +71,8 @@ displayTimePhased::displayTimePhased(QWidget* parent, const char* name, Qt::Wind
 
   connect(_data->_calendar, SIGNAL(newCalendarId(int)), _data->_periods, SLOT(populate(int)));
   connect(_data->_calendar, SIGNAL(select(ParameterList&)), _data->_periods, SLOT(load(ParameterList&)));
+  connect(_data->_periods,  SIGNAL(itemSelectionChanged()),  this,            SLOT(sPeriodsChanged()));
+  connect(_data->_aggregator, SIGNAL(aggregated()),          this,            SLOT(sAggregated()));
 
   _column = 0;
 }
@@ -89,12 +123,59 @@ void displayTimePhased::setBaseColumns(int columns)
   _data->_baseColumns = columns;
 }
 
-void displayTimePhased::sFillList()
+/** \brief Return the MetaSQL that fetches the dated facts behind this
+           display, or an empty string if it has neither a statement in
+           the database nor a built-in default and uses its MetaSQL
+           options.
+  */
+QString displayTimePhased::factsQuery() const
 {
-  ParameterList params;
-  if(!setParams(params))
-    return;
+  if (_data->_factsGroup.isEmpty())
+    return QString();
 
+  QString sql = omfgThis->_mqlhash->value(_data->_factsGroup, _data->_factsName);
+  return sql.isEmpty() ? _data->_factsDefault : sql;
+}
+
+/** \brief Fetch dated facts once and sum them into periods on the client.
+
+    Without a facts query, every change to the selected periods needs a new
+    trip to the database, where the MetaSQL set with setMetaSQLOptions()
+    builds one column per period. With one, sFillList() fetches each fact
+    dated within the selected periods and sums them into those periods
+    here. Selecting other periods within the same dates, or switching to
+    another calendar whose periods fall within them, then redraws the list
+    without asking the database again.
+
+    The facts query is read from the metasql table like any other, so it
+    can be customised the same way. If the database has no MetaSQL by that
+    group and name, pDefault is used instead, and if that is empty too the
+    display falls back to its MetaSQL options. A site that customises
+    those should customise the facts query to match.
+
+    The query gets the parameters from setParamsTP() plus startDate and
+    endDate, which span the selected periods. It must return one row per
+    fact with these columns:
+    - id and altid (optional): the id and alt id of the row in the list
+    - fact_date: the date that chooses the fact's period
+    - fact_value: the amount to add to that period
+    - fact_xtnumericrole (optional): how to format the period columns,
+      "qty" if not given
+    Every other column is copied to the list column of the same name. Rows
+    sharing an id and alt id are summed into one line of the list, which
+    takes its other columns from the first fact.
+  */
+void displayTimePhased::setFactsMetaSQLOptions(const QString &pGroup, const QString &pName,
+                                               const QString &pDefault)
+{
+  _data->_factsGroup   = pGroup;
+  _data->_factsName    = pName;
+  _data->_factsDefault = pDefault;
+  _data->_facts.clear();
+}
+
+void displayTimePhased::setBucketColumns()
+{
   if(_data->_baseColumns == -1)
     _data->_baseColumns = list()->columnCount();
 
@@ -112,7 +193,182 @@ void displayTimePhased::sFillList()
     list()->addColumn(formatDate(cursor->startDate()), _qtyColumn, Qt::AlignRight, true, bucketname);
     _columnDates.append(DatePair(cursor->startDate(), cursor->endDate()));
   }
+}
+
+/** \brief Run the facts query over the dates the selected periods span.
+    \return true if the facts were fetched
+  */
+bool displayTimePhased::fetchFacts(const QString &pQuery)
+{
+  ParameterList params;
+  if (! setParamsTP(params))
+    return false;
+
+  QSharedPointer<TimePhasedFacts> facts(new TimePhasedFacts());
+  foreach (DatePair period, _columnDates)
+  {
+    if (! facts->startDate.isValid() || period.startDate < facts->startDate)
+      facts->startDate = period.startDate;
+    if (! facts->endDate.isValid() || period.endDate > facts->endDate)
+      facts->endDate = period.endDate;
+  }
+
+  ParameterList factsParams = params;
+  factsParams.append("startDate", facts->startDate);
+  factsParams.append("endDate",   facts->endDate);
+
+  MetaSQLQuery mql(pQuery);
+  XSqlQuery factq = mql.toQuery(factsParams);
+  if (ErrorReporter::error(QtCriticalMsg, this, tr("Error Retrieving Information"),
+                           factq, __FILE__, __LINE__))
+    return false;
+
+  QSqlRecord  rec       = factq.record();
+  int         idCol     = rec.indexOf("id");
+  int         altIdCol  = rec.indexOf("altid");
+  int         dateCol   = rec.indexOf("fact_date");
+  int         valueCol  = rec.indexOf("fact_value");
+  int         roleCol   = rec.indexOf("fact_xtnumericrole");
+  QList<int>  baseCols;
+  for (int i = 0; i < rec.count(); i++)
+  {
+    if (i != idCol && i != altIdCol && i != dateCol && i != valueCol && i != roleCol)
+    {
+      baseCols.append(i);
+      facts->columns.append(rec.fieldName(i));
+    }
+  }
+
+  QHash<QString, int> rows;
+  while (factq.next())
+  {
+    int     id    = idCol    < 0 ? -1 : factq.value(idCol).toInt();
+    int     altId = altIdCol < 0 ? -1 : factq.value(altIdCol).toInt();
+    QString key   = QString("%1|%2").arg(id).arg(altId);
+
+    QHash<QString, int>::const_iterator found = rows.constFind(key);
+    int row;
+    if (found == rows.constEnd())
+    {
+      QVariantList values;
+      foreach (int col, baseCols)
+        values.append(factq.value(col));
+      row = facts->addRow(id, altId, values);
+      rows.insert(key, row);
+      if (roleCol >= 0 && facts->numericRole.isEmpty())
+        facts->numericRole = factq.value(roleCol).toString();
+    }
+    else
+      row = found.value();
+
+    facts->append(row, factq.value(dateCol).toDate(), factq.value(valueCol).toDouble());
+  }
+  if (facts->numericRole.isEmpty())
+    facts->numericRole = "qty";
+  facts->sortByDate();
+
+  if (DEBUG)
+    qDebug("displayTimePhased::fetchFacts() %d facts for %d rows from %s to %s",
+           facts->size(), facts->rowCount(),
+           qPrintable(facts->startDate.toString(Qt::ISODate)),
+           qPrintable(facts->endDate.toString(Qt::ISODate)));
+
+  _data->_facts       = facts;
+  _data->_factsParams = params;
+  return true;
+}
+
+void displayTimePhased::sFillList()
+{
+  ParameterList params;
+  if(!setParams(params))
+    return;
+
+  setBucketColumns();
+
+  QString query = factsQuery();
+  if (query.isEmpty())
+  {
+    display::sFillList();
+    return;
+  }
 
-  display::sFillList();
+  emit fillListBefore();
+  if (fetchFacts(query))
+    _data->_aggregator->start(_data->_facts, _columnDates);
 }
 
+/* Redraw from the facts already fetched if they still answer the question
+   the options ask. Otherwise wait for the user to ask for a new query.
+ */
+void displayTimePhased::sPeriodsChanged()
+{
+  if (! _data->_facts || _data->_periods->selectedItems().isEmpty())
+    return;
+
+  QList<DatePair> periods;
+  foreach (XTreeWidgetItem *item, _data->_periods->selectedItems())
+  {
+    PeriodListViewItem *cursor = (PeriodListViewItem*)item;
+    periods.append(DatePair(cursor->startDate(), cursor->endDate()));
+  }
+  if (! _data->_facts->covers(periods))
+    return;
+
+  ParameterList params;
+  if (! setParamsTP(params) || ! _data->sameFactsParams(params))
+    return;
+
+  setBucketColumns();
+  _data->_aggregator->start(_data->_facts, _columnDates);
+}
+
+void displayTimePhased::sAggregated()
+{
+  QSharedPointer<const TimePhasedFacts> facts = _data->_aggregator->facts();
+  if (! facts || _data->_aggregator->periods().size() != _columnDates.size())
+    return;
+
+  QVector<double> sums    = _data->_aggregator->sums();
+  QVector<int>    counts  = _data->_aggregator->counts();
+  int             buckets = _columnDates.size();
+  int             scale   = decimalPlaces(facts->numericRole);
+  int             itemid  = list()->id();
+  int             altid   = list()->altId();
+
+  QList<int> cols;
+  foreach (QString name, facts->columns)
+    cols.append(list()->column(name));
+
+  list()->clear();
+  for (int r = 0; r < facts->rowCount(); r++)
+  {
+    if (counts.at(r) == 0)
+      continue;
+
+    XTreeWidgetItem *item = new XTreeWidgetItem(list(), facts->ids.at(r), facts->altIds.at(r));
+    const QVariantList &values = facts->values.at(r);
+    for (int c = 0; c < cols.size(); c++)
+    {
+      if (cols.at(c) < 0)
+        continue;
+      item->setData(cols.at(c), Qt::DisplayRole, values.at(c));
+      item->setData(cols.at(c), Xt::RawRole,     values.at(c));
+    }
+
+    for (int b = 0; b < buckets; b++)
+    {
+      int    col = _data->_baseColumns + b;
+      double sum = sums.at(r * buckets + b);
+      item->setData(col, Qt::DisplayRole,       formatNumber(sum, scale));
+      item->setData(col, Xt::RawRole,           sum);
+      item->setData(col, Xt::ScaleRole,         scale);
+      item->setData(col, Qt::TextAlignmentRole, list()->headerItem()->textAlignment(col));
+    }
+  }
+
+  if (itemid >= 0)
+    list()->setId(itemid, altid, false);
+
+  emit fillListAfter();
+}
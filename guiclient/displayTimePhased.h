@@ -29,6 +29,10 @@ public:
 
     virtual bool setParams(ParameterList &);
 
+    Q_INVOKABLE QString factsQuery() const;
+    Q_INVOKABLE void    setFactsMetaSQLOptions(const QString &, const QString &,
+                                               const QString & = QString());
+
 public slots:
     virtual void sFillList();
 
@@ -36,12 +40,16 @@ protected:
     Q_INVOKABLE QWidget * optionsWidget();
     virtual bool setParamsTP(ParameterList &) = 0;
     virtual void setBaseColumns(int);
+    virtual void setBucketColumns();
+    virtual bool fetchFacts(const QString &);
 
     int _column;
     QList<DatePair> _columnDates;
 
 protected slots:
     virtual void languageChange();
+    virtual void sAggregated();
+    virtual void sPeriodsChanged();
 
 private:
     displayTimePhasedPrivate * _data;
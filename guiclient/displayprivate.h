@@ -14,11 +14,16 @@
 #include "ui_display.h"
 
 #include <parameter.h>
+#include <xsqlquery.h>
+#include <QSqlError>
 #include <QStatusBar>
 
 #include "parameterlistsetup.h"
 
+class AsyncQuery;
+class QProgressBar;
 class QToolButton;
+class QueryProbe;
 class display;
 
 class displayPrivate : public QObject, public Ui::display
@@ -31,6 +36,15 @@ class displayPrivate : public QObject, public Ui::display
     bool setParams(ParameterList &params);
     void setupCharacteristics(QStringList uses);
     void print(ParameterList pParams, bool showPreview, bool forceSetParams);
+    void bindCharacteristics(XSqlQuery &xq, ParameterList &params);
+    bool canReusePrepared(ParameterList &params);
+    bool preparePages(XSqlQuery &base);
+    XSqlQuery &firstPage();
+    bool fetchPage(bool pAll = false);
+    void addPage(XSqlQuery &pPage, int pItemId, bool pFirst, bool pAll);
+    void showRecordCount();
+    void showResult(XSqlQuery &pResult, const QSqlError &pError, int pItemId);
+    void setBusy(bool pBusy);
 
     QString reportName;
     QString metasqlName;
@@ -74,8 +88,41 @@ class displayPrivate : public QObject, public Ui::display
     QList<QVariant> _charidslist;
     QList<QVariant> _charidsdate;
 
+    // the last query sFillList prepared and the parameters that produced it
+    XSqlQuery     _prepared;
+    int           _preparedGeneration;
+    QString       _preparedKey;
+    ParameterList _preparedParams;
+    int           _parsesSaved;
+    int           _preparesSaved;
+
+    // keyset paging, see display::setPageKey()
+    QStringList   _pageKey;
+    bool          _pageDescending;
+    int           _pageSize;
+    XSqlQuery     _firstPage;
+    XSqlQuery     _nextPage;
+    QVariantList  _pageLastKey;
+    int           _pageRows;
+    int           _pageTotal;
+    bool          _pageDone;
+    bool          _pageFetching;
+
+    // background queries, see display::setQueryAsync()
+    bool          _queryAsync;
+    AsyncQuery   *_async;
+    int           _asyncItemId;
+    QueryProbe   *_asyncProbe;
+    QProgressBar *_busy;
+    QToolButton  *_cancelBtn;
+
   public slots:
+    void sAsyncCancelled();
+    void sAsyncFinished();
+    void sConnectionLost();
+    void sFetchRemainingPages();
     void sFilterChanged();
+    void sListScrolled(int pValue);
     void sSavedFilterApplied(int pFilter, QString pColumns);
 
   private:
@@ -44,6 +44,7 @@ dspGLTransactions::dspGLTransactions(QWidget* parent, const char*, Qt::WindowFla
   setReportName("GLTransactions");
   setMetaSQLOptions("gltransactions", "detail");
   setUseAltId(true);
+  setQueryAsync(true);
   setParameterWidgetVisible(true);
 
   QString qryType = QString( "SELECT  1, '%1' UNION "
@@ -375,14 +376,20 @@ void dspGLTransactions::sFillList(ParameterList pParams, bool forceSetParams)
   if (! setParams(pParams))
     return;
 
+  // a running total is only right when every row before it is shown
   if (_showRunningTotal->isChecked() &&
       _showRunningTotal->isVisible())
   {
+    setPageKey(QString());
     list()->showColumn("running");
     _beginningBalance->setDouble(pParams.value("beginningBalance").toDouble());
   }
   else
+  {
+    // date first, like the MetaSQL's own order; the id breaks ties
+    setPageKey("gltrans_date, gltrans_id");
     list()->hideColumn("running");
+  }
 
   display::sFillList(pParams, forceSetParams);
 }
@@ -33,6 +33,7 @@ dspInventoryHistory::dspInventoryHistory(QWidget* parent, const char* name, Qt::
   setReportName("InventoryHistory");
   setMetaSQLOptions("inventoryHistory", "detail");
   setUseAltId(true);
+  setQueryAsync(true);
   setParameterWidgetVisible(true);
 
   QString qryType;
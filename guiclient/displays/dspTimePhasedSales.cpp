@@ -20,6 +20,85 @@
 #include "parameterwidget.h"
 #include "guiclient.h"
 
+/* The default for the timePhasedSales-facts MetaSQL statement. A statement
+   of that name in the metasql table takes its place, so sites can still
+   customize it. It returns the sales history behind timePhasedSales-detail
+   one invoice line at a time for displayTimePhased to sum into periods.
+ */
+static const char *defaultFactsSql =
+  "SELECT <? if exists(\"byProdcat\") ?>"
+  "         prodcat_id AS id, prodcat_code, prodcat_descrip,"
+  "       <? elseif exists(\"byItem\") ?>"
+  "         item_id AS id, item_number, item_descrip1,"
+  "       <? else ?>"
+  "         cust_id AS id, cust_number, cust_name,"
+  "       <? endif ?>"
+  "       warehous_id AS altid, warehous_code,"
+  "       <? if exists(\"inventoryUnits\") ?>"
+  "         uom_name AS uom,"
+  "         cohist_qtyshipped AS fact_value,"
+  "       <? elseif exists(\"capacityUnits\") ?>"
+  "         itemcapuom(item_id) AS uom,"
+  "         cohist_qtyshipped * itemcapinvrat(item_id) AS fact_value,"
+  "       <? elseif exists(\"altCapacityUnits\") ?>"
+  "         itemaltcapuom(item_id) AS uom,"
+  "         cohist_qtyshipped * itemaltcapinvrat(item_id) AS fact_value,"
+  "       <? else ?>"
+  "         <? value(\"baseCurrAbbr\") ?> AS uom,"
+  "         currToBase(cohist_curr_id,"
+  "                    ROUND(cohist_qtyshipped * cohist_unitprice, 2),"
+  "                    cohist_invcdate) AS fact_value,"
+  "         'curr' AS fact_xtnumericrole,"
+  "       <? endif ?>"
+  "       cohist_invcdate AS fact_date"
+  "  FROM cohist"
+  "  JOIN custinfo ON (cohist_cust_id=cust_id)"
+  "  LEFT OUTER JOIN itemsite ON (cohist_itemsite_id=itemsite_id)"
+  "  LEFT OUTER JOIN item ON (itemsite_item_id=item_id)"
+  "  LEFT OUTER JOIN uom ON (item_inv_uom_id=uom_id)"
+  "  LEFT OUTER JOIN prodcat ON (item_prodcat_id=prodcat_id)"
+  "  LEFT OUTER JOIN whsinfo ON (itemsite_warehous_id=warehous_id)"
+  " WHERE cohist_invcdate BETWEEN <? value(\"startDate\") ?> AND <? value(\"endDate\") ?>"
+  "<? if not exists(\"includeMisc\") ?>"
+  "   AND cohist_misc_type IS NULL"
+  "<? endif ?>"
+  "<? if exists(\"cust_id\") ?>"
+  "   AND cust_id=<? value(\"cust_id\") ?>"
+  "<? endif ?>"
+  "<? if exists(\"custgrp_id\") ?>"
+  "   AND cust_id IN (SELECT custgrpitem_cust_id FROM custgrpitem"
+  "                    WHERE custgrpitem_custgrp_id=<? value(\"custgrp_id\") ?>)"
+  "<? endif ?>"
+  "<? if exists(\"custgrp_pattern\") ?>"
+  "   AND cust_id IN (SELECT custgrpitem_cust_id"
+  "                     FROM custgrpitem"
+  "                     JOIN custgrp ON (custgrpitem_custgrp_id=custgrp_id)"
+  "                    WHERE custgrp_name ~ <? value(\"custgrp_pattern\") ?>)"
+  "<? endif ?>"
+  "<? if exists(\"custtype_id\") ?>"
+  "   AND cust_custtype_id=<? value(\"custtype_id\") ?>"
+  "<? endif ?>"
+  "<? if exists(\"custtype_pattern\") ?>"
+  "   AND cust_custtype_id IN (SELECT custtype_id FROM custtype"
+  "                             WHERE custtype_code ~ <? value(\"custtype_pattern\") ?>)"
+  "<? endif ?>"
+  "<? if exists(\"item_id\") ?>"
+  "   AND item_id=<? value(\"item_id\") ?>"
+  "<? endif ?>"
+  "<? if exists(\"prodcat_id\") ?>"
+  "   AND prodcat_id=<? value(\"prodcat_id\") ?>"
+  "<? endif ?>"
+  "<? if exists(\"prodcat_pattern\") ?>"
+  "   AND prodcat_code ~ <? value(\"prodcat_pattern\") ?>"
+  "<? endif ?>"
+  "<? if exists(\"warehous_id\") ?>"
+  "   AND warehous_id=<? value(\"warehous_id\") ?>"
+  "<? endif ?>"
+  " ORDER BY <? if exists(\"byProdcat\") ?> prodcat_code,"
+  "          <? elseif exists(\"byItem\") ?> item_number,"
+  "          <? else ?> cust_number,"
+  "          <? endif ?> warehous_code;";
+
 dspTimePhasedSales::dspTimePhasedSales(QWidget* parent, const char*, Qt::WindowFlags fl)
   : displayTimePhased(parent, "dspTimePhasedSales", fl)
 {
@@ -27,6 +106,7 @@ dspTimePhasedSales::dspTimePhasedSales(QWidget* parent, const char*, Qt::WindowF
   setWindowTitle(tr("Time-Phased Sales History"));
   setReportName("TimePhasedSalesHistory");
   setMetaSQLOptions("timePhasedSales", "detail");
+  setFactsMetaSQLOptions("timePhasedSales", "facts", defaultFactsSql);
   setUseAltId(true);
   setParameterWidgetVisible(true);
 
@@ -58,6 +58,7 @@ dspAROpenItems::dspAROpenItems(QWidget* parent, const char*, Qt::WindowFlags fl)
   setReportName("AROpenItems");
   setMetaSQLOptions("arOpenItems", "detail");
   setUseAltId(true);
+  setQueryAsync(true);
   setNewVisible(true);
 
   connect(_customerSelector, SIGNAL(updated()), list(), SLOT(clear()));
@@ -12,6 +12,8 @@
 
 #include <QAction>
 #include <QCloseEvent>
+#include <QCoreApplication>
+#include <QHash>
 #include <QInputDialog>
 #include <QList>
 #include <QMenu>
@@ -32,6 +34,7 @@
 #include "financialReportNotes.h"
 #include "storedProcErrorLookup.h"
 #include "errorReporter.h"
+#include "xcachedhash.h"
 
 #define cFlRoot  0
 #define cFlItem  1
@@ -45,6 +48,59 @@
 #define cBudget   4
 #define cDiff     5
 
+/* financialReport() leaves its roll-up of the trial balances in flrpt,
+   one snapshot per user, layout, period and interval. This remembers
+   which snapshots every dspFinancialReport window in this session has
+   had the server build, so changing columns, intervals or periods only
+   builds the snapshots that are missing. The key includes the project
+   and the value stamps the flrpt rows the build left behind, so rows
+   rebuilt since by another session of the same user are noticed.
+   The column date ranges used for drill-down are remembered here too.
+
+   Everything is forgotten when the database announces a change to a
+   table the snapshots are built from. trialbal is only watched when
+   ManualForwardUpdate is set; otherwise it changes only after gltrans
+   does, and watching it would make this client's own forward update
+   throw away the snapshots it was run for. current is true once the
+   trial balances have been forward updated since the last change.
+ */
+class FinancialSnapshotCache : public XCachedHash<QString, QString>
+{
+  public:
+    FinancialSnapshotCache(QObject *pParent)
+      : XCachedHash<QString, QString>(pParent, QStringList()
+                                      << "gltrans"  << "period" << "yearperiod"
+                                      << "budgitem" << "flhead" << "flgrp"
+                                      << "flitem"   << "flspec" << "flcol"),
+        current(false)
+    {
+      if (_metrics->boolean("ManualForwardUpdate"))
+        setNotification(QStringList() << "trialbal");
+    }
+
+    virtual void clear()
+    {
+      XCachedHash<QString, QString>::clear();
+      columnDates.clear();
+      current = false;
+    }
+
+    QHash<QString, QMap<int, QPair<QDate, QDate> > > columnDates;
+    bool                                             current;
+
+  protected:
+    virtual bool refresh(const QString &) { return false; }
+};
+
+static FinancialSnapshotCache *_snapshots = 0;
+
+static FinancialSnapshotCache *snapshotCache()
+{
+  if (! _snapshots)
+    _snapshots = new FinancialSnapshotCache(QCoreApplication::instance());
+  return _snapshots;
+}
+
 dspFinancialReport::dspFinancialReport(QWidget* parent, const char*, Qt::WindowFlags fl)
   : display(parent, "dspFinancialReport", fl)
 {
@@ -77,6 +133,8 @@ dspFinancialReport::dspFinancialReport(QWidget* parent, const char*, Qt::WindowF
   connect(_year, SIGNAL(toggled(bool)), this, SLOT(sFillPeriods()));
   connect(_notesBtn, SIGNAL(clicked()), _notesAct, SLOT(trigger()));
   connect(_notesAct, SIGNAL(triggered()), this, SLOT(sNotes()));
+  connect(omfgThis, SIGNAL(glSeriesUpdated()),         this, SLOT(sInvalidateSnapshots()));
+  connect(omfgThis, SIGNAL(budgetsUpdated(int, bool)), this, SLOT(sInvalidateSnapshots()));
 
   list()->setPopulateLinear(true);
   _flhead->setType(XComboBox::FinancialLayouts);
@@ -158,10 +216,11 @@ void dspFinancialReport::sFillList()
 {
   if (!sCheck())
     return; 
-  if (!_metrics->boolean("ManualForwardUpdate"))
+  if (!snapshotCache()->current && !_metrics->boolean("ManualForwardUpdate"))
   {
     if (!forwardUpdate())
       return;
+    snapshotCache()->current = true;
   }
   if (_trend->isChecked())
     sFillListTrend();
@@ -196,19 +255,27 @@ void dspFinancialReport::sFillListStatement()
     label.exec();
 
     //Get column date ranges for drill down
-    _columnDates.clear();
-    XSqlQuery coldata;
-    coldata.prepare("SELECT * FROM getflcoldata(:flcolid,:periodid)");
-    coldata.bindValue(":flcolid", _flcol->id());
-    coldata.bindValue(":periodid", periodsRef.at(0));
-    coldata.exec();
-    while(coldata.next())
+    QString datesKey = QString("S:%1:%2").arg(_flcol->id()).arg(periodsRef.at(0));
+    if (snapshotCache()->columnDates.contains(datesKey))
+      _columnDates = snapshotCache()->columnDates.value(datesKey);
+    else
     {
-      QPair<QDate, QDate> range;
-      range.first = coldata.value("flcoldata_start").toDate();
-      range.second = coldata.value("flcoldata_end").toDate();
-      _columnDates.insert(coldata.value("flcoldata_column").toInt(), range);
-    };
+      _columnDates.clear();
+      XSqlQuery coldata;
+      coldata.prepare("SELECT * FROM getflcoldata(:flcolid,:periodid)");
+      coldata.bindValue(":flcolid", _flcol->id());
+      coldata.bindValue(":periodid", periodsRef.at(0));
+      coldata.exec();
+      while(coldata.next())
+      {
+        QPair<QDate, QDate> range;
+        range.first = coldata.value("flcoldata_start").toDate();
+        range.second = coldata.value("flcoldata_end").toDate();
+        _columnDates.insert(coldata.value("flcoldata_column").toInt(), range);
+      };
+      if (coldata.lastError().type() == QSqlError::NoError)
+        snapshotCache()->columnDates.insert(datesKey, _columnDates);
+    }
 
     if (label.first())
     {
@@ -538,7 +605,11 @@ void dspFinancialReport::sFillListTrend()
     return;
 
   //Get column date ranges for drill down
-  if (_actuals->isChecked())
+  QString datesKey = QString("T:%1:%2:%3").arg(interval, periodList.join(","))
+                                           .arg(_budgets->isChecked());
+  if (_actuals->isChecked() && snapshotCache()->columnDates.contains(datesKey))
+    _columnDates = snapshotCache()->columnDates.value(datesKey);
+  else if (_actuals->isChecked())
   {
     _columnDates.clear();
     XSqlQuery coldata;
@@ -561,6 +632,8 @@ void dspFinancialReport::sFillListTrend()
       range.second = coldata.value("flcoldata_end").toDate();
       _columnDates.insert(coldata.value("flcoldata_column").toInt(), range);
     };
+    if (coldata.lastError().type() == QSqlError::NoError)
+      snapshotCache()->columnDates.insert(datesKey, _columnDates);
   }
 
   list()->setColumnCount(0);
@@ -794,11 +867,31 @@ void dspFinancialReport::sFillListTrend()
     if(c > 0)
       q4w += QString(" AND (r0.flrpt_order=r%1.flrpt_order)").arg(c);
 
-    dspFillListTrend.bindValue(":flhead_id", _flhead->id());
-    dspFillListTrend.bindValue(":period_id", periodsRef.at(c));
-    dspFillListTrend.bindValue(":interval", interval);
-    dspFillListTrend.bindValue(":prjid", _prjid);
-    dspFillListTrend.exec();
+    // only build the snapshots this session does not already have
+    QString snapshot = QString("%1:%2:%3:%4").arg(_flhead->id()).arg(periodsRef.at(c))
+                                             .arg(interval).arg(_prjid);
+    QString stamp;
+    if (snapshotCache()->contains(snapshot))
+      stamp = snapshotStamp(periodsRef.at(c), interval);
+    if (stamp.isEmpty() || snapshotCache()->value(snapshot) != stamp)
+    {
+      dspFillListTrend.bindValue(":flhead_id", _flhead->id());
+      dspFillListTrend.bindValue(":period_id", periodsRef.at(c));
+      dspFillListTrend.bindValue(":interval", interval);
+      dspFillListTrend.bindValue(":prjid", _prjid);
+      dspFillListTrend.exec();
+      if (ErrorReporter::error(QtCriticalMsg, this, tr("Error Retrieving Financial Information"),
+                               dspFillListTrend, __FILE__, __LINE__))
+      {
+        snapshotCache()->remove(snapshot);
+        return;
+      }
+      stamp = snapshotStamp(periodsRef.at(c), interval);
+      if (stamp.isEmpty())
+        snapshotCache()->remove(snapshot);
+      else
+        snapshotCache()->insert(snapshot, stamp);
+    }
   }
 
   //Grand Total for Trend Reports
@@ -995,6 +1088,16 @@ void dspFinancialReport::sEditPeriodLabel()
 
 void dspFinancialReport::sReportChanged(int flheadid)
 {
+  // the layout may have been edited since its snapshots were built
+  QStringList stale;
+  foreach (QString snapshot, snapshotCache()->keys())
+  {
+    if (snapshot.startsWith(QString("%1:").arg(flheadid)))
+      stale << snapshot;
+  }
+  foreach (QString snapshot, stale)
+    snapshotCache()->remove(snapshot);
+
   XSqlQuery dspReportChanged;
     //Populate column layouts
   dspReportChanged.prepare( "SELECT flcol_id, flcol_name "
@@ -1157,6 +1260,33 @@ bool dspFinancialReport::forwardUpdate()
   return true;
 }
 
+/* Identify the flrpt rows financialReport() last left for the current
+   user, layout, period and interval. Rebuilding them gives them a new
+   xmin, so a stamp that still matches means nobody has touched them.
+ */
+QString dspFinancialReport::snapshotStamp(int pPeriodid, const QString &pInterval)
+{
+  XSqlQuery stampq;
+  stampq.prepare("SELECT COUNT(*) || '/' || COALESCE(MIN(xmin::TEXT), '') AS stamp"
+                 "  FROM flrpt"
+                 " WHERE ((flrpt_flhead_id=:flhead_id)"
+                 "   AND  (flrpt_period_id=:period_id)"
+                 "   AND  (flrpt_username=getEffectiveXtUser())"
+                 "   AND  (flrpt_interval=:interval));");
+  stampq.bindValue(":flhead_id", _flhead->id());
+  stampq.bindValue(":period_id", pPeriodid);
+  stampq.bindValue(":interval",  pInterval);
+  stampq.exec();
+  if (stampq.first())
+    return stampq.value("stamp").toString();
+  return QString();
+}
+
+void dspFinancialReport::sInvalidateSnapshots()
+{
+  snapshotCache()->clear();
+}
+
 QString dspFinancialReport::reportName() const
 {
   if (_trend->isChecked())
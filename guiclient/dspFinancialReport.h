@@ -59,9 +59,11 @@ protected slots:
     virtual void sCollapsed( QTreeWidgetItem * item );
     virtual void sExpanded( QTreeWidgetItem * item );
     virtual void sReportChanged(int);
+    virtual void sInvalidateSnapshots();
 
 protected:
     virtual bool forwardUpdate();
+    virtual QString snapshotStamp(int pPeriodid, const QString &pInterval);
     Q_INVOKABLE ParameterList getParams();
     
 private:
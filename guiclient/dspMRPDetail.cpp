@@ -14,6 +14,7 @@
 #include <QMenu>
 #include <QMessageBox>
 #include <QSqlError>
+#include <QStringList>
 #include <QVariant>
 
 #include <datecluster.h>
@@ -28,13 +29,43 @@
 #include "mqlutil.h"
 #include "errorReporter.h"
 
+#define DEBUG false
+
+/* The default for the mrpDetail-buckets MetaSQL statement. A statement of
+   that name in the metasql table takes its place, so sites can still
+   customize the numbers. It replaces mrpDetail-detail, which returned one
+   period per call.
+ */
+static const char *defaultBucketsSql =
+  "SELECT itemsite_qtyonhand AS qoh,"
+  "       string_agg(qtyAllocated(itemsite_id, startdate, enddate)::TEXT,"
+  "                  ',' ORDER BY seq) AS allocations,"
+  "       string_agg(qtyOrdered(itemsite_id, startdate, enddate)::TEXT,"
+  "                  ',' ORDER BY seq) AS orders,"
+  "       string_agg(qtyFirmedAllocated(itemsite_id, startdate, enddate)::TEXT,"
+  "                  ',' ORDER BY seq) AS firmedallocations,"
+  "       string_agg(qtyFirmed(itemsite_id, startdate, enddate)::TEXT,"
+  "                  ',' ORDER BY seq) AS firmedorders"
+  "  FROM itemsite"
+  "  CROSS JOIN (VALUES <? literal(\"periods\") ?>) AS period(seq, startdate, enddate)"
+  " WHERE itemsite_id=<? value(\"itemsite_id\") ?>"
+  " GROUP BY itemsite_qtyonhand;";
+
+static QString periodKey(XTreeWidgetItem *pPeriod)
+{
+  PeriodListViewItem *period = (PeriodListViewItem *)pPeriod;
+  return period->startDate().toString(Qt::ISODate) + "|" +
+         period->endDate().toString(Qt::ISODate);
+}
+
 dspMRPDetail::dspMRPDetail(QWidget* parent, const char* name, Qt::WindowFlags fl)
     : XWidget(parent, name, fl)
 {
   setupUi(this);
 
-  connect(_itemsite, SIGNAL(itemSelected(int)), this, SLOT(sFillMRPDetail()));
-  connect(_itemsite, SIGNAL(itemSelectionChanged()), this, SLOT(sFillMRPDetail()));
+  connect(_itemsite, SIGNAL(itemSelected(int)), this, SLOT(sRefreshMRPDetail()));
+  connect(_itemsite, SIGNAL(itemSelectionChanged()), this, SLOT(sRefreshMRPDetail()));
+  connect(_periods, SIGNAL(itemSelectionChanged()), this, SLOT(sFillMRPDetail()));
   connect(_mrp, SIGNAL(populateMenu(QMenu*,QTreeWidgetItem*,int)), this, SLOT(sPopulateMenu(QMenu*,QTreeWidgetItem*,int)));
   connect(_plannerCode, SIGNAL(updated()), this, SLOT(sFillItemsites()));
   connect(_print, SIGNAL(clicked()), this, SLOT(sPrint()));
@@ -190,7 +221,7 @@ void dspMRPDetail::sIssuePR()
   newdlg.set(params);
 
   if (newdlg.exec() != XDialog::Rejected)
-    sFillMRPDetail();
+    sRefreshMRPDetail();
 }
 
 void dspMRPDetail::sIssuePO()
@@ -223,15 +254,94 @@ void dspMRPDetail::sFillItemsites()
   if (! setParams(params))
     return;
 
+  _buckets.clear();
+  _qoh.clear();
+
   MetaSQLQuery mql = mqlLoad("mrpDetail", "item");
 
   dspFillItemsites = mql.toQuery(params);
   _itemsite->populate(dspFillItemsites, true);
 }
 
+/** \brief Forget what was fetched and fetch the selected itemsite again.
+
+    This runs whenever an itemsite is selected, so the numbers are always
+    current when the user picks one. Only changing the selected periods
+    reuses what was fetched.
+  */
+void dspMRPDetail::sRefreshMRPDetail()
+{
+  _buckets.clear();
+  _qoh.clear();
+  sFillMRPDetail();
+}
+
+/* Fetch the raw numbers for every period in pPeriods that we have not
+   already fetched for this itemsite, all in one query. Running totals are
+   left to sFillMRPDetail() so choosing other periods costs at most one
+   round-trip for the new ones.
+ */
+bool dspMRPDetail::loadBuckets(int pItemsiteid, const QList<XTreeWidgetItem*> &pPeriods)
+{
+  QHash<QString, MRPBucket> &buckets = _buckets[pItemsiteid];
+  QStringList keys;
+  QStringList values;
+  for (int i = 0; i < pPeriods.size(); i++)
+  {
+    QString key = periodKey(pPeriods[i]);
+    if (buckets.contains(key) || keys.contains(key))
+      continue;
+    PeriodListViewItem *period = (PeriodListViewItem *)pPeriods[i];
+    keys.append(key);
+    values.append(QString("(%1, DATE '%2', DATE '%3')")
+                  .arg(keys.size())
+                  .arg(period->startDate().toString(Qt::ISODate))
+                  .arg(period->endDate().toString(Qt::ISODate)));
+  }
+
+  if (keys.isEmpty() && _qoh.contains(pItemsiteid))
+    return true;
+  if (keys.isEmpty())
+    values.append("(1, CURRENT_DATE, CURRENT_DATE)");
+
+  QString sql = omfgThis->_mqlhash->value("mrpDetail", "buckets");
+  MetaSQLQuery mql(sql.isEmpty() ? QString(defaultBucketsSql) : sql);
+  ParameterList params;
+  params.append("itemsite_id", pItemsiteid);
+  params.append("periods",     values.join(", "));
+  XSqlQuery mrpq = mql.toQuery(params);
+  if (! mrpq.first())
+  {
+    _buckets.remove(pItemsiteid);
+    ErrorReporter::error(QtCriticalMsg, this, tr("Error Retrieving MRP Detail Information"),
+                         mrpq, __FILE__, __LINE__);
+    return false;
+  }
+
+  _qoh.insert(pItemsiteid, mrpq.value("qoh").toDouble());
+
+  QStringList allocations       = mrpq.value("allocations").toString().split(",");
+  QStringList orders            = mrpq.value("orders").toString().split(",");
+  QStringList firmedAllocations = mrpq.value("firmedallocations").toString().split(",");
+  QStringList firmedOrders      = mrpq.value("firmedorders").toString().split(",");
+  for (int i = 0; i < keys.size(); i++)
+  {
+    MRPBucket bucket;
+    bucket.allocations       = allocations.value(i).toDouble();
+    bucket.orders            = orders.value(i).toDouble();
+    bucket.firmedAllocations = firmedAllocations.value(i).toDouble();
+    bucket.firmedOrders      = firmedOrders.value(i).toDouble();
+    buckets.insert(keys.at(i), bucket);
+  }
+
+  if (DEBUG)
+    qDebug("dspMRPDetail::loadBuckets(%d) fetched %d of %d periods",
+           pItemsiteid, keys.size(), pPeriods.size());
+  return true;
+}
+
 void dspMRPDetail::sFillMRPDetail()
 {
-  XSqlQuery dspFillMRPDetail;
   _mrp->clear();
 
   _mrp->setColumnCount(1);
@@ -243,6 +353,12 @@ void dspMRPDetail::sFillMRPDetail()
     _mrp->addColumn(formatDate(((PeriodListViewItem *)cursor)->startDate()), _qtyColumn, Qt::AlignRight);
   }
 
+  int itemsiteid = _itemsite->id();
+  if (itemsiteid < 0 || selected.isEmpty() || ! loadBuckets(itemsiteid, selected))
+    return;
+
+  const QHash<QString, MRPBucket> &buckets = _buckets[itemsiteid];
+
   XTreeWidgetItem *qoh = 0;
   XTreeWidgetItem *allocations = 0;
   XTreeWidgetItem *orders = 0;
@@ -250,56 +366,40 @@ void dspMRPDetail::sFillMRPDetail()
   XTreeWidgetItem *firmedAllocations = 0;
   XTreeWidgetItem *firmedOrders = 0;
   XTreeWidgetItem *firmedAvailability = 0;
-  double        runningAvailability = 0.0;
+  double        runningAvailability = _qoh.value(itemsiteid);
   double	runningFirmed = 0.0;
-  int           counter = 0;
 
-  for (int i = 0; i < selected.size(); i++)
+  for (int counter = 1; counter <= selected.size(); counter++)
   {
-    XTreeWidgetItem *cursor = (XTreeWidgetItem*)selected[i];
-    counter++;
-    ParameterList params;
-    params.append("cursorId", cursor->id());
-    params.append("counter", counter);
-    params.append("itemsite_id", _itemsite->id());
-
-    MetaSQLQuery mql = mqlLoad("mrpDetail", "detail");
-    dspFillMRPDetail = mql.toQuery(params);
-    if (dspFillMRPDetail.first())
+    MRPBucket bucket = buckets.value(periodKey(selected[counter - 1]));
+    if (counter == 1)
     {
-      if (counter == 1)
-      {
-        runningFirmed = dspFillMRPDetail.value("firmedorders1").toDouble();
-        runningAvailability = (dspFillMRPDetail.value("qoh").toDouble() - dspFillMRPDetail.value("allocations1").toDouble() + dspFillMRPDetail.value("orders1").toDouble());
-
-        qoh                = new XTreeWidgetItem(_mrp, 0, QVariant(tr("Projected QOH")), dspFillMRPDetail.value("f_qoh"));
-        allocations        = new XTreeWidgetItem(_mrp, qoh, 0, QVariant(tr("Allocations")), formatQty(dspFillMRPDetail.value("allocations1").toDouble()));
-        orders             = new XTreeWidgetItem(_mrp, allocations,  0, QVariant(tr("Orders")), formatQty(dspFillMRPDetail.value("orders1").toDouble()));
-        availability       = new XTreeWidgetItem(_mrp, orders, 0, QVariant(tr("Availability")), formatQty(runningAvailability));
-        firmedAllocations  = new XTreeWidgetItem(_mrp, availability, 0, QVariant(tr("Firmed Allocations")), formatQty(dspFillMRPDetail.value("firmedallocations1").toDouble()));
-        firmedOrders       = new XTreeWidgetItem(_mrp, firmedAllocations, 0, QVariant(tr("Firmed Orders")), formatQty(runningFirmed));
-        firmedAvailability = new XTreeWidgetItem(_mrp, firmedOrders, 0, QVariant(tr("Firmed Availability")), formatQty( runningAvailability -
-                                                                                                            dspFillMRPDetail.value("firmedallocations1").toDouble() +
-                                                                                                            runningFirmed ) );
-      }
-      else
-      {
-        qoh->setText(counter, formatQty(runningAvailability));
-        allocations->setText(counter, formatQty(dspFillMRPDetail.value(QString("allocations%1").arg(counter)).toDouble()));
-        orders->setText(counter, formatQty(dspFillMRPDetail.value(QString("orders%1").arg(counter)).toDouble()));
+      runningFirmed = bucket.firmedOrders;
+      runningAvailability = runningAvailability - bucket.allocations + bucket.orders;
+
+      qoh                = new XTreeWidgetItem(_mrp, 0, QVariant(tr("Projected QOH")), formatQty(_qoh.value(itemsiteid)));
+      allocations        = new XTreeWidgetItem(_mrp, qoh, 0, QVariant(tr("Allocations")), formatQty(bucket.allocations));
+      orders             = new XTreeWidgetItem(_mrp, allocations,  0, QVariant(tr("Orders")), formatQty(bucket.orders));
+      availability       = new XTreeWidgetItem(_mrp, orders, 0, QVariant(tr("Availability")), formatQty(runningAvailability));
+      firmedAllocations  = new XTreeWidgetItem(_mrp, availability, 0, QVariant(tr("Firmed Allocations")), formatQty(bucket.firmedAllocations));
+      firmedOrders       = new XTreeWidgetItem(_mrp, firmedAllocations, 0, QVariant(tr("Firmed Orders")), formatQty(runningFirmed));
+      firmedAvailability = new XTreeWidgetItem(_mrp, firmedOrders, 0, QVariant(tr("Firmed Availability")),
+                                               formatQty(runningAvailability - bucket.firmedAllocations + runningFirmed));
+    }
+    else
+    {
+      qoh->setText(counter, formatQty(runningAvailability));
+      allocations->setText(counter, formatQty(bucket.allocations));
+      orders->setText(counter, formatQty(bucket.orders));
 
-        runningAvailability =  ( runningAvailability - dspFillMRPDetail.value(QString("allocations%1").arg(counter)).toDouble() +
-                                                       dspFillMRPDetail.value(QString("orders%1").arg(counter)).toDouble() );
-        availability->setText(counter, formatQty(runningAvailability));
+      runningAvailability = runningAvailability - bucket.allocations + bucket.orders;
+      availability->setText(counter, formatQty(runningAvailability));
 
-        firmedAllocations->setText(counter, formatQty(dspFillMRPDetail.value(QString("firmedallocations%1").arg(counter)).toDouble()));
+      firmedAllocations->setText(counter, formatQty(bucket.firmedAllocations));
 
-        runningFirmed += dspFillMRPDetail.value(QString("firmedorders%1").arg(counter)).toDouble();
-        firmedOrders->setText(counter, formatQty(runningFirmed));
-        firmedAvailability->setText(counter, formatQty( runningAvailability -
-                                                              dspFillMRPDetail.value(QString("firmedallocations%1").arg(counter)).toDouble() +
-                                                              runningFirmed ) );
-      }
+      runningFirmed += bucket.firmedOrders;
+      firmedOrders->setText(counter, formatQty(runningFirmed));
+      firmedAvailability->setText(counter, formatQty(runningAvailability - bucket.firmedAllocations + runningFirmed));
     }
   }
 }
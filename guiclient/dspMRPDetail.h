@@ -13,10 +13,23 @@
 
 #include "guiclient.h"
 #include "xwidget.h"
+#include <QHash>
 #include <parameter.h>
 
 #include "ui_dspMRPDetail.h"
 
+// what the server says about one itemsite in one period
+class MRPBucket
+{
+  public:
+    MRPBucket() : allocations(0), orders(0), firmedAllocations(0), firmedOrders(0) { }
+
+    double allocations;
+    double orders;
+    double firmedAllocations;
+    double firmedOrders;
+};
+
 class dspMRPDetail : public XWidget, public Ui::dspMRPDetail
 {
     Q_OBJECT
@@ -39,9 +52,14 @@ public slots:
 
 protected slots:
     virtual void languageChange();
+    virtual void sRefreshMRPDetail();
 
 private:
+    bool loadBuckets(int pItemsiteid, const QList<XTreeWidgetItem*> &pPeriods);
+
+    QHash<int, QHash<QString, MRPBucket> > _buckets;
     int _column;
+    QHash<int, double> _qoh;
 
 };
 
@@ -19,6 +19,7 @@
 #include <QStringList>
 #include <QDateTime>
 #include <QSqlError>
+#include <QThread>
 
 #include "xtsettings.h"
 
@@ -113,6 +114,17 @@ void errorLogListener::error(const QString & sql, const QSqlError & error)
   msg += " " + error.text();
   msg += "\n" + sql;
 
+  // queries on worker connections fail on their own threads, but the list
+  // and the error button belong to the GUI thread
+  if (QThread::currentThread() != thread())
+    QMetaObject::invokeMethod(this, "record", Qt::QueuedConnection,
+                              Q_ARG(QString, msg));
+  else
+    record(msg);
+}
+
+void errorLogListener::record(const QString &msg)
+{
   _errorList.append(msg);
   if(_errorList.size() > 20)
     _errorList.removeFirst();
@@ -50,6 +50,9 @@ class errorLogListener : public QObject, public XSqlQueryErrorListener {
   public slots:
     void clear();
 
+  protected slots:
+    void record(const QString &);
+
   signals:
     void updated(const QString &);
 };
@@ -34,6 +34,11 @@
 #include <QBuffer>
 #include <QDesktopServices>
 #include <QScriptEngineDebugger>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QRunnable>
+#include <QThreadPool>
+#include <QWaitCondition>
 
 #include <parameter.h>
 #include <dbtools.h>
@@ -67,18 +72,22 @@
 
 #include "timeoutHandler.h"
 #include "idleShutdown.h"
+#include "itembundle.h"
 #include "inputManager.h"
 #include "xdoublevalidator.h"
 
+#include "calendarcache.h"
 #include "distributeInventory.h"
 #include "comments.h"
 #include "documents.h"
 #include "splashconst.h"
 #include "scripttoolbox.h"
+#include "sessionBootstrap.h"
 #include "menubutton.h"
 #include "guiErrorCheck.h"
 #include "salesOrderItem.h"
 #include "xtupleguiclientinterface.h"
+#include "windowPool.h"
 
 #include "include.h"
 #include "setup.h"
@@ -323,11 +332,23 @@ GUIClient::GUIClient(const QString &pDatabaseURL, const QString &pUsername)
     _shuttingDown(false),
     _spellCodec(0),
     _spellChecker(0),
+    _spellLoader(0),
     _menu(0)
 {
 #ifdef Q_OS_LINUX
   QCoreApplication::setAttribute(Qt::AA_DontUseNativeMenuBar, true); // bug 34231 - testability
 #endif
+  productsMenu    = 0;
+  inventoryMenu   = 0;
+  scheduleMenu    = 0;
+  purchaseMenu    = 0;
+  manufactureMenu = 0;
+  crmMenu         = 0;
+  salesMenu       = 0;
+  accountingMenu  = 0;
+  windowMenu      = 0;
+  systemMenu      = 0;
+
   XSqlQuery qry;
 
   __saveSizePositionEventFilter = new SaveSizePositionEventFilter(this);
@@ -337,8 +358,13 @@ GUIClient::GUIClient(const QString &pDatabaseURL, const QString &pUsername)
 
   _mqlhash = new MqlHash(this);
 
-  qry.exec("SELECT startOfTime() AS sot, endOfTime() AS eot;");
-  if (qry.first())
+  SessionBootstrap *bootstrap = SessionBootstrap::current();
+  if (bootstrap && bootstrap->contains("sot") && bootstrap->contains("eot"))
+  {
+    _startOfTime = bootstrap->value("sot").toDate();
+    _endOfTime   = bootstrap->value("eot").toDate();
+  }
+  else if (qry.exec("SELECT startOfTime() AS sot, endOfTime() AS eot;") && qry.first())
   {
     _startOfTime = qry.value("sot").toDate();
     _endOfTime   = qry.value("eot").toDate();
@@ -420,7 +446,11 @@ GUIClient::GUIClient(const QString &pDatabaseURL, const QString &pUsername)
   _timeoutHandler->setIdleMinutes(_preferences->value("IdleTimeout").toInt());
   _reportHandler = 0;
 
-  connect(_privileges, SIGNAL(loaded()), this, SLOT(initMenuBar()));
+  connect(_privileges, SIGNAL(privilegesChanged(QBitArray)), this, SLOT(sPrivilegesChanged(QBitArray)));
+
+  // caches in common can't see this window, so tell them when the connection drops
+  connect(this, SIGNAL(dbConnectionLost()), CalendarCache::instance(),   SLOT(sConnectionLost()));
+  connect(this, SIGNAL(dbConnectionLost()), ItemBundleCache::instance(), SLOT(sConnectionLost()));
 
   ScriptableWidget::_guiClientInterface = new xTupleGuiClientInterface(this);
   ScriptableWidget::_guiClientInterface->setMqlHash(_mqlhash);
@@ -505,17 +535,23 @@ GUIClient::GUIClient(const QString &pDatabaseURL, const QString &pUsername)
   }
 
   //  Populate the menu bar
-  XSqlQuery window;
-  window.prepare("SELECT usr_window "
-                 "  FROM usr "
-                 " WHERE (usr_username=getEffectiveXtUser());");
-  window.exec();
   // keep synchronized with user.ui.h
   _singleWindow = "";
-  if (window.first())
-    _singleWindow = window.value("usr_window").toString();
+  if (bootstrap && bootstrap->contains("usr_window"))
+    _singleWindow = bootstrap->value("usr_window").toString();
+  else
+  {
+    XSqlQuery window;
+    window.prepare("SELECT usr_window "
+                   "  FROM usr "
+                   " WHERE (usr_username=getEffectiveXtUser());");
+    window.exec();
+    if (window.first())
+      _singleWindow = window.value("usr_window").toString();
+  }
   if (_singleWindow.isEmpty())
     initMenuBar();
+  SessionBootstrap::mark("menus");
 
 }
 
@@ -588,14 +624,23 @@ void GUIClient::setWindowTitle()
   QSqlDatabase db       = QSqlDatabase::database();
   QString      username = db.userName();
   QString      edition  = tr("[ unknown edition ]");
-  XSqlQuery q("SELECT getEffectiveXtUser() AS u, getEdition() AS e;");
-  if (q.first())
+  SessionBootstrap *bootstrap = SessionBootstrap::current();
+  if (bootstrap && bootstrap->contains("effective_user") && bootstrap->contains("edition"))
+  {
+    username = bootstrap->value("effective_user").toString();
+    edition  = bootstrap->value("edition").toString();
+  }
+  else
   {
-    username = q.value("u").toString();
-    edition  = q.value("e").toString();
+    XSqlQuery q("SELECT getEffectiveXtUser() AS u, getEdition() AS e;");
+    if (q.first())
+    {
+      username = q.value("u").toString();
+      edition  = q.value("e").toString();
+    }
+    ErrorReporter::error(QtCriticalMsg, this, tr("Could not get user and edition"),
+                         q, __FILE__, __LINE__);
   }
-  ErrorReporter::error(QtCriticalMsg, this, tr("Could not get user and edition"),
-                       q, __FILE__, __LINE__);
   
 
   QMainWindow::setWindowTitle(tr("%1 %2 - %3 on %4:%5/%6 AS %7")
@@ -605,8 +650,64 @@ void GUIClient::setWindowTitle()
                                    db.databaseName(),  username));
 }
 
+/* The module menus in menu bar order. Each is built the first time it is
+   needed rather than at login; see GUIClient::initMenuBar().
+ */
+static const struct {
+  const char *menu;        // object name of the module's top-level QMenu
+  const char *toolbar;     // object name of the module's QToolBar
+  const char *showMenu;    // preference that shows the menu
+  const char *showToolbar; // preference that shows the toolbar
+  const char *context;     // translation context of title
+  const char *title;       // menu bar text, as the module class sets it
+  const char *splash;
+  bool        allEditions; // false if the module is not in PostBooks
+} __menuModules[] = {
+  { "menu.prod",  "Products Tools",    "ShowPDMenu",  "ShowPDToolbar",
+    "menuProducts",    QT_TRANSLATE_NOOP("menuProducts",    "Produc&ts"),
+    QT_TRANSLATE_NOOP("GUIClient", "Initializing the Products Module"),    true  },
+  { "menu.im",    "Inventory Tools",   "ShowIMMenu",  "ShowIMToolbar",
+    "menuInventory",   QT_TRANSLATE_NOOP("menuInventory",   "&Inventory"),
+    QT_TRANSLATE_NOOP("GUIClient", "Initializing the Inventory Module"),   true  },
+  { "menu.sched", "Schedule Tools",    "ShowMSMenu",  "ShowMSToolbar",
+    "menuSchedule",    QT_TRANSLATE_NOOP("menuSchedule",    "Sche&dule"),
+    QT_TRANSLATE_NOOP("GUIClient", "Initializing the Scheduling Module"),  false },
+  { "menu.purch", "Purchase Tools",    "ShowPOMenu",  "ShowPOToolbar",
+    "menuPurchase",    QT_TRANSLATE_NOOP("menuPurchase",    "P&urchase"),
+    QT_TRANSLATE_NOOP("GUIClient", "Initializing the Purchase Module"),    true  },
+  { "menu.manu",  "Manufacture Tools", "ShowWOMenu",  "ShowWOToolbar",
+    "menuManufacture", QT_TRANSLATE_NOOP("menuManufacture", "&Manufacture"),
+    QT_TRANSLATE_NOOP("GUIClient", "Initializing the Manufacture Module"), true  },
+  { "menu.crm",   "CRM Tools",         "ShowCRMMenu", "ShowCRMToolbar",
+    "menuCRM",         QT_TRANSLATE_NOOP("menuCRM",         "C&RM"),
+    QT_TRANSLATE_NOOP("GUIClient", "Initializing the CRM Module"),         true  },
+  { "menu.sales", "Sales Tools",       "ShowSOMenu",  "ShowSOToolbar",
+    "menuSales",       QT_TRANSLATE_NOOP("menuSales",       "S&ales"),
+    QT_TRANSLATE_NOOP("GUIClient", "Initializing the Sales Module"),       true  },
+  { "menu.accnt", "Accounting Tools",  "ShowGLMenu",  "ShowGLToolbar",
+    "menuAccounting",  QT_TRANSLATE_NOOP("menuAccounting",  "Accountin&g"),
+    QT_TRANSLATE_NOOP("GUIClient", "Initializing the Accounting Module"),  true  }
+};
+static const int __menuModuleCount = sizeof(__menuModules) / sizeof(__menuModules[0]);
+
 /** @brief Build the application menus and toolbars based on
            the current user's preferences for menu and toolbar visibility.
+
+    The System and Window menus are always built. A module menu is built
+    at once only if its toolbar is visible, since the toolbar shares the
+    menu's actions. Every other visible module gets a placeholder in the
+    menu bar; the real menu is built when the user first points at or
+    opens the placeholder, or during idle time after the main window is
+    shown, one module per pass through the event loop. Modules with both
+    the menu and the toolbar hidden are not built at all unless something
+    asks for them, so login time depends on the modules the user works
+    with rather than on all of them. An unbuilt module still gets an empty,
+    hidden toolbar under its toolbar's name, so restoreState() and
+    saveState() keep its saved position until the real one replaces it.
+
+    On later calls, after preferences or privileges change, only the menus
+    that have been built are re-evaluated. The rest pick up the current
+    privileges when they are built.
  */
 void GUIClient::initMenuBar()
 {
@@ -633,98 +734,290 @@ void GUIClient::initMenuBar()
     while(!toolbars.isEmpty())
       delete toolbars.takeFirst();
 
-    _splash->showMessage(tr("Initializing the Products Module"), SplashTextAlignment, SplashTextColor);
-    qApp->processEvents();
-    productsMenu = new menuProducts(this);
+    connect(menuBar(), SIGNAL(hovered(QAction*)), this, SLOT(sMenuBarHovered(QAction*)));
+  }
 
-    _splash->showMessage(tr("Initializing the Inventory Module"), SplashTextAlignment, SplashTextColor);
-    qApp->processEvents();
-    inventoryMenu = new menuInventory(this);
+  for (int m = 0; m < __menuModuleCount; m++)
+  {
+    if (! hasMenuModule(m))
+      continue;
 
-    if(_metrics->value("Application") != "PostBooks")
+    if (_preferences->boolean(__menuModules[m].showToolbar))
+      buildMenuModule(m);
+    else if (! isMenuModuleBuilt(m) && ! _menuStubs.contains(m))
     {
-      _splash->showMessage(tr("Initializing the Scheduling Module"), SplashTextAlignment, SplashTextColor);
-      qApp->processEvents();
-      scheduleMenu = new menuSchedule(this);
+      QMenu *stub = new QMenu(this);
+      stub->setTitle(QCoreApplication::translate(__menuModules[m].context,
+                                                 __menuModules[m].title));
+      connect(stub, SIGNAL(aboutToShow()), this, SLOT(sMenuStubAboutToShow()));
+      menuBar()->addMenu(stub);
+      _menuStubs.insert(m, stub);
+
+      QToolBar *spot = new QToolBar(this);
+      spot->setObjectName(__menuModules[m].toolbar);
+      spot->toggleViewAction()->setVisible(false);
+      spot->hide();
+      addToolBar(spot);
+      _toolbarStubs.insert(m, spot);
     }
+  }
 
-    _splash->showMessage(tr("Initializing the Purchase Module"), SplashTextAlignment, SplashTextColor);
-    qApp->processEvents();
-    purchaseMenu = new menuPurchase(this);
-
-    _splash->showMessage(tr("Initializing the Manufacture Module"), SplashTextAlignment, SplashTextColor);
-    qApp->processEvents();
-    manufactureMenu = new menuManufacture(this);
-
-    _splash->showMessage(tr("Initializing the CRM Module"), SplashTextAlignment, SplashTextColor);
-    qApp->processEvents();
-    crmMenu = new menuCRM(this);
-
-    _splash->showMessage(tr("Initializing the Sales Module"), SplashTextAlignment, SplashTextColor);
-    qApp->processEvents();
-    salesMenu = new menuSales(this);
-
-    _splash->showMessage(tr("Initializing the Accounting Module"), SplashTextAlignment, SplashTextColor);
-    qApp->processEvents();
-    accountingMenu = new menuAccounting(this);
-
+  if (firstRun)
+  {
     windowMenu = new menuWindow(this);
 
     _splash->showMessage(tr("Initializing the System Module"), SplashTextAlignment, SplashTextColor);
     qApp->processEvents();
     systemMenu = new menuSystem(this);
-
   }
 
-  findChild<QMenu*>("menu.prod")->menuAction()->setVisible(_preferences->boolean("ShowPDMenu"));
-  findChild<QMenu*>("menu.im")->menuAction()->setVisible(_preferences->boolean("ShowIMMenu"));
-  if(_metrics->value("Application") != "PostBooks")
+  for (int m = 0; m < __menuModuleCount; m++)
   {
-    findChild<QMenu*>("menu.sched")->menuAction()->setVisible(_preferences->boolean("ShowMSMenu"));
+    if (! hasMenuModule(m))
+      continue;
+
+    bool show = _preferences->boolean(__menuModules[m].showMenu);
+    if (QMenu *menu = findChild<QMenu*>(__menuModules[m].menu))
+      menu->menuAction()->setVisible(show);
+    else if (_menuStubs.contains(m))
+      _menuStubs.value(m)->menuAction()->setVisible(show);
   }
-  findChild<QMenu*>("menu.purch")->menuAction()->setVisible(_preferences->boolean("ShowPOMenu"));
-  findChild<QMenu*>("menu.manu")->menuAction()->setVisible(_preferences->boolean("ShowWOMenu"));
-  findChild<QMenu*>("menu.crm")->menuAction()->setVisible(_preferences->boolean("ShowCRMMenu"));
-  findChild<QMenu*>("menu.sales")->menuAction()->setVisible(_preferences->boolean("ShowSOMenu"));
-  findChild<QMenu*>("menu.accnt")->menuAction()->setVisible(_preferences->boolean("ShowGLMenu"));
 
   // Restore toolbar positions from local machine
   restoreState(xtsettingsValue("MainWindowState", QByteArray()).toByteArray(), 1);
 
   // Set visibility of toolbars based on preferences stored in the database
-  findChild<QToolBar*>("Products Tools")->setVisible(_preferences->boolean("ShowPDToolbar"));
-  findChild<QToolBar*>("Inventory Tools")->setVisible(_preferences->boolean("ShowIMToolbar"));
-  if(_metrics->value("Application") != "PostBooks")
+  for (int m = 0; m < __menuModuleCount; m++)
   {
-    findChild<QToolBar*>("Schedule Tools")->setVisible(_preferences->boolean("ShowMSToolbar"));
+    QToolBar *toolbar = findChild<QToolBar*>(__menuModules[m].toolbar);
+    if (toolbar)
+      toolbar->setVisible(_preferences->boolean(__menuModules[m].showToolbar));
   }
-  findChild<QToolBar*>("Purchase Tools")->setVisible(_preferences->boolean("ShowPOToolbar"));
-  findChild<QToolBar*>("Manufacture Tools")->setVisible(_preferences->boolean("ShowWOToolbar"));
-  findChild<QToolBar*>("CRM Tools")->setVisible(_preferences->boolean("ShowCRMToolbar"));
-  findChild<QToolBar*>("Sales Tools")->setVisible(_preferences->boolean("ShowSOToolbar"));
-  findChild<QToolBar*>("Accounting Tools")->setVisible(_preferences->boolean("ShowGLToolbar"));
+
+  if (_shown)
+    QTimer::singleShot(0, this, SLOT(sPrefetchMenuModules()));
 
   firstRun = false;
   qApp->restoreOverrideCursor();
 }
 
+/** @brief Return whether module pModule belongs in this edition's menu bar.
+  */
+bool GUIClient::hasMenuModule(int pModule) const
+{
+  return __menuModules[pModule].allEditions ||
+         _metrics->value("Application") != "PostBooks";
+}
+
+bool GUIClient::isMenuModuleBuilt(int pModule) const
+{
+  switch (pModule)
+  {
+    case 0: return productsMenu    != 0;
+    case 1: return inventoryMenu   != 0;
+    case 2: return scheduleMenu    != 0;
+    case 3: return purchaseMenu    != 0;
+    case 4: return manufactureMenu != 0;
+    case 5: return crmMenu         != 0;
+    case 6: return salesMenu       != 0;
+    case 7: return accountingMenu  != 0;
+  }
+  return false;
+}
+
+/** @brief Build the menu and toolbar of module pModule if they do not
+           exist yet, putting the menu where its placeholder was.
+    @return the module's top-level menu, or 0 if pModule is not part of
+            this edition
+  */
+QMenu *GUIClient::buildMenuModule(int pModule)
+{
+  if (pModule < 0 || pModule >= __menuModuleCount || ! hasMenuModule(pModule))
+    return 0;
+
+  if (! isMenuModuleBuilt(pModule))
+  {
+    if (DEBUG)
+      qDebug("GUIClient::buildMenuModule(%s)", __menuModules[pModule].menu);
+
+    if (_splash->isVisible())
+    {
+      _splash->showMessage(tr(__menuModules[pModule].splash), SplashTextAlignment, SplashTextColor);
+      qApp->processEvents();
+    }
+
+    // step aside so the module's own toolbar is the one found by name
+    QToolBar *spot = _toolbarStubs.take(pModule);
+    if (spot)
+      spot->setObjectName(QString());
+
+    switch (pModule)
+    {
+      case 0: productsMenu    = new menuProducts(this);    break;
+      case 1: inventoryMenu   = new menuInventory(this);   break;
+      case 2: scheduleMenu    = new menuSchedule(this);    break;
+      case 3: purchaseMenu    = new menuPurchase(this);    break;
+      case 4: manufactureMenu = new menuManufacture(this); break;
+      case 5: crmMenu         = new menuCRM(this);         break;
+      case 6: salesMenu       = new menuSales(this);       break;
+      case 7: accountingMenu  = new menuAccounting(this);  break;
+    }
+
+    QToolBar *toolbar = findChild<QToolBar*>(__menuModules[pModule].toolbar);
+    if (toolbar && spot)
+    {
+      // take over the position restoreState() gave the placeholder
+      if (spot->isFloating())
+        addToolBar(toolBarArea(spot), toolbar);
+      else
+        insertToolBar(spot, toolbar);
+    }
+    if (spot)
+    {
+      removeToolBar(spot);
+      spot->deleteLater();
+    }
+    if (toolbar)
+      toolbar->setVisible(_preferences->boolean(__menuModules[pModule].showToolbar));
+  }
+
+  QMenu *menu = findChild<QMenu*>(__menuModules[pModule].menu);
+  QMenu *stub = _menuStubs.take(pModule);
+  if (stub)
+  {
+    if (menu)
+    {
+      menuBar()->insertAction(stub->menuAction(), menu->menuAction());
+      menu->menuAction()->setVisible(stub->menuAction()->isVisible());
+    }
+    menuBar()->removeAction(stub->menuAction());
+    stub->deleteLater();
+  }
+  return menu;
+}
+
+/** @brief Build the menu with object name pMenuName, e.g. "menu.sales",
+           if it is a module menu that has not been built yet.
+
+    Scripts that look up a module menu by name after startup should call
+    this first.
+  */
+bool GUIClient::buildMenu(const QString &pMenuName)
+{
+  for (int m = 0; m < __menuModuleCount; m++)
+  {
+    if (pMenuName == __menuModules[m].menu)
+      return buildMenuModule(m) != 0;
+  }
+  return findChild<QMenu*>(pMenuName) != 0;
+}
+
+/** @brief Build every module menu for this edition.
+  */
+void GUIClient::buildMenus()
+{
+  for (int m = 0; m < __menuModuleCount; m++)
+    buildMenuModule(m);
+}
+
+/* The user pointed at a placeholder. Build the real menu now so it opens
+   with its contents when clicked.
+ */
+void GUIClient::sMenuBarHovered(QAction *pAction)
+{
+  for (QMap<int, QMenu*>::const_iterator it = _menuStubs.constBegin();
+       it != _menuStubs.constEnd(); ++it)
+  {
+    if (it.value()->menuAction() == pAction)
+    {
+      buildMenuModule(it.key());
+      return;
+    }
+  }
+}
+
+/* A placeholder was opened before it was hovered, from the keyboard or by
+   moving over it while another menu was open. Build the real menu and
+   open it in the placeholder's place.
+ */
+void GUIClient::sMenuStubAboutToShow()
+{
+  QMenu *stub = qobject_cast<QMenu*>(sender());
+  int module = _menuStubs.key(stub, -1);
+  if (module < 0)
+    return;
+
+  if (buildMenuModule(module))
+    QMetaObject::invokeMethod(this, "sOpenMenuModule", Qt::QueuedConnection,
+                              Q_ARG(int, module));
+}
+
+void GUIClient::sOpenMenuModule(int pModule)
+{
+  QMenu *menu = findChild<QMenu*>(__menuModules[pModule].menu);
+  if (menu && menu->menuAction()->isVisible())
+    menuBar()->setActiveAction(menu->menuAction());
+}
+
+/* Build one visible placeholder's menu per pass through the event loop so
+   the menus are ready by the time the user reaches for them without
+   holding up the first paint of the main window. Once they are all built
+   the window pool gets its turn.
+ */
+void GUIClient::sPrefetchMenuModules()
+{
+  for (QMap<int, QMenu*>::const_iterator it = _menuStubs.constBegin();
+       it != _menuStubs.constEnd(); ++it)
+  {
+    if (it.value()->menuAction()->isVisible())
+    {
+      buildMenuModule(it.key());
+      QTimer::singleShot(0, this, SLOT(sPrefetchMenuModules()));
+      return;
+    }
+  }
+  WindowPool::instance()->prewarm();
+}
+
+/** @brief Re-evaluate only the menu actions whose privilege expressions
+           depend on privileges that were just granted or revoked.
+
+    Menus that have not been built yet are skipped; they evaluate the
+    current privileges when they are built.
+  */
+void GUIClient::sPrivilegesChanged(const QBitArray &pChanged)
+{
+  QList<QMenu*> menulist = findChildren<QMenu*>();
+  for(int m = 0; m < menulist.size(); ++m)
+  {
+    QList<QAction*> actionlist = menulist.at(m)->actions();
+    for(int i = 0; i < actionlist.size(); ++i)
+    {
+      QString privs = actionlist.at(i)->data().toString();
+      if (! privs.isEmpty() && privs != "true" && privs != "false" &&
+          _privileges->references(privs, pChanged))
+        __menuEvaluate(actionlist.at(i));
+    }
+  }
+}
+
 /** @brief Save the position and visibility of application toolbars in
            user preferences.
+
+    Toolbars of modules that have not been built keep their saved
+    preference.
   */
 void GUIClient::saveToolbarPositions()
 {
   xtsettingsSetValue("MainWindowState", saveState(1));
 
   // Set preferences base on visibility of toolbars
-  _preferences->set("ShowPDToolbar", findChild<QToolBar*>("Products Tools")->isVisible());
-  _preferences->set("ShowIMToolbar", findChild<QToolBar*>("Inventory Tools")->isVisible());
-  if(_metrics->value("Application") != "PostBooks")
-    _preferences->set("ShowMSToolbar", findChild<QToolBar*>("Schedule Tools")->isVisible());
-  _preferences->set("ShowPOToolbar", findChild<QToolBar*>("Purchase Tools")->isVisible());
-  _preferences->set("ShowWOToolbar", findChild<QToolBar*>("Manufacture Tools")->isVisible());
-  _preferences->set("ShowCRMToolbar", findChild<QToolBar*>("CRM Tools")->isVisible());
-  _preferences->set("ShowSOToolbar", findChild<QToolBar*>("Sales Tools")->isVisible());
-  _preferences->set("ShowGLToolbar", findChild<QToolBar*>("Accounting Tools")->isVisible());
+  for (int m = 0; m < __menuModuleCount; m++)
+  {
+    QToolBar *toolbar = findChild<QToolBar*>(__menuModules[m].toolbar);
+    if (toolbar && isMenuModuleBuilt(m))
+      _preferences->set(__menuModules[m].showToolbar, toolbar->isVisible());
+  }
 }
 
 /** @brief Save information about the current state of the application
@@ -799,6 +1092,8 @@ void GUIClient::showEvent(QShowEvent *event)
         QString script = sq.value("script_source").toString();
         if(!engine)
         {
+          // initMenu scripts find the module menus by name
+          buildMenus();
           engine = new QScriptEngine(this);
           if (_preferences->boolean("EnableScriptDebug"))
           {
@@ -844,6 +1139,8 @@ void GUIClient::showEvent(QShowEvent *event)
         }
       }
     // END script code
+
+    QTimer::singleShot(0, this, SLOT(sPrefetchMenuModules()));
   }
 
   QMainWindow::showEvent(event);
@@ -2377,11 +2674,58 @@ void GUIClient::handleDocument(QString path)
     Load the dictionary for the user's current language and
     the user's personal additions.
  */
+/* Reads the spelling dictionary on a worker thread so the menus can be
+   built while it loads. GUIClient::hunspell_wait() collects the result.
+ */
+class SpellLoadJob : public QRunnable
+{
+  public:
+    SpellLoadJob(const QString &pPathWithoutExt)
+      : _checker(0),
+        _done(false),
+        _path(pPathWithoutExt)
+    {
+      setAutoDelete(false);
+    }
+
+    virtual void run()
+    {
+      Hunspell *checker = new Hunspell(_path.toLatin1() + ".aff",
+                                       _path.toLatin1() + ".dic");
+      QFile file(QDir::homePath() + "/xTuple/user.dic");
+      if (file.exists())
+      {
+        if (DEBUG) qDebug() << "loading" << file.fileName();
+        checker->add_dic(file.fileName().toLatin1());
+      }
+
+      QMutexLocker locker(&_lock);
+      _checker = checker;
+      _done    = true;
+      _finished.wakeAll();
+    }
+
+    Hunspell *wait()
+    {
+      QMutexLocker locker(&_lock);
+      while (! _done)
+        _finished.wait(&_lock);
+      return _checker;
+    }
+
+  protected:
+    Hunspell       *_checker;
+    bool            _done;
+    QWaitCondition  _finished;
+    QMutex          _lock;
+    QString         _path;
+};
+
 void GUIClient::hunspell_initialize()
 {
   // TODO: handle user changing languages
   QString appPath, fullPathWithoutExt;
-  if (! _spellChecker)
+  if (! _spellChecker && ! _spellLoader)
   {
     QStringList filename;
     filename << QLocale::languageToString(QLocale().language()) // eg English
@@ -2421,24 +2765,32 @@ void GUIClient::hunspell_initialize()
                              .arg(filename.join("</li><li> "), dirname.join("</li><li>")));
     } else {
       if (DEBUG) qDebug() << "loading" << appPath;
-      _spellChecker = new Hunspell(fullPathWithoutExt.toLatin1() + ".aff",
-                                   fullPathWithoutExt.toLatin1() + ".dic");
-
-      QString spell_encoding = QString(_spellChecker->get_dic_encoding());
-      _spellCodec = QTextCodec::codecForName(spell_encoding.toLocal8Bit());
-
-      QFile file(QDir::homePath() + "/xTuple/user.dic");
-      if (file.exists())
-      {
-        if (DEBUG) qDebug() << "loading" << file.fileName();
-        _spellChecker->add_dic(file.fileName().toLatin1());
-      }
+      _spellLoader = new SpellLoadJob(fullPathWithoutExt);
+      QThreadPool::globalInstance()->start(_spellLoader);
     }
   }
 }
 
+/* Finish loading the spelling dictionary if it is still being read.
+ */
+void GUIClient::hunspell_wait()
+{
+  if (! _spellLoader)
+    return;
+
+  _spellChecker = _spellLoader->wait();
+  delete _spellLoader;
+  _spellLoader = 0;
+
+  QString spell_encoding = QString(_spellChecker->get_dic_encoding());
+  _spellCodec = QTextCodec::codecForName(spell_encoding.toLocal8Bit());
+  SessionBootstrap::mark("spelling dictionary");
+}
+
 void GUIClient::hunspell_uninitialize()
 {
+    hunspell_wait();
+
     QString homePath = QDir::homePath().toLatin1();
     QFile file(homePath + tr("/xTuple/user.dic"));
 
@@ -2488,11 +2840,13 @@ void GUIClient::hunspell_uninitialize()
 
 bool GUIClient::hunspell_ready()
 {
+  hunspell_wait();
   return (_spellChecker != 0);
 }
 
 int GUIClient::hunspell_check(const QString word)
 {
+  hunspell_wait();
   QByteArray encodedString = _spellCodec->fromUnicode(word);
   return _spellChecker->spell(encodedString.data());
 }
@@ -2501,6 +2855,7 @@ const QStringList GUIClient::hunspell_suggest(const QString word)
 {
     char **wlst;
     QStringList wordList;
+    hunspell_wait();
     QByteArray encodedString = _spellCodec->fromUnicode(word);
     if(_spellChecker->spell(encodedString.data()) < 1)
     {
@@ -2517,6 +2872,7 @@ const QStringList GUIClient::hunspell_suggest(const QString word)
 
 int GUIClient::hunspell_add(const QString word)
 {
+    hunspell_wait();
     QByteArray encodedString = _spellCodec->fromUnicode(word);
     //check if word has been added before
     if(!_spellAddWords.contains(encodedString.data()))
@@ -2526,6 +2882,7 @@ int GUIClient::hunspell_add(const QString word)
 
 int GUIClient::hunspell_ignore(const QString word)
 {
+    hunspell_wait();
     QByteArray encodedString = _spellCodec->fromUnicode(word);
     return _spellChecker->add(encodedString.data());
 }
@@ -55,6 +55,7 @@ class menuSystem;
 class TimeoutHandler;
 class InputManager;
 class ReportHandler;
+class SpellLoadJob;
 
 class XMainWindow;
 class XWidget;
@@ -215,6 +216,8 @@ class GUIClient : public QMainWindow
     Q_INVOKABLE bool singleCurrency();
     Q_INVOKABLE QWidgetList windowList();
     Q_INVOKABLE void populateCustomMenu(QMenu*, const QString &);
+    Q_INVOKABLE bool buildMenu(const QString &);
+    Q_INVOKABLE void buildMenus();
 
     Q_INVOKABLE void handleNewWindow(QWidget *, Qt::WindowModality = Qt::NonModal, bool forceFloat = false);
     Q_INVOKABLE QMenuBar *menuBar();
@@ -293,6 +296,7 @@ class GUIClient : public QMainWindow
     void sItemsUpdated(int, bool);
     void sItemsitesUpdated();
     void sPaymentsUpdated(int, int, bool);
+    void sPrivilegesChanged(const QBitArray &);
     void sProjectsUpdated(int);
     void sProspectsUpdated();
     void sPurchaseOrderReceiptsUpdated();
@@ -408,6 +412,11 @@ class GUIClient : public QMainWindow
   private slots:
     void handleDocument(QString path);
     void hunspell_uninitialize();
+    void hunspell_wait();
+    void sMenuBarHovered(QAction *);
+    void sMenuStubAboutToShow();
+    void sOpenMenuModule(int);
+    void sPrefetchMenuModules();
 
   private:
     QMdiArea   *_workspace;
@@ -432,6 +441,12 @@ class GUIClient : public QMainWindow
     menuAccounting  *accountingMenu;
     menuWindow      *windowMenu;
     menuSystem      *systemMenu;
+    QMap<int, QMenu*>    _menuStubs;
+    QMap<int, QToolBar*> _toolbarStubs;
+
+    QMenu *buildMenuModule(int);
+    bool   hasMenuModule(int)     const;
+    bool   isMenuModuleBuilt(int) const;
 
     QDate _startOfTime;
     QDate _endOfTime;
@@ -463,6 +478,7 @@ class GUIClient : public QMainWindow
     QMap<QString, int>  _fileMap;
     QTextCodec *_spellCodec;
     Hunspell   *_spellChecker;
+    SpellLoadJob *_spellLoader;
     QStringList _spellAddWords;
 
     QMenu *_menu;
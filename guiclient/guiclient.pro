@@ -1085,6 +1085,7 @@ HEADERS = ../common/format.h                    \
           purgeInvoices.h               \
           purgePostedCountSlips.h       \
           purgePostedCounts.h           \
+          queryProfilerView.h           \
           quickRelocateLot.h            \
           quotes.h                      \
           reasonCode.h                  \
@@ -1150,6 +1151,7 @@ HEADERS = ../common/format.h                    \
           selectPayments.h                      \
           selectShippedOrders.h                 \
           selectedPayments.h                    \
+          sessionBootstrap.h                    \
           setup.h                               \
           shipOrder.h                           \
           shipTo.h                              \
@@ -1206,6 +1208,7 @@ HEADERS = ../common/format.h                    \
           terms.h                       \
           termses.h                     \
           thawItemSitesByClassCode.h    \
+          timePhasedAggregator.h        \
           timeoutHandler.h              \
           taskCalendarControl.h         \
           taskList.h                    \
@@ -1270,6 +1273,7 @@ HEADERS = ../common/format.h                    \
           warehouse.h                   \
           warehouseZone.h               \
           warehouses.h                  \
+          windowPool.h                  \
           woMaterialItem.h              \
           workOrder.h                   \
           workOrderMaterials.h          \
@@ -1707,6 +1711,7 @@ SOURCES = absoluteCalendarItem.cpp              \
           purgeInvoices.cpp                     \
           purgePostedCountSlips.cpp             \
           purgePostedCounts.cpp                 \
+          queryProfilerView.cpp                 \
           quickRelocateLot.cpp                  \
           quotes.cpp                            \
           reasonCode.cpp                        \
@@ -1772,6 +1777,7 @@ SOURCES = absoluteCalendarItem.cpp              \
           selectPayments.cpp                    \
           selectShippedOrders.cpp               \
           selectedPayments.cpp                  \
+          sessionBootstrap.cpp                  \
           setup.cpp                             \
           shipOrder.cpp                         \
           shipTo.cpp                            \
@@ -1828,6 +1834,7 @@ SOURCES = absoluteCalendarItem.cpp              \
           terms.cpp                             \
           termses.cpp                           \
           thawItemSitesByClassCode.cpp          \
+          timePhasedAggregator.cpp              \
           timeoutHandler.cpp                    \
           taskCalendarControl.cpp               \
           taskList.cpp                          \
@@ -1892,6 +1899,7 @@ SOURCES = absoluteCalendarItem.cpp              \
           warehouse.cpp                         \
           warehouseZone.cpp                     \
           warehouses.cpp                        \
+          windowPool.cpp                        \
           woMaterialItem.cpp                    \
           workOrder.cpp                         \
           workOrderMaterials.cpp                \
@@ -17,12 +17,15 @@
 
 #include "configureIE.h"
 #include "importhelper.h"
+#include "importscheduler.h"
 #include "storedProcErrorLookup.h"
 #include "errorReporter.h"
 
 #define DEBUG false
 
-enum ImportFileType { Unknown = -1, Csv, Xml };
+enum ImportFileType { Unknown = ImportScheduler::Unknown,
+                      Csv     = ImportScheduler::Csv,
+                      Xml     = ImportScheduler::Xml };
 
 bool importData::userHasPriv()
 {
@@ -63,6 +66,7 @@ importData::importData(QWidget* parent, const char * name, Qt::WindowFlags fl)
   setupUi(this);
 
   connect(_add,            SIGNAL(clicked()), this, SLOT(sAdd()));
+  connect(_autoImport,  SIGNAL(toggled(bool)), this, SLOT(sHandleAutoImport(bool)));
   connect(_autoUpdate,  SIGNAL(toggled(bool)), this, SLOT(sHandleAutoUpdate(bool)));
   connect(_clearStatus,    SIGNAL(clicked()), this, SLOT(sClearStatus()));
   connect(_delete,         SIGNAL(clicked()), this, SLOT(sDelete()));
@@ -70,6 +74,7 @@ importData::importData(QWidget* parent, const char * name, Qt::WindowFlags fl)
   connect(_importAll,      SIGNAL(clicked()), this, SLOT(sImportAll()));
   connect(_importSelected, SIGNAL(clicked()), this, SLOT(sImportSelected()));
   connect(_resetList,      SIGNAL(clicked()), this, SLOT(sFillList()));
+  connect(_retryErrors,    SIGNAL(clicked()), this, SLOT(sRetryErrors()));
 
   _file->addColumn(tr("Type"),          -1, Qt::AlignLeft,  false, "type");
   _file->addColumn(tr("File Name"),     -1, Qt::AlignLeft,  true,  "filename");
@@ -87,8 +92,23 @@ importData::importData(QWidget* parent, const char * name, Qt::WindowFlags fl)
   if (_defaultDir.isEmpty())
     _defaultDir = ".";
 
+  QStringList filters;
+  filters << "*.xml" << "*.XML";
+  if (ImportHelper::getCSVImpPlugin(omfgThis))
+    filters << "*.csv" << "*.CSV" << "*.tsv" << "*.TSV";
+
+  _scheduler = new ImportScheduler(this);
+  _scheduler->setDirectory(_defaultDir);
+  _scheduler->setNameFilters(filters);
+  connect(_scheduler, SIGNAL(fileFound(QString, int)), this, SLOT(sFileFound(QString, int)));
+  connect(_scheduler, SIGNAL(finished()),              this, SLOT(sSchedulerFinished()));
+  connect(_scheduler, SIGNAL(statisticsChanged()),     this, SLOT(sStatisticsChanged()));
+  connect(_scheduler, SIGNAL(statusChanged(QString, int, QString)),
+          this,       SLOT(sStatusChanged(QString, int, QString)));
+
   sFillList();
   sHandleAutoUpdate(_autoUpdate->isChecked());
+  sHandleAutoImport(_autoImport->isChecked());
 }
 
 importData::~importData()
@@ -106,27 +126,65 @@ void importData::sFillList()
   _file->clear();
   if (! _defaultDir.isEmpty())
   {
-    QStringList filters;
-    filters << "*.xml" << "*.XML";
-    if (ImportHelper::getCSVImpPlugin(omfgThis))
-      filters << "*.csv" << "*.CSV" << "*.tsv" << "*.TSV";
-
-    QDirIterator iterator(_defaultDir, filters);
-    XTreeWidgetItem *last = 0;
-    for (int i = 0; iterator.hasNext(); i++)
+    QDirIterator iterator(_defaultDir, _scheduler->nameFilters());
+    while (iterator.hasNext())
     {
       QString filename = iterator.next();
-      ImportFileType type = Unknown;
-      QString suffix = QFileInfo(filename).suffix().toUpper();
-      if (suffix == "XML")
-        type = Xml;
-      else if (suffix == "CSV" || suffix == "TSV")
-        type = Csv;
-      last = new XTreeWidgetItem(_file, last, type, i, QVariant(suffix), QVariant(filename));
+      addFile(filename, ImportScheduler::fileType(filename));
     }
   }
 }
 
+void importData::sFileFound(const QString &pFileName, int pType)
+{
+  addFile(pFileName, pType);
+}
+
+XTreeWidgetItem *importData::addFile(const QString &pFileName, int pType)
+{
+  XTreeWidgetItem *item = findFile(pFileName);
+  if (item)
+    return item;
+
+  int last = _file->topLevelItemCount() - 1;
+  item = new XTreeWidgetItem(_file, last < 0 ? 0 : _file->topLevelItem(last),
+                             pType, last + 1,
+                             QVariant(QFileInfo(pFileName).suffix().toUpper()),
+                             QVariant(pFileName));
+
+  int status = _scheduler->status(pFileName);
+  if (status >= 0)
+  {
+    item->setText(_file->column("status"), statusText(status));
+    item->setToolTip(_file->column("status"), _scheduler->message(pFileName));
+  }
+  return item;
+}
+
+XTreeWidgetItem *importData::findFile(const QString &pFileName)
+{
+  for (int i = 0; i < _file->topLevelItemCount(); i++)
+  {
+    XTreeWidgetItem *item = _file->topLevelItem(i);
+    if (item->text("filename") == pFileName)
+      return item;
+  }
+  return 0;
+}
+
+QString importData::statusText(int pStatus)
+{
+  switch (pStatus)
+  {
+    case ImportScheduler::Queued:  return tr("Queued");
+    case ImportScheduler::Running: return tr("Importing");
+    case ImportScheduler::Done:    return tr("Done");
+    case ImportScheduler::Warning: return tr("Warning");
+    case ImportScheduler::Error:   return tr("Error");
+  }
+  return QString();
+}
+
 void importData::sAdd()
 {
   QFileDialog newdlg(this, tr("Select File(s) to Import"), _defaultDir);
@@ -141,18 +199,8 @@ void importData::sAdd()
   if (newdlg.exec())
   {
     QStringList files = newdlg.selectedFiles();
-    XTreeWidgetItem *last = 0;
     for (int i = 0; i < files.size(); i++)
-    {
-      ImportFileType type = Unknown;
-      QString suffix = QFileInfo(files[i]).suffix().toUpper();
-      if (suffix == "XML")
-        type = Xml;
-      else if (suffix == "CSV" || suffix == "TSV")
-        type = Csv;
-
-      last = new XTreeWidgetItem(_file, last, type, i, QVariant(suffix), QVariant(files[i]));
-    }
+      addFile(files[i], ImportScheduler::fileType(files[i]));
   }
 }
 
@@ -160,7 +208,14 @@ void importData::sClearStatus()
 {
   QList<XTreeWidgetItem*> selected = _file->selectedItems();
   for (int i = selected.size() - 1; i >= 0; i--)
+  {
+    int status = _scheduler->status(selected[i]->text("filename"));
+    if (status == ImportScheduler::Queued || status == ImportScheduler::Running)
+      continue;
+    _scheduler->forget(selected[i]->text("filename"));
     selected[i]->setText(_file->column("status"), "");
+    selected[i]->setToolTip(_file->column("status"), QString());
+  }
 }
 
 void importData::sDelete()
@@ -175,54 +230,47 @@ void importData::sPopulateMenu(QMenu* pMenu, QTreeWidgetItem* /* pItem */)
   //QAction *menuItem;
 
   (void)pMenu->addAction(tr("Import Selected"),  this, SLOT(sImportSelected()));
+  (void)pMenu->addAction(tr("Retry Errors"),     this, SLOT(sRetryErrors()));
   (void)pMenu->addAction(tr("Clear Status"),     this, SLOT(sClearStatus()));
   (void)pMenu->addAction(tr("Delete From List"), this, SLOT(sDelete()));
 }
 
 void importData::sImportAll()
 {
-  bool oldAutoUpdate = _autoUpdate->isChecked();
-  sHandleAutoUpdate(false);
   for (int i = 0; i < _file->topLevelItemCount(); i++)
   {
     XTreeWidgetItem* pItem = _file->topLevelItem(i);
     if (pItem->text("status").isEmpty())
-    {
-      if (importOne(pItem->text("filename"), pItem->id()))
-        pItem->setText(_file->column("status"), tr("Done"));
-      else
-        pItem->setText(_file->column("status"), tr("Error"));
-    }
+      importOne(pItem);
   }
-  if (oldAutoUpdate)
-    sHandleAutoUpdate(true);
 }
 
 void importData::sImportSelected()
 {
-  bool oldAutoUpdate = _autoUpdate->isChecked();
-  sHandleAutoUpdate(false);
   QList<XTreeWidgetItem*> selected = _file->selectedItems();
   for (int i = 0; i < selected.size(); i++)
   {
     if (selected[i]->text("status").isEmpty())
-    {
-      if (importOne(selected[i]->text("filename"), selected[i]->id()))
-        selected[i]->setText(_file->column("status"), tr("Done"));
-      else
-        selected[i]->setText(_file->column("status"), tr("Error"));
-    }
+      importOne(selected[i]);
   }
-  if (oldAutoUpdate)
-    sHandleAutoUpdate(true);
 }
 
-bool importData::importOne(const QString &pFileName, int pType)
+void importData::sRetryErrors()
 {
-  if (DEBUG)
-    qDebug("importData::importOne(%s, %d)", qPrintable(pFileName), pType);
+  _scheduler->retryErrors();
+}
+
+/* Work out the file type, asking the user if the name doesn't tell us,
+   then hand the file to the scheduler. The import itself happens later,
+   off the GUI thread, and reports back through sStatusChanged().
+ */
+bool importData::importOne(XTreeWidgetItem *pItem)
+{
+  QString pFileName = pItem->text("filename");
+  int     filetype  = pItem->id();
 
-  int filetype = pType;
+  if (DEBUG)
+    qDebug("importData::importOne(%s, %d)", qPrintable(pFileName), filetype);
 
   if (filetype == Unknown)
   {
@@ -260,41 +308,56 @@ bool importData::importOne(const QString &pFileName, int pType)
       return false;
   }
 
-  QString errmsg;
-  QString warnmsg;
-  if (filetype == Xml || QFileInfo(pFileName).suffix().toUpper() == "XML")
-  {
-    if (! ImportHelper::importXML(pFileName, errmsg, warnmsg))
-    {
-      ErrorReporter::error(QtCriticalMsg, this, tr("XML Import Error"),
-                           tr("%1: %2 ").arg(windowTitle(),errmsg),__FILE__,__LINE__);
-      return false;
-    }
-    else if (! warnmsg.isEmpty())
-    {
-      QMessageBox::warning(this, tr("XML Import Warnings"), warnmsg);
-      return true;
-    }
-  }
-  else if (filetype == Csv ||
-           QFileInfo(pFileName).suffix().toUpper() == "CSV" ||
-           QFileInfo(pFileName).suffix().toUpper() == "TSV")
+  return _scheduler->enqueue(pFileName, filetype);
+}
+
+void importData::sStatusChanged(const QString &pFileName, int pStatus, const QString &pMessage)
+{
+  XTreeWidgetItem *item = findFile(pFileName);
+  if (item)
   {
-    if (! ImportHelper::importCSV(pFileName, errmsg))
-    {
-      ErrorReporter::error(QtCriticalMsg, this, tr("CSV Import Error"),
-                           tr("%1: %2 ").arg(windowTitle(),errmsg),__FILE__,__LINE__);
-      return false;
-    }
+    item->setText(_file->column("status"), statusText(pStatus));
+    item->setToolTip(_file->column("status"), pMessage);
   }
 
-  return true;
+  if (pStatus == ImportScheduler::Error)
+    _batchErrors.append(tr("%1: %2").arg(pFileName, pMessage));
+  else if (pStatus == ImportScheduler::Warning)
+    _batchWarnings.append(tr("%1: %2").arg(pFileName, pMessage));
+}
+
+void importData::sStatisticsChanged()
+{
+  _stats->setText(tr("%1 done, %2 errors, %3 waiting, %4 files/min")
+                  .arg(_scheduler->doneCount())
+                  .arg(_scheduler->errorCount())
+                  .arg(_scheduler->pendingCount())
+                  .arg(_scheduler->filesPerMinute(), 0, 'f', 1));
 }
 
+// report problems once per batch instead of interrupting every file
+void importData::sSchedulerFinished()
+{
+  if (! _batchErrors.isEmpty())
+    ErrorReporter::error(QtCriticalMsg, this, tr("Import Error"),
+                         tr("%1: %2 ").arg(windowTitle(), _batchErrors.join("\n")),
+                         __FILE__, __LINE__);
+  else if (! _batchWarnings.isEmpty())
+    QMessageBox::warning(this, tr("Import Warnings"), _batchWarnings.join("\n"));
+
+  _batchErrors.clear();
+  _batchWarnings.clear();
+}
+
+// keep the file list current; importing what appears is a separate choice
 void importData::sHandleAutoUpdate(const bool pAutoUpdate)
 {
-  if (pAutoUpdate)
-    connect(omfgThis, SIGNAL(tick()), this, SLOT(sFillList()));
-  else
-    disconnect(omfgThis, SIGNAL(tick()), this, SLOT(sFillList()));
+  _scheduler->setWatching(pAutoUpdate);
+  _autoImport->setEnabled(pAutoUpdate);
+  sHandleAutoImport(_autoImport->isChecked());
+}
+
+void importData::sHandleAutoImport(const bool pAutoImport)
+{
+  _scheduler->setAutoImport(pAutoImport && _autoUpdate->isChecked());
 }
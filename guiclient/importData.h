@@ -17,6 +17,8 @@
 
 #include "ui_importData.h"
 
+class ImportScheduler;
+
 class importData : public XWidget, public Ui::importData
 {
   Q_OBJECT
@@ -35,15 +37,27 @@ class importData : public XWidget, public Ui::importData
     virtual void sAdd();
     virtual void sClearStatus();
     virtual void sDelete();
+    virtual void sFileFound(const QString &, int);
     virtual void sFillList();
+    virtual void sHandleAutoImport(const bool);
     virtual void sHandleAutoUpdate(const bool);
     virtual void sImportAll();
     virtual void sImportSelected();
     virtual void sPopulateMenu(QMenu*, QTreeWidgetItem*);
+    virtual void sRetryErrors();
+    virtual void sSchedulerFinished();
+    virtual void sStatisticsChanged();
+    virtual void sStatusChanged(const QString &, int, const QString &);
 
   private:
+    QStringList	_batchErrors;
+    QStringList	_batchWarnings;
     QString	_defaultDir;
-    bool	importOne(const QString &, const int pType = -1);
+    ImportScheduler *_scheduler;
+    XTreeWidgetItem *addFile(const QString &, int pType);
+    XTreeWidgetItem *findFile(const QString &);
+    bool	importOne(XTreeWidgetItem *);
+    QString	statusText(int);
 };
 
 #endif
@@ -16,6 +16,7 @@
 #include <QSqlError>
 #include <QScriptEngine>
 #include <QScriptValue>
+#include <QTimer>
 
 #include <xsqlquery.h>
 
@@ -94,6 +95,11 @@ InputManagerPrivate::InputManagerPrivate(InputManager *parent)
     _state(cIdle),
     _event(0)
 {
+  _resolveTimer = new QTimer(this);
+  _resolveTimer->setSingleShot(true);
+  _resolveTimer->setInterval(0);
+  connect(_resolveTimer, SIGNAL(timeout()), this, SLOT(sResolveNext()));
+
   if (eventList.isEmpty())
   {
     // MUST BE CAREFUL HERE. e.g. POXX and POLI must take pohead_number = :f1 and return pohead_id as id
@@ -129,6 +135,18 @@ ReceiverItem InputManagerPrivate::findReceiver(int pMask)
   return ReceiverItem();
 }
 
+/* find a receiver for pMask registered by pTarget or its window
+ */
+ReceiverItem InputManagerPrivate::findReceiver(int pMask, QObject *pTarget)
+{
+  for (int counter = 0; counter < _receivers.count(); counter++)
+    if ((_receivers[counter].type() & pMask) &&
+        (_receivers[counter].target() == pTarget ||
+         _receivers[counter].parent() == pTarget))
+      return _receivers[counter];
+  return ReceiverItem();
+}
+
 void InputManagerPrivate::addToEventList(QString prefix, int type, int length1, int length2, int length3, QString descrip, QString query) {
   if (! eventList.contains(prefix))
     eventList.insert(prefix, new ScanEvent(type, prefix, length1, length2, length3, descrip, query));
@@ -161,6 +179,41 @@ QString InputManager::slotName(const QString &slotname)
   return QString("1") + slotname;
 }
 
+/** \brief Send every scan to pTarget until endBurst() is called.
+
+    Scans that pTarget, or a widget that pTarget registered with notify(),
+    can receive go to it even if another window registers for the same
+    kind of scan in the meantime, for example a dialog opened by pTarget's
+    slot. Scans are queued as fast as the scanner sends them and looked up
+    in the order they were scanned.
+ */
+void InputManager::beginBurst(QObject *pTarget)
+{
+  if (DEBUG) qDebug() << "InputManager::beginBurst() entered" << pTarget;
+  _private->_burstTarget = pTarget;
+}
+
+/** \brief Stop sending scans to the burst target. Scans already queued
+           are still delivered to it.
+ */
+void InputManager::endBurst()
+{
+  if (DEBUG) qDebug() << "InputManager::endBurst() entered" << _private->_scans.size();
+  _private->_burstTarget = 0;
+}
+
+bool InputManager::inBurst() const
+{
+  return ! _private->_burstTarget.isNull();
+}
+
+/** \brief Return the number of complete scans waiting to be looked up.
+ */
+int InputManager::pendingScans() const
+{
+  return _private->_scans.size();
+}
+
 void InputManager::sRemove(QObject *pTarget)
 {
   if (DEBUG) qDebug() << "InputManager::sRemove() entered" << pTarget;
@@ -341,7 +394,7 @@ bool InputManager::eventFilter(QObject *, QEvent *pEvent)
             case cBCUPCCode:
             case cBCLocationIssue:
             case cBCLocationContents:
-              _private->dispatchScan(_private->_event->type);
+              _private->queueScan(_private->_event->type);
               // FALLTHROUGH
 
             default:
@@ -411,79 +464,141 @@ QString InputManagerPrivate::queryFieldName(int barcodeType, int receiverType)
   return result;
 }
 
-void InputManagerPrivate::dispatchScan(int type)
+/* Take the scan just decoded off the key stream and queue it for lookup.
+   Decoding the next scan never waits for the database; the lookups run
+   from the event loop one at a time, in the order the scans arrived.
+ */
+void InputManagerPrivate::queueScan(int type)
 {
+  if (DEBUG)
+    qDebug("queueScan(%d) entered", type);
+
+  ScanRequest scan;
+  scan.event = _event;
+  if (_burstTarget)
+    scan.receiver = findReceiver(type, _burstTarget);
+  if (scan.receiver.isNull())
+    scan.receiver = findReceiver(type);
+  if (scan.receiver.isNull())
+    return;
+  scan.target = scan.receiver.target();
+
+  scan.number    = _buffer.left(_length1);
+  scan.subNumber = _buffer.mid(_length1, _length2);
+  scan.seqNumber = _buffer.right(_length3);
+  if (DEBUG)
+    qDebug() << "queueScan:" << _length1 << _length2 << _length3
+             << scan.number << scan.subNumber << scan.seqNumber;
+
+  // TODO: can we remove this special-casing for kit sales order items?
+  if (type & cBCSalesOrderLineItem) {
+    int subsep = scan.subNumber.indexOf(".");
+    if (subsep >= 0)
+    {
+      scan.subNumber = scan.subNumber.left(subsep);
+      scan.seqNumber = scan.subNumber.right(scan.subNumber.length() - (subsep + 1));
+    }
+    if (scan.seqNumber.isEmpty())
+      scan.seqNumber = "0";
+  }
+
+  if (_length3 > 0)
+    scan.descrip = _event->descrip.arg(scan.number, scan.subNumber, scan.seqNumber);
+  else if (_length2 > 0)
+    scan.descrip = _event->descrip.arg(scan.number, scan.subNumber);
+  else
+    scan.descrip = _event->descrip.arg(scan.number);
+
+  _scans.enqueue(scan);
+  if (! _resolveTimer->isActive())
+    _resolveTimer->start();
+}
+
+/* Look up the oldest queued scan, then come back for the next one after
+   the event loop has had a chance to decode more keystrokes.
+ */
+void InputManagerPrivate::sResolveNext()
+{
+  if (_scans.isEmpty())
+    return;
+
+  dispatchScan(_scans.dequeue());
+
+  if (! _scans.isEmpty())
+    _resolveTimer->start();
+}
+
+void InputManagerPrivate::dispatchScan(const ScanRequest &scan)
+{
+  int          type     = scan.event->type;
+  ReceiverItem receiver = scan.receiver;
   if (DEBUG)
     qDebug("dispatchScan(%d) entered", type);
-  ReceiverItem receiver = findReceiver(type);
-  if (! receiver.isNull())
+  if (scan.target.isNull())
   {
     if (DEBUG)
-      qDebug() << "dispatchScan() receiver:"     << receiver.type()
-               << receiver.parent()      << "->" << receiver.target()
-               << "[" << receiver.slot() << "]"  << receiver.isNull();
+      qDebug() << "dispatchScan() receiver is gone:" << scan.descrip;
+    return;
+  }
 
-    QString number    = _buffer.left(_length1);
-    QString subNumber = _buffer.mid(_length1, _length2);
-    QString seqNumber = _buffer.right(_length3);
-    if (DEBUG)
-      qDebug() << "dispatchScan:" << _length1 << _length2 << _length3 << number << subNumber << seqNumber;
-
-    // TODO: can we remove this special-casing for kit sales order items?
-    if (type & cBCSalesOrderLineItem) {
-      int subsep = subNumber.indexOf(".");
-      if (subsep >= 0)
-      {
-        subNumber = subNumber.left(subsep);
-        seqNumber = subNumber.right(subNumber.length() - (subsep + 1));
-      }
-      if (seqNumber.isEmpty())
-        seqNumber = "0";
+  if (DEBUG)
+    qDebug() << "dispatchScan() receiver:"     << receiver.type()
+             << receiver.parent()      << "->" << receiver.target()
+             << "[" << receiver.slot() << "]"  << receiver.isNull();
+
+  // each kind of scan keeps its statement prepared for the whole session
+  XSqlQuery q;
+  if (_statements.contains(type))
+    q = _statements.value(type);
+  else
+  {
+    q.prepare(scan.event->query);
+    if (q.lastError().type() != QSqlError::NoError)
+    {
+      message(tr("Error Scanning %1: %2").arg(scan.descrip, q.lastError().text()), 1000);
+      return;
     }
+    _statements.insert(type, q);
+  }
+  q.bindValue(":f1", scan.number);
+  q.bindValue(":f2", scan.subNumber);
+  q.bindValue(":f3", scan.seqNumber);
+  q.exec();
+  if (q.first())
+  {
+    message(tr("Scanned %1").arg(scan.descrip), 1000);
+
+    QString fieldName = queryFieldName(type, receiver.type());
 
-    QString descrip;
-    if (_length3 > 0)
-      descrip = _event->descrip.arg(number, subNumber, seqNumber);
-    else if (_length2 > 0)
-      descrip = _event->descrip.arg(number, subNumber);
-    else
-      descrip = _event->descrip.arg(number);
-
-    XSqlQuery q;
-    q.prepare(_event->query);
-    q.bindValue(":f1", number);
-    q.bindValue(":f2", subNumber);
-    q.bindValue(":f3", seqNumber);
-    q.exec();
-    if (q.first())
+    if (fieldName.isEmpty())
     {
-      message(tr("Scanned %1").arg(descrip), 1000);
-
-      QString fieldName = queryFieldName(type, receiver.type());
-
-      if (fieldName.isEmpty())
-      {
-        message(tr("Don't know how to send %1 (barcode %2, receiver %3)")
-                .arg(descrip).arg(type, receiver.type()));
-        return;
-      }
-
-      int id = q.value(fieldName).toInt();
-      QGenericArgument idArg = Q_ARG(int, id);
-      // convert "1methodName(args)(stuff)" to just "methodName"
-      QString methodName = receiver.slot();
-      methodName.replace(QRegExp("^1([a-z][a-z0-9_]*).*", Qt::CaseInsensitive), "\\1");
-
-      if (DEBUG)
-        qDebug() << receiver.target() << methodName.toLatin1().data() << id;
-      (void)QMetaObject::invokeMethod(receiver.target(),
-                                      methodName.toLatin1().data(), idArg);
-      emit gotBarCode(type, id);
+      message(tr("Don't know how to send %1 (barcode %2, receiver %3)")
+              .arg(scan.descrip).arg(type, receiver.type()));
+      return;
     }
-    else if (q.lastError().type() != QSqlError::NoError)
-      message(tr("Error Scanning %1: %2").arg(descrip, q.lastError().text()), 1000);
-    else
-      message(tr("%1 not found").arg(descrip));
+
+    int id = q.value(fieldName).toInt();
+    q.finish();
+    QGenericArgument idArg = Q_ARG(int, id);
+    // convert "1methodName(args)(stuff)" to just "methodName"
+    QString methodName = receiver.slot();
+    methodName.replace(QRegExp("^1([a-z][a-z0-9_]*).*", Qt::CaseInsensitive), "\\1");
+
+    if (DEBUG)
+      qDebug() << receiver.target() << methodName.toLatin1().data() << id;
+    (void)QMetaObject::invokeMethod(receiver.target(),
+                                    methodName.toLatin1().data(), idArg);
+    emit gotBarCode(type, id);
+  }
+  else if (q.lastError().type() != QSqlError::NoError)
+  {
+    message(tr("Error Scanning %1: %2").arg(scan.descrip, q.lastError().text()), 1000);
+    _statements.remove(type);
+  }
+  else
+  {
+    q.finish();
+    message(tr("%1 not found").arg(scan.descrip));
   }
 }
 
@@ -47,6 +47,11 @@ class InputManager : public QObject
     Q_INVOKABLE void notify(int, QObject *, QObject *, const QString &);
     Q_INVOKABLE QString slotName(const QString &);
 
+    Q_INVOKABLE void beginBurst(QObject *);
+    Q_INVOKABLE void endBurst();
+    Q_INVOKABLE bool inBurst() const;
+    Q_INVOKABLE int  pendingScans() const;
+
     void scriptAPI(QScriptEngine *engine, QString globalName);
 
   public slots:
@@ -14,8 +14,13 @@
 #include <QHash>
 #include <QList>
 #include <QObject>
+#include <QPointer>
+#include <QQueue>
+
+#include <xsqlquery.h>
 
 class InputManager;
+class QTimer;
 class ScanEvent;
 
 class ReceiverItem
@@ -39,6 +44,22 @@ class ReceiverItem
     bool    _null;
 };
 
+/* A complete scan waiting to be looked up. The receiver is chosen when
+   the scan finishes so a window opened while earlier scans are still
+   being looked up does not take scans meant for the one the user saw.
+ */
+class ScanRequest
+{
+  public:
+    ScanEvent         *event;
+    QString            number;
+    QString            subNumber;
+    QString            seqNumber;
+    QString            descrip;
+    ReceiverItem       receiver;
+    QPointer<QObject>  target;
+};
+
 class InputManagerPrivate : public QObject
 {
   Q_OBJECT
@@ -58,12 +79,22 @@ class InputManagerPrivate : public QObject
     int                 _length3;
     QString             _buffer;
 
-    void dispatchScan(int type);
+    QPointer<QObject>       _burstTarget;
+    QQueue<ScanRequest>     _scans;
+    QHash<int, XSqlQuery>   _statements;
+    QTimer                 *_resolveTimer;
+
+    void queueScan(int type);
+    void dispatchScan(const ScanRequest &scan);
 
     void         addToEventList(QString prefix, int type, int length1, int length2, int length3, QString descrip, QString query);
     ReceiverItem findReceiver(int pMask);
+    ReceiverItem findReceiver(int pMask, QObject *pTarget);
     QString      queryFieldName(int barcodeType, int receiverType);
 
+  public slots:
+    void sResolveNext();
+
   signals:
     void gotBarCode(int type, int id);
 };
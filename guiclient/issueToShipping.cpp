@@ -12,6 +12,7 @@
 #include "issueToShipping.h"
 
 #include <QMenu>
+#include <QSet>
 #include <QSqlError>
 #include <QVariant>
 
@@ -26,6 +27,7 @@
 #include "shipOrder.h"
 #include "storedProcErrorLookup.h"
 #include "errorReporter.h"
+#include "format.h"
 
 #define DEBUG false
 
@@ -731,25 +733,244 @@ bool issueToShipping::sIssueLineBalance(int id, int altId)
   return true;
 }
 
+/* Issue the balance of every line on the order. Lines that can be issued
+   without asking the user anything are issued together in one
+   transaction. Lines that need lot/serial or location detail, job items
+   and lines short of inventory go through sIssueLineBalance() one at a
+   time as before. Only the rows that were issued are refreshed.
+ */
 void issueToShipping::sIssueAllBalance()
 {
-  bool refresh = false;
   int orderid = _order->id();
 
   if (! sufficientInventory(orderid))
     return;
 
+  QVariantList ids;
+  QHash<int, int> altIds;
   for (int i = 0; i < _soitem->topLevelItemCount(); i++)
   {
     XTreeWidgetItem *cursor = (XTreeWidgetItem*)_soitem->topLevelItem(i);
-    if (sIssueLineBalance(cursor->id(),cursor->altId()))
-      refresh = true;
-    // attempt to issue all lines
-    //else
-    //  break;
+    if (cursor->id() < 0 || altIds.contains(cursor->id()))
+      continue;
+    ids.append(cursor->id());
+    altIds.insert(cursor->id(), cursor->altId());
   }
+  if (ids.isEmpty())
+    return;
 
-  if (refresh)
+  ParameterList linep;
+  linep.append("ordertype",    _order->type());
+  linep.append("orderitem_id", ids);
+  if (_requireInventory->isChecked() ||
+      (_order->isSO() && _metrics->boolean("EnableSOReservations")))
+    linep.append("checkInventory");
+
+  MetaSQLQuery linem("SELECT orderitem_id,"
+                     "       calcIssueToShippingLineBalance(<? value('ordertype') ?>,"
+                     "                                      orderitem_id) AS balance,"
+                     "       isControlledItemsite(orderitem_itemsite_id) AS controlled,"
+                     "<? if exists('checkInventory') ?>"
+                     "       sufficientInventoryToShipItem(<? value('ordertype') ?>,"
+                     "                                     orderitem_id) AS sufficient"
+                     "<? else ?>"
+                     "       0 AS sufficient"
+                     "<? endif ?>"
+                     "  FROM orderitem"
+                     " WHERE orderitem_orderhead_type = <? value('ordertype') ?>"
+                     "   AND orderitem_id IN (-1"
+                     "       <? foreach('orderitem_id') ?>"
+                     "       , <? value('orderitem_id') ?>"
+                     "       <? endforeach ?>"
+                     "       );");
+  XSqlQuery lineq = linem.toQuery(linep);
+
+  QSet<int>  bulk;
+  QList<int> single;
+  while (lineq.next())
+  {
+    int id = lineq.value("orderitem_id").toInt();
+    if (lineq.value("balance").toDouble() == 0)
+      continue;
+    else if (altIds.value(id) == 0 &&
+             ! lineq.value("controlled").toBool() &&
+             lineq.value("sufficient").toInt() >= 0)
+      bulk.insert(id);
+    else
+      single.append(id);
+  }
+  if (ErrorReporter::error(QtCriticalMsg, this, tr("Error Retrieving Item Information"),
+                           lineq, __FILE__, __LINE__))
+    return;
+
+  QList<int> issued;
+  if (! bulk.isEmpty())
+  {
+    if (issueLinesInBulk(bulk.toList()))
+      issued = bulk.toList();
+    else
+    {
+      // one bad line rolled back the whole batch; let each line try alone
+      foreach (QVariant id, ids)
+      {
+        if (bulk.contains(id.toInt()) && sIssueLineBalance(id.toInt(), 0))
+          issued.append(id.toInt());
+      }
+    }
+  }
+
+  // attempt to issue all lines, in the order they are listed
+  foreach (QVariant id, ids)
+  {
+    if (single.contains(id.toInt()) &&
+        sIssueLineBalance(id.toInt(), altIds.value(id.toInt())))
+      issued.append(id.toInt());
+  }
+
+  if (! issued.isEmpty())
+    refreshLines(issued);
+}
+
+/* Issue the balance of every line in pLines in one transaction, each with
+   its own itemloc series. The lines must not need distribution detail.
+   Returns false without changing anything if any line fails.
+ */
+bool issueToShipping::issueLinesInBulk(const QList<int> &pLines)
+{
+  if (DEBUG)
+    qDebug("issueToShipping::issueLinesInBulk() %d lines", pLines.size());
+
+  QVariantList ids;
+  foreach (int id, pLines)
+    ids.append(id);
+
+  ParameterList issuep;
+  issuep.append("ordertype",    _order->type());
+  issuep.append("orderitem_id", ids);
+  issuep.append("ts",           _transDate->date());
+
+  MetaSQLQuery issuem("SELECT orderitem_id, series,"
+                      "       issueToShipping(<? value('ordertype') ?>::text, orderitem_id,"
+                      "                       balance, series, <? value('ts') ?>,"
+                      "                       NULL, false, true) AS result"
+                      "  FROM (SELECT orderitem_id,"
+                      "               calcIssueToShippingLineBalance(<? value('ordertype') ?>,"
+                      "                                              orderitem_id) AS balance,"
+                      "               NEXTVAL('itemloc_series_seq') AS series"
+                      "          FROM orderitem"
+                      "         WHERE orderitem_orderhead_type = <? value('ordertype') ?>"
+                      "           AND orderitem_id IN (-1"
+                      "               <? foreach('orderitem_id') ?>"
+                      "               , <? value('orderitem_id') ?>"
+                      "               <? endforeach ?>"
+                      "               )"
+                      "         ORDER BY orderitem_id) AS lines"
+                      " WHERE balance != 0;");
+
+  XSqlQuery rollback;
+  rollback.prepare("ROLLBACK;");
+
+  XSqlQuery issue;
+  issue.exec("BEGIN;");
+  issue = issuem.toQuery(issuep);
+  while (issue.next())
+  {
+    int result = issue.value("result").toInt();
+    if (result < 0 || result != issue.value("series").toInt())
+    {
+      if (DEBUG)
+        qDebug("issueToShipping::issueLinesInBulk() line %d returned %d",
+               issue.value("orderitem_id").toInt(), result);
+      rollback.exec();
+      return false;
+    }
+  }
+  if (issue.lastError().type() != QSqlError::NoError)
+  {
+    if (DEBUG)
+      qDebug("issueToShipping::issueLinesInBulk() %s",
+             qPrintable(issue.lastError().text()));
+    rollback.exec();
+    return false;
+  }
+
+  issue.exec("COMMIT;");
+  return true;
+}
+
+/* Update the At Shipping and Balance columns of the rows for pLines
+   instead of reloading the whole order. The reservation view shows
+   a row per reserved location under each line, so it is reloaded.
+ */
+void issueToShipping::refreshLines(const QList<int> &pLines)
+{
+  int atshippingCol = _soitem->column("atshipping");
+  int balanceCol    = _soitem->column("balance");
+  if (_metrics->boolean("EnableSOReservationsByLocation") ||
+      atshippingCol < 0 || balanceCol < 0)
+  {
+    sFillList();
+    return;
+  }
+
+  QVariantList ids;
+  foreach (int id, pLines)
+    ids.append(id);
+
+  ParameterList refreshp;
+  refreshp.append("ordertype",    _order->type());
+  refreshp.append("orderhead_id", _order->id());
+  refreshp.append("orderitem_id", ids);
+
+  MetaSQLQuery refreshm("SELECT orderitem_id,"
+                        "       qtyAtShipping(<? value('ordertype') ?>, orderitem_id) AS atshipping,"
+                        "       calcIssueToShippingLineBalance(<? value('ordertype') ?>,"
+                        "                                      orderitem_id) AS balance,"
+                        "       (SELECT shiphead_number"
+                        "          FROM shiphead"
+                        "         WHERE shiphead_order_type = <? value('ordertype') ?>"
+                        "           AND shiphead_order_id   = <? value('orderhead_id') ?>"
+                        "           AND NOT shiphead_shipped"
+                        "         ORDER BY shiphead_id DESC LIMIT 1) AS shiphead_number"
+                        "  FROM orderitem"
+                        " WHERE orderitem_orderhead_type = <? value('ordertype') ?>"
+                        "   AND orderitem_id IN (-1"
+                        "       <? foreach('orderitem_id') ?>"
+                        "       , <? value('orderitem_id') ?>"
+                        "       <? endforeach ?>"
+                        "       );");
+  XSqlQuery refreshq = refreshm.toQuery(refreshp);
+
+  QHash<int, XTreeWidgetItem*> rows;
+  for (int i = 0; i < _soitem->topLevelItemCount(); i++)
+  {
+    XTreeWidgetItem *cursor = (XTreeWidgetItem*)_soitem->topLevelItem(i);
+    rows.insert(cursor->id(), cursor);
+  }
+
+  int found = 0;
+  while (refreshq.next())
+  {
+    XTreeWidgetItem *row = rows.value(refreshq.value("orderitem_id").toInt());
+    if (! row)
+      continue;
+    found++;
+
+    QStringList names;
+    names << "atshipping" << "balance";
+    foreach (QString name, names)
+    {
+      int    col   = _soitem->column(name);
+      double value = refreshq.value(name).toDouble();
+      int     scale = row->data(col, Xt::ScaleRole).isValid()
+                    ? row->data(col, Xt::ScaleRole).toInt() : decimalPlaces("qty");
+      row->setData(col, Xt::RawRole,     value);
+      row->setData(col, Qt::DisplayRole, formatNumber(value, scale));
+    }
+    _shipment->setText(refreshq.value("shiphead_number").toString());
+  }
+  if (ErrorReporter::error(QtCriticalMsg, this, tr("Error Retrieving Item Information"),
+                           refreshq, __FILE__, __LINE__) || found != pLines.size())
     sFillList();
 }
 
@@ -57,6 +57,8 @@ protected:
     bool        _captive;
 
 private:
+    bool	issueLinesInBulk(const QList<int> &);
+    void	refreshLines(const QList<int> &);
     bool	sufficientInventory(int);
     bool	sufficientItemInventory(int);
 
@@ -10,6 +10,8 @@
 
 #include "issueWoMaterialBatch.h"
 
+#include <algorithm>
+
 #include <QSqlError>
 #include <QVariant>
 #include <QMessageBox>
@@ -118,9 +120,6 @@ void issueWoMaterialBatch::sIssue()
                                QMessageBox::No | QMessageBox::Default, QMessageBox::Yes) == QMessageBox::No)
         return;
 
-  XSqlQuery rollback;
-  rollback.prepare("ROLLBACK;");
-
   QString sqlitems =
                ("SELECT womatl_id, womatl_wo_id, item_number, itemsite_id, formatWoNumber(womatl_wo_id) AS wo_number, "
                 " CASE WHEN (womatl_qtyreq >= 0) THEN "
@@ -152,110 +151,94 @@ void issueWoMaterialBatch::sIssue()
   params.append("items", itemlist);
   XSqlQuery items = mqlitems.toQuery(params);
 
-  int succeeded = 0;
-  QList<QString> failedItems;
-  QList<QString> errors;
-  while(items.next())
-  { 
-    // Stage distribution cleanup function to be called on error
-    XSqlQuery cleanup;
-    cleanup.prepare("SELECT deleteitemlocseries(:itemlocSeries, TRUE);");
-    int itemlocSeries;
+  QList<MaterialIssue> materials;
+  while (items.next())
+  {
+    MaterialIssue material;
+    material.womatlId   = items.value("womatl_id").toInt();
+    material.itemNumber = items.value("item_number").toString();
+    material.qty        = items.value("qty").toDouble();
+    material.postQty    = items.value("post_qty").toDouble();
+    material.controlled = items.value("controlled").toBool();
+    material.issued     = false;
+    materials.append(material);
+  }
+  if (ErrorReporter::error(QtCriticalMsg, this, tr("Error Retrieving Material"),
+                           items, __FILE__, __LINE__))
+    return;
 
-    // Get the parent series id
-    XSqlQuery parentSeries;
-    parentSeries.prepare("SELECT NEXTVAL('itemloc_series_seq') AS result;");
-    parentSeries.exec();
-    if (parentSeries.first() && parentSeries.value("result").toInt() > 0)
+  // Collect every distribution decision before anything is posted
+  QList<int> toIssue;
+  QList<int> controlled;
+  for (int i = 0; i < materials.size(); i++)
+  {
+    if (materials.at(i).controlled)
+      controlled.append(i);
+    else
+      toIssue.append(i);
+  }
+
+  int  itemlocSeries = 0;
+  bool proceed       = true;
+  if (! controlled.isEmpty())
+  {
+    itemlocSeries = nextItemlocSeries();
+    if (itemlocSeries <= 0)
+      return;
+
+    QString error;
+    bool    distributed = false;
+    if (! createItemlocdist(materials, controlled, itemlocSeries, error))
+      markFailed(materials, controlled, tr("Error Creating itemlocdist Records. %1").arg(error));
+    else if (distributeInventory::SeriesAdjust(itemlocSeries, this, QString(), QDate(),
+                                               QDate(), true) == XDialog::Rejected)
     {
-      itemlocSeries = parentSeries.value("result").toInt();
-      cleanup.bindValue(":itemlocSeries", itemlocSeries);
+      markFailed(materials, controlled, tr("Detail Distribution Cancelled"));
+      // If there are more items to issue, ask the user to stop or continue
+      proceed = toIssue.isEmpty() ||
+                QMessageBox::question(this,  tr("Material Issue"),
+                                      tr("Posting distribution detail was cancelled but "
+                                         "there are more items to issue. Continue issuing "
+                                         "the remaining materials?"),
+                                      QMessageBox::Yes | QMessageBox::No,
+                                      QMessageBox::No) == QMessageBox::Yes;
     }
     else
     {
-      failedItems.append(items.value("item_number").toString());
-      errors.append("Failed to Retrieve the Next itemloc_series_seq");
-      continue;
+      toIssue.append(controlled);
+      std::sort(toIssue.begin(), toIssue.end());
+      distributed = true;
     }
 
-    if (items.value("controlled").toBool())
+    if (! distributed)
     {
-      // Create the parent itemlocdist record for each line item requiring distribution, call distributeInventory::seriesAdjust
-      XSqlQuery parentItemlocdist;
-      parentItemlocdist.prepare("SELECT createitemlocdistparent(:itemsite_id, :qty, 'WO', "
-                                " :orderitemId, :itemlocSeries, NULL, NULL, 'IM');");
-      parentItemlocdist.bindValue(":itemsite_id", items.value("itemsite_id").toInt());
-      parentItemlocdist.bindValue(":qty", items.value("post_qty").toDouble());
-      parentItemlocdist.bindValue(":orderitemId", items.value("womatl_id").toInt());
-      parentItemlocdist.bindValue(":itemlocSeries", itemlocSeries);
-      parentItemlocdist.exec();
-      if (parentItemlocdist.first())
-      {
-        if (distributeInventory::SeriesAdjust(itemlocSeries, this, QString(), QDate(),
-          QDate(), true) == XDialog::Rejected)
-        {
-          cleanup.exec();
-          failedItems.append(items.value("item_number").toString());
-          errors.append("Detail Distribution Cancelled");
-          // If it's not the last item in the loop, ask the user to exit loop or continue
-          if (items.at() != (items.size() -1))
-          {
-            if (QMessageBox::question(this,  tr("Material Issue"),
-            tr("Posting distribution detail for item number %1 was cancelled but "
-              "there are more items to issue. Continue issuing the remaining materials?")
-            .arg(items.value("item_number").toString()),
-            QMessageBox::Yes | QMessageBox::No, QMessageBox::No) == QMessageBox::Yes)
-            {
-              continue;
-            }
-            else
-              break;
-          }
-          else
-            continue;
-        }
-      }
-      else
-      {
-        cleanup.exec();
-        failedItems.append(items.value("item_number").toString());
-        errors.append(tr("Error Creating itemlocdist Records. %1")
-          .arg(parentItemlocdist.lastError().text()));
-        continue;
-      }
+      XSqlQuery cleanup;
+      cleanup.prepare("SELECT deleteitemlocseries(:itemlocSeries, TRUE);");
+      cleanup.bindValue(":itemlocSeries", itemlocSeries);
+      cleanup.exec();
+      itemlocSeries = 0;
     }
-  
-    // Post inventory
-    issue.exec("BEGIN;");	// because of possible lot, serial, or location distribution cancelations
-    issue.prepare("SELECT issueWoMaterial(:womatl_id, :qty, :itemlocSeries, true, "
-                  " :date, TRUE) AS result;");
-    issue.bindValue(":womatl_id", items.value("womatl_id").toInt());
-    issue.bindValue(":qty", items.value("qty").toDouble());
-    issue.bindValue(":itemlocSeries", itemlocSeries);
-    issue.bindValue(":date",  _transDate->date());
-    issue.exec();
-    if (issue.first())
-    {
-      int result = issue.value("result").toInt();
-      if (result < 0 || result != itemlocSeries)
-      {
-        rollback.exec();
-        cleanup.exec();
-        failedItems.append(items.value("item_number").toString());
-        errors.append(tr("Error Issuing Work Order Material; Work Order ID #%1. Database error: %2")
-                             .arg(_wo->id()).arg(issue.lastError().text()));
-        continue;
-      }
+  }
+
+  if (proceed && ! toIssue.isEmpty())
+  {
+    if (itemlocSeries <= 0)
+      itemlocSeries = nextItemlocSeries();
+    if (itemlocSeries > 0)
+      issueMaterials(materials, toIssue, itemlocSeries);
+  }
 
+  int succeeded = 0;
+  QList<QString> failedItems;
+  QList<QString> errors;
+  foreach (MaterialIssue material, materials)
+  {
+    if (material.issued)
       succeeded++;
-      issue.exec("COMMIT;");      
-    }
-    else
+    else if (! material.error.isEmpty())
     {
-      rollback.exec();
-      cleanup.exec();
-      failedItems.append(items.value("item_number").toString());
-      errors.append(issue.lastError().text());
+      failedItems.append(material.itemNumber);
+      errors.append(material.error);
     }
   }
 
@@ -265,8 +248,13 @@ void issueWoMaterialBatch::sIssue()
     dlg.setText(tr("%1 Items succeeded.\n%2 Items failed.").arg(succeeded).arg(failedItems.size()));
 
     QString details;
-    for (int i=0; i<failedItems.size(); i++)
-      details += tr("Item %1 failed with:\n%2\n").arg(failedItems[i]).arg(errors[i]);
+    foreach (MaterialIssue material, materials)
+    {
+      if (material.issued)
+        details += tr("Item %1 issued.\n").arg(material.itemNumber);
+      else if (! material.error.isEmpty())
+        details += tr("Item %1 failed with:\n%2\n").arg(material.itemNumber).arg(material.error);
+    }
     dlg.setDetailedText(details);
 
     dlg.exec();
@@ -287,6 +275,172 @@ void issueWoMaterialBatch::sIssue()
   }
 }
 
+/* Return a new itemloc series, or 0 after telling the user why not.
+ */
+int issueWoMaterialBatch::nextItemlocSeries()
+{
+  XSqlQuery parentSeries;
+  parentSeries.prepare("SELECT NEXTVAL('itemloc_series_seq') AS result;");
+  parentSeries.exec();
+  if (parentSeries.first() && parentSeries.value("result").toInt() > 0)
+    return parentSeries.value("result").toInt();
+
+  ErrorReporter::error(QtCriticalMsg, this, tr("Failed to Retrieve the Next itemloc_series_seq"),
+                       parentSeries, __FILE__, __LINE__);
+  return 0;
+}
+
+/* Format a list of numbers as a PostgreSQL array literal.
+ */
+static QString arrayLiteral(const QStringList &pValues)
+{
+  return QString("{%1}").arg(pValues.join(","));
+}
+
+/* Create the parent itemlocdist records for the controlled materials
+   pIndexes in one statement so distributeInventory can ask for all of
+   their detail at once.
+ */
+bool issueWoMaterialBatch::createItemlocdist(const QList<MaterialIssue> &pMaterials,
+                                             const QList<int> &pIndexes,
+                                             int pItemlocSeries, QString &pError)
+{
+  QStringList ids;
+  QStringList qtys;
+  foreach (int i, pIndexes)
+  {
+    ids  << QString::number(pMaterials.at(i).womatlId);
+    qtys << QString::number(pMaterials.at(i).postQty, 'g', 15);
+  }
+
+  XSqlQuery parentItemlocdist;
+  parentItemlocdist.prepare("SELECT createitemlocdistparent(womatl_itemsite_id, batch_qty, 'WO',"
+                            "                               womatl_id, :itemlocSeries,"
+                            "                               NULL, NULL, 'IM') AS result"
+                            "  FROM unnest(:womatl_ids::INTEGER[], :qtys::NUMERIC[])"
+                            "         AS batch(batch_womatl_id, batch_qty)"
+                            "  JOIN womatl ON (womatl_id = batch_womatl_id)"
+                            " ORDER BY womatl_id;");
+  parentItemlocdist.bindValue(":itemlocSeries", pItemlocSeries);
+  parentItemlocdist.bindValue(":womatl_ids",    arrayLiteral(ids));
+  parentItemlocdist.bindValue(":qtys",          arrayLiteral(qtys));
+  parentItemlocdist.exec();
+  if (parentItemlocdist.lastError().type() != QSqlError::NoError)
+  {
+    pError = parentItemlocdist.lastError().text();
+    return false;
+  }
+  return true;
+}
+
+void issueWoMaterialBatch::markFailed(QList<MaterialIssue> &pMaterials,
+                                      const QList<int> &pIndexes, const QString &pError)
+{
+  foreach (int i, pIndexes)
+    pMaterials[i].error = pError;
+}
+
+/* Issue the materials pIndexes under pItemlocSeries. All of them are
+   posted by one statement in one transaction. If that fails the
+   transaction is rolled back and they are posted again one at a time,
+   still in one transaction but each behind its own savepoint, so the
+   report can say which ones failed and why.
+ */
+void issueWoMaterialBatch::issueMaterials(QList<MaterialIssue> &pMaterials,
+                                          const QList<int> &pIndexes, int pItemlocSeries)
+{
+  QStringList ids;
+  QStringList qtys;
+  foreach (int i, pIndexes)
+  {
+    ids  << QString::number(pMaterials.at(i).womatlId);
+    qtys << QString::number(pMaterials.at(i).qty, 'g', 15);
+  }
+
+  XSqlQuery rollback;
+  rollback.prepare("ROLLBACK;");
+
+  XSqlQuery issue;
+  issue.exec("BEGIN;");	// because of possible lot, serial, or location distribution cancelations
+  issue.prepare("SELECT batch_womatl_id,"
+                "       issueWoMaterial(batch_womatl_id, batch_qty, :itemlocSeries, true,"
+                "                       :date, TRUE) AS result"
+                "  FROM unnest(:womatl_ids::INTEGER[], :qtys::NUMERIC[])"
+                "         AS batch(batch_womatl_id, batch_qty)"
+                " ORDER BY batch_womatl_id;");
+  issue.bindValue(":itemlocSeries", pItemlocSeries);
+  issue.bindValue(":womatl_ids",    arrayLiteral(ids));
+  issue.bindValue(":qtys",          arrayLiteral(qtys));
+  issue.bindValue(":date",          _transDate->date());
+  issue.exec();
+  bool ok = issue.lastError().type() == QSqlError::NoError;
+  while (ok && issue.next())
+    ok = issue.value("result").toInt() == pItemlocSeries;
+
+  if (ok)
+  {
+    issue.exec("COMMIT;");
+    foreach (int i, pIndexes)
+      pMaterials[i].issued = true;
+    return;
+  }
+  rollback.exec();
+
+  QStringList failed;
+  issue.exec("BEGIN;");
+  foreach (int i, pIndexes)
+  {
+    XSqlQuery savepoint;
+    savepoint.exec("SAVEPOINT issuewomatl;");
+
+    issue.prepare("SELECT issueWoMaterial(:womatl_id, :qty, :itemlocSeries, true, "
+                  " :date, TRUE) AS result;");
+    issue.bindValue(":womatl_id", pMaterials.at(i).womatlId);
+    issue.bindValue(":qty", pMaterials.at(i).qty);
+    issue.bindValue(":itemlocSeries", pItemlocSeries);
+    issue.bindValue(":date",  _transDate->date());
+    issue.exec();
+    if (issue.first() && issue.value("result").toInt() == pItemlocSeries)
+    {
+      savepoint.exec("RELEASE SAVEPOINT issuewomatl;");
+      pMaterials[i].issued = true;
+    }
+    else
+    {
+      pMaterials[i].error = issue.lastError().type() != QSqlError::NoError
+                          ? issue.lastError().text()
+                          : tr("Error Issuing Work Order Material; Work Order ID #%1. Database error: %2")
+                              .arg(_wo->id()).arg(issue.value("result").toInt());
+      savepoint.exec("ROLLBACK TO SAVEPOINT issuewomatl;");
+      failed << QString::number(pMaterials.at(i).womatlId);
+    }
+  }
+  issue.exec("COMMIT;");
+
+  if (failed.size() == pIndexes.size())
+  {
+    XSqlQuery cleanup;
+    cleanup.prepare("SELECT deleteitemlocseries(:itemlocSeries, TRUE);");
+    cleanup.bindValue(":itemlocSeries", pItemlocSeries);
+    cleanup.exec();
+  }
+  else if (! failed.isEmpty())
+  {
+    // drop the distribution detail of the materials that were not issued
+    XSqlQuery cleanup;
+    cleanup.prepare("DELETE FROM itemlocdist"
+                    " WHERE itemlocdist_series = :itemlocSeries"
+                    "   AND (itemlocdist_order_id = ANY(:womatl_ids::INTEGER[])"
+                    "        OR itemlocdist_itemlocdist_id IN"
+                    "           (SELECT itemlocdist_id FROM itemlocdist"
+                    "             WHERE itemlocdist_series = :itemlocSeries"
+                    "               AND itemlocdist_order_id = ANY(:womatl_ids::INTEGER[])));");
+    cleanup.bindValue(":itemlocSeries", pItemlocSeries);
+    cleanup.bindValue(":womatl_ids",    arrayLiteral(failed));
+    cleanup.exec();
+  }
+}
+
 void issueWoMaterialBatch::sFillList()
 {
   _womatl->clear();
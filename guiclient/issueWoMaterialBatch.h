@@ -17,6 +17,18 @@
 
 #include "ui_issueWoMaterialBatch.h"
 
+class MaterialIssue
+{
+  public:
+    int     womatlId;
+    QString itemNumber;
+    double  qty;
+    double  postQty;
+    bool    controlled;
+    bool    issued;
+    QString error;
+};
+
 class issueWoMaterialBatch : public XDialog, public Ui::issueWoMaterialBatch
 {
     Q_OBJECT
@@ -37,6 +49,11 @@ private:
     bool _captive;
     bool _hasPush;
 
+    bool createItemlocdist(const QList<MaterialIssue> &, const QList<int> &, int, QString &);
+    void issueMaterials(QList<MaterialIssue> &, const QList<int> &, int);
+    void markFailed(QList<MaterialIssue> &, const QList<int> &, const QString &);
+    int  nextItemlocSeries();
+
 };
 
 #endif // ISSUEWOMATERIALBATCH_H
@@ -125,6 +125,7 @@
 #include "xmainwindow.h"
 #include "checkForUpdates.h"
 #include "salesOrderSimple.h"
+#include "sessionBootstrap.h"
 #include "taxIntegration.h"
 #include "userPreferences.h"
 #include "xtNetworkRequestManager.h"
@@ -149,7 +150,6 @@ extern void xTupleMessageOutput(QtMsgType type, const char *msg);
 
 int main(int argc, char *argv[])
 {
-  XSqlQuery main;
   Q_INIT_RESOURCE(guiclient);
 
   QString username;
@@ -167,6 +167,7 @@ int main(int argc, char *argv[])
   qInstallMsgHandler(xTupleMessageOutput);
 #endif
   QApplication app(argc, argv);
+  SessionBootstrap::mark("application start");
   app.setOrganizationDomain("xTuple.com");
   app.setOrganizationName("xTuple");
   app.setApplicationName("xTuple");
@@ -274,20 +275,20 @@ int main(int argc, char *argv[])
       }
     }
   }
+  SessionBootstrap::mark("login");
+
+  // read the session state in one round-trip instead of one query per step
+  SessionBootstrap bootstrap;
+  bootstrap.load(username, _ConnAppName);
+
 //{
   _splash->showMessage(QObject::tr("Loading Translations"), SplashTextAlignment, SplashTextColor);
   qApp->processEvents();
-  XSqlQuery langq("SELECT lang_abbr2,   lang_qt_number,"
-                  "       country_abbr, country_qt_number"
-                  "  FROM usr"
-                  "  JOIN locale  ON usr_locale_id     = locale_id"
-                  "  JOIN lang    ON locale_lang_id    = lang_id"
-                  "  LEFT OUTER JOIN country ON locale_country_id = country_id"
-                  " WHERE usr_username = getEffectiveXtUser();");
-  if (langq.first())
+  MetricMap locale = bootstrap.map("locale");
+  if (! locale.isEmpty())
   {
-    QString langAbbr    = langq.value("lang_abbr2").toString();
-    QString countryAbbr = langq.value("country_abbr").toString().toUpper();
+    QString langAbbr    = locale.value("lang_abbr2");
+    QString countryAbbr = locale.value("country_abbr").toUpper();
 
     if (! langAbbr.isEmpty() && ! countryAbbr.isEmpty())
       lang.prepend(langAbbr + "_" + countryAbbr.toLower());
@@ -304,30 +305,28 @@ int main(int argc, char *argv[])
       QLocale::setDefault(QLocale(langAbbr + "_" + countryAbbr));
     else if (! langAbbr.isEmpty())
       QLocale::setDefault(QLocale(langAbbr));
-    else if (langq.value("lang_qt_number").toInt() &&
-             langq.value("country_qt_number").toInt())
+    else if (locale.value("lang_qt_number").toInt() &&
+             locale.value("country_qt_number").toInt())
       QLocale::setDefault(
-          QLocale(QLocale::Language(langq.value("lang_qt_number").toInt()),
-                  QLocale::Country(langq.value("country_qt_number").toInt())));
+          QLocale(QLocale::Language(locale.value("lang_qt_number").toInt()),
+                  QLocale::Country(locale.value("country_qt_number").toInt())));
     else
       QLocale::setDefault(sysl);
 
     qDebug() << "Locale set to language" << QLocale();
   }
-  ErrorReporter::error(QtCriticalMsg, 0, QObject::tr("Error Getting Locale"),
-                       langq, __FILE__, __LINE__);
+  if (! bootstrap.error("locale").isEmpty())
+    ErrorReporter::error(QtCriticalMsg, 0, QObject::tr("Error Getting Locale"),
+                         bootstrap.error("locale"), __FILE__, __LINE__);
 
   (void)lang.removeDuplicates();
 
   QList<QPair<QString, QString> > transfile;
   transfile << qMakePair(QString("xTuple"), QString()) << qMakePair(QString("openrpt"), QString()) << qMakePair(QString("reports"), QString());
-  XSqlQuery pkglist("SELECT pkghead_name, pkghead_version "
-                    "  FROM pkghead"
-                    " WHERE packageIsEnabled(pkghead_name);");
-  while (pkglist.next())
-    transfile << qMakePair(pkglist.value("pkghead_name").toString(), pkglist.value("pkghead_version").toString());
-  ErrorReporter::error(QtCriticalMsg, 0, QObject::tr("Error Getting Extension Names"),
-                       pkglist, __FILE__, __LINE__);
+  transfile << bootstrap.pairs("packages");
+  if (! bootstrap.error("packages").isEmpty())
+    ErrorReporter::error(QtCriticalMsg, 0, QObject::tr("Error Getting Extension Names"),
+                         bootstrap.error("packages"), __FILE__, __LINE__);
 
   QTranslator *translator = new QTranslator(&app);
   QPair<QString, QString> f;
@@ -350,10 +349,14 @@ int main(int argc, char *argv[])
     }
   }
 //}
+  SessionBootstrap::mark("translations");
 
   _splash->showMessage(QObject::tr("Loading Database Metrics"), SplashTextAlignment, SplashTextColor);
   qApp->processEvents();
-  _metrics = new Metrics();
+  if (bootstrap.contains("metrics"))
+    _metrics = new Metrics(bootstrap.map("metrics"));
+  else
+    _metrics = new Metrics();
 
   // TODO: we should compose the splash screen on the fly from parts
   QString edition("PostBooks");
@@ -363,10 +366,9 @@ int main(int argc, char *argv[])
   splashMap.insert("Manufacturing", ":/images/splashMfgEdition.png");
   splashMap.insert("PostBooks",     ":/images/splashPostBooks.png");
 
-  XSqlQuery q("SELECT getEdition() AS result;");
-  if (q.first())
+  if (bootstrap.contains("edition"))
   {
-    edition = q.value("result").toString();
+    edition = bootstrap.value("edition").toString();
   }
   else
   {
@@ -374,7 +376,7 @@ int main(int argc, char *argv[])
   }
 
   qDebug() << edition;
-  _splash->setPixmap(QPixmap(splashMap[q.value("result").toString()]));
+  _splash->setPixmap(QPixmap(splashMap[edition]));
 
   _Name = _Name.arg(edition);
 
@@ -384,25 +386,18 @@ int main(int argc, char *argv[])
   int cnt = 50000;
   int tot = 50000;
 
-  XSqlQuery metric;
-  metric.prepare("SELECT numOfDatabaseUsers(:appName) AS xt_client_count,"
-                 "       numOfServerUsers() as total_client_count;");
-  metric.bindValue(":appName", _ConnAppName);
-  metric.exec();
-  if(metric.first())
+  if(bootstrap.contains("xt_client_count") && bootstrap.contains("total_client_count"))
   {
-    cnt = metric.value("xt_client_count").toInt();
-    tot = metric.value("total_client_count").toInt();
+    cnt = bootstrap.value("xt_client_count").toInt();
+    tot = bootstrap.value("total_client_count").toInt();
   }
   else
   {
     ErrorReporter::error(QtCriticalMsg, 0, QObject::tr("Error Counting Users"),
-                         metric, __FILE__, __LINE__);
+                         bootstrap.error("xt_client_count") + bootstrap.error("total_client_count"),
+                         __FILE__, __LINE__);
   }
-  metric.exec("SELECT packageIsEnabled('drupaluserinfo') AS result;");
-  bool xtweb = false;
-  if(metric.first())
-    xtweb = metric.value("result").toBool();
+  bool xtweb = bootstrap.value("xtweb").toBool();
   bool forceLimit = _metrics->boolean("ForceLicenseLimit");
   bool forced = false;
   bool checkPass = true;
@@ -500,14 +495,9 @@ int main(int argc, char *argv[])
     if(forced)
       checkPassReason.append(" FORCED!");
 
-    metric.exec("SELECT current_database() AS db;");
-    QString db = "";
+    QString db     = bootstrap.value("database").toString();
     QString dbname = _metrics->value("DatabaseName");
     QString name   = _metrics->value("remitto_name");
-    if(metric.first())
-    {
-      db = metric.value("db").toString();
-    }
 #if QT_VERSION >= 0x050000
     QUrlQuery urlQuery("https://www.xtuple.org/api/regviolation.php?");
     urlQuery.addQueryItem("key", rkey);
@@ -531,13 +521,17 @@ int main(int argc, char *argv[])
     url.addQueryItem("tot", QString::number(tot));
     url.addQueryItem("ver", _Version);
 #endif
-    QMutex wait;
-    xtNetworkRequestManager _networkManager(url, wait);
+    xtNetworkRequest *violation = xtNetworkRequestManager::instance()->get(url);
     if(forced)
+    {
+      violation->waitForFinished(10000);
+      delete violation;
       return 0;
+    }
 
     _splash->show();
   }
+  SessionBootstrap::mark("license check");
 
   QString _serverVersion = _metrics->value("ServerVersion");
   if (_serverVersion != _dbVersion) {
@@ -579,11 +573,19 @@ int main(int argc, char *argv[])
 
   _splash->showMessage(QObject::tr("Loading User Preferences"), SplashTextAlignment, SplashTextColor);
   qApp->processEvents();
-  _preferences = new Preferences(username);
+  if (bootstrap.contains("preferences"))
+    _preferences = new Preferences(username, bootstrap.map("preferences"));
+  else
+    _preferences = new Preferences(username);
 
   _splash->showMessage(QObject::tr("Loading User Privileges"), SplashTextAlignment, SplashTextColor);
   qApp->processEvents();
-  _privileges = new Privileges();
+  if (bootstrap.contains("privileges") && bootstrap.contains("effective_user"))
+    _privileges = new Privileges(bootstrap.value("effective_user").toString(),
+                                 bootstrap.map("privileges"));
+  else
+    _privileges = new Privileges();
+  SessionBootstrap::mark("preferences and privileges");
 
   qApp->processEvents();
 
@@ -632,6 +634,7 @@ int main(int argc, char *argv[])
 
   omfgThis = new GUIClient(databaseURL, username);
   omfgThis->_key = key;
+  SessionBootstrap::mark("main window");
 
   if (key.length() > 0) {
 	_splash->showMessage(QObject::tr("Loading Database Encryption Metrics"), SplashTextAlignment, SplashTextColor);
@@ -644,11 +647,9 @@ int main(int argc, char *argv[])
   initializePlugin(_preferences, _metrics, _privileges, omfgThis->username(), omfgThis->workspace(), _taxIntegration);
 
 // START code for updating the locale settings if they haven't been already
-  XSqlQuery lc;
-  lc.exec("SELECT count(*) FROM metric WHERE metric_name='AutoUpdateLocaleHasRun';");
-  lc.first();
-  if(lc.value(0).toInt() == 0)
+  if(! bootstrap.value("locale_has_run").toBool())
   {
+    XSqlQuery lc;
     lc.exec("INSERT INTO metric (metric_name, metric_value) values('AutoUpdateLocaleHasRun', 't');");
     lc.exec("SELECT locale_id from locale;");
     while(lc.next())
@@ -705,15 +706,16 @@ int main(int argc, char *argv[])
 
   // Check for the existance of a base currency, if none, one needs to
   // be selected or created
-  XSqlQuery baseCurrency;
-  baseCurrency.prepare("SELECT COUNT(*) AS count FROM curr_symbol WHERE curr_base=TRUE;");
-  baseCurrency.exec();
-  if(baseCurrency.first())
+  bool currenciesChanged = false;
+  if(bootstrap.contains("base_curr_count"))
   {
-    if(baseCurrency.value("count").toInt() != 1)
+    if(bootstrap.value("base_curr_count").toInt() != 1)
     {
       currenciesDialog newdlg(0, "", true);
       newdlg.exec();
+      currenciesChanged = true;
+      XSqlQuery baseCurrency;
+      baseCurrency.prepare("SELECT COUNT(*) AS count FROM curr_symbol WHERE curr_base=TRUE;");
       baseCurrency.exec();
       if(baseCurrency.first())
       {
@@ -732,25 +734,25 @@ int main(int argc, char *argv[])
   else
   {
       ErrorReporter::error(QtCriticalMsg, omfgThis, QObject::tr("Error Retrieving Base Currency Information"),
-                           baseCurrency, __FILE__, __LINE__);
+                           bootstrap.error("base_curr_count"), __FILE__, __LINE__);
     // need to figure out appropriate return code for this...unusual error
     return -1;
   }
 
-  if(!omfgThis->singleCurrency() &&
+  // the setup dialog may have added currencies, and with them accounts and
+  // rates to check, so ask again rather than trust what was read at login
+  if (currenciesChanged)
+    bootstrap.refresh(QStringList() << "curr_count" << "gainloss_ok"
+                                    << "period_found" << "missing_xrates");
+
+  bool singleCurrency = ! bootstrap.contains("curr_count")
+                      ? omfgThis->singleCurrency()
+                      : bootstrap.value("curr_count").toInt() <= 1;
+  if(!singleCurrency &&
      _metrics->value("GLCompanySize").toInt() == 0)
   {
     // Check for the gain/loss and discrep accounts
-    main.prepare("SELECT COALESCE((SELECT TRUE"
-              "                   FROM accnt, metric"
-              "                  WHERE ((CAST(accnt_id AS text)=metric_value)"
-              "                    AND  (metric_name='CurrencyGainLossAccount'))), FALSE)"
-              "   AND COALESCE((SELECT TRUE"
-              "                   FROM accnt, metric"
-              "                  WHERE ((CAST(accnt_id AS text)=metric_value)"
-              "                    AND  (metric_name='GLSeriesDiscrepancyAccount'))), FALSE) AS result; ");
-    main.exec();
-    if(main.first() && main.value("result").toBool() != true)
+    if(bootstrap.contains("gainloss_ok") && bootstrap.value("gainloss_ok").toBool() != true)
       QMessageBox::warning( omfgThis, QObject::tr("Additional Configuration Required"),
         QObject::tr("<p>Your system is configured to use multiple Currencies, "
                     "but the Currency Gain/Loss Account and/or the G/L Series "
@@ -761,23 +763,14 @@ int main(int argc, char *argv[])
   }
 
 //  Check for valid current Fiscal period
-  XSqlQuery periodCheck;
-  periodCheck.prepare("SELECT EXISTS(SELECT 1 FROM period "
-            "     WHERE ((current_date BETWEEN period_start AND period_end) "
-            "       AND (NOT period_closed))) AS found; ");
-  periodCheck.exec();
-  if(periodCheck.first() && ! periodCheck.value("found").toBool())
+  if(bootstrap.contains("period_found") && ! bootstrap.value("period_found").toBool())
   {
     createFiscalYear newdlg(NULL);
     (void)newdlg.exec();
   }
 
 //  Check for valid current exchange rates
-  XSqlQuery xrateCheck("SELECT curr_abbr"
-	          "  FROM curr_symbol s JOIN curr_rate r ON s.curr_id = r.curr_id"
-	          "  GROUP BY curr_abbr"
-	          "  HAVING NOT BOOL_OR(current_date BETWEEN curr_effective AND curr_expires);");
-  if (xrateCheck.first())
+  if (! bootstrap.list("missing_xrates").isEmpty())
   {
     if (_privileges->check("MaintainCurrencyRates"))
     {
@@ -802,19 +795,13 @@ int main(int argc, char *argv[])
   }
 
 // Check for presence of password reset requirement and user last reset days
-  XSqlQuery resetCheck("SELECT fetchmetricbool('EnforcePasswordReset') as passreset, "
-                       "       fetchmetricvalue('PasswordResetDays')::TEXT as resetdays, "
-                       "(SELECT current_date - fetchmetricvalue('PasswordResetDays')::INTEGER > "
-                       "(SELECT usrpref_value FROM usrpref WHERE ((usrpref_username = geteffectivextuser()) "
-                       " AND (usrpref_name = 'PasswordResetDate')))::DATE) AS lastreset;");
-  resetCheck.exec();
-  if(resetCheck.first())
+  if(bootstrap.contains("passreset"))
   {
-    if(resetCheck.value("passreset").toBool() && resetCheck.value("lastreset").toBool())
+    if(bootstrap.value("passreset").toBool() && bootstrap.value("lastreset").toBool())
     {
       QMessageBox::warning( omfgThis, QObject::tr("New Password Required"),
         QObject::tr("<p>Your company has a policy of updating passwords every %1 days.  "
-                  "Please change your password before logging out.").arg(resetCheck.value("resetdays").toString()));
+                  "Please change your password before logging out.").arg(bootstrap.value("resetdays").toString()));
       if (_privileges->check("MaintainPreferencesSelf"))
       {
         ParameterList params;
@@ -826,6 +813,10 @@ int main(int argc, char *argv[])
     }
   }
 
+  SessionBootstrap::mark("startup checks");
+  if (DEBUG)
+    qDebug("startup timeline:\n%s", qPrintable(SessionBootstrap::timeline()));
+
   app.exec();
 
 //  Clean up
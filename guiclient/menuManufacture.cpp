@@ -62,6 +62,7 @@
 #include "printWoForm.h"
 
 #include "setup.h"
+#include "windowPool.h"
 
 #include "menuManufacture.h"
 
@@ -259,7 +260,7 @@ void menuManufacture::sNewWorkOrder()
   ParameterList params;
   params.append("mode", "new");
 
-  workOrder *newdlg = new workOrder();
+  workOrder *newdlg = qobject_cast<workOrder*>(WindowPool::instance()->take("workOrder"));
   newdlg->set(params);
   omfgThis->handleNewWindow(newdlg);
 }
@@ -73,6 +73,7 @@
 #include "assignClassCodeToPlannerCode.h"
 
 #include "setup.h"
+#include "windowPool.h"
 
 #include "menuPurchase.h"
 
@@ -312,7 +313,7 @@ void menuPurchase::sNewPurchaseOrder()
   ParameterList params;
   params.append("mode", "new");
 
-  purchaseOrder *newdlg = new purchaseOrder();
+  purchaseOrder *newdlg = qobject_cast<purchaseOrder*>(WindowPool::instance()->take("purchaseOrder"));
   newdlg->set(params);
   omfgThis->handleNewWindow(newdlg);
 }
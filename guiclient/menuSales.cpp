@@ -107,6 +107,7 @@
 #include "allocateReservations.h"
 
 #include "setup.h"
+#include "windowPool.h"
 
 #include "menuSales.h"
 
@@ -443,7 +444,7 @@ void menuSales::sNewQuote()
   ParameterList params;
   params.append("mode", "newQuote");
 
-  salesOrder *newdlg = new salesOrder();
+  salesOrder *newdlg = qobject_cast<salesOrder*>(WindowPool::instance()->take("salesOrder"));
   newdlg->set(params);
   omfgThis->handleNewWindow(newdlg);
 }
@@ -61,6 +61,7 @@
 #include "fixACL.h"
 #include "fixSerial.h"
 #include "dspProcesses.h"
+#include "queryProfilerView.h"
 #include "exportData.h"
 #include "importData.h"
 
@@ -137,6 +138,7 @@ menuSystem::menuSystem(GUIClient *Pparent) :
     { "sys.fixACL",        tr("&Access Control"),  SLOT(sFixACL()),     sysUtilsMenu,  "fixACL+#superuser",           NULL, NULL, true },
     { "sys.fixSerial",     tr("&Serial Columns"),  SLOT(sFixSerial()),  sysUtilsMenu,  "FixSerial+#superuser", NULL, NULL, true },
     { "sys.processes",     tr("&Process/Lock Manager"), SLOT(sProcessManager()), sysUtilsMenu, "#superuser",     NULL, NULL, true },
+    { "sys.queryProfiler", tr("&Query Profiler"),  SLOT(sQueryProfiler()), sysUtilsMenu, "#superuser",         NULL, NULL, true },
     { "separator",      NULL,                         NULL,             sysUtilsMenu, "true",                        NULL, NULL, true },
     { "sys.CSVAtlases",  tr("Maintain CS&V Atlases..."),             SLOT(sCSVAtlases()),  sysUtilsMenu, "ConfigureImportExport", NULL, NULL, loadCSVPlugin() },
     { "sys.importData",    tr("&Import Data"),     SLOT(sImportData()), sysUtilsMenu,  "ImportXML",        NULL, NULL, true },
@@ -374,6 +376,13 @@ void menuSystem::sProcessManager()
   omfgThis->handleNewWindow(new dspProcesses());
 }
 
+void menuSystem::sQueryProfiler()
+{
+  queryProfilerView *view = queryProfilerView::getInstance(omfgThis);
+  view->show();
+  view->raise();
+}
+
 void menuSystem::sExportData()
 {
   omfgThis->handleNewWindow(new exportData());
@@ -64,6 +64,7 @@ class menuSystem : public QObject
     void sFixACL();
     void sFixSerial();
     void sProcessManager();
+    void sQueryProfiler();
     void sExportData();
     void sImportData();
     void sCSVAtlases();
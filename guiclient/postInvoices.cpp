@@ -10,6 +10,7 @@
 
 #include "postInvoices.h"
 
+#include <QCloseEvent>
 #include <QMessageBox>
 #include "guiErrorCheck.h"
 #include <QSqlError>
@@ -18,14 +19,29 @@
 #include "distributeInventory.h"
 #include <openreports.h>
 #include "errorReporter.h"
-#include "storedProcErrorLookup.h"
+#include "invoiceposter.h"
+#include "xtsettings.h"
 
 postInvoices::postInvoices(QWidget* parent, const char* name, bool modal, Qt::WindowFlags fl)
-    : XDialog(parent, name, modal, fl)
+    : XDialog(parent, name, modal, fl),
+      _cancelled(false),
+      _closeWhenDone(false),
+      _distributing(false),
+      _finished(false),
+      _journal(-1),
+      _poster(0)
 {
   setupUi(this);
 
-  connect(_post, SIGNAL(clicked()), this, SLOT(sPost()));
+  connect(_post,  SIGNAL(clicked()), this, SLOT(sPost()));
+  connect(_retry, SIGNAL(clicked()), this, SLOT(sRetry()));
+
+  _log->addColumn(tr("Invoice #"), _orderColumn,   Qt::AlignLeft,   true, "invcnumber");
+  _log->addColumn(tr("Status"),    _docTypeColumn, Qt::AlignCenter, true, "status");
+  _log->addColumn(tr("Message"),   -1,             Qt::AlignLeft,   true, "message");
+
+  _connections->setValue(xtsettingsInt("postInvoices/connections", 4));
+  _progress->setValue(0);
 
   if (_preferences->boolean("XCheckBox/forgetful"))
     _printJournal->setChecked(true);
@@ -116,36 +132,41 @@ void postInvoices::sPost()
   }
   int journalNumber = postPost.value("journal").toInt();
 
-  // Gather invoices to cycle through (create parent itemlocdist records) - logic from postInvoices(boolean, boolean, integer).sql
+  // Gather invoices to post - logic from postInvoices(boolean, boolean, integer).sql
   QList<int> invoiceIds;
   XSqlQuery invoices;
   if (inclZero)
   {
-    invoices.prepare("SELECT invchead_id "
+    invoices.prepare("SELECT invchead_id, invchead_invcnumber "
                      "FROM invchead "
                      "WHERE NOT invchead_posted "
                      "  AND checkInvoiceSitePrivs(invchead_id) "
-                     "  AND (:postUnprinted OR invchead_printed);");
+                     "  AND (:postUnprinted OR invchead_printed) "
+                     "ORDER BY invchead_id;");
   }
   else 
   {
-    invoices.prepare("SELECT invchead_id "
+    invoices.prepare("SELECT invchead_id, invchead_invcnumber "
                      "FROM invchead LEFT OUTER JOIN invcitem ON invchead_id = invcitem_invchead_id "
                      "  LEFT OUTER JOIN item ON invcitem_item_id = item_id "
                      "WHERE NOT invchead_posted "
                      "  AND checkInvoiceSitePrivs(invchead_id) "
                      "  AND (:postUnprinted OR invchead_printed) "
-                     "GROUP BY invchead_id, invchead_freight, invchead_misc_amount "
+                     "GROUP BY invchead_id, invchead_invcnumber, invchead_freight, invchead_misc_amount "
                      "HAVING (COALESCE(SUM(round((invcitem_billed * invcitem_qty_invuomratio) * (invcitem_price / "  
                      "  CASE WHEN (item_id IS NULL) THEN 1 " 
                      "  ELSE invcitem_price_invuomratio END), 2)),0) "
-                     "  + invchead_freight + invchead_misc_amount) > 0;"); 
+                     "  + invchead_freight + invchead_misc_amount) > 0 "
+                     "ORDER BY invchead_id;"); 
   }
   invoices.bindValue(":postUnprinted", QVariant(_postUnprinted->isChecked()));
   invoices.exec();
+  _numbers.clear();
   while (invoices.next())
   {
     invoiceIds.append(invoices.value("invchead_id").toInt());
+    _numbers.insert(invoices.value("invchead_id").toInt(),
+                    invoices.value("invchead_invcnumber").toString());
   }
 
   if (invoiceIds.count() == 0)
@@ -155,171 +176,339 @@ void postInvoices::sPost()
     return;
   }
 
-  int itemlocSeries;
-  // Stage distribution cleanup function to be called on error
-  XSqlQuery cleanup;
-  cleanup.prepare("SELECT deleteitemlocseries(:itemlocSeries, TRUE);");
-  
-  // Get the parent series id
-  XSqlQuery parentSeries;
-  parentSeries.prepare("SELECT NEXTVAL('itemloc_series_seq') AS itemlocSeries;");
-  parentSeries.exec();
-  if (parentSeries.first() && parentSeries.value("itemlocSeries").toInt() > 0)
-  {
-    itemlocSeries = parentSeries.value("itemlocSeries").toInt();
-    cleanup.bindValue(":itemlocSeries", itemlocSeries);
-  }
-  else
-  {
-    ErrorReporter::error(QtCriticalMsg, this, tr("Failed to Retrieve the Next itemloc_series_seq"),
-                            parentSeries, __FILE__, __LINE__);
+  // Invoices with billed inventory that needs location, lot, or serial detail
+  XSqlQuery distq;
+  distq.prepare("SELECT DISTINCT invchead_id "
+                "FROM invchead "
+                " JOIN invcitem ON invcitem_invchead_id = invchead_id "
+                "   AND invcitem_billed <> 0 "
+                "   AND invcitem_updateinv "
+                " JOIN itemsite ON itemsite_item_id = invcitem_item_id "
+                "   AND itemsite_warehous_id = invcitem_warehous_id "
+                "WHERE NOT invchead_posted "
+                " AND itemsite_costmethod != 'J' "
+                " AND (itemsite_loccntrl OR itemsite_controlmethod IN ('L', 'S')) "
+                " AND itemsite_controlmethod != 'N';");
+  distq.exec();
+  _needsDistribution.clear();
+  while (distq.next())
+    _needsDistribution.insert(distq.value("invchead_id").toInt());
+  if (ErrorReporter::error(QtCriticalMsg, this, tr("Error Finding the List of Invoices to Post"),
+                           distq, __FILE__, __LINE__))
     return;
+
+  xtsettingsSetValue("postInvoices/connections", _connections->value());
+
+  _journal = journalNumber;
+  _poster  = new InvoicePoster(journalNumber, this);
+  _poster->setMaxConnections(_connections->value());
+  connect(_poster, SIGNAL(finished()),        this, SLOT(sPosterFinished()));
+  connect(_poster, SIGNAL(progress(int, int)), this, SLOT(sProgress()));
+  connect(_poster, SIGNAL(statusChanged(int, QString, int, QString)),
+          this,    SLOT(sStatusChanged(int, QString, int, QString)));
+
+  _post->setEnabled(false);
+  _postUnprinted->setEnabled(false);
+  _connections->setEnabled(false);
+  _log->clear();
+  _items.clear();
+  _status.clear();
+  _distFailed.clear();
+  _cancelled = false;
+  _progress->setRange(0, invoiceIds.size());
+
+  // invoices that need no detail go straight to the workers; the rest wait
+  // for the user to distribute them while the workers keep going
+  QList<int> distribute;
+  foreach (int invcheadId, invoiceIds)
+  {
+    sStatusChanged(invcheadId, _numbers.value(invcheadId), InvoicePoster::Queued, QString());
+    if (_needsDistribution.contains(invcheadId))
+      distribute.append(invcheadId);
+    else
+      _poster->enqueue(invcheadId, _numbers.value(invcheadId));
   }
 
-  int succeeded = 0;
-  QList<QString> failedInvoiceNumbers;
-  QList<QString> errors;
-  for (int i = 0; i < invoiceIds.size(); i++)
+  postDistributed(distribute);
+}
+
+void postInvoices::postDistributed(QList<int> pInvcheadIds)
+{
+  _distributing = true;
+  for (int i = 0; i < pInvcheadIds.size(); i++)
   {
-    bool invoiceLineFailed = false;
-
-    QString invoiceNumber;
-    int invoiceId = invoiceIds.at(i);
-    // Handle the Inventory and G/L Transactions for any billed Inventory where invcitem_updateinv is true
-    XSqlQuery items;
-    items.prepare("SELECT item_number, itemsite_id, invcitem_id, "
-                  " (invcitem_billed * invcitem_qty_invuomratio) AS qty, "
-                  " invchead_invcnumber "
-                  "FROM invchead " 
-                  " JOIN invcitem ON invcitem_invchead_id = invchead_id "
-                  "   AND invcitem_billed <> 0 " 
-                  "   AND invcitem_updateinv "
-                  " JOIN itemsite ON itemsite_item_id = invcitem_item_id " 
-                  "   AND itemsite_warehous_id = invcitem_warehous_id "
-                  " JOIN item ON item_id = invcitem_item_id "
-                  "WHERE invchead_id = :invchead_id "
-                  " AND itemsite_costmethod != 'J' "
-                  " AND (itemsite_loccntrl OR itemsite_controlmethod IN ('L', 'S')) "
-                  " AND itemsite_controlmethod != 'N' "
-                  "ORDER BY invcitem_id;");
-    items.bindValue(":invchead_id", invoiceId);
-    items.exec();
-    while (items.next())
+    int     invcheadId = pInvcheadIds.at(i);
+    QString number     = _numbers.value(invcheadId);
+    if (_cancelled)
     {
-      invoiceNumber = items.value("invchead_invcnumber").toString();
-      // Create the parent itemlocdist record for each line item requiring distribution, call distributeInventory::seriesAdjust
-      XSqlQuery parentItemlocdist;
-      parentItemlocdist.prepare("SELECT createitemlocdistparent(:itemsite_id, :qty, 'IN', "
-                                " :orderitemId, :itemlocSeries, NULL, NULL, 'SH');");
-      parentItemlocdist.bindValue(":itemsite_id", items.value("itemsite_id").toInt());
-      parentItemlocdist.bindValue(":qty", items.value("qty").toDouble() * -1);
-      parentItemlocdist.bindValue(":orderitemId", items.value("invcitem_id").toInt());
-      parentItemlocdist.bindValue(":itemlocSeries", itemlocSeries);
-      parentItemlocdist.exec();
-      if (!parentItemlocdist.first())
-      {
-        cleanup.exec();
-        failedInvoiceNumbers.append(invoiceNumber);
-        errors.append(tr("Error Creating itemlocdist Record for item %1").arg(items.value("item_number").toString()));
-        invoiceLineFailed = true;
-        break;
-      }
+      _distFailed.insert(invcheadId);
+      sStatusChanged(invcheadId, number, InvoicePoster::Cancelled, QString());
+      continue;
     }
 
-    if (invoiceLineFailed)
+    QString errmsg;
+    int     series     = distribute(invcheadId, errmsg);
+    if (series > 0)
+    {
+      _distFailed.remove(invcheadId);
+      _poster->enqueue(invcheadId, number, series);
       continue;
+    }
+
+    _distFailed.insert(invcheadId);
+    sStatusChanged(invcheadId, number, InvoicePoster::Error, errmsg);
 
-    // Distribute the items from above
-    if (items.size() > 0 && distributeInventory::SeriesAdjust(itemlocSeries, this, QString(), QDate(), QDate(), true)
-      == XDialog::Rejected)
+    if (series < 0 && i < pInvcheadIds.size() - 1 &&
+        QMessageBox::question(this,  tr("Post Invoices"),
+          tr("Posting distribution detail for invoice number %1 was cancelled but "
+             "there other invoices to Post. Continue posting the remaining invoices?")
+          .arg(number),
+          QMessageBox::Yes | QMessageBox::No, QMessageBox::No) == QMessageBox::No)
     {
-      cleanup.exec();
-      if (QMessageBox::question(this,  tr("Post Invoices"),
-        tr("Posting distribution detail for invoice number %1 was cancelled but "
-           "there other invoices to Post. Continue posting the remaining invoices?")
-        .arg(invoiceNumber), 
-        QMessageBox::Yes | QMessageBox::No, QMessageBox::No) == QMessageBox::Yes)
+      for (i++; i < pInvcheadIds.size(); i++)
       {
-        failedInvoiceNumbers.append(invoiceNumber);
-        errors.append(tr("Detail Distribution Cancelled"));
-        continue;
-      }
-      else
-      {
-        failedInvoiceNumbers.append(invoiceNumber);
-        errors.append(tr("Detail Distribution Cancelled"));
-        break;
+        _distFailed.insert(pInvcheadIds.at(i));
+        sStatusChanged(pInvcheadIds.at(i), _numbers.value(pInvcheadIds.at(i)),
+                       InvoicePoster::Cancelled, QString());
       }
+      _poster->cancel();
+      break;
     }
+  }
+  _distributing = false;
 
-    // TODO - remove this after postInvoice has had the remaining negative error codes replaced with RAISE EXCEPTIONs
-    XSqlQuery rollback;
-    rollback.prepare("ROLLBACK;");
-
-    // Post invoice
-    XSqlQuery post;
-    post.exec("BEGIN;");
-    post.prepare("SELECT postInvoice(:invchead_id, :journal, :itemlocSeries, true) AS result;");
-    post.bindValue(":invchead_id", invoiceIds.at(i));
-    post.bindValue(":journal", journalNumber);
-    post.bindValue(":itemlocSeries", itemlocSeries);
-    post.exec();
-    if (post.first())
-    {
-      int result = post.value("result").toInt();
-      if (result < 0 || result != itemlocSeries)
-      {
-        rollback.exec();
-        cleanup.exec();
-        failedInvoiceNumbers.append(invoiceNumber);
-        if (result < 0)
-          errors.append(tr("Error Posting Invoice. %1").arg(storedProcErrorLookup("postInvoice", result)));
-        if (result > 0)
-          errors.append(tr("Error Posting Invoice. Expected: %1, returned: %2").arg(itemlocSeries).arg(result));
-        continue;
-      }
+  sProgress();
+  if (_poster->isIdle())
+    sPosterFinished();
+}
 
-      if (!_taxIntegration->commit("INV", invoiceIds.at(i)))
-      {
-        rollback.exec();
-        cleanup.exec();
-        failedInvoiceNumbers.append(invoiceNumber);
-        errors.append(_taxIntegration->error());
-        continue;
-      }
-    }
-    else if (postPost.lastError().type() != QSqlError::NoError)
+/* Create the parent itemlocdist records for an invoice's controlled items
+   and let the user distribute them. Returns the itemloc series on success,
+   0 on error, and -1 if the user cancelled.
+ */
+int postInvoices::distribute(int pInvcheadId, QString &pErrMsg)
+{
+  XSqlQuery parentSeries;
+  parentSeries.exec("SELECT NEXTVAL('itemloc_series_seq') AS itemlocSeries;");
+  if (! parentSeries.first() || parentSeries.value("itemlocSeries").toInt() <= 0)
+  {
+    pErrMsg = tr("Failed to Retrieve the Next itemloc_series_seq");
+    return 0;
+  }
+  int itemlocSeries = parentSeries.value("itemlocSeries").toInt();
+
+  // Stage distribution cleanup function to be called on error
+  XSqlQuery cleanup;
+  cleanup.prepare("SELECT deleteitemlocseries(:itemlocSeries, TRUE);");
+  cleanup.bindValue(":itemlocSeries", itemlocSeries);
+
+  // Handle the Inventory and G/L Transactions for any billed Inventory where invcitem_updateinv is true
+  XSqlQuery items;
+  items.prepare("SELECT item_number, itemsite_id, invcitem_id, "
+                " (invcitem_billed * invcitem_qty_invuomratio) AS qty "
+                "FROM invchead " 
+                " JOIN invcitem ON invcitem_invchead_id = invchead_id "
+                "   AND invcitem_billed <> 0 " 
+                "   AND invcitem_updateinv "
+                " JOIN itemsite ON itemsite_item_id = invcitem_item_id " 
+                "   AND itemsite_warehous_id = invcitem_warehous_id "
+                " JOIN item ON item_id = invcitem_item_id "
+                "WHERE invchead_id = :invchead_id "
+                " AND itemsite_costmethod != 'J' "
+                " AND (itemsite_loccntrl OR itemsite_controlmethod IN ('L', 'S')) "
+                " AND itemsite_controlmethod != 'N' "
+                "ORDER BY invcitem_id;");
+  items.bindValue(":invchead_id", pInvcheadId);
+  items.exec();
+  while (items.next())
+  {
+    // Create the parent itemlocdist record for each line item requiring distribution, call distributeInventory::seriesAdjust
+    XSqlQuery parentItemlocdist;
+    parentItemlocdist.prepare("SELECT createitemlocdistparent(:itemsite_id, :qty, 'IN', "
+                              " :orderitemId, :itemlocSeries, NULL, NULL, 'SH');");
+    parentItemlocdist.bindValue(":itemsite_id", items.value("itemsite_id").toInt());
+    parentItemlocdist.bindValue(":qty", items.value("qty").toDouble() * -1);
+    parentItemlocdist.bindValue(":orderitemId", items.value("invcitem_id").toInt());
+    parentItemlocdist.bindValue(":itemlocSeries", itemlocSeries);
+    parentItemlocdist.exec();
+    if (!parentItemlocdist.first())
     {
-      rollback.exec();
       cleanup.exec();
-      failedInvoiceNumbers.append(invoiceNumber);
-      errors.append(postPost.lastError().text());
+      pErrMsg = tr("Error Creating itemlocdist Record for item %1").arg(items.value("item_number").toString());
+      return 0;
+    }
+  }
+
+  // Distribute the items from above
+  if (items.size() > 0 && distributeInventory::SeriesAdjust(itemlocSeries, this, QString(), QDate(), QDate(), true)
+    == XDialog::Rejected)
+  {
+    cleanup.exec();
+    pErrMsg = tr("Detail Distribution Cancelled");
+    return -1;
+  }
+
+  return itemlocSeries;
+}
+
+void postInvoices::sRetry()
+{
+  QList<int> distribute;
+  for (int i = 0; i < _log->topLevelItemCount(); i++)
+  {
+    int invcheadId = _log->topLevelItem(i)->id();
+    int status     = _status.value(invcheadId);
+    if (status != InvoicePoster::Error && status != InvoicePoster::Cancelled)
       continue;
+
+    if (_needsDistribution.contains(invcheadId) && ! _poster->isTaxPending(invcheadId))
+    {
+      distribute.append(invcheadId);
+      sStatusChanged(invcheadId, _numbers.value(invcheadId), InvoicePoster::Queued, QString());
     }
-    succeeded++;
-    post.exec("COMMIT;");
+    else
+      _poster->enqueue(invcheadId, _numbers.value(invcheadId));
   }
 
-  if (errors.size() > 0)
+  _retry->setEnabled(false);
+  _cancelled     = false;
+  _closeWhenDone = false;
+  postDistributed(distribute);
+}
+
+void postInvoices::sProgress()
+{
+  if (! _poster)
+    return;
+
+  int done = _poster->totalCount() - _poster->pendingCount() + _distFailed.size();
+  _progress->setValue(done);
+  _progress->setFormat(tr("%1 of %2 (%3 per minute)")
+                       .arg(done).arg(_progress->maximum())
+                       .arg(qRound(_poster->invoicesPerMinute())));
+}
+
+void postInvoices::sStatusChanged(int pInvcheadId, const QString &pNumber, int pStatus, const QString &pMessage)
+{
+  XTreeWidgetItem *item = _items.value(pInvcheadId);
+  if (! item)
   {
-    QMessageBox dlg(QMessageBox::Critical, "Errors Posting Invoice", "", QMessageBox::Ok, this);
-    dlg.setText(tr("%1 Invoices succeeded.\n%2 Invoices failed.").arg(succeeded).arg(failedInvoiceNumbers.size()));
+    item = new XTreeWidgetItem(_log, pInvcheadId, QVariant(pNumber));
+    _items.insert(pInvcheadId, item);
+  }
+  item->setText(_log->column("status"),  statusText(pStatus));
+  item->setText(_log->column("message"), pMessage);
+  _status.insert(pInvcheadId, pStatus);
 
-    QString details;
-    for (int i=0; i<failedInvoiceNumbers.size(); i++)
-      details += tr("Invoice number %1 failed with:\n%2\n").arg(failedInvoiceNumbers[i]).arg(errors[i]);
-    dlg.setDetailedText(details);
+  if (pStatus == InvoicePoster::Error)
+    item->setTextColor(namedColor("error"));
+  else
+    item->setTextColor(_log->palette().color(QPalette::Text));
+}
+
+QString postInvoices::statusText(int pStatus)
+{
+  switch (pStatus)
+  {
+    case InvoicePoster::Queued:    return tr("Queued");
+    case InvoicePoster::Running:   return tr("Posting");
+    case InvoicePoster::Posted:    return tr("Posted");
+    case InvoicePoster::Error:     return tr("Error");
+    case InvoicePoster::Cancelled: return tr("Cancelled");
+  }
+  return QString();
+}
+
+void postInvoices::sPosterFinished()
+{
+  if (_distributing || ! _poster || ! _poster->isIdle())
+    return;
 
-    dlg.exec();
+  int failed = 0;
+  foreach (int status, _status)
+  {
+    if (status == InvoicePoster::Error || status == InvoicePoster::Cancelled)
+      failed++;
+  }
+
+  sProgress();
+  if (failed == 0)
+  {
+    finishPosting();
+    accept();
+    return;
   }
 
+  _retry->setEnabled(true);
+  _close->setText(tr("&Close"));
+  if (_closeWhenDone)
+  {
+    close();
+    return;
+  }
+
+  QMessageBox::critical(this, tr("Errors Posting Invoice"),
+                        tr("%1 Invoices succeeded.\n%2 Invoices failed.\n"
+                           "The reasons are listed next to each Invoice.")
+                        .arg(_poster->postedCount()).arg(failed));
+}
+
+void postInvoices::closeEvent(QCloseEvent *event)
+{
+  if (stillPosting())
+  {
+    event->ignore();
+    return;
+  }
+
+  finishPosting();
+  XDialog::closeEvent(event);
+}
+
+// Esc hides the dialog without a close event, so finish here too
+void postInvoices::reject()
+{
+  if (stillPosting())
+    return;
+
+  finishPosting();
+  XDialog::reject();
+}
+
+/* If invoices are still being posted, offer to stop once the ones in
+   progress are done and return true so the caller stays open.
+ */
+bool postInvoices::stillPosting()
+{
+  if (! _distributing && (! _poster || _poster->isIdle()))
+    return false;
+
+  if (QMessageBox::question(this, tr("Post Invoices"),
+                            tr("Invoices are still being posted. Stop once the "
+                               "Invoices in progress are done?"),
+                            QMessageBox::Yes | QMessageBox::No,
+                            QMessageBox::No) == QMessageBox::Yes)
+  {
+    _cancelled     = true;
+    _closeWhenDone = true;
+    _poster->cancel();
+  }
+  return true;
+}
+
+void postInvoices::finishPosting()
+{
+  if (_finished || ! _poster || _poster->postedCount() == 0)
+    return;
+  _finished = true;
+
   if (_printJournal->isChecked())
   {
     ParameterList params;
     params.append("source", "A/R");
     params.append("sourceLit", tr("A/R"));
-    params.append("startJrnlnum", journalNumber);
-    params.append("endJrnlnum", journalNumber);
+    params.append("startJrnlnum", _journal);
+    params.append("endJrnlnum", _journal);
 
     if (_metrics->boolean("UseJournals"))
     {
@@ -342,5 +531,4 @@ void postInvoices::sPost()
 
   omfgThis->sInvoicesUpdated(-1, true);
   omfgThis->sSalesOrdersUpdated(-1);
-  accept();
 }
@@ -11,10 +11,16 @@
 #ifndef POSTINVOICES_H
 #define POSTINVOICES_H
 
+#include <QHash>
+#include <QList>
+#include <QSet>
+
 #include "guiclient.h"
 #include "xdialog.h"
 #include "ui_postInvoices.h"
 
+class InvoicePoster;
+
 class postInvoices : public XDialog, public Ui::postInvoices
 {
     Q_OBJECT
@@ -24,11 +30,36 @@ public:
     ~postInvoices();
 
 public slots:
+    virtual void reject();
     virtual void sPost();
+    virtual void sRetry();
 
 protected slots:
     virtual void languageChange();
+    virtual void sPosterFinished();
+    virtual void sProgress();
+    virtual void sStatusChanged(int pInvcheadId, const QString &pNumber, int pStatus, const QString &pMessage);
+
+protected:
+    virtual void closeEvent(QCloseEvent *event);
+    virtual int  distribute(int pInvcheadId, QString &pErrMsg);
+    virtual void finishPosting();
+    virtual void postDistributed(QList<int> pInvcheadIds);
+    virtual QString statusText(int pStatus);
+    virtual bool stillPosting();
 
+private:
+    bool                         _cancelled;
+    bool                         _closeWhenDone;
+    bool                         _distributing;
+    QSet<int>                    _distFailed;
+    bool                         _finished;
+    QHash<int, XTreeWidgetItem*> _items;
+    int                          _journal;
+    QSet<int>                    _needsDistribution;
+    QHash<int, QString>          _numbers;
+    InvoicePoster               *_poster;
+    QHash<int, int>              _status;
 };
 
 #endif // POSTINVOICES_H
@@ -18,6 +18,7 @@
 
 #include "errorReporter.h"
 #include "guiErrorCheck.h"
+#include "itembundle.h"
 #include "mqlutil.h"
 #include "taxBreakdown.h"
 #include "itemCharacteristicDelegate.h"
@@ -186,6 +187,7 @@ enum SetResponse purchaseOrderItem::set(const ParameterList &pParams)
     {
       _poNumber->setText(purchaseet.value("pohead_number").toString());
       _poStatus = purchaseet.value("pohead_status").toString();
+      _vendid = purchaseet.value("vend_id").toInt();
       _unitPrice->setEffective(purchaseet.value("pohead_orderdate").toDate());
       _unitPrice->setId(purchaseet.value("pohead_curr_id").toInt());
 	  _taxzoneid=purchaseet.value("pohead_taxzone_id").toInt();   // added  to pick up tax zone id.
@@ -993,22 +995,24 @@ void purchaseOrderItem::sFindWarehouseItemsites( int id )
   }
 }
 
+ItemBundleRequest purchaseOrderItem::bundleRequest(int pItemid) const
+{
+  ItemBundleRequest request(pItemid, _warehouse->id());
+  request.vendid    = _vendid;
+  request.taxzoneid = _taxzoneid;
+  request.effective = _unitPrice->effective();
+  return request;
+}
+
 void purchaseOrderItem::sPopulateItemInfo(int pItemid)
 {
-  XSqlQuery item;
   if (pItemid != -1 && _mode == cNew)
   {
-      item.prepare("SELECT stdCost(item_id) AS stdcost, "
-                   "       getItemTaxType(item_id, pohead_taxzone_id) AS taxtype_id, "
-                   "       item_tax_recoverable, COALESCE(item_maxcost, 0.0) AS maxcost "
-                   "FROM item, pohead "
-                   "WHERE ( (item_id=:item_id) "
-                   "  AND   (pohead_id=:pohead_id) );");
-      item.bindValue(":item_id", pItemid);
-      item.bindValue(":pohead_id", _poheadid);
-      item.exec();
-
-      if (item.first())
+      ItemBundle item = ItemBundleCache::instance()->bundle(bundleRequest(pItemid));
+      if (! item.lastError().isEmpty())
+        ErrorReporter::error(QtCriticalMsg, this, tr("Error Retrieving Item Information"),
+                             item.lastError(), __FILE__, __LINE__);
+      else if (item.isValid())
       {
           // Reset order qty cache
           _orderQtyCache = -1;
@@ -1030,33 +1034,15 @@ void purchaseOrderItem::sPopulateItemInfo(int pItemid)
         sPopulateItemsiteInfo();
         sPopulateItemChar();
 
-        item.prepare("SELECT itemsrc_id "
-                     "FROM itemsrc, pohead "
-                     "WHERE ( (itemsrc_vend_id=pohead_vend_id)"
-                     " AND (itemsrc_item_id=:item_id)"
-                     " AND (:effective BETWEEN itemsrc_effective AND (itemsrc_expires - 1))"
-                     " AND (itemsrc_active)"
-                     " AND (pohead_id=:pohead_id) );" );
-        item.bindValue(":item_id", pItemid);
-        item.bindValue(":pohead_id", _poheadid);
-        item.bindValue(":effective", _unitPrice->effective());
-        item.exec();
-        if (item.size() == 1)
+        QList<int> itemsrcids = item.itemsrcIds();
+        if (itemsrcids.size() == 1)
         {
-          item.first();
-
-          if (item.value("itemsrc_id").toInt() != _itemsrcid)
-            sPopulateItemSourceInfo(item.value("itemsrc_id").toInt());
+          if (itemsrcids.first() != _itemsrcid)
+            sPopulateItemSourceInfo(itemsrcids.first());
         }
-        else if (item.size() > 1)
+        else if (itemsrcids.size() > 1)
         {
-          bool isCurrent = false;
-          while (item.next())
-          {
-            if (item.value("itemsrc_id").toInt() == _itemsrcid)
-              isCurrent = true;
-          }
-          if (!isCurrent)
+          if (! itemsrcids.contains(_itemsrcid))
           {
             _vendorItemNumber->clear();
             sVendorItemNumberList();
@@ -1143,17 +1129,10 @@ void purchaseOrderItem::sPopulateItemChar()
 
 void purchaseOrderItem::sPopulateItemsiteInfo()
 {
-  XSqlQuery itemsite;
   if (_item->isValid() && _warehouse->isValid())
   {
-    itemsite.prepare("SELECT * "
-                     "FROM itemsite "
-                     "WHERE ( (itemsite_item_id=:item_id) "
-                     "  AND   (itemsite_warehous_id=:warehous_id) );");
-    itemsite.bindValue(":item_id", _item->id());
-    itemsite.bindValue(":warehous_id", _warehouse->id());
-    itemsite.exec();
-    if (itemsite.first())
+    ItemBundle itemsite = ItemBundleCache::instance()->bundle(bundleRequest(_item->id()));
+    if (itemsite.hasItemsite())
     {
        _costmethod = itemsite.value("itemsite_costmethod").toString();
        if (_costmethod == "J")
@@ -17,6 +17,8 @@
 #include <parameter.h>
 #include "ui_purchaseOrderItem.h"
 
+class ItemBundleRequest;
+
 class purchaseOrderItem : public XDialog, public Ui::purchaseOrderItem
 {
     Q_OBJECT
@@ -66,6 +68,8 @@ protected slots:
 
 
 private:
+    ItemBundleRequest bundleRequest(int pItemid) const;
+
     int _itemsrcid;
     int _mode;
     int _poheadid;
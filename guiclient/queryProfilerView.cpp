@@ -0,0 +1,207 @@
+/*
+ * This file is part of the xTuple ERP: PostBooks Edition, a free and
+ * open source Enterprise Resource Planning software suite,
+ * Copyright (c) 1999-2019 by OpenMFG LLC, d/b/a xTuple.
+ * It is licensed to you under the Common Public Attribution License
+ * version 1.0, the full text of which (including xTuple-specific Exhibits)
+ * is available at www.xtuple.com/CPAL.  By using this software, you agree
+ * to be bound by its terms.
+ */
+
+#include "queryProfilerView.h"
+
+#include <QAction>
+#include <QCheckBox>
+#include <QCloseEvent>
+#include <QLabel>
+#include <QToolBar>
+#include <QVBoxLayout>
+
+#include "format.h"
+#include "guiclient.h"
+#include "queryprofiler.h"
+#include "xtreewidget.h"
+
+#define DEBUG false
+
+#define cTurn      0
+#define cTime      1
+#define cWindow    2
+#define cSource    3
+#define cElapsed   4
+#define cRows      5
+#define cDuplicate 6
+#define cRepeated  7
+#define cSql       8
+#define cParams    9
+
+static queryProfilerView *queryProfilerViewSingleton = 0;
+
+queryProfilerView *queryProfilerView::getInstance(QWidget *parent)
+{
+  if (! queryProfilerViewSingleton)
+    queryProfilerViewSingleton = new queryProfilerView(parent);
+  return queryProfilerViewSingleton;
+}
+
+queryProfilerView::queryProfilerView(QWidget *parent)
+  : QDockWidget(tr("Query Profiler"), parent),
+    _duplicates(0),
+    _repeated(0)
+{
+  setObjectName("queryProfilerView");
+  setAttribute(Qt::WA_DeleteOnClose);
+
+  QWidget     *container = new QWidget(this);
+  QVBoxLayout *layout    = new QVBoxLayout(container);
+  QToolBar    *toolbar   = new QToolBar(container);
+
+  _record = toolbar->addAction(tr("Record"));
+  _record->setCheckable(true);
+  QAction *clearAct  = toolbar->addAction(tr("Clear"));
+  QAction *exportAct = toolbar->addAction(tr("Export..."));
+  toolbar->addSeparator();
+  _problemsOnly = new QCheckBox(tr("Duplicates and N+1 only"), toolbar);
+  toolbar->addWidget(_problemsOnly);
+
+  _summary = new QLabel(container);
+
+  _list = new XTreeWidget(container);
+  _list->setObjectName("_list");
+  _list->addColumn(tr("Turn"),       _seqColumn,      Qt::AlignRight, true,  "turn");
+  _list->addColumn(tr("Time"),       _timeColumn,     Qt::AlignLeft,  true,  "time");
+  _list->addColumn(tr("Window"),     _itemColumn,     Qt::AlignLeft,  true,  "window");
+  _list->addColumn(tr("Source"),     _itemColumn,     Qt::AlignLeft,  true,  "source");
+  _list->addColumn(tr("ms"),         _qtyColumn,      Qt::AlignRight, true,  "elapsed");
+  _list->addColumn(tr("Rows"),       _qtyColumn,      Qt::AlignRight, true,  "rows");
+  _list->addColumn(tr("Duplicate"),  _ynColumn,       Qt::AlignCenter, true, "duplicate");
+  _list->addColumn(tr("N+1"),        _ynColumn,       Qt::AlignCenter, true, "repeated");
+  _list->addColumn(tr("SQL"),        -1,              Qt::AlignLeft,  true,  "sql");
+  _list->addColumn(tr("Parameters"), -1,              Qt::AlignLeft,  false, "params");
+
+  layout->setContentsMargins(0, 0, 0, 0);
+  layout->setSpacing(0);
+  layout->addWidget(toolbar);
+  layout->addWidget(_summary);
+  layout->addWidget(_list);
+  setWidget(container);
+
+  QueryProfiler *profiler = QueryProfiler::instance();
+  connect(_record,       SIGNAL(toggled(bool)),   this,  SLOT(sRecord(bool)));
+  connect(clearAct,      SIGNAL(triggered()),     profiler, SLOT(clear()));
+  connect(exportAct,     SIGNAL(triggered()),     _list, SLOT(sExport()));
+  connect(_problemsOnly, SIGNAL(toggled(bool)),   this,  SLOT(sShowProblemsOnly(bool)));
+  connect(profiler,      SIGNAL(recorded(int)),   this,  SLOT(sRecorded(int)));
+  connect(profiler,      SIGNAL(flagged(int)),    this,  SLOT(sFlagged(int)));
+  connect(profiler,      SIGNAL(dropped(int)),    this,  SLOT(sDropped(int)));
+  connect(profiler,      SIGNAL(cleared()),       this,  SLOT(sClear()));
+
+  foreach (QueryProfile profile, profiler->profiles())
+    sRecorded(profile.serial);
+  _record->setChecked(QueryProfiler::isEnabled());
+  updateSummary();
+
+  omfgThis->addDockWidget(Qt::BottomDockWidgetArea, this);
+}
+
+queryProfilerView::~queryProfilerView()
+{
+  QueryProfiler::instance()->setEnabled(false);
+  queryProfilerViewSingleton = 0;
+}
+
+void queryProfilerView::closeEvent(QCloseEvent *pEvent)
+{
+  _record->setChecked(false);
+  QDockWidget::closeEvent(pEvent);
+}
+
+void queryProfilerView::sClear()
+{
+  _list->clear();
+  _items.clear();
+  _duplicates = 0;
+  _repeated   = 0;
+  updateSummary();
+}
+
+void queryProfilerView::sRecord(bool pRecord)
+{
+  QueryProfiler::instance()->setEnabled(pRecord);
+}
+
+void queryProfilerView::sRecorded(int pSerial)
+{
+  XTreeWidgetItem *item = new XTreeWidgetItem(_list, pSerial);
+  _items.insert(pSerial, item);
+  updateItem(item, pSerial);
+}
+
+/* The profiler keeps a limited number of records; let the oldest go too. */
+void queryProfilerView::sDropped(int pSerial)
+{
+  XTreeWidgetItem *item = _items.take(pSerial);
+  if (! item)
+    return;
+
+  _duplicates -= item->data(cDuplicate, Xt::RawRole).toBool() ? 1 : 0;
+  _repeated   -= item->data(cRepeated,  Xt::RawRole).toBool() ? 1 : 0;
+  delete item;
+  updateSummary();
+}
+
+/* An earlier query turned out to be part of an N+1 loop. */
+void queryProfilerView::sFlagged(int pSerial)
+{
+  XTreeWidgetItem *item = _items.value(pSerial);
+  if (item)
+    updateItem(item, pSerial);
+}
+
+void queryProfilerView::sShowProblemsOnly(bool pOnly)
+{
+  QueryProfiler *profiler = QueryProfiler::instance();
+  foreach (int serial, _items.keys())
+  {
+    QueryProfile profile = profiler->profile(serial);
+    _items.value(serial)->setHidden(pOnly && ! profile.duplicate && ! profile.repeated);
+  }
+}
+
+void queryProfilerView::updateItem(XTreeWidgetItem *pItem, int pSerial)
+{
+  QueryProfile profile = QueryProfiler::instance()->profile(pSerial);
+  bool wasDuplicate = pItem->data(cDuplicate, Xt::RawRole).toBool();
+  bool wasRepeated  = pItem->data(cRepeated,  Xt::RawRole).toBool();
+
+  pItem->setText(cTurn,      QString::number(profile.turn));
+  pItem->setText(cTime,      profile.when.time().toString("hh:mm:ss.zzz"));
+  pItem->setText(cWindow,    profile.window);
+  pItem->setText(cSource,    profile.source);
+  pItem->setText(cElapsed,   profile.elapsed < 0 ? QString() : QString::number(profile.elapsed));
+  pItem->setText(cRows,      profile.rows    < 0 ? QString() : QString::number(profile.rows));
+  pItem->setText(cDuplicate, profile.duplicate ? tr("Yes") : QString());
+  pItem->setText(cRepeated,  profile.repeated  ? tr("Yes") : QString());
+  pItem->setText(cSql,       profile.sql);
+  pItem->setText(cParams,    profile.params);
+  pItem->setData(cDuplicate, Xt::RawRole, profile.duplicate);
+  pItem->setData(cRepeated,  Xt::RawRole, profile.repeated);
+  pItem->setToolTip(cSql, profile.sql);
+
+  if (profile.repeated)
+    pItem->setTextColor(namedColor("error"));
+  else if (profile.duplicate)
+    pItem->setTextColor(namedColor("warning"));
+
+  pItem->setHidden(_problemsOnly->isChecked() && ! profile.duplicate && ! profile.repeated);
+
+  _duplicates += (profile.duplicate ? 1 : 0) - (wasDuplicate ? 1 : 0);
+  _repeated   += (profile.repeated  ? 1 : 0) - (wasRepeated  ? 1 : 0);
+  updateSummary();
+}
+
+void queryProfilerView::updateSummary()
+{
+  _summary->setText(tr("%1 queries, %2 duplicates, %3 in N+1 loops")
+                    .arg(_items.size()).arg(_duplicates).arg(_repeated));
+}
@@ -0,0 +1,62 @@
+/*
+ * This file is part of the xTuple ERP: PostBooks Edition, a free and
+ * open source Enterprise Resource Planning software suite,
+ * Copyright (c) 1999-2019 by OpenMFG LLC, d/b/a xTuple.
+ * It is licensed to you under the Common Public Attribution License
+ * version 1.0, the full text of which (including xTuple-specific Exhibits)
+ * is available at www.xtuple.com/CPAL.  By using this software, you agree
+ * to be bound by its terms.
+ */
+
+#ifndef __QUERYPROFILERVIEW_H__
+#define __QUERYPROFILERVIEW_H__
+
+#include <QDockWidget>
+#include <QHash>
+
+class QAction;
+class QCheckBox;
+class QLabel;
+class XTreeWidget;
+class XTreeWidgetItem;
+
+/** @brief A dockable list of the queries recorded by the QueryProfiler.
+
+    Profiling runs while Record is checked. Duplicates and statements that
+    look like N+1 loops are highlighted and can be shown on their own.
+    The list can be exported with Export or from its context menu.
+ */
+class queryProfilerView : public QDockWidget
+{
+  Q_OBJECT
+
+  public:
+    static queryProfilerView *getInstance(QWidget *parent = 0);
+    ~queryProfilerView();
+
+  public slots:
+    void sClear();
+    void sDropped(int pSerial);
+    void sFlagged(int pSerial);
+    void sRecorded(int pSerial);
+    void sRecord(bool pRecord);
+    void sShowProblemsOnly(bool pOnly);
+
+  protected:
+    void closeEvent(QCloseEvent *pEvent);
+    void updateItem(XTreeWidgetItem *pItem, int pSerial);
+    void updateSummary();
+
+    QHash<int, XTreeWidgetItem*> _items;
+    XTreeWidget *_list;
+    QCheckBox   *_problemsOnly;
+    QAction     *_record;
+    QLabel      *_summary;
+    int          _duplicates;
+    int          _repeated;
+
+  private:
+    queryProfilerView(QWidget *parent = 0);
+};
+
+#endif
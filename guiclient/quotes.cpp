@@ -28,6 +28,7 @@
 #include "salesOrder.h"
 #include "copyQuote.h"
 #include "storedProcErrorLookup.h"
+#include "windowPool.h"
 
 quotes::quotes(QWidget* parent, const char *name, Qt::WindowFlags fl)
   : display(parent, "quotes", fl)
@@ -184,23 +185,26 @@ void quotes::sConvert(int pType)
       QList<XTreeWidgetItem*> selected = list()->selectedItems();
       QList<XTreeWidgetItem*> notConverted;
 
+      QVariantList ids;
+      foreach (XTreeWidgetItem *item, selected)
+        ids << item->id();
+      if (!_lock.acquireAll("quhead", ids, AppLock::Interactive))
+      {
+        QMessageBox::critical(this, tr("Cannot Convert"),
+                              tr("<p>One or more of the selected Quotes is"
+                                 " being edited.  You cannot convert a Quote"
+                                 " that is being edited."));
+        return;
+      }
+      if (! _lock.release())
+      {
+        ErrorReporter::error(QtCriticalMsg, this, tr("Locking Error"),
+                             _lock.lastError(), __FILE__, __LINE__);
+        return;
+      }
+
       foreach (XTreeWidgetItem *item, list()->selectedItems())
       {
-        if (!_lock.acquire("quhead", item->id(), AppLock::Interactive))
-        {
-          QMessageBox::critical(this, tr("Cannot Convert"),
-                                tr("<p>One or more of the selected Quotes is"
-                                   " being edited.  You cannot convert a Quote"
-                                   " that is being edited."));
-          return;
-        }
-        if (! _lock.release())
-        {
-          ErrorReporter::error(QtCriticalMsg, this, tr("Locking Error"),
-                               _lock.lastError(), __FILE__, __LINE__);
-          return;
-        }
-        
         if (checkSitePrivs(item->id()))
         {
           int quheadid = item->id();
@@ -405,7 +409,7 @@ void quotes::sNew()
   params.append("mode", "newQuote");
   parameterWidget()->appendValue(params); // To pick up customer id, if any
       
-  salesOrder *newdlg = new salesOrder(this);
+  salesOrder *newdlg = qobject_cast<salesOrder*>(WindowPool::instance()->take("salesOrder", this));
   newdlg->set(params);
   omfgThis->handleNewWindow(newdlg);
 }
@@ -420,7 +424,7 @@ void quotes::sEdit()
       params.append("mode", "editQuote");
       params.append("quhead_id", item->id());
     
-      salesOrder *newdlg = new salesOrder(this);
+      salesOrder *newdlg = qobject_cast<salesOrder*>(WindowPool::instance()->take("salesOrder", this));
       newdlg->set(params);
       omfgThis->handleNewWindow(newdlg);
       break;
@@ -438,7 +442,7 @@ void quotes::sView()
       params.append("mode", "viewQuote");
       params.append("quhead_id", item->id());
       
-      salesOrder *newdlg = new salesOrder(this);
+      salesOrder *newdlg = qobject_cast<salesOrder*>(WindowPool::instance()->take("salesOrder", this));
       newdlg->set(params);
       omfgThis->handleNewWindow(newdlg);
       break;
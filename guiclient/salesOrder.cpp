@@ -41,6 +41,7 @@
 #include "purchaseOrder.h"
 #include "workOrder.h"
 #include "itemAvailabilityWorkbench.h"
+#include "windowPool.h"
 
 // why did someone invent modetype & modestate for scripting vs. rewriting the macros below or passing _mode?
 enum OrderModeType  { QuoteMode = 1, OrderMode = 2 };
@@ -4012,7 +4013,7 @@ void salesOrder::newSalesOrder(int pCustid, QWidget *parent)
   if (pCustid != -1)
     params.append("cust_id", pCustid);
 
-  salesOrder *newdlg = new salesOrder(parent);
+  salesOrder *newdlg = qobject_cast<salesOrder*>(WindowPool::instance()->take("salesOrder", parent));
   newdlg->set(params);
   omfgThis->handleNewWindow(newdlg);
 }
@@ -4041,7 +4042,7 @@ void salesOrder::editSalesOrder( int pId, bool enableSaveAndAdd, QWidget *parent
   if (enableSaveAndAdd)
     params.append("enableSaveAndAdd");
 
-  salesOrder *newdlg = new salesOrder(parent);
+  salesOrder *newdlg = qobject_cast<salesOrder*>(WindowPool::instance()->take("salesOrder", parent));
   newdlg->set(params);
   omfgThis->handleNewWindow(newdlg);
 }
@@ -4068,7 +4069,7 @@ void salesOrder::viewSalesOrder( int pId, QWidget *parent )
   params.append("mode", "view");
   params.append("sohead_id", pId);
 
-  salesOrder *newdlg = new salesOrder(parent);
+  salesOrder *newdlg = qobject_cast<salesOrder*>(WindowPool::instance()->take("salesOrder", parent));
   newdlg->set(params);
   omfgThis->handleNewWindow(newdlg);
 }
@@ -20,10 +20,12 @@
 
 #include "errorReporter.h"
 #include "guiErrorCheck.h"
+#include "itembundle.h"
 #include "itemCharacteristicDelegate.h"
 #include "itemSourceList.h"
 #include "openPurchaseOrder.h"
 #include "priceList.h"
+#include "queryprofiler.h"
 #include "reserveSalesOrderItem.h"
 #include "storedProcErrorLookup.h"
 #include "taxBreakdown.h"
@@ -50,6 +52,14 @@ salesOrderItem::salesOrderItem(QWidget *parent, const char *name, Qt::WindowFlag
 {
   setupUi(this);
 
+  _recalcPasses  = 0;
+  _recalcPending = 0;
+  _queriesSaved  = 0;
+  _recalcTimer   = new QTimer(this);
+  _recalcTimer->setSingleShot(true);
+  _recalcTimer->setInterval(0);
+  connect(_recalcTimer, SIGNAL(timeout()), this, SLOT(sRecalculate()));
+
   // _itemchar needs to be initialized before calling clear()
   _itemchar = new QStandardItemModel(0, 3, this);
   _itemchar->setHeaderData( CHAR_ID, Qt::Horizontal, tr("Name"), Qt::DisplayRole);
@@ -62,24 +72,19 @@ salesOrderItem::salesOrderItem(QWidget *parent, const char *name, Qt::WindowFlag
   _historyDates->setEndNull(tr("Latest"), omfgThis->endOfTime(), true);
 
   connect(_item,              SIGNAL(newId(int)),                   this, SLOT(sPopulateItemInfo(int)), Qt::UniqueConnection);
-  connect(_item,              SIGNAL(newId(int)),                   this, SLOT(sPopulateItemSources(int)), Qt::UniqueConnection);
-  connect(_item,              SIGNAL(newId(int)),                   this, SLOT(sPopulateItemSubs()), Qt::UniqueConnection);
-  connect(_item,              SIGNAL(newId(int)),                   this, SLOT(sPopulateHistory()), Qt::UniqueConnection);
-  connect(_item,              SIGNAL(newId(int)),                   this, SLOT(sDetermineAvailability()), Qt::UniqueConnection);
+  connect(_item,              SIGNAL(newId(int)),                   this, SLOT(sItemChanged()), Qt::UniqueConnection);
   connect(_listPrices,        SIGNAL(clicked()),                    this, SLOT(sListPrices()), Qt::UniqueConnection);
   connect(_netUnitPrice,      SIGNAL(idChanged(int)),               this, SLOT(sPriceGroup()), Qt::UniqueConnection);
   connect(_netUnitPrice,      SIGNAL(valueChanged()),               this, SLOT(sCalculateExtendedPrice()), Qt::UniqueConnection);
-  connect(_qtyOrdered,        SIGNAL(editingFinished()),            this, SLOT(sDetermineAvailability()), Qt::UniqueConnection);
+  connect(_qtyOrdered,        SIGNAL(editingFinished()),            this, SLOT(sQtyOrderedChanged()), Qt::UniqueConnection);
   connect(_qtyOrdered,        SIGNAL(editingFinished()),            this, SLOT(sDeterminePrice()), Qt::UniqueConnection);
-  connect(_qtyOrdered,        SIGNAL(editingFinished()),            this, SLOT(sCalcUnitCost()), Qt::UniqueConnection);
   connect(_save,              SIGNAL(clicked()),                    this, SLOT(sSaveClicked()), Qt::UniqueConnection);
   connect(_scheduledDate,     SIGNAL(newDate(const QDate &)),       this, SLOT(sHandleScheduleDate()), Qt::UniqueConnection);
-  connect(_showAvailability,  SIGNAL(toggled(bool)),                this, SLOT(sDetermineAvailability()), Qt::UniqueConnection);
-  connect(_asOfScheddate,     SIGNAL(toggled(bool)),                this, SLOT(sDetermineAvailability()), Qt::UniqueConnection);
-  connect(_showIndented,      SIGNAL(toggled(bool)),                this, SLOT(sDetermineAvailability()), Qt::UniqueConnection);
+  connect(_showAvailability,  SIGNAL(toggled(bool)),                this, SLOT(sAvailabilityOptionsChanged()), Qt::UniqueConnection);
+  connect(_asOfScheddate,     SIGNAL(toggled(bool)),                this, SLOT(sAvailabilityOptionsChanged()), Qt::UniqueConnection);
+  connect(_showIndented,      SIGNAL(toggled(bool)),                this, SLOT(sAvailabilityOptionsChanged()), Qt::UniqueConnection);
   connect(_warehouse,         SIGNAL(newID(int)),                   this, SLOT(sPopulateItemsiteInfo()), Qt::UniqueConnection);
-  connect(_warehouse,         SIGNAL(newID(int)),                   this, SLOT(sDetermineAvailability()), Qt::UniqueConnection);
-  connect(_warehouse,         SIGNAL(newID(int)),                   this, SLOT(sPopulateItemSubs()), Qt::UniqueConnection);
+  connect(_warehouse,         SIGNAL(newID(int)),                   this, SLOT(sWarehouseChanged()), Qt::UniqueConnection);
   connect(_subs,              SIGNAL(populateMenu(QMenu*,QTreeWidgetItem*,int)), this, SLOT(sPopulateSubMenu(QMenu*,QTreeWidgetItem*,int)), Qt::UniqueConnection);
   connect(_next,              SIGNAL(clicked()),                    this, SLOT(sNext()), Qt::UniqueConnection);
   connect(_prev,              SIGNAL(clicked()),                    this, SLOT(sPrev()), Qt::UniqueConnection);
@@ -100,8 +105,8 @@ salesOrderItem::salesOrderItem(QWidget *parent, const char *name, Qt::WindowFlag
   connect(_supplyOrderButton, SIGNAL(toggled(bool)),                this, SLOT(sHandleButton()), Qt::UniqueConnection);
   connect(_substitutesButton, SIGNAL(toggled(bool)),                this, SLOT(sHandleButton()), Qt::UniqueConnection);
   connect(_historyCostsButton,SIGNAL(toggled(bool)),                this, SLOT(sHandleButton()), Qt::UniqueConnection);
-  connect(_historyCostsButton,SIGNAL(toggled(bool)),                this, SLOT(sPopulateHistory()), Qt::UniqueConnection);
-  connect(_historyDates,      SIGNAL(updated()),                    this, SLOT(sPopulateHistory()), Qt::UniqueConnection);
+  connect(_historyCostsButton,SIGNAL(toggled(bool)),                this, SLOT(sHistoryOptionsChanged()), Qt::UniqueConnection);
+  connect(_historyDates,      SIGNAL(updated()),                    this, SLOT(sHistoryOptionsChanged()), Qt::UniqueConnection);
 
 #ifndef Q_OS_MAC
   _listPrices->setMaximumWidth(25);
@@ -703,6 +708,125 @@ int salesOrderItem::modeType() const
     return 2;
 }
 
+/** \return the number of queries skipped because the same statement with
+    the same values had already run in the current recalculation pass.
+ */
+int salesOrderItem::queriesSaved() const
+{
+  return _queriesSaved;
+}
+
+/** \return the number of coalesced recalculation passes run so far.
+ */
+int salesOrderItem::recalcPasses() const
+{
+  return _recalcPasses;
+}
+
+/** \brief Mark derived values as out of date.
+
+    Changing the item, site, or quantity used to refresh availability,
+    item sources, substitutes, history, and unit cost once for every
+    signal that fired. Instead the values are marked here and refreshed
+    together by sRecalculate() when control returns to the event loop, so
+    a burst of changes costs one refresh.
+ */
+void salesOrderItem::scheduleRecalc(int pFlags)
+{
+  _recalcPending |= pFlags;
+  if (! _recalcTimer->isActive())
+    _recalcTimer->start();
+}
+
+/** \brief Execute pQuery and return its first row in pRecord, unless the
+           same statement with the same bound values already ran during
+           this recalculation pass.
+
+    Price and cost lookups are often repeated several times while the
+    item, UOMs, and quantity settle. The remembered rows are forgotten at
+    the end of the pass.
+    \return true if there is a row.
+ */
+bool salesOrderItem::execMemo(XSqlQuery &pQuery, QSqlRecord &pRecord)
+{
+  QString key = pQuery.lastQuery();
+  QMapIterator<QString, QVariant> value(pQuery.boundValues());
+  while (value.hasNext())
+  {
+    value.next();
+    key += QString("|%1=%2").arg(value.key(), value.value().toString());
+  }
+
+  if (_recalcMemo.contains(key))
+  {
+    _queriesSaved++;
+    pRecord = _recalcMemo.value(key);
+    return true;
+  }
+
+  QueryProbe probe(this, __FILE__, __LINE__);
+  pQuery.exec();
+  probe.record(pQuery);
+  if (! pQuery.first())
+  {
+    pRecord = QSqlRecord();
+    return false;
+  }
+
+  pRecord = pQuery.record();
+  _recalcMemo.insert(key, pRecord);
+  scheduleRecalc(0);
+  return true;
+}
+
+void salesOrderItem::sRecalculate()
+{
+  int pending = _recalcPending;
+  _recalcPending = 0;
+  _recalcPasses++;
+  if (DEBUG)
+    qDebug() << "salesOrderItem::sRecalculate() pass" << _recalcPasses
+             << "flags" << pending << "saved" << _queriesSaved;
+
+  if (pending & RecalcItemSources)
+    sPopulateItemSources(_item->id());
+  if (pending & RecalcItemSubs)
+    sPopulateItemSubs();
+  if (pending & RecalcHistory)
+    sPopulateHistory();
+  if (pending & RecalcAvailability)
+    sDetermineAvailability();
+  if (pending & RecalcUnitCost)
+    sCalcUnitCost();
+
+  _recalcMemo.clear();
+}
+
+void salesOrderItem::sItemChanged()
+{
+  scheduleRecalc(RecalcItemSources | RecalcItemSubs | RecalcHistory | RecalcAvailability);
+}
+
+void salesOrderItem::sWarehouseChanged()
+{
+  scheduleRecalc(RecalcItemSubs | RecalcAvailability);
+}
+
+void salesOrderItem::sQtyOrderedChanged()
+{
+  scheduleRecalc(RecalcAvailability | RecalcUnitCost);
+}
+
+void salesOrderItem::sAvailabilityOptionsChanged()
+{
+  scheduleRecalc(RecalcAvailability);
+}
+
+void salesOrderItem::sHistoryOptionsChanged()
+{
+  scheduleRecalc(RecalcHistory);
+}
+
 void salesOrderItem::prepare()
 {
   XSqlQuery salesprepare;
@@ -929,6 +1053,10 @@ void salesOrderItem::sSave(bool pPartial)
   XSqlQuery salesSave;
   _save->setFocus();
 
+  // the unit cost is saved, so it cannot wait for the next recalculation
+  if (_recalcPending & RecalcUnitCost)
+    sCalcUnitCost();
+
   _error = true;
   if (! pPartial)
   {
@@ -1965,10 +2093,10 @@ void salesOrderItem::sDeterminePrice(bool force)
       salesDeterminePrice.bindValue(":curr_id", _customerPrice->id());
       salesDeterminePrice.bindValue(":effective", _customerPrice->effective());
       salesDeterminePrice.bindValue(":asof", asOf);
-      salesDeterminePrice.exec();
-      if (salesDeterminePrice.first())
+      QSqlRecord pricerec;
+      if (execMemo(salesDeterminePrice, pricerec))
       {
-        _itemchar->setData(idx3, salesDeterminePrice.value("price").toString(), Qt::DisplayRole);
+        _itemchar->setData(idx3, pricerec.value("price").toString(), Qt::DisplayRole);
         _itemchar->setData(idx3, QVariant(_charVars), Qt::UserRole);
       }
       else if (ErrorReporter::error(QtCriticalMsg, this, tr("Error Retrieving Item Pricing Information"),
@@ -2022,10 +2150,10 @@ void salesOrderItem::sPopulatePrices(bool update, bool allPrices, double charTot
   itemprice.bindValue(":effective", _customerPrice->effective());
   itemprice.bindValue(":asof", asOf);
   itemprice.bindValue(":warehouse", _warehouse->id());
-  itemprice.exec();
-  if (itemprice.first())
+  QSqlRecord pricerec;
+  if (execMemo(itemprice, pricerec))
   {
-    if (itemprice.value("itemprice_price").toDouble() == -9999.0)
+    if (pricerec.value("itemprice_price").toDouble() == -9999.0)
     {
       if (!update)
       {
@@ -2059,9 +2187,9 @@ void salesOrderItem::sPopulatePrices(bool update, bool allPrices, double charTot
     }
     else
     {
-      double price = itemprice.value("itemprice_price").toDouble();
-      QString _priceMethod = itemprice.value("itemprice_method").toString();
-      QString _priceType = itemprice.value("itemprice_type").toString();
+      double price = pricerec.value("itemprice_price").toDouble();
+      QString _priceMethod = pricerec.value("itemprice_method").toString();
+      QString _priceType = pricerec.value("itemprice_type").toString();
       if (_priceType == "N" || _priceType == "D" || _priceType == "P")  // nominal, discount, or list price
         _priceMode = "D";
       else  // markup or list cost
@@ -2074,7 +2202,7 @@ void salesOrderItem::sPopulatePrices(bool update, bool allPrices, double charTot
         if (update) // Configuration or user said they also want net unit price updated
         {
           _netUnitPrice->setLocalValue(price + charTotal);
-          _listPrice->setBaseValue(itemprice.value("itemprice_listprice").toDouble() * (_priceinvuomratio / _priceRatio));
+          _listPrice->setBaseValue(pricerec.value("itemprice_listprice").toDouble() * (_priceinvuomratio / _priceRatio));
           _listPrice->setLocalValue(_listPrice->localValue() + charTotal);
         }
 
@@ -2090,8 +2218,8 @@ void salesOrderItem::sPopulatePrices(bool update, bool allPrices, double charTot
       {
         // IPS Schedule
         _pricingStack->setCurrentWidget(_ipsPricePage);
-        _ipsSaleName->setText(itemprice.value("itemprice_sale").toString());
-        _ipsSchedule->setText(itemprice.value("itemprice_schedule").toString());
+        _ipsSaleName->setText(pricerec.value("itemprice_sale").toString());
+        _ipsSchedule->setText(pricerec.value("itemprice_schedule").toString());
         if (_priceType == "N")
         {
           _ipsType->setText(tr("Nominal"));
@@ -2113,16 +2241,16 @@ void salesOrderItem::sPopulatePrices(bool update, bool allPrices, double charTot
           _ipsModifierPctLit->setText(tr("Markup %:"));
           _ipsModifierAmtLit->setText(tr("Markup Amt:"));
         }
-        _ipsBasis->setDouble(itemprice.value("itemprice_basis").toDouble());
-        _ipsModifierPct->setDouble(itemprice.value("itemprice_modifierpct").toDouble() * 100.0);
-        _ipsModifierAmt->setDouble(itemprice.value("itemprice_modifieramt").toDouble());
-        _ipsQtyBreak->setDouble(itemprice.value("itemprice_qtybreak").toDouble());
+        _ipsBasis->setDouble(pricerec.value("itemprice_basis").toDouble());
+        _ipsModifierPct->setDouble(pricerec.value("itemprice_modifierpct").toDouble() * 100.0);
+        _ipsModifierAmt->setDouble(pricerec.value("itemprice_modifieramt").toDouble());
+        _ipsQtyBreak->setDouble(pricerec.value("itemprice_qtybreak").toDouble());
       }
       if (_priceMethod == "L")
       {
         // List Price
         _pricingStack->setCurrentWidget(_listPricePage);
-        _listDiscount->setDouble(itemprice.value("itemprice_modifierpct").toDouble() * 100.0);
+        _listDiscount->setDouble(pricerec.value("itemprice_modifierpct").toDouble() * 100.0);
       }
     }
   }
@@ -2138,73 +2266,50 @@ void salesOrderItem::sPopulateItemInfo(int pItemid)
   _itemchar->removeRows(0, _itemchar->rowCount());
   if (pItemid != -1)
   {
+    // fetch the item's details on a pooled connection while we get the UOMs
+    ItemBundleRequest request(pItemid, _warehouse->id());
+    request.custid    = _custid;
+    request.taxzoneid = _taxzoneid;
+    ItemBundleCache::instance()->prefetch(request);
+
     sPopulateUOM();
 
-    //  Grab the price for this item/customer/qty
-    salesPopulateItemInfo.prepare( "SELECT item_type, item_config, uom_name,"
-               "       item_inv_uom_id, item_price_uom_id, item_fractional,"
-               "       iteminvpricerat(item_id) AS invpricerat,"
-               "       itemsite_createsopo, itemsite_dropship, itemsite_costmethod,"
-               "       getItemTaxType(item_id, :taxzone) AS taxtype_id "
-               "FROM item JOIN uom ON (item_inv_uom_id=uom_id)"
-               "LEFT OUTER JOIN itemsite ON ((itemsite_item_id=item_id) AND (itemsite_warehous_id=:warehous_id)) "
-               "WHERE (item_id=:item_id);" );
-    salesPopulateItemInfo.bindValue(":item_id", pItemid);
-    salesPopulateItemInfo.bindValue(":warehous_id", _warehouse->id());
-    salesPopulateItemInfo.bindValue(":taxzone", _taxzoneid);
-    salesPopulateItemInfo.exec();
-    if (salesPopulateItemInfo.first())
+    ItemBundle item = ItemBundleCache::instance()->bundle(request);
+    if (item.isValid())
     {
-      if (salesPopulateItemInfo.value("itemsite_createsopo").toBool())
+      if (item.value("itemsite_createsopo").toBool() && ! item.value("has_itemsrc").toBool())
       {
-        XSqlQuery itemsrc;
-        itemsrc.prepare("SELECT itemsrc_id, itemsrc_item_id "
-                        "FROM itemsrc "
-                        "WHERE (itemsrc_item_id = :item_id) "
-                        "  AND (itemsrc_active) "
-                        "LIMIT 1;");
-        itemsrc.bindValue(":item_id", _item->id());
-        itemsrc.exec();
-        if (itemsrc.first())
-          ;   // do nothing
-        else if (ErrorReporter::error(QtCriticalMsg, this, tr("Error Retrieving Item Information"),
-                                      itemsrc, __FILE__, __LINE__))
-        {
-          return;
-        }
-        else
-        {
-          QMessageBox::warning( this, tr("Cannot Create P/O"),
-                                tr("<p> Purchase Orders cannot be automatically "
-                                     "created for this Item as there are no Item "
-                                     "Sources for it.  You must create one or "
-                                     "more Item Sources for this Item before "
-                                     "the application can automatically create "
-                                     "Purchase Orders for it." ) );
-          _createSupplyOrder->setEnabled(false);
-        }
+        QMessageBox::warning( this, tr("Cannot Create P/O"),
+                              tr("<p> Purchase Orders cannot be automatically "
+                                   "created for this Item as there are no Item "
+                                   "Sources for it.  You must create one or "
+                                   "more Item Sources for this Item before "
+                                   "the application can automatically create "
+                                   "Purchase Orders for it." ) );
+        _createSupplyOrder->setEnabled(false);
       }
 
       if (_mode == cNew)
         sDeterminePrice();
 
-      _priceRatio        = salesPopulateItemInfo.value("invpricerat").toDouble(); // Always ratio from default price uom
-      _invuomid          = salesPopulateItemInfo.value("item_price_uom_id").toInt();
-      _invIsFractional   = salesPopulateItemInfo.value("item_fractional").toBool();
+      _priceRatio        = item.value("invpricerat").toDouble(); // Always ratio from default price uom
+      _invuomid          = item.value("item_price_uom_id").toInt();
+      _invIsFractional   = item.value("item_fractional").toBool();
       _priceinvuomratio  = _priceRatio;
       _qtyinvuomratio    = _priceRatio;
 
-      _qtyUOM->setId(salesPopulateItemInfo.value("item_price_uom_id").toInt());
-      _priceUOM->setId(salesPopulateItemInfo.value("item_price_uom_id").toInt());
+      _qtyUOM->setId(item.value("item_price_uom_id").toInt());
+      _priceUOM->setId(item.value("item_price_uom_id").toInt());
 
-      _taxtype->setId(salesPopulateItemInfo.value("taxtype_id").toInt());
+      _taxtype->setId(item.value("taxtype_id").toInt());
 
       sFindSellingWarehouseItemsites(_item->id());
 
     }
-    else if (ErrorReporter::error(QtCriticalMsg, this, tr("Error Retrieving Item Information"),
-                                  salesPopulateItemInfo, __FILE__, __LINE__))
+    else if (! item.lastError().isEmpty())
     {
+      ErrorReporter::error(QtCriticalMsg, this, tr("Error Retrieving Item Information"),
+                           item.lastError(), __FILE__, __LINE__);
       return;
     }
 
@@ -2212,25 +2317,9 @@ void salesOrderItem::sPopulateItemInfo(int pItemid)
     disconnect( _itemchar,  SIGNAL(itemChanged(QStandardItem *)), this, SLOT(sRecalcPrice()));
     disconnect( _itemchar,  SIGNAL(itemChanged(QStandardItem *)), this, SLOT(sRecalcAvailability()));
 
-    if (_customerPN->text().trimmed().length() == 0)
-    {
-      salesPopulateItemInfo.prepare("SELECT itemalias_number,"
-                                    "       CASE WHEN (itemalias_crmacct_id IS NOT NULL) THEN 0"
-                                    "            ELSE 1 END AS orderby "
-                                    "FROM itemalias"
-                                    " LEFT OUTER JOIN crmacct ON (itemalias_crmacct_id=crmacct_id)"
-                                    " LEFT OUTER JOIN custinfo ON (cust_crmacct_id=crmacct_id) "
-                                    "WHERE (itemalias_item_id=:item_id)"
-                                    "  AND (cust_id=:cust_id OR itemalias_crmacct_id IS NULL) "
-                                    "ORDER BY orderby, itemalias_number;" );
-      salesPopulateItemInfo.bindValue(":item_id", _item->id());
-      salesPopulateItemInfo.bindValue(":cust_id", _custid);
-      salesPopulateItemInfo.exec();
-      if (salesPopulateItemInfo.first())
-      {
-        _customerPN->setText(salesPopulateItemInfo.value("itemalias_number").toString());
-      }
-    }
+    if (_customerPN->text().trimmed().length() == 0 &&
+        ! item.value("itemalias_number").toString().isEmpty())
+      _customerPN->setText(item.value("itemalias_number").toString());
 
     salesPopulateItemInfo.prepare("SELECT char_id, char_name, "
               " CASE WHEN char_type < 2 THEN "
@@ -2342,6 +2431,7 @@ void salesOrderItem::sRecalcAvailability()
 void salesOrderItem::sDetermineAvailability(bool p)
 {
   ENTERED << "with" << p;
+  _recalcPending &= ~RecalcAvailability;
   if (  (_item->id()==_availabilityLastItemid) &&
         (_warehouse->id()==_availabilityLastWarehousid) &&
         (_scheduledDate->date()==_availabilityLastSchedDate) &&
@@ -2511,6 +2601,7 @@ void salesOrderItem::sDetermineAvailability(bool p)
 void salesOrderItem::sPopulateItemSources(int pItemid)
 {
   ENTERED << "with" << pItemid;
+  _recalcPending &= ~RecalcItemSources;
   if (pItemid < 0)
     _itemsrcp->clear();
   else
@@ -2540,6 +2631,7 @@ void salesOrderItem::sPopulateItemSubs()
 void salesOrderItem::sPopulateItemSubs(int pItemid)
 {
   ENTERED << "with" << pItemid;
+  _recalcPending &= ~RecalcItemSubs;
   if (_item->isValid() && _warehouse->isValid())
   {
     if (_item->id() == _itemsubsLastItemid && _warehouse->id() == _itemsubsLastWarehousid)
@@ -2619,6 +2711,7 @@ void salesOrderItem::sReserveStock()
 void salesOrderItem::sPopulateHistory()
 {
   ENTERED;
+  _recalcPending &= ~RecalcHistory;
   if (_item->id() < 0)
   {
     _historyCosts->clear();
@@ -4942,15 +5035,16 @@ void salesOrderItem::sPriceUOMChanged()
   item.bindValue(":item_id", _item->id());
   item.bindValue(":warehous_id", _warehouse->id());
   item.bindValue(":dropShip", _supplyOrderDropShipCache);
-  item.exec();
-  item.first();
-  _unitCost->setBaseValue(item.value("unitcost").toDouble() * _priceinvuomratio);
+  QSqlRecord costrec;
+  execMemo(item, costrec);
+  _unitCost->setBaseValue(costrec.value("unitcost").toDouble() * _priceinvuomratio);
   sDeterminePrice(true);
 }
 
 void salesOrderItem::sCalcUnitCost()
 {
   ENTERED;
+  _recalcPending &= ~RecalcUnitCost;
   XSqlQuery salesCalcUnitCost;
   if (_costmethod == "J" && _supplyOrderId > -1 && _qtyOrdered->toDouble() != 0)
   {
@@ -4984,9 +5078,9 @@ void salesOrderItem::sCalcUnitCost()
       salesCalcUnitCost.bindValue(":asof", omfgThis->dbDate());
     salesCalcUnitCost.bindValue(":warehous_id", _warehouse->id());
     salesCalcUnitCost.bindValue(":dropShip", _supplyOrderDropShipCache);
-    salesCalcUnitCost.exec();
-    if (salesCalcUnitCost.first())
-      _unitCost->setBaseValue(salesCalcUnitCost.value("unitcost").toDouble() * _priceinvuomratio);
+    QSqlRecord costrec;
+    if (execMemo(salesCalcUnitCost, costrec))
+      _unitCost->setBaseValue(costrec.value("unitcost").toDouble() * _priceinvuomratio);
   }
 }
 
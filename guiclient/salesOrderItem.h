@@ -12,6 +12,8 @@
 #define SALESORDERITEM_H
 
 #include "guiclient.h"
+#include <QHash>
+#include <QSqlRecord>
 #include <QStandardItemModel>
 #include "xdialog.h"
 #include <parameter.h>
@@ -37,6 +39,8 @@ class salesOrderItem : public XDialog, public Ui::salesOrderItem
     Q_INVOKABLE virtual int supplyid() { return _supplyOrderId; }
     Q_INVOKABLE virtual int mode()  { return _mode; }
     Q_INVOKABLE virtual int modeType() const;
+    Q_INVOKABLE virtual int queriesSaved() const;
+    Q_INVOKABLE virtual int recalcPasses() const;
 
   signals:
     virtual void startingSave(bool);
@@ -101,10 +105,29 @@ class salesOrderItem : public XDialog, public Ui::salesOrderItem
 
   protected slots:
     virtual void  languageChange();
+    virtual void  sAvailabilityOptionsChanged();
+    virtual void  sHistoryOptionsChanged();
+    virtual void  sItemChanged();
+    virtual void  sQtyOrderedChanged();
+    virtual void  sRecalculate();
+    virtual void  sWarehouseChanged();
 
   private:
     virtual void  handleFieldsOnModeChange(int pMode);
 
+    // values that are recalculated together once per event loop turn
+    enum RecalcFlag
+    {
+      RecalcAvailability = 0x01,
+      RecalcItemSources  = 0x02,
+      RecalcItemSubs     = 0x04,
+      RecalcHistory      = 0x08,
+      RecalcUnitCost     = 0x10
+    };
+
+    bool  execMemo(XSqlQuery &pQuery, QSqlRecord &pRecord);
+    void  scheduleRecalc(int pFlags);
+
     double  _priceRatio;
     int     _preferredWarehouseid;
     int     _saletypeid;
@@ -163,6 +186,11 @@ class salesOrderItem : public XDialog, public Ui::salesOrderItem
     int     _itemsubsLastWarehousid;
     SaveStatus _saveStatus;
     QString _scriptErrorMsg;
+    QHash<QString, QSqlRecord> _recalcMemo;
+    int     _recalcPasses;
+    int     _recalcPending;
+    QTimer *_recalcTimer;
+    int     _queriesSaved;
 
     // For holding variables for characteristic pricing
     QList<QVariant> _charVars;
@@ -0,0 +1,311 @@
+/*
+ * This file is part of the xTuple ERP: PostBooks Edition, a free and
+ * open source Enterprise Resource Planning software suite,
+ * Copyright (c) 1999-2019 by OpenMFG LLC, d/b/a xTuple.
+ * It is licensed to you under the Common Public Attribution License
+ * version 1.0, the full text of which (including xTuple-specific Exhibits)
+ * is available at www.xtuple.com/CPAL.  By using this software, you agree
+ * to be bound by its terms.
+ */
+
+#include "sessionBootstrap.h"
+
+#include <QElapsedTimer>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSqlError>
+#include <QSqlRecord>
+
+#include "xsqlquery.h"
+
+#define DEBUG false
+
+static SessionBootstrap *_currentBootstrap = 0;
+
+static QElapsedTimer                  _startupClock;
+static QList<QPair<QString, qint64> > _startupSteps;
+
+SessionBootstrap::SessionBootstrap()
+{
+  _names
+    << "effective_user"
+    << "locale"
+    << "packages"
+    << "edition"
+    << "metrics"
+    << "preferences"
+    << "privileges"
+    << "xt_client_count"
+    << "total_client_count"
+    << "xtweb"
+    << "database"
+    << "sot"
+    << "eot"
+    << "usr_window"
+    << "locale_has_run"
+    << "base_curr_count"
+    << "curr_count"
+    << "gainloss_ok"
+    << "period_found"
+    << "missing_xrates"
+    << "passreset"
+    << "resetdays"
+    << "lastreset";
+
+  _parts
+    << "getEffectiveXtUser()"
+    << "(SELECT row_to_json(l)"
+       "   FROM (SELECT lang_abbr2,   lang_qt_number,"
+       "                country_abbr, country_qt_number"
+       "           FROM usr"
+       "           JOIN locale  ON usr_locale_id     = locale_id"
+       "           JOIN lang    ON locale_lang_id    = lang_id"
+       "           LEFT OUTER JOIN country ON locale_country_id = country_id"
+       "          WHERE usr_username = getEffectiveXtUser()) l)"
+    << "(SELECT json_agg(json_build_array(pkghead_name, pkghead_version))"
+       "   FROM pkghead"
+       "  WHERE packageIsEnabled(pkghead_name))"
+    << "getEdition()"
+    << "(SELECT json_object_agg(metric_name, metric_value) FROM metric)"
+    << "(SELECT json_object_agg(usrpref_name, usrpref_value)"
+       "   FROM usrpref"
+       "  WHERE usrpref_username = :username)"
+    << "(SELECT json_agg(priv_name)"
+       "   FROM (SELECT priv_name"
+       "           FROM usrpriv"
+       "           JOIN priv ON usrpriv_priv_id = priv_id"
+       "          WHERE usrpriv_username = getEffectiveXtUser()"
+       "          UNION"
+       "         SELECT priv_name"
+       "           FROM usrgrp"
+       "           JOIN grppriv ON usrgrp_grp_id = grppriv_grp_id"
+       "           JOIN priv    ON grppriv_priv_id = priv_id"
+       "          WHERE usrgrp_username = getEffectiveXtUser()) p)"
+    << "numOfDatabaseUsers(:appName)"
+    << "numOfServerUsers()"
+    << "packageIsEnabled('drupaluserinfo')"
+    << "current_database()"
+    << "startOfTime()"
+    << "endOfTime()"
+    << "(SELECT usr_window FROM usr WHERE usr_username = getEffectiveXtUser())"
+    << "EXISTS(SELECT 1 FROM metric WHERE metric_name = 'AutoUpdateLocaleHasRun')"
+    << "(SELECT COUNT(*) FROM curr_symbol WHERE curr_base)"
+    << "(SELECT COUNT(*) FROM curr_symbol)"
+    << "(COALESCE((SELECT TRUE"
+       "             FROM accnt, metric"
+       "            WHERE ((CAST(accnt_id AS text)=metric_value)"
+       "              AND  (metric_name='CurrencyGainLossAccount'))), FALSE)"
+       " AND COALESCE((SELECT TRUE"
+       "                 FROM accnt, metric"
+       "                WHERE ((CAST(accnt_id AS text)=metric_value)"
+       "                  AND  (metric_name='GLSeriesDiscrepancyAccount'))), FALSE))"
+    << "EXISTS(SELECT 1 FROM period"
+       "        WHERE ((current_date BETWEEN period_start AND period_end)"
+       "          AND (NOT period_closed)))"
+    << "(SELECT string_agg(curr_abbr, ',')"
+       "   FROM (SELECT curr_abbr"
+       "           FROM curr_symbol s JOIN curr_rate r ON s.curr_id = r.curr_id"
+       "          GROUP BY curr_abbr"
+       "         HAVING NOT BOOL_OR(current_date BETWEEN curr_effective AND curr_expires)) x)"
+    << "fetchmetricbool('EnforcePasswordReset')"
+    << "fetchmetricvalue('PasswordResetDays')::TEXT"
+    << "(SELECT current_date - fetchmetricvalue('PasswordResetDays')::INTEGER >"
+       "        (SELECT usrpref_value FROM usrpref"
+       "          WHERE ((usrpref_username = getEffectiveXtUser())"
+       "            AND (usrpref_name = 'PasswordResetDate')))::DATE)";
+}
+
+SessionBootstrap::~SessionBootstrap()
+{
+  if (_currentBootstrap == this)
+    _currentBootstrap = 0;
+}
+
+/** \brief Return the bootstrap loaded most recently, or 0 if there is none.
+  */
+SessionBootstrap *SessionBootstrap::current()
+{
+  return _currentBootstrap;
+}
+
+/** \brief Read the session state for pUsername.
+    \return true if every piece was read in a single query
+  */
+bool SessionBootstrap::load(const QString &pUsername, const QString &pAppName)
+{
+  _errors.clear();
+  _values.clear();
+  _username         = pUsername;
+  _appName          = pAppName;
+  _currentBootstrap = this;
+
+  QStringList columns;
+  for (int i = 0; i < _parts.size(); i++)
+    columns << QString("%1 AS %2").arg(_parts.at(i), _names.at(i));
+
+  XSqlQuery bootq;
+  bootq.prepare(QString("SELECT %1;").arg(columns.join(",\n       ")));
+  bootq.bindValue(":username", pUsername);
+  bootq.bindValue(":appName",  pAppName);
+  bootq.exec();
+  if (bootq.first())
+  {
+    QSqlRecord row = bootq.record();
+    for (int i = 0; i < row.count(); i++)
+      _values.insert(row.fieldName(i), row.value(i));
+    mark("session bootstrap");
+    return true;
+  }
+
+  if (DEBUG)
+    qDebug("SessionBootstrap::load() combined query failed: %s",
+           qPrintable(bootq.lastError().text()));
+
+  for (int i = 0; i < _parts.size(); i++)
+  {
+    XSqlQuery partq;
+    partq.prepare(QString("SELECT %1 AS %2;").arg(_parts.at(i), _names.at(i)));
+    if (_parts.at(i).contains(":username"))
+      partq.bindValue(":username", pUsername);
+    if (_parts.at(i).contains(":appName"))
+      partq.bindValue(":appName",  pAppName);
+    partq.exec();
+    if (partq.first())
+      _values.insert(_names.at(i), partq.value(0));
+    else
+      _errors.insert(_names.at(i), partq.lastError().text());
+  }
+  mark("session bootstrap, piece by piece");
+
+  return false;
+}
+
+/** \brief Read the pieces in pNames again in one query.
+    \return true if they were read; if not, contains() is false for them
+            and error() says why
+  */
+bool SessionBootstrap::refresh(const QStringList &pNames)
+{
+  QStringList columns;
+  foreach (QString name, pNames)
+  {
+    int i = _names.indexOf(name);
+    if (i >= 0)
+      columns << QString("%1 AS %2").arg(_parts.at(i), name);
+  }
+  if (columns.isEmpty())
+    return false;
+
+  QString sql = QString("SELECT %1;").arg(columns.join(",\n       "));
+  XSqlQuery refreshq;
+  refreshq.prepare(sql);
+  if (sql.contains(":username"))
+    refreshq.bindValue(":username", _username);
+  if (sql.contains(":appName"))
+    refreshq.bindValue(":appName",  _appName);
+  refreshq.exec();
+  if (! refreshq.first())
+  {
+    foreach (QString name, pNames)
+    {
+      _values.remove(name);
+      _errors.insert(name, refreshq.lastError().text());
+    }
+    return false;
+  }
+
+  QSqlRecord row = refreshq.record();
+  for (int i = 0; i < row.count(); i++)
+  {
+    _values.insert(row.fieldName(i), row.value(i));
+    _errors.remove(row.fieldName(i));
+  }
+  return true;
+}
+
+/** \brief Return whether pName was read successfully.
+  */
+bool SessionBootstrap::contains(const QString &pName) const
+{
+  return _values.contains(pName);
+}
+
+/** \brief Return the database error for pName, or an empty string if it
+           was read or load() has not been called.
+  */
+QString SessionBootstrap::error(const QString &pName) const
+{
+  return _errors.value(pName);
+}
+
+QVariant SessionBootstrap::value(const QString &pName) const
+{
+  return _values.value(pName);
+}
+
+/** \brief Return a JSON object (metrics, preferences) or array of names
+           (privileges) as a MetricMap. Array elements map to "t".
+  */
+MetricMap SessionBootstrap::map(const QString &pName) const
+{
+  MetricMap result;
+  QJsonDocument doc = QJsonDocument::fromJson(_values.value(pName).toByteArray());
+  if (doc.isObject())
+  {
+    QJsonObject obj = doc.object();
+    for (QJsonObject::const_iterator it = obj.constBegin(); it != obj.constEnd(); ++it)
+      result.insert(it.key(), it.value().isString() ? it.value().toString()
+                                                    : it.value().toVariant().toString());
+  }
+  else if (doc.isArray())
+  {
+    foreach (QJsonValue name, doc.array())
+      result.insert(name.toString(), "t");
+  }
+  return result;
+}
+
+/** \brief Return a JSON array of two-element arrays as a list of pairs.
+  */
+QList<QPair<QString, QString> > SessionBootstrap::pairs(const QString &pName) const
+{
+  QList<QPair<QString, QString> > result;
+  QJsonDocument doc = QJsonDocument::fromJson(_values.value(pName).toByteArray());
+  foreach (QJsonValue pair, doc.array())
+    result << qMakePair(pair.toArray().at(0).toString(), pair.toArray().at(1).toString());
+  return result;
+}
+
+/** \brief Return a comma-separated value as a list.
+  */
+QStringList SessionBootstrap::list(const QString &pName) const
+{
+  return _values.value(pName).toString().split(",", QString::SkipEmptyParts);
+}
+
+/** \brief Record that pStep has finished. The first call starts the clock.
+  */
+void SessionBootstrap::mark(const QString &pStep)
+{
+  if (! _startupClock.isValid())
+    _startupClock.start();
+  _startupSteps.append(qMakePair(pStep, _startupClock.elapsed()));
+}
+
+/** \brief Return the steps recorded by mark(), one per line, with the time
+           each finished and how long it took.
+  */
+QString SessionBootstrap::timeline()
+{
+  QStringList lines;
+  qint64 previous = 0;
+  for (int i = 0; i < _startupSteps.size(); i++)
+  {
+    lines << QString("%1 ms (+%2 ms) %3").arg(_startupSteps.at(i).second, 6)
+                                         .arg(_startupSteps.at(i).second - previous, 5)
+                                         .arg(_startupSteps.at(i).first);
+    previous = _startupSteps.at(i).second;
+  }
+  return lines.join("\n");
+}
@@ -0,0 +1,75 @@
+/*
+ * This file is part of the xTuple ERP: PostBooks Edition, a free and
+ * open source Enterprise Resource Planning software suite,
+ * Copyright (c) 1999-2019 by OpenMFG LLC, d/b/a xTuple.
+ * It is licensed to you under the Common Public Attribution License
+ * version 1.0, the full text of which (including xTuple-specific Exhibits)
+ * is available at www.xtuple.com/CPAL.  By using this software, you agree
+ * to be bound by its terms.
+ */
+
+#ifndef __SESSIONBOOTSTRAP_H__
+#define __SESSIONBOOTSTRAP_H__
+
+#include <QHash>
+#include <QList>
+#include <QPair>
+#include <QString>
+#include <QStringList>
+#include <QVariant>
+
+#include "metrics.h"
+
+/**
+  @class SessionBootstrap
+
+  @brief Reads everything the application needs to start a session in one
+         round-trip to the database.
+
+  Each piece of session state is a named scalar expression: the locale,
+  enabled packages, edition, license counts, metrics, user preferences,
+  privileges, and the configuration checks made after login. load()
+  selects all of them as the columns of a single row. If that fails,
+  usually because an older database lacks one of the functions used,
+  load() asks for the pieces one at a time so a single failure does not
+  hide the rest; error() then says which pieces could not be read.
+
+  refresh() reads some of the pieces again, for checks whose answer may
+  have changed since load(), such as after a setup dialog.
+
+  The class also keeps the startup timeline. mark() records how long after
+  the application started a step finished and timeline() returns the list
+  for the log.
+ */
+class SessionBootstrap
+{
+  public:
+    SessionBootstrap();
+    virtual ~SessionBootstrap();
+
+    static SessionBootstrap *current();
+
+    virtual bool load(const QString &pUsername, const QString &pAppName);
+    virtual bool refresh(const QStringList &pNames);
+
+    bool        contains(const QString &pName) const;
+    QString     error(const QString &pName)    const;
+    QVariant    value(const QString &pName)    const;
+
+    MetricMap   map(const QString &pName)      const;
+    QList<QPair<QString, QString> > pairs(const QString &pName) const;
+    QStringList list(const QString &pName)     const;
+
+    static void    mark(const QString &pStep);
+    static QString timeline();
+
+  protected:
+    QString                  _appName;
+    QHash<QString, QString>  _errors;
+    QStringList              _names;
+    QStringList              _parts;
+    QString                  _username;
+    QHash<QString, QVariant> _values;
+};
+
+#endif
@@ -0,0 +1,300 @@
+/*
+ * This file is part of the xTuple ERP: PostBooks Edition, a free and
+ * open source Enterprise Resource Planning software suite,
+ * Copyright (c) 1999-2019 by OpenMFG LLC, d/b/a xTuple.
+ * It is licensed to you under the Common Public Attribution License
+ * version 1.0, the full text of which (including xTuple-specific Exhibits)
+ * is available at www.xtuple.com/CPAL.  By using this software, you agree
+ * to be bound by its terms.
+ */
+
+#include "timePhasedAggregator.h"
+
+#include <algorithm>
+
+#include <QMutex>
+#include <QMutexLocker>
+#include <QRunnable>
+#include <QThreadPool>
+
+#define DEBUG false
+
+// fewer facts than this are summed on the calling thread
+#define THREADTHRESHOLD 50000
+
+// orders fact indexes by the day of the fact
+class EarlierDay
+{
+  public:
+    EarlierDay(const QVector<qint64> &pDays) : _days(pDays) { }
+
+    bool operator()(int a, int b) const { return _days.at(a) < _days.at(b); }
+
+  protected:
+    const QVector<qint64> &_days;
+};
+
+TimePhasedFacts::TimePhasedFacts()
+{
+}
+
+/** \brief Add a row to the display and return its index for append().
+  */
+int TimePhasedFacts::addRow(int pId, int pAltId, const QVariantList &pValues)
+{
+  ids.append(pId);
+  altIds.append(pAltId);
+  values.append(pValues);
+  return ids.size() - 1;
+}
+
+void TimePhasedFacts::append(int pRow, const QDate &pDate, double pAmount)
+{
+  row.append(pRow);
+  day.append(pDate.toJulianDay());
+  amount.append(pAmount);
+}
+
+/** \brief Return whether every period falls within the dates these facts
+           were fetched for, so summing them gives the same answer the
+           database would.
+  */
+bool TimePhasedFacts::covers(const QList<DatePair> &pPeriods) const
+{
+  if (! startDate.isValid() || ! endDate.isValid())
+    return false;
+
+  foreach (DatePair period, pPeriods)
+  {
+    if (period.startDate < startDate || period.endDate > endDate)
+      return false;
+  }
+  return true;
+}
+
+int TimePhasedFacts::rowCount() const
+{
+  return ids.size();
+}
+
+int TimePhasedFacts::size() const
+{
+  return day.size();
+}
+
+void TimePhasedFacts::sortByDate()
+{
+  QVector<int> order(day.size());
+  for (int i = 0; i < order.size(); i++)
+    order[i] = i;
+
+  std::stable_sort(order.begin(), order.end(), EarlierDay(day));
+
+  QVector<double> sortedAmount(order.size());
+  QVector<qint64> sortedDay(order.size());
+  QVector<int>    sortedRow(order.size());
+  for (int i = 0; i < order.size(); i++)
+  {
+    sortedAmount[i] = amount.at(order.at(i));
+    sortedDay[i]    = day.at(order.at(i));
+    sortedRow[i]    = row.at(order.at(i));
+  }
+  amount = sortedAmount;
+  day    = sortedDay;
+  row    = sortedRow;
+}
+
+/* What a worker thread shares with the aggregator that started it. The
+   aggregator clears _owner when it is deleted or no longer wants the
+   answer, so the worker never posts to an object that is gone.
+ */
+class TimePhasedAggregateJob
+{
+  public:
+    TimePhasedAggregateJob(TimePhasedAggregator *pOwner, int pGeneration)
+      : _generation(pGeneration),
+        _owner(pOwner)
+    {
+    }
+
+    void detach()
+    {
+      QMutexLocker locker(&_lock);
+      _owner = 0;
+    }
+
+    void finish(const QVector<double> &pSums, const QVector<int> &pCounts)
+    {
+      QMutexLocker locker(&_lock);
+      _sums   = pSums;
+      _counts = pCounts;
+      if (_owner)
+        QMetaObject::invokeMethod(_owner, "sFinished", Qt::QueuedConnection,
+                                  Q_ARG(int, _generation));
+    }
+
+    void result(QVector<double> &pSums, QVector<int> &pCounts)
+    {
+      QMutexLocker locker(&_lock);
+      pSums   = _sums;
+      pCounts = _counts;
+    }
+
+  protected:
+    QVector<int>          _counts;
+    int                   _generation;
+    QMutex                _lock;
+    TimePhasedAggregator *_owner;
+    QVector<double>       _sums;
+};
+
+class TimePhasedAggregateRunnable : public QRunnable
+{
+  public:
+    TimePhasedAggregateRunnable(QSharedPointer<TimePhasedAggregateJob> pJob,
+                                QSharedPointer<const TimePhasedFacts> pFacts,
+                                const QList<DatePair> &pPeriods)
+      : _facts(pFacts),
+        _job(pJob),
+        _periods(pPeriods)
+    {
+    }
+
+    virtual void run()
+    {
+      QVector<double> sums;
+      QVector<int>    counts;
+      TimePhasedAggregator::aggregate(*_facts, _periods, sums, counts);
+      _job->finish(sums, counts);
+    }
+
+  protected:
+    QSharedPointer<const TimePhasedFacts>  _facts;
+    QSharedPointer<TimePhasedAggregateJob> _job;
+    QList<DatePair>                        _periods;
+};
+
+TimePhasedAggregator::TimePhasedAggregator(QObject *pParent)
+  : QObject(pParent),
+    _generation(0)
+{
+}
+
+TimePhasedAggregator::~TimePhasedAggregator()
+{
+  cancel();
+}
+
+/** \brief Sum pFacts into one bucket per period in pPeriods.
+
+    pSums gets pFacts.rowCount() rows of pPeriods.size() buckets each,
+    stored row after row. pCounts gets the number of facts that landed in
+    any bucket of each row, so callers can leave out rows with no activity
+    in the chosen periods. pFacts must be sorted by date.
+  */
+void TimePhasedAggregator::aggregate(const TimePhasedFacts &pFacts,
+                                     const QList<DatePair> &pPeriods,
+                                     QVector<double> &pSums, QVector<int> &pCounts)
+{
+  int buckets = pPeriods.size();
+  pSums.fill(0.0, pFacts.rowCount() * buckets);
+  pCounts.fill(0, pFacts.rowCount());
+
+  const qint64 *first   = pFacts.day.constData();
+  const qint64 *last    = first + pFacts.day.size();
+  const int    *rows    = pFacts.row.constData();
+  const double *amounts = pFacts.amount.constData();
+  double       *sums    = pSums.data();
+  int          *counts  = pCounts.data();
+
+  for (int b = 0; b < buckets; b++)
+  {
+    const qint64 *lo = std::lower_bound(first, last, pPeriods.at(b).startDate.toJulianDay());
+    const qint64 *hi = std::upper_bound(lo,    last, pPeriods.at(b).endDate.toJulianDay());
+    for (int i = lo - first; i < hi - first; i++)
+    {
+      sums[rows[i] * buckets + b] += amounts[i];
+      counts[rows[i]]++;
+    }
+  }
+}
+
+bool TimePhasedAggregator::isRunning() const
+{
+  return ! _job.isNull();
+}
+
+QVector<int> TimePhasedAggregator::counts() const
+{
+  return _counts;
+}
+
+QSharedPointer<const TimePhasedFacts> TimePhasedAggregator::facts() const
+{
+  return _facts;
+}
+
+QList<DatePair> TimePhasedAggregator::periods() const
+{
+  return _periods;
+}
+
+QVector<double> TimePhasedAggregator::sums() const
+{
+  return _sums;
+}
+
+/** \brief Sum pFacts into pPeriods and emit aggregated() when done.
+
+    Small sets are summed before start() returns. Large ones are summed
+    on a thread from the global QThreadPool and aggregated() is emitted
+    from the event loop once the worker is finished.
+  */
+void TimePhasedAggregator::start(QSharedPointer<const TimePhasedFacts> pFacts,
+                                 const QList<DatePair> &pPeriods)
+{
+  cancel();
+  _generation++;
+  _facts   = pFacts;
+  _periods = pPeriods;
+
+  if (! pFacts)
+  {
+    _sums.clear();
+    _counts.clear();
+    emit aggregated();
+    return;
+  }
+
+  if (pFacts->size() < THREADTHRESHOLD)
+  {
+    aggregate(*pFacts, pPeriods, _sums, _counts);
+    emit aggregated();
+    return;
+  }
+
+  if (DEBUG)
+    qDebug("TimePhasedAggregator::start() %d facts on a worker thread", pFacts->size());
+
+  _job = QSharedPointer<TimePhasedAggregateJob>(new TimePhasedAggregateJob(this, _generation));
+  QThreadPool::globalInstance()->start(new TimePhasedAggregateRunnable(_job, pFacts, pPeriods));
+}
+
+void TimePhasedAggregator::cancel()
+{
+  if (_job)
+  {
+    _job->detach();
+    _job.clear();
+  }
+}
+
+void TimePhasedAggregator::sFinished(int pGeneration)
+{
+  if (pGeneration != _generation || ! _job)
+    return;
+
+  _job->result(_sums, _counts);
+  _job.clear();
+  emit aggregated();
+}
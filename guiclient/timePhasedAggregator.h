@@ -0,0 +1,116 @@
+/*
+ * This file is part of the xTuple ERP: PostBooks Edition, a free and
+ * open source Enterprise Resource Planning software suite,
+ * Copyright (c) 1999-2019 by OpenMFG LLC, d/b/a xTuple.
+ * It is licensed to you under the Common Public Attribution License
+ * version 1.0, the full text of which (including xTuple-specific Exhibits)
+ * is available at www.xtuple.com/CPAL.  By using this software, you agree
+ * to be bound by its terms.
+ */
+
+#ifndef __TIMEPHASEDAGGREGATOR_H__
+#define __TIMEPHASEDAGGREGATOR_H__
+
+#include <QDate>
+#include <QList>
+#include <QObject>
+#include <QSharedPointer>
+#include <QString>
+#include <QStringList>
+#include <QVariant>
+#include <QVector>
+
+#include "calendarTools.h"
+
+class TimePhasedAggregateJob;
+
+/**
+  @class TimePhasedFacts
+
+  @brief The dated amounts behind a time-phased display, stored by column.
+
+  Each fact belongs to one row of the display (a customer and site, an
+  item and site, ...) and has a date and an amount. The row's id, alt id,
+  and the values of its base columns are kept once per row, not once per
+  fact. The facts themselves live in three parallel vectors sorted by day
+  so a period can be summed by finding where it starts and stops.
+ */
+class TimePhasedFacts
+{
+  public:
+    TimePhasedFacts();
+
+    int  addRow(int pId, int pAltId, const QVariantList &pValues);
+    void append(int pRow, const QDate &pDate, double pAmount);
+    bool covers(const QList<DatePair> &pPeriods) const;
+    void sortByDate();
+
+    int  rowCount() const;
+    int  size()     const;
+
+    QStringList         columns;        //!< names of the base columns in values
+    QDate               startDate;      //!< first date the facts were fetched for
+    QDate               endDate;        //!< last date the facts were fetched for
+    QString             numericRole;    //!< xtnumericrole for the bucket columns
+
+    QList<int>          ids;
+    QList<int>          altIds;
+    QList<QVariantList> values;
+
+    QVector<double>     amount;
+    QVector<qint64>     day;
+    QVector<int>        row;
+};
+
+/**
+  @class TimePhasedAggregator
+
+  @brief Sums TimePhasedFacts into one bucket per period.
+
+  aggregate() does the work on the calling thread. start() does the same
+  but hands large sets of facts to a worker thread and emits aggregated()
+  when the sums are ready, so the window stays responsive while a year of
+  daily history is being bucketed. Starting again before a worker has
+  finished discards the older result.
+ */
+class TimePhasedAggregator : public QObject
+{
+  Q_OBJECT
+
+  public:
+    TimePhasedAggregator(QObject *pParent = 0);
+    virtual ~TimePhasedAggregator();
+
+    static void aggregate(const TimePhasedFacts &pFacts,
+                          const QList<DatePair> &pPeriods,
+                          QVector<double> &pSums, QVector<int> &pCounts);
+
+    Q_INVOKABLE bool isRunning() const;
+
+    QVector<int>    counts() const;
+    QSharedPointer<const TimePhasedFacts> facts() const;
+    QList<DatePair> periods() const;
+    QVector<double> sums()   const;
+
+    void start(QSharedPointer<const TimePhasedFacts> pFacts,
+               const QList<DatePair> &pPeriods);
+
+  public slots:
+    void cancel();
+
+  signals:
+    void aggregated();
+
+  protected slots:
+    void sFinished(int pGeneration);
+
+  protected:
+    QVector<int>                           _counts;
+    QSharedPointer<const TimePhasedFacts>  _facts;
+    int                                    _generation;
+    QSharedPointer<TimePhasedAggregateJob> _job;
+    QList<DatePair>                        _periods;
+    QVector<double>                        _sums;
+};
+
+#endif
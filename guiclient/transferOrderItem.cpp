@@ -14,6 +14,7 @@
 #include <QSqlError>
 #include <QVariant>
 
+#include "itembundle.h"
 #include "itemCharacteristicDelegate.h"
 #include "itemSite.h"
 #include "storedProcErrorLookup.h"
@@ -523,21 +524,16 @@ void transferOrderItem::sPopulateItemInfo(int pItemid)
   _itemchar->removeRows(0, _itemchar->rowCount());
   if (pItemid != -1)
   {
-    transferPopulateItemInfo.prepare("SELECT stdcost(:item_id) AS stdcost, itemsite_id "
-	      "FROM itemsite "
-	      "WHERE ((itemsite_item_id=:item_id)"
-	      "  AND  (itemsite_warehous_id=:whsid));");
-    transferPopulateItemInfo.bindValue(":item_id", pItemid);
-    transferPopulateItemInfo.bindValue(":whsid", _warehouse->id());
-    transferPopulateItemInfo.exec();
-    if (transferPopulateItemInfo.first())
+    ItemBundle item = ItemBundleCache::instance()->bundle(ItemBundleRequest(pItemid, _warehouse->id()));
+    if (item.hasItemsite())
     {
-      _stdcost->setBaseValue(transferPopulateItemInfo.value("stdcost").toDouble());
-      _itemsiteid = transferPopulateItemInfo.value("itemsite_id").toInt();
+      _stdcost->setBaseValue(item.value("stdcost").toDouble());
+      _itemsiteid = item.value("itemsite_id").toInt();
     }
-    else if (ErrorReporter::error(QtCriticalMsg, this, tr("Error Retrieving ItemSite Information"),
-                                  transferPopulateItemInfo, __FILE__, __LINE__))
+    else if (! item.lastError().isEmpty())
     {
+      ErrorReporter::error(QtCriticalMsg, this, tr("Error Retrieving ItemSite Information"),
+                           item.lastError(), __FILE__, __LINE__);
       return;
     }
     
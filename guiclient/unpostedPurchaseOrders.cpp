@@ -27,6 +27,7 @@
 #include "storedProcErrorLookup.h"
 #include "parameterwidget.h"
 #include "errorReporter.h"
+#include "windowPool.h"
 
 unpostedPurchaseOrders::unpostedPurchaseOrders(QWidget* parent, const char*, Qt::WindowFlags fl)
   : display(parent, "unpostedPurchaseOrders", fl)
@@ -84,7 +85,7 @@ void unpostedPurchaseOrders::sNew()
   ParameterList params;
   params.append("mode", "new");
 
-  purchaseOrder *newdlg = new purchaseOrder();
+  purchaseOrder *newdlg = qobject_cast<purchaseOrder*>(WindowPool::instance()->take("purchaseOrder"));
   newdlg->set(params);
   omfgThis->handleNewWindow(newdlg);
 }
@@ -103,7 +104,7 @@ void unpostedPurchaseOrders::sEdit()
       params.append("mode", "edit");
       params.append("pohead_id", ((XTreeWidgetItem*)(selected[i]))->id());
 
-      purchaseOrder *newdlg = new purchaseOrder();
+      purchaseOrder *newdlg = qobject_cast<purchaseOrder*>(WindowPool::instance()->take("purchaseOrder"));
       newdlg->set(params);
       omfgThis->handleNewWindow(newdlg);
       done = true;
@@ -129,7 +130,7 @@ void unpostedPurchaseOrders::sView()
       params.append("mode", "view");
       params.append("pohead_id", ((XTreeWidgetItem*)(selected[i]))->id());
 
-      purchaseOrder *newdlg = new purchaseOrder();
+      purchaseOrder *newdlg = qobject_cast<purchaseOrder*>(WindowPool::instance()->take("purchaseOrder"));
       newdlg->set(params);
       omfgThis->handleNewWindow(newdlg);
       break;
@@ -148,57 +149,55 @@ void unpostedPurchaseOrders::sDelete()
   {
     unpostedDelete.prepare("SELECT deletePo(:pohead_id) AS result;");
 
-    QList<XTreeWidgetItem*> selected = list()->selectedItems();
+    QList<XTreeWidgetItem*> selected;
+    QVariantList            ids;
+    foreach (XTreeWidgetItem *item, list()->selectedItems())
+    {
+      if (item->rawValue("pohead_status").toString() == "U" && checkSitePrivs(item->id()))
+      {
+        selected << item;
+        ids      << item->id();
+      }
+    }
+
+    // If any are locked, don't proceed
+    if (!ids.isEmpty() && !_lock.acquireAll("pohead", ids, AppLock::Interactive))
+      return;
+
     bool done = false;
     for (int i = 0; i < selected.size(); i++)
     {
-      if (checkSitePrivs(((XTreeWidgetItem*)(selected[i]))->id()))
+      if (selected[i]->altId() != -1)
       {
-        if (selected[i]->rawValue("pohead_status").toString() == "U")
-        {
-          if (selected[i]->altId() != -1)
-		      {
-            QString question = tr("<p>The Purchase Order that you selected to delete was created "
-            "to satisfy Sales Order demand. If you delete the selected "
-            "Purchase Order then the Sales Order demand will remain but "
-            "the Purchase Order to relieve that demand will not. Are you "
-            "sure that you want to delete the selected Purchase Order?" );
-            if (QMessageBox::question(this, tr("Delete Purchase Order?"),
-                                      question,
-                                      QMessageBox::Yes,
-                                      QMessageBox::No | QMessageBox::Default) == QMessageBox::No)
-			        continue;
-		      }
-
-          // If locked, don't proceed
-          if (!_lock.acquire("pohead", ((XTreeWidgetItem*)(selected[i]))->id(), AppLock::Interactive))
-          {
-            if (i == selected.size() - 1)
-              return;
-            else
-              continue;
-          }
-
-          unpostedDelete.bindValue(":pohead_id", ((XTreeWidgetItem*)(selected[i]))->id());
-          unpostedDelete.exec();
-          if (unpostedDelete.first() && ! unpostedDelete.value("result").toBool())
-              ErrorReporter::error(QtCriticalMsg, this, tr("Error Occurred"),
-                               tr("%1: <p>Only Unposted Purchase Orders may be "
-                                  "deleted. Check the status of Purchase Order "
-                                  "%2. If it is 'U' then contact your system "
-                                  "Administrator.")
-                                   .arg(windowTitle())
-                                   .arg(selected[i]->text(0)),__FILE__,__LINE__);
-          else if (unpostedDelete.lastError().type() != QSqlError::NoError)
-            ErrorReporter::error(QtCriticalMsg, this, tr("Error Deleting Purchase Order"),
-                               unpostedDelete, __FILE__, __LINE__);
-          else
-            done = true;
-
-          _lock.release();
-        }
+        QString question = tr("<p>The Purchase Order that you selected to delete was created "
+        "to satisfy Sales Order demand. If you delete the selected "
+        "Purchase Order then the Sales Order demand will remain but "
+        "the Purchase Order to relieve that demand will not. Are you "
+        "sure that you want to delete the selected Purchase Order?" );
+        if (QMessageBox::question(this, tr("Delete Purchase Order?"),
+                                  question,
+                                  QMessageBox::Yes,
+                                  QMessageBox::No | QMessageBox::Default) == QMessageBox::No)
+          continue;
       }
+
+      unpostedDelete.bindValue(":pohead_id", ((XTreeWidgetItem*)(selected[i]))->id());
+      unpostedDelete.exec();
+      if (unpostedDelete.first() && ! unpostedDelete.value("result").toBool())
+          ErrorReporter::error(QtCriticalMsg, this, tr("Error Occurred"),
+                           tr("%1: <p>Only Unposted Purchase Orders may be "
+                              "deleted. Check the status of Purchase Order "
+                              "%2. If it is 'U' then contact your system "
+                              "Administrator.")
+                               .arg(windowTitle())
+                               .arg(selected[i]->text(0)),__FILE__,__LINE__);
+      else if (unpostedDelete.lastError().type() != QSqlError::NoError)
+        ErrorReporter::error(QtCriticalMsg, this, tr("Error Deleting Purchase Order"),
+                           unpostedDelete, __FILE__, __LINE__);
+      else
+        done = true;
     }
+    _lock.release();
     if (done)
       omfgThis->sPurchaseOrdersUpdated(-1, true);
     else
@@ -270,42 +269,43 @@ void unpostedPurchaseOrders::sRelease()
   XSqlQuery unpostedRelease;
   unpostedRelease.prepare("SELECT releasePurchaseOrder(:pohead_id) AS result;");
 
-  QList<XTreeWidgetItem*> selected = list()->selectedItems();
-  bool done = false;
-  for (int i = 0; i < selected.size(); i++)
+  QList<XTreeWidgetItem*> selected;
+  QVariantList            ids;
+  foreach (XTreeWidgetItem *item, list()->selectedItems())
   {
-    if ((selected[i]->rawValue("pohead_status").toString() == "U")
+    if ((item->rawValue("pohead_status").toString() == "U")
       && (_privileges->check("ReleasePurchaseOrders"))
-      && (checkSitePrivs(((XTreeWidgetItem*)(selected[i]))->id())))
+      && (checkSitePrivs(item->id())))
     {
-      // If locked, don't proceed
-      if (!_lock.acquire("pohead", ((XTreeWidgetItem*)(selected[i]))->id(), AppLock::Interactive))
-      {
-        if (i == selected.size() - 1)
-          return;
-        else
-          continue;
-      }
+      selected << item;
+      ids      << item->id();
+    }
+  }
 
-      unpostedRelease.bindValue(":pohead_id", ((XTreeWidgetItem*)(selected[i]))->id());
-      unpostedRelease.exec();
-      if (unpostedRelease.first())
-      {
-        int result = unpostedRelease.value("result").toInt();
-        if (result < 0)
-          ErrorReporter::error(QtCriticalMsg, this, tr("Error Releasing Purchase Order"),
-                                 storedProcErrorLookup("releasePurchaseOrder", result),
-                                 __FILE__, __LINE__);
-        else
-          done = true;
-      }
-      else if (unpostedRelease.lastError().type() != QSqlError::NoError)
-        ErrorReporter::error(QtCriticalMsg, this, tr("Error Releasing Purchase Order"),
-                           unpostedRelease, __FILE__, __LINE__);
+  // If any are locked, don't proceed
+  if (!ids.isEmpty() && !_lock.acquireAll("pohead", ids, AppLock::Interactive))
+    return;
 
-      _lock.release();
+  bool done = false;
+  for (int i = 0; i < selected.size(); i++)
+  {
+    unpostedRelease.bindValue(":pohead_id", ((XTreeWidgetItem*)(selected[i]))->id());
+    unpostedRelease.exec();
+    if (unpostedRelease.first())
+    {
+      int result = unpostedRelease.value("result").toInt();
+      if (result < 0)
+        ErrorReporter::error(QtCriticalMsg, this, tr("Error Releasing Purchase Order"),
+                               storedProcErrorLookup("releasePurchaseOrder", result),
+                               __FILE__, __LINE__);
+      else
+        done = true;
     }
+    else if (unpostedRelease.lastError().type() != QSqlError::NoError)
+      ErrorReporter::error(QtCriticalMsg, this, tr("Error Releasing Purchase Order"),
+                         unpostedRelease, __FILE__, __LINE__);
   }
+  _lock.release();
   if (done)
     omfgThis->sPurchaseOrdersUpdated(-1, true);
   else
@@ -321,42 +321,43 @@ void unpostedPurchaseOrders::sUnrelease()
   XSqlQuery unRelease;
   unRelease.prepare("SELECT unreleasePurchaseOrder(:pohead_id) AS result;");
   
-  QList<XTreeWidgetItem*> selected = list()->selectedItems();
+  QList<XTreeWidgetItem*> selected;
+  QVariantList            ids;
+  foreach (XTreeWidgetItem *item, list()->selectedItems())
+  {
+    if ((item->rawValue("pohead_status").toString() == "O")
+      && (_privileges->check("UnreleasePurchaseOrders"))
+      && (checkSitePrivs(item->id())))
+    {
+      selected << item;
+      ids      << item->id();
+    }
+  }
+
+  // If any are locked, don't proceed
+  if (!ids.isEmpty() && !_lock.acquireAll("pohead", ids, AppLock::Interactive))
+    return;
+
   bool done = false;
   for (int i = 0; i < selected.size(); i++)
   {
-    if ((selected[i]->rawValue("pohead_status").toString() == "O")
-        && (_privileges->check("UnreleasePurchaseOrders"))
-        && (checkSitePrivs(((XTreeWidgetItem*)(selected[i]))->id())))
+    unRelease.bindValue(":pohead_id", ((XTreeWidgetItem*)(selected[i]))->id());
+    unRelease.exec();
+    if (unRelease.first())
     {
-      // If locked, don't proceed
-      if (!_lock.acquire("pohead", ((XTreeWidgetItem*)(selected[i]))->id(), AppLock::Interactive))
-      {
-        if (i == selected.size() - 1)
-          return;
-        else
-          continue;
-      }
-
-      unRelease.bindValue(":pohead_id", ((XTreeWidgetItem*)(selected[i]))->id());
-      unRelease.exec();
-      if (unRelease.first())
-      {
-        int result = unRelease.value("result").toInt();
-        if (result < 0)
-          ErrorReporter::error(QtCriticalMsg, this, tr("Error Unreleasing Purchase Order"),
-                                 storedProcErrorLookup("unreleasePurchaseOrder", result),
-                                 __FILE__, __LINE__);
-        else
-          done = true;
-      }
-      else if (unRelease.lastError().type() != QSqlError::NoError)
+      int result = unRelease.value("result").toInt();
+      if (result < 0)
         ErrorReporter::error(QtCriticalMsg, this, tr("Error Unreleasing Purchase Order"),
-                           unRelease, __FILE__, __LINE__);
-
-      _lock.release();
+                               storedProcErrorLookup("unreleasePurchaseOrder", result),
+                               __FILE__, __LINE__);
+      else
+        done = true;
     }
+    else if (unRelease.lastError().type() != QSqlError::NoError)
+      ErrorReporter::error(QtCriticalMsg, this, tr("Error Unreleasing Purchase Order"),
+                         unRelease, __FILE__, __LINE__);
   }
+  _lock.release();
   if (done)
     omfgThis->sPurchaseOrdersUpdated(-1, true);
   else
@@ -0,0 +1,338 @@
+/*
+ * This file is part of the xTuple ERP: PostBooks Edition, a free and
+ * open source Enterprise Resource Planning software suite,
+ * Copyright (c) 1999-2019 by OpenMFG LLC, d/b/a xTuple.
+ * It is licensed to you under the Common Public Attribution License
+ * version 1.0, the full text of which (including xTuple-specific Exhibits)
+ * is available at www.xtuple.com/CPAL.  By using this software, you agree
+ * to be bound by its terms.
+ */
+
+#include "windowPool.h"
+
+#include <QApplication>
+#include <QEvent>
+#include <QMetaObject>
+#include <QSqlDatabase>
+#include <QWidget>
+
+#include "guiclient.h"
+#include "purchaseOrder.h"
+#include "salesOrder.h"
+#include "workOrder.h"
+
+#define DEBUG false
+
+// how long after startup to start building spares, in milliseconds
+#define PREWARMDELAY  5000
+// how long after a pooled window closes to build its replacement
+#define REFILLDELAY   1000
+// how often to look for spares to rebuild while the user is idle
+#define IDLECHECK     5000
+// how long without keyboard or mouse input counts as idle
+#define IDLEDELAY     10000
+// how old a spare may get before it is rebuilt during idle time, in seconds
+#define MAXSPAREAGE   300
+
+static QWidget *newPurchaseOrder(QWidget *pParent)
+{
+  return new purchaseOrder(pParent);
+}
+
+static QWidget *newSalesOrder(QWidget *pParent)
+{
+  return new salesOrder(pParent);
+}
+
+static QWidget *newWorkOrder(QWidget *pParent)
+{
+  return new workOrder(pParent);
+}
+
+WindowPool::WindowPool(QObject *pParent)
+  : QObject(pParent),
+    _idleTimer(this),
+    _building(false),
+    _refillPending(false)
+{
+  setObjectName("windowPool");
+
+  connect(_privileges, SIGNAL(privilegesChanged(QBitArray)), this, SLOT(clear()));
+  connect(_privileges, SIGNAL(privilegesChanged(QBitArray)), this, SLOT(prewarm()));
+  connect(omfgThis,    SIGNAL(dbConnectionLost()),           this, SLOT(clear()));
+
+  // spares read settings and fill lookup lists when they are constructed
+  connect(_metrics,     SIGNAL(loaded()),              this, SLOT(sInvalidate()));
+  connect(_metrics,     SIGNAL(valueChanged(QString)), this, SLOT(sMetricChanged(QString)));
+  connect(_preferences, SIGNAL(loaded()),              this, SLOT(sInvalidate()));
+  connect(_preferences, SIGNAL(valueChanged(QString)), this, SLOT(sPreferenceChanged(QString)));
+
+  _lastInput.start();
+  qApp->installEventFilter(this);
+  connect(&_idleTimer, SIGNAL(timeout()), this, SLOT(sRefreshStale()));
+  _idleTimer.start(IDLECHECK);
+}
+
+WindowPool::~WindowPool()
+{
+  foreach (QString name, _spares.keys())
+  {
+    for (int i = 0; i < _spares[name].size(); i++)
+      delete _spares[name].at(i).first;
+  }
+}
+
+WindowPool *WindowPool::instance()
+{
+  static WindowPool *pool = 0;
+  if (! pool)
+  {
+    pool = new WindowPool(omfgThis);
+    pool->addType("purchaseOrder", newPurchaseOrder, "MaintainPurchaseOrders ViewPurchaseOrders");
+    pool->addType("salesOrder",    newSalesOrder,    "MaintainSalesOrders ViewSalesOrders MaintainQuotes ViewQuotes");
+    pool->addType("workOrder",     newWorkOrder,     "MaintainWorkOrders ViewWorkOrders");
+
+    pool->watch("purchaseOrder", SIGNAL(taxAuthsUpdated(int)));
+    pool->watch("purchaseOrder", SIGNAL(userUpdated(QString)));
+    pool->watch("purchaseOrder", SIGNAL(warehousesUpdated()));
+    pool->watch("salesOrder",    SIGNAL(bankAccountsUpdated()));
+    pool->watch("salesOrder",    SIGNAL(salesRepUpdated(int)));
+    pool->watch("salesOrder",    SIGNAL(taxAuthsUpdated(int)));
+    pool->watch("salesOrder",    SIGNAL(warehousesUpdated()));
+    pool->watch("workOrder",     SIGNAL(warehousesUpdated()));
+  }
+  return pool;
+}
+
+/** @brief Register a window class with the pool.
+
+    @param pName       The class name passed to take()
+    @param pFactory    A function that constructs a new window of the class
+    @param pPrivileges A privilege expression; no spares are built for a
+                       user who fails it
+  */
+void WindowPool::addType(const QString &pName, Factory pFactory, const QString &pPrivileges)
+{
+  _factories.insert(pName, pFactory);
+  _required.insert(pName, pPrivileges);
+}
+
+/** @brief Replace the spares of type pName whenever GUIClient emits
+           pSignal, which announces a change to one of their lookup lists.
+  */
+void WindowPool::watch(const QString &pName, const char *pSignal)
+{
+  int index = omfgThis->metaObject()->indexOfSignal(QMetaObject::normalizedSignature(pSignal + 1));
+  if (index < 0)
+  {
+    qWarning("WindowPool::watch(%s) GUIClient has no signal %s",
+             qPrintable(pName), pSignal + 1);
+    return;
+  }
+
+  if (! _watchers.contains(index))
+    connect(omfgThis, pSignal, this, SLOT(sLookupChanged()));
+  _watchers.insert(index, pName);
+}
+
+/** @brief The number of spares to keep of each type. */
+int WindowPool::size() const
+{
+  QString size = _preferences->value("WindowPoolSize");
+  return size.isEmpty() ? 1 : qMax(size.toInt(), 0);
+}
+
+/** @brief Return a window of class pName for the caller to set() and pass
+           to GUIClient::handleNewWindow().
+
+    A window opened from a modal window has to be modal too, so it is
+    always constructed for pParent. Otherwise handleNewWindow() would drop
+    the parent anyway, so a spare is returned if one is ready.
+
+    @return The window, or 0 if pName was never registered
+  */
+QWidget *WindowPool::take(const QString &pName, QWidget *pParent)
+{
+  Factory factory = _factories.value(pName);
+  if (! factory)
+    return 0;
+
+  QWidget *window = 0;
+  if (pParent && pParent->window()->isModal())
+    window = factory(pParent);
+  else
+  {
+    if (! _spares.value(pName).isEmpty())
+    {
+      window = _spares[pName].takeFirst().first;
+      if (DEBUG)
+        qDebug("WindowPool::take(%s) handing out a spare", qPrintable(pName));
+    }
+    else
+      window = factory(0);
+  }
+
+  connect(window, SIGNAL(destroyed()), this, SLOT(sScheduleRefill()));
+  return window;
+}
+
+/** @brief Throw away all of the spares. */
+void WindowPool::clear()
+{
+  foreach (QString name, _spares.keys())
+  {
+    for (int i = 0; i < _spares[name].size(); i++)
+      _spares[name].at(i).first->deleteLater();
+  }
+  _spares.clear();
+}
+
+/** @brief Start building spares once the application has had time to
+           settle.
+  */
+void WindowPool::prewarm()
+{
+  if (size() <= 0 || _refillPending)
+    return;
+
+  _refillPending = true;
+  QTimer::singleShot(PREWARMDELAY, this, SLOT(sRefill()));
+}
+
+bool WindowPool::eventFilter(QObject *pObj, QEvent *pEvent)
+{
+  QEvent::Type type = pEvent->type();
+  if (type == QEvent::KeyPress || type == QEvent::MouseButtonPress ||
+      type == QEvent::Wheel)
+    _lastInput.restart();
+
+  return QObject::eventFilter(pObj, pEvent);
+}
+
+/** @brief Throw away the spares of type pName and build new ones. */
+void WindowPool::invalidate(const QString &pName)
+{
+  // a spare's own constructor saving a setting doesn't make it stale
+  if (_building || _spares.value(pName).isEmpty())
+    return;
+
+  if (DEBUG)
+    qDebug("WindowPool::invalidate(%s)", qPrintable(pName));
+
+  QList<QPair<QWidget*, QDateTime> > spares = _spares.take(pName);
+  for (int i = 0; i < spares.size(); i++)
+    spares.at(i).first->deleteLater();
+  sScheduleRefill();
+}
+
+/* Build one missing spare per pass through the event loop so the user is
+   never kept waiting for more than one construction.
+ */
+void WindowPool::sRefill()
+{
+  _refillPending = false;
+  if (! QSqlDatabase::database().isOpen())
+    return;
+
+  int size = this->size();
+  foreach (QString name, _factories.keys())
+  {
+    if (_spares.value(name).size() >= size ||
+        ! _privileges->check(_required.value(name)))
+      continue;
+
+    if (DEBUG)
+      qDebug("WindowPool::sRefill() building a %s", qPrintable(name));
+
+    _building = true;
+    _metrics->setReadLog(&_metricsRead[name]);
+    _preferences->setReadLog(&_preferencesRead[name]);
+    QWidget *window = _factories.value(name)(0);
+    _metrics->setReadLog(0);
+    _preferences->setReadLog(0);
+    _building = false;
+    _spares[name].append(qMakePair(window, QDateTime::currentDateTime()));
+
+    _refillPending = true;
+    QTimer::singleShot(0, this, SLOT(sRefill()));
+    return;
+  }
+}
+
+/* Metrics or preferences were reread wholesale, so any of them may differ
+   from what the spares saw.
+ */
+void WindowPool::sInvalidate()
+{
+  if (_building || _spares.isEmpty())
+    return;
+
+  clear();
+  sScheduleRefill();
+}
+
+void WindowPool::sLookupChanged()
+{
+  foreach (QString name, _watchers.values(senderSignalIndex()))
+    invalidate(name);
+}
+
+void WindowPool::sMetricChanged(const QString &pName)
+{
+  foreach (QString name, _metricsRead.keys())
+  {
+    if (_metricsRead.value(name).contains(pName))
+      invalidate(name);
+  }
+}
+
+/* Most preference writes come from list column and filter settings that
+   no spare reads, so check before throwing work away.
+ */
+void WindowPool::sPreferenceChanged(const QString &pName)
+{
+  foreach (QString name, _preferencesRead.keys())
+  {
+    if (_preferencesRead.value(name).contains(pName))
+      invalidate(name);
+  }
+}
+
+/* Rebuild the oldest spare past MAXSPAREAGE, one per check so the user
+   is never kept waiting for more than one construction if they come back.
+ */
+void WindowPool::sRefreshStale()
+{
+  if (_refillPending || _building || _lastInput.elapsed() < IDLEDELAY ||
+      ! QSqlDatabase::database().isOpen())
+    return;
+
+  QDateTime oldest = QDateTime::currentDateTime().addSecs(-MAXSPAREAGE);
+  QString   stalest;
+  foreach (QString name, _spares.keys())
+  {
+    QList<QPair<QWidget*, QDateTime> > &spares = _spares[name];
+    if (! spares.isEmpty() && spares.first().second < oldest)
+    {
+      oldest  = spares.first().second;
+      stalest = name;
+    }
+  }
+  if (stalest.isEmpty())
+    return;
+
+  if (DEBUG)
+    qDebug("WindowPool::sRefreshStale() replacing a %s", qPrintable(stalest));
+
+  _spares[stalest].takeFirst().first->deleteLater();
+  sRefill();
+}
+
+void WindowPool::sScheduleRefill()
+{
+  if (_refillPending || size() <= 0)
+    return;
+
+  _refillPending = true;
+  QTimer::singleShot(REFILLDELAY, this, SLOT(sRefill()));
+}
@@ -0,0 +1,105 @@
+/*
+ * This file is part of the xTuple ERP: PostBooks Edition, a free and
+ * open source Enterprise Resource Planning software suite,
+ * Copyright (c) 1999-2019 by OpenMFG LLC, d/b/a xTuple.
+ * It is licensed to you under the Common Public Attribution License
+ * version 1.0, the full text of which (including xTuple-specific Exhibits)
+ * is available at www.xtuple.com/CPAL.  By using this software, you agree
+ * to be bound by its terms.
+ */
+
+#ifndef __WINDOWPOOL_H__
+#define __WINDOWPOOL_H__
+
+#include <QDateTime>
+#include <QList>
+#include <QMap>
+#include <QObject>
+#include <QPair>
+#include <QSet>
+#include <QString>
+#include <QTime>
+#include <QTimer>
+
+class QEvent;
+class QWidget;
+
+/**
+  @class WindowPool
+
+  @brief Keeps constructed, never-shown instances of the busiest document
+         windows ready so opening one doesn't wait for its widget tree,
+         lookups and combo box queries.
+
+  Each pooled type is registered with a factory and the privileges needed
+  to open it. take() hands out a spare if there is one and constructs a
+  new window otherwise. Spares are built during idle time: a few seconds
+  after prewarm() is called at startup, and again after a window taken
+  from the pool closes.
+
+  The reset contract is that a spare is always a window that has only been
+  constructed. It has never had set() called, never been shown and never
+  held a document, and the pool never hands out the same window twice. A
+  closed window is deleted as usual and a fresh one takes its place, so
+  nothing from one document can leak into the next.
+
+  While a spare is built the pool records which metrics and preferences
+  it reads, and only a change to one of those replaces it. Types also
+  watch() the GUIClient signals for the lookup lists they fill, such as
+  sales reps or sites. Lists with no change signal of their own are kept
+  fresh by age: once the user has been idle for a few seconds, a spare
+  older than a few minutes is rebuilt. The pool is emptied when metrics or
+  preferences are reloaded, when privileges change and when the database
+  connection is lost.
+
+  The user preference WindowPoolSize sets how many spares to keep of each
+  type; 0 turns the pool off.
+ */
+class WindowPool : public QObject
+{
+  Q_OBJECT
+
+  public:
+    typedef QWidget *(*Factory)(QWidget *pParent);
+
+    static WindowPool *instance();
+    virtual ~WindowPool();
+
+    void     addType(const QString &pName, Factory pFactory, const QString &pPrivileges);
+    void     watch(const QString &pName, const char *pSignal);
+    int      size() const;
+    QWidget *take(const QString &pName, QWidget *pParent = 0);
+
+  public slots:
+    virtual void clear();
+    virtual void prewarm();
+
+  protected:
+    WindowPool(QObject *pParent = 0);
+
+    virtual bool eventFilter(QObject *pObj, QEvent *pEvent);
+    void invalidate(const QString &pName);
+
+  protected slots:
+    virtual void sInvalidate();
+    virtual void sLookupChanged();
+    virtual void sMetricChanged(const QString &pName);
+    virtual void sPreferenceChanged(const QString &pName);
+    virtual void sRefill();
+    virtual void sRefreshStale();
+    virtual void sScheduleRefill();
+
+  private:
+    QMap<QString, Factory>                                   _factories;
+    QMap<QString, QString>                                   _required;
+    QMap<QString, QList<QPair<QWidget*, QDateTime> > >       _spares;
+    QMap<QString, QSet<QString> >                            _metricsRead;
+    QMap<QString, QSet<QString> >                            _preferencesRead;
+    QMultiMap<int, QString>                                  _watchers;
+    QTimer                                                   _idleTimer;
+    QTime                                                    _lastInput;
+    bool                                                     _building;
+    bool                                                     _refillPending;
+};
+
+#endif
@@ -70,7 +70,14 @@ QWidget* xTupleGuiClientInterface::openWindow(const QString      pname,
 
 QAction* xTupleGuiClientInterface::findAction(const QString pname)
 {
- return omfgThis->findChild<QAction*>(pname);
+  QAction *action = omfgThis->findChild<QAction*>(pname);
+  if (! action)
+  {
+    // the action may belong to a module menu that hasn't been built yet
+    omfgThis->buildMenus();
+    action = omfgThis->findChild<QAction*>(pname);
+  }
+  return action;
 }
 
 void xTupleGuiClientInterface::addDocumentWatch(QString path, int id)
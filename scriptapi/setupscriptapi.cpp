@@ -15,6 +15,7 @@
 #include <QMessageBox>
 
 #include "applock.h"
+#include "calendarcache.h"
 #include "metrics.h"
 #include "xtsettings.h"
 #include "char.h"
@@ -174,6 +175,7 @@ void setupScriptApi(QScriptEngine *engine, Preferences *pPreferences)
     prefs = pPreferences;
 
   setupAppLockProto(engine);
+  setupCalendarCache(engine);
   setupXtSettings(engine);
   setupEngineEvaluate(engine);
   setupExportHelper(engine);
@@ -0,0 +1,56 @@
+/**
+* Tests for CalendarCache
+*/
+var publicFunctions = [
+        'calendarType'
+        , 'clear'
+        , 'currentDate'
+        , 'isWorkingDay'
+        , 'nextWorkingDate'
+    ];
+
+assertIsNotConstructor(CalendarCache, 'CalendarCache');
+
+// Test the public methods
+publicFunctions.forEach(function(func) {
+    assertIsFunction(CalendarCache[func], func);
+});
+
+function sameDay(a, b) {
+    return a.getFullYear() == b.getFullYear() &&
+           a.getMonth()    == b.getMonth()    &&
+           a.getDate()     == b.getDate();
+}
+
+// The cached server date must match current_date
+var dateq = new XSqlQuery("SELECT current_date AS result;");
+if (dateq.first())
+    assert(sameDay(CalendarCache.currentDate(), dateq.value("result")),
+           'currentDate() does not match current_date');
+
+// Every cached answer must match calculatenextworkingdate() directly,
+// including across the boundary between two cached windows
+CalendarCache.clear();
+var workq = new XSqlQuery(
+    "SELECT warehous_id, day::DATE AS day,"
+  + "       calculatenextworkingdate(warehous_id, day::DATE, 0) AS result"
+  + "  FROM whsinfo,"
+  + "       generate_series(current_date - 200, current_date + 200,"
+  + "                       INTERVAL '1 day') AS day"
+  + " WHERE warehous_active"
+  + " ORDER BY warehous_id, day;");
+while (workq.next()) {
+    var site = workq.value("warehous_id");
+    var day  = workq.value("day");
+    var next = CalendarCache.nextWorkingDate(site, day);
+    assert(sameDay(next, workq.value("result")),
+           'nextWorkingDate(' + site + ', ' + day + ') returned ' + next);
+    assert(CalendarCache.isWorkingDay(site, day) == sameDay(next, day),
+           'isWorkingDay(' + site + ', ' + day + ') disagrees with nextWorkingDate');
+}
+
+// Calendar types must match calhead
+var calq = new XSqlQuery("SELECT calhead_id, calhead_type FROM calhead;");
+while (calq.next())
+    assert(CalendarCache.calendarType(calq.value("calhead_id")) == calq.value("calhead_type"),
+           'calendarType(' + calq.value("calhead_id") + ') is wrong');
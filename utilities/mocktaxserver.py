@@ -0,0 +1,168 @@
+#!/usr/bin/env python3
+#
+# This file is part of the xTuple ERP: PostBooks Edition, a free and
+# open source Enterprise Resource Planning software suite,
+# Copyright (c) 1999-2019 by OpenMFG LLC, d/b/a xTuple.
+# It is licensed to you under the Common Public Attribution License
+# version 1.0, the full text of which (including xTuple-specific Exhibits)
+# is available at www.xtuple.com/CPAL.  By using this software, you agree
+# to be bound by its terms.
+#
+# A stand-in for the AvaTax REST v2 service with fixed latency, for timing
+# the tax integration without depending on the real service.
+#
+# HOW TO USE THIS FROM THE COMMAND LINE
+#   python3 mocktaxserver.py [--port 8099] [--latency 200] [--rate 0.0825]
+#
+# then set the Avalara URL in Configure Tax to http://localhost:8099/api/v2/
+# Every request waits --latency milliseconds before it is answered. Tax on
+# each line is amount * --rate. Request counts and mean response times are
+# printed every --report seconds.
+#
+# GET /bench/<bytes> answers with <bytes> bytes of text after the same
+# latency, for timing xtNetworkRequestManager and other HTTP clients.
+
+import argparse
+import json
+import re
+import sys
+import threading
+import time
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+
+options = None
+stats_lock = threading.Lock()
+stats = {}
+
+
+def record(kind, elapsed):
+    with stats_lock:
+        count, total = stats.get(kind, (0, 0.0))
+        stats[kind] = (count + 1, total + elapsed)
+
+
+def report():
+    while True:
+        time.sleep(options.report)
+        with stats_lock:
+            if not stats:
+                continue
+            line = ', '.join('%s %d (%.0f ms)' % (kind, count, total * 1000 / count)
+                             for kind, (count, total) in sorted(stats.items()))
+        print(time.strftime('%H:%M:%S'), line, flush=True)
+
+
+def transaction(request):
+    lines = []
+    total_tax = 0.0
+    for line in request.get('lines', []):
+        amount = float(line.get('amount', 0))
+        tax = round(amount * options.rate, 2)
+        total_tax += tax
+        lines.append({
+            'lineNumber': line.get('number', str(len(lines) + 1)),
+            'itemCode': line.get('itemCode', ''),
+            'lineAmount': amount,
+            'taxableAmount': amount,
+            'tax': tax,
+            'taxCalculated': tax,
+            'details': [{
+                'jurisType': 'STA',
+                'jurisCode': 'MK',
+                'jurisName': 'MOCK',
+                'taxName': 'MOCK STATE TAX',
+                'taxType': 'Sales',
+                'rate': options.rate,
+                'taxableAmount': amount,
+                'tax': tax,
+                'taxCalculated': tax,
+            }],
+        })
+    return {
+        'id': 0,
+        'code': request.get('code', ''),
+        'type': request.get('type', ''),
+        'status': 'Saved',
+        'totalAmount': sum(l['lineAmount'] for l in lines),
+        'totalTax': round(total_tax, 2),
+        'totalTaxCalculated': round(total_tax, 2),
+        'lines': lines,
+        'summary': [],
+    }
+
+
+class Handler(BaseHTTPRequestHandler):
+    protocol_version = 'HTTP/1.1'
+
+    def log_message(self, format, *args):
+        if options.verbose:
+            BaseHTTPRequestHandler.log_message(self, format, *args)
+
+    def answer(self, kind, body, status=200, content_type='application/json'):
+        start = time.time()
+        time.sleep(options.latency / 1000.0)
+        data = body if isinstance(body, bytes) else json.dumps(body).encode('utf-8')
+        self.send_response(status)
+        self.send_header('Content-Type', content_type)
+        self.send_header('Content-Length', str(len(data)))
+        self.end_headers()
+        self.wfile.write(data)
+        record(kind, time.time() - start)
+
+    def do_GET(self):
+        bench = re.match(r'/bench/(\d+)/?$', self.path)
+        if bench:
+            self.answer('bench', b'x' * min(int(bench.group(1)), 64 * 1024 * 1024),
+                        content_type='text/plain')
+        elif self.path.rstrip('/').endswith('/utilities/ping'):
+            self.answer('ping', {'version': 'mock', 'authenticated': True,
+                                 'authenticationType': 'UsernamePassword'})
+        elif '/definitions/taxcodes' in self.path:
+            self.answer('taxcodes', {'value': [{'taxCode': 'P0000000',
+                                                'description': 'Tangible personal property'}]})
+        elif '/definitions/entityusecodes' in self.path:
+            self.answer('taxexempt', {'value': [{'code': 'A', 'name': 'FEDERAL GOV'}]})
+        else:
+            self.answer('unknown', {'error': {'code': 'NotFound', 'message': self.path}}, 404)
+
+    def do_POST(self):
+        length = int(self.headers.get('Content-Length', 0))
+        try:
+            request = json.loads(self.rfile.read(length) or b'{}')
+        except ValueError:
+            request = {}
+
+        if re.search(r'/transactions/createoradjust', self.path):
+            self.answer('create', transaction(request.get('createTransactionModel', request)))
+        elif self.path.rstrip('/').endswith('/commit'):
+            self.answer('commit', {'status': 'Committed'})
+        elif self.path.rstrip('/').endswith('/void'):
+            self.answer('void', {'status': 'Cancelled'})
+        elif self.path.rstrip('/').endswith('/refund'):
+            self.answer('refund', transaction(request))
+        else:
+            self.answer('unknown', {'error': {'code': 'NotFound', 'message': self.path}}, 404)
+
+
+def main():
+    global options
+    parser = argparse.ArgumentParser(description='Stand-in AvaTax REST service')
+    parser.add_argument('--port',    type=int,   default=8099)
+    parser.add_argument('--latency', type=int,   default=200, help='milliseconds per request')
+    parser.add_argument('--rate',    type=float, default=0.0825)
+    parser.add_argument('--report',  type=int,   default=10, help='seconds between reports')
+    parser.add_argument('--verbose', action='store_true')
+    options = parser.parse_args()
+
+    threading.Thread(target=report, daemon=True).start()
+    server = ThreadingHTTPServer(('localhost', options.port), Handler)
+    print('mock tax server on http://localhost:%d/api/v2/' % options.port, flush=True)
+    try:
+        server.serve_forever()
+    except KeyboardInterrupt:
+        pass
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
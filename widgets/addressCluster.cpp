@@ -9,9 +9,13 @@
  */
 
 #include "addresscluster.h"
+#include "addressclusterprivate.h"
 
+#include <QCoreApplication>
 #include <QGridLayout>
 #include <QMessageBox>
+#include <QSqlDatabase>
+#include <QSqlDriver>
 #include <QSqlError>
 #include <QPushButton>
 #include <QtScript>
@@ -21,11 +25,156 @@
 #include <xsqlquery.h>
 
 #include "errorReporter.h"
+#include "guiclientinterface.h"
+#include "queryprofiler.h"
 #include "xcheckbox.h"
 #include "xtreewidget.h"
 
 #define DEBUG false
 
+AddressStateList::AddressStateList()
+  : freeForm(false)
+{
+}
+
+/* Add a state used by an address to a free-form list, keeping it sorted
+   the way the query that built the list sorts it.
+ */
+void AddressStateList::insert(int pId, const QString &pName, const QString &pCode)
+{
+  if (names.contains(pName))
+    return;
+
+  int i = 0;
+  while (i < names.size() && names.at(i) < pName)
+    i++;
+  ids.insert(i,   pId);
+  names.insert(i, pName);
+  codes.insert(i, pCode);
+}
+
+AddressStateCache::AddressStateCache(QObject *pParent)
+  : QObject(pParent)
+{
+  QSqlDatabase db = QSqlDatabase::database();
+  if (! db.driver()->subscribedToNotifications().contains("state"))
+    db.driver()->subscribeToNotification("state");
+  connect(db.driver(), SIGNAL(notification(const QString&)),
+          this,        SLOT(sNotified(const QString&)));
+
+  if (VirtualCluster::_guiClientInterface)
+    connect(VirtualCluster::_guiClientInterface, SIGNAL(dbConnectionLost()), this, SLOT(clear()));
+}
+
+AddressStateCache *AddressStateCache::instance()
+{
+  static AddressStateCache *cache = 0;
+  if (! cache)
+    cache = new AddressStateCache(QCoreApplication::instance());
+  return cache;
+}
+
+/** @brief Return the states to offer for pCountryId, whose abbreviation is
+           pCountry, reading them from the database only the first time.
+           A pCountryId of -1 asks for the states used by any address.
+  */
+const AddressStateList &AddressStateCache::states(int pCountryId, const QString &pCountry)
+{
+  if (_states.contains(pCountryId))
+    return _states[pCountryId];
+
+  AddressStateList list;
+  XSqlQuery stateq;
+  if (pCountryId >= 0)
+  {
+    MetaSQLQuery state("SELECT DISTINCT state_id,"
+                       "       CASE WHEN state_abbr IS NULL THEN state_name"
+                       "            WHEN TRIM(state_abbr) = '' THEN state_name"
+                       "            ELSE state_abbr END,"
+                       "       CASE WHEN state_abbr IS NULL THEN state_name"
+                       "            WHEN TRIM(state_abbr) = '' THEN state_name"
+                       "            ELSE state_abbr END"
+                       "  FROM state"
+                       " WHERE (state_country_id=<? value('country_id') ?>) "
+                       "ORDER BY 2;");
+    ParameterList params;
+    params.append("country_id", pCountryId);
+    stateq = state.toQuery(params);
+    while (stateq.next())
+    {
+      list.ids   << stateq.value(0).toInt();
+      list.names << stateq.value(1).toString();
+      list.codes << stateq.value(2).toString();
+    }
+  }
+
+  // AddressCluster's state combo box allows null, so its old count() <= 1
+  // test meant the same as this: the country has no state rows at all
+  if (list.ids.isEmpty())
+  {
+    if (DEBUG)
+      qDebug("AddressStateCache::states() find states for stateless country %s",
+             qPrintable(pCountry));
+    list = AddressStateList();
+    list.freeForm = true;
+    if (pCountryId >= 0)
+    {
+      stateq.prepare("SELECT MIN(addr_id), addr_state, addr_state"
+                     "  FROM addr"
+                     " WHERE (addr_country=:country)"
+                     " GROUP BY addr_state"
+                     " ORDER BY addr_state;");
+      stateq.bindValue(":country", pCountry);
+      stateq.exec();
+    }
+    else
+      stateq.exec("SELECT MIN(addr_id), addr_state, addr_state"
+                  "  FROM addr"
+                  " GROUP BY addr_state"
+                  " ORDER BY addr_state;");
+    while (stateq.next())
+    {
+      list.ids   << stateq.value(0).toInt();
+      list.names << stateq.value(1).toString();
+      list.codes << stateq.value(2).toString();
+    }
+  }
+
+  if (stateq.lastError().type() != QSqlError::NoError)
+  {
+    _uncached = list;   // don't keep a failed read
+    return _uncached;
+  }
+
+  _states.insert(pCountryId, list);
+  return _states[pCountryId];
+}
+
+/** @brief Add pState to the free-form lists after an address using it was
+           saved, so they stay current without reading addr again.
+  */
+void AddressStateCache::addressSaved(int pCountryId, int pAddrId, const QString &pState)
+{
+  if (pState.isEmpty())
+    return;
+
+  if (_states.contains(pCountryId) && _states[pCountryId].freeForm)
+    _states[pCountryId].insert(pAddrId, pState, pState);
+  if (_states.contains(-1))
+    _states[-1].insert(pAddrId, pState, pState);
+}
+
+void AddressStateCache::clear()
+{
+  _states.clear();
+}
+
+void AddressStateCache::sNotified(const QString &pNotification)
+{
+  if (pNotification == "state")
+    clear();
+}
+
 void AddressCluster::init()
 {
   _list = new QPushButton(tr("..."), this);
@@ -318,54 +467,20 @@ void AddressCluster::populateStateComboBox()
            qPrintable(tmpstate));
   _state->clear();
 
-  XSqlQuery stateq;
+  int countryid = -1;
   if (_country->id() >= 0 &&
       _country->id() == _country->id(_country->findText(_country->currentText(),
                                                         Qt::MatchExactly)))
-  {
-    MetaSQLQuery state("SELECT DISTINCT state_id,"
-                       "       CASE WHEN state_abbr IS NULL THEN state_name"
-                       "            WHEN TRIM(state_abbr) = '' THEN state_name"
-                       "            ELSE state_abbr END,"
-                       "       CASE WHEN state_abbr IS NULL THEN state_name"
-                       "            WHEN TRIM(state_abbr) = '' THEN state_name"
-                       "            ELSE state_abbr END"
-                       "  FROM state"
-                       " WHERE (state_country_id=<? value('country_id') ?>) "
-                       "ORDER BY 2;");
-    ParameterList params;
-    params.append("country_id", _country->id());
+    countryid = _country->id();
 
-    stateq = state.toQuery(params);
-    _state->populate(stateq);
+  const AddressStateList &states = AddressStateCache::instance()->states(countryid, _country->code());
+  for (int i = 0; i < states.ids.size(); i++)
+    _state->append(states.ids.at(i), states.names.at(i), states.codes.at(i));
+  _state->setId(-1);
 
-    _state->setEditable(_state->count() <= 1 ||
-                        (! tmpstate.isEmpty() &&
-                         ! (_state->findText(tmpstate, Qt::MatchExactly) >= 0)));
-    if (_state->count() <= 1)
-    {
-      if (DEBUG)
-        qDebug("%s::populateStateComboBox() find states for stateless country",
-           (objectName().isEmpty() ? "AddressCluster":qPrintable(objectName())));
-      stateq.prepare("SELECT MIN(addr_id), addr_state, addr_state"
-                     "  FROM addr"
-                     " WHERE (addr_country=:country)"
-                     " GROUP BY addr_state"
-                     " ORDER BY addr_state;");
-      stateq.bindValue(":country", _country->code());
-      stateq.exec();
-      _state->populate(stateq);
-    }
-  }
-  else
-  {
-    stateq.exec("SELECT MIN(addr_id), addr_state, addr_state"
-                "  FROM addr"
-                " GROUP BY addr_state"
-                " ORDER BY addr_state;");
-    _state->populate(stateq);
-    _state->setEditable(true);
-  }
+  _state->setEditable(states.freeForm || _state->count() <= 1 ||
+                      (! tmpstate.isEmpty() &&
+                       ! (_state->findText(tmpstate, Qt::MatchExactly) >= 0)));
 
   if (_state->isEditable())
     _state->setEditText(tmpstate);
@@ -658,6 +773,7 @@ int AddressCluster::save(enum SaveFlags flag)
       _id=datamodQ.value("result").toInt();
       _selected = false;
       _valid = true;
+      AddressStateCache::instance()->addressSaved(_country->id(), _id, _state->currentText());
       silentSetId(id());
       return id();
     }
@@ -1096,8 +1212,9 @@ void AddressSearch::sFillList()
     params.append("searchText", _search->text());
 
     MetaSQLQuery mql(sql);
+    QueryProbe probe(this, __FILE__, __LINE__);
     XSqlQuery query = mql.toQuery(params);
-    query.exec();
+    probe.record(query);
     _listTab->populate(query);
     if (ErrorReporter::error(QtCriticalMsg, this, tr("Error Searching Addresses"),
                              query, __FILE__, __LINE__))
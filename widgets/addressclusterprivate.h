@@ -0,0 +1,68 @@
+/*
+ * This file is part of the xTuple ERP: PostBooks Edition, a free and
+ * open source Enterprise Resource Planning software suite,
+ * Copyright (c) 1999-2019 by OpenMFG LLC, d/b/a xTuple.
+ * It is licensed to you under the Common Public Attribution License
+ * version 1.0, the full text of which (including xTuple-specific Exhibits)
+ * is available at www.xtuple.com/CPAL.  By using this software, you agree
+ * to be bound by its terms.
+ */
+
+#ifndef __ADDRESSCLUSTERPRIVATE_H__
+#define __ADDRESSCLUSTERPRIVATE_H__
+
+#include <QHash>
+#include <QList>
+#include <QObject>
+#include <QString>
+#include <QStringList>
+
+/** @brief The states offered for one country, in the order they're shown. */
+class AddressStateList
+{
+  public:
+    AddressStateList();
+
+    void insert(int pId, const QString &pName, const QString &pCode);
+
+    bool        freeForm;   // states are the ones used by addresses, not the state table
+    QList<int>  ids;
+    QStringList names;
+    QStringList codes;
+};
+
+/** @brief The state lists shown by every AddressCluster in the session.
+
+    Lists are read once per country and shared. They are dropped when the
+    state table changes or the database connection is lost.
+
+    Countries without entries in the state table offer the states already
+    used by their addresses. Reading those takes a pass over the whole addr
+    table, so the list is kept up to date as this session saves addresses
+    rather than read again.
+ */
+class AddressStateCache : public QObject
+{
+  Q_OBJECT
+
+  public:
+    static AddressStateCache *instance();
+
+    const AddressStateList &states(int pCountryId, const QString &pCountry);
+    void addressSaved(int pCountryId, int pAddrId, const QString &pState);
+
+  public slots:
+    virtual void clear();
+
+  protected:
+    AddressStateCache(QObject *pParent = 0);
+
+  protected slots:
+    virtual void sNotified(const QString &pNotification);
+
+  private:
+    QHash<int, AddressStateList> _states; // by country_id, -1 for every country
+    AddressStateList             _uncached;
+};
+
+#endif
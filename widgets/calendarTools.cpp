@@ -13,6 +13,7 @@
 #include <QtScript>
 
 #include "calendarTools.h"
+#include "calendarcache.h"
 
 CalendarComboBox::CalendarComboBox(QWidget *pParent, const char *pName) :
   XComboBox(pParent, pName)
@@ -22,11 +23,11 @@ CalendarComboBox::CalendarComboBox(QWidget *pParent, const char *pName) :
 
   if(_x_metrics)
   {
-    XSqlQuery q;
-    q.exec( "SELECT calhead_id, calhead_name, calhead_name "
-            "FROM calhead "
-            "ORDER BY calhead_name;" );
-    populate(q);
+    QList<QPair<int, QString> > calendars = CalendarCache::instance()->calendars();
+    clear();
+    for (int i = 0; i < calendars.size(); i++)
+      append(calendars.at(i).first, calendars.at(i).second);
+    setId(-1);
   }
 
   connect(this, SIGNAL(newID(int)), this, SIGNAL(newCalendarId(int)));
@@ -84,48 +85,20 @@ PeriodsListView::PeriodsListView(QWidget *pParent, const char *pName) :
 
 void PeriodsListView::populate(int pCalheadid)
 {
-  XSqlQuery caltype( QString( "SELECT calhead_type "
-                              "FROM calhead "
-                              "WHERE (calhead_id=%1);" )
-                     .arg(pCalheadid) );
-  if (caltype.first())
+  if (! CalendarCache::instance()->calendarType(pCalheadid).isEmpty())
   {
-    QString sql;
-
     _calheadid = pCalheadid;
     clear();
 
-    if (caltype.value("calhead_type").toString() == "A")
-      sql = QString( "SELECT acalitem_id, periodstart, periodend, acalitem_name AS periodname,"
-                     "       (formatDate(periodstart) || ' - ' || formatDate(periodend)) AS periodrange "
-                     "FROM ( SELECT acalitem_id, acalitem_name,"
-                     "              findPeriodStart(acalitem_id) AS periodstart,"
-                     "              findPeriodEnd(acalitem_id) AS periodend "
-                     "       FROM acalitem "
-                     "       WHERE (acalitem_calhead_id=%1) ) AS data "
-                     "ORDER BY periodstart;" )
-              .arg(pCalheadid);
-
-    else if (caltype.value("calhead_type").toString() == "R")
-      sql = QString( "SELECT rcalitem_id, periodstart, periodend, rcalitem_name AS periodname,"
-                     "       (formatDate(periodstart) || ' - ' || formatDate(periodend)) AS periodrange "
-                     "FROM ( SELECT rcalitem_id, rcalitem_name,"
-                     "              findPeriodStart(rcalitem_id) AS periodstart,"
-                     "              findPeriodEnd(rcalitem_id) AS periodend "
-                     "       FROM rcalitem "
-                     "       WHERE (rcalitem_calhead_id=%1) ) AS data "
-                     "ORDER BY periodstart;" )
-              .arg(pCalheadid);
-
-    XSqlQuery query(sql);
+    QList<CalendarPeriod> periods = CalendarCache::instance()->periods(pCalheadid);
     XTreeWidgetItem *last = 0;
     QAbstractItemView::SelectionMode tmp = selectionMode();
     setSelectionMode(QAbstractItemView::MultiSelection);
-    while (query.next())
+    foreach (CalendarPeriod period, periods)
     {
-      last = new PeriodListViewItem(this, last, query.value(0).toInt(),
-                                    query.value(1).toDate(), query.value(2).toDate(),
-                                    query.value(3).toString(), query.value(4).toString() );
+      last = new PeriodListViewItem(this, last, period.id,
+                                    period.start, period.end,
+                                    period.name, period.range);
       setCurrentItem(last);
     }
     setSelectionMode(tmp);
@@ -26,6 +26,7 @@
 #include <xsqlquery.h>
 #include <parameter.h>
 
+#include "calendarcache.h"
 #include "datecluster.h"
 #include "dcalendarpopup.h"
 #include "errorReporter.h"
@@ -493,20 +494,12 @@ void XDateEdit::checkDate(const QDate &pDate)
 
   if(determineIfStd() && (_siteId != -1) && (pDate != _currentDate))
   {
-    XSqlQuery workday;
-
-    workday.prepare("SELECT calculatenextworkingdate(:whsid, :date, :desired) AS result;");
-    workday.bindValue(":whsid", _siteId);
-    workday.bindValue(":date", pDate);
-    workday.bindValue(":desired", 0);
-    workday.exec();
-    if (workday.first())
-    {
-      nextWorkDate = workday.value("result").toDate();
-    }
-    else if (ErrorReporter::error(QtWarningMsg, this, tr("No work week calendar found"),
-                                  workday, __FILE__, __LINE__))
+    nextWorkDate = CalendarCache::instance()->nextWorkingDate(_siteId, pDate);
+    if (! nextWorkDate.isValid())
     {
+      ErrorReporter::error(QtWarningMsg, this, tr("No work week calendar found"),
+                           CalendarCache::instance()->lastError(),
+                           __FILE__, __LINE__);
       return;
     }
   }
@@ -537,15 +530,13 @@ void XDateEdit::clear()
 
 QDate XDateEdit::currentDefault()
 {
-  XSqlQuery query;
-  
   if (_default==Empty)
     return _nullDate;
   else if (_default==Current)
   {
-    query.exec("SELECT current_date AS result;");
-    if (query.first())
-      return query.value("result").toDate();
+    QDate today = CalendarCache::instance()->currentDate();
+    if (today.isValid())
+      return today;
   }
   return date();
 }
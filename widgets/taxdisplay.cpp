@@ -12,6 +12,7 @@
 
 #include <QMenu>
 #include <QMessageBox>
+#include <QTimer>
 
 #include "errorReporter.h"
 #include "taxBreakdown.h"
@@ -24,7 +25,14 @@ TaxDisplay::TaxDisplay(QWidget* parent, const char* name)
   _mode = cNew;
 
   if (_x_taxIntegration)
-    connect(_x_taxIntegration, SIGNAL(taxCalculated(double, QString)), this, SLOT(sUpdate(double, QString)));
+    connect(_x_taxIntegration, SIGNAL(orderTaxCalculated(QString, int, double, QString)),
+            this,              SLOT(sUpdate(QString, int, double, QString)));
+
+  // line edits come in bursts; recalculate once they settle
+  _recalculateTimer = new QTimer(this);
+  _recalculateTimer->setSingleShot(true);
+  _recalculateTimer->setInterval(250);
+  connect(_recalculateTimer, SIGNAL(timeout()), this, SLOT(sRecalculate()));
 
   _recalculateAct = new QAction(tr("Recalculate Tax"), this);
   _recalculateAct->setObjectName("_recalculateAct");
@@ -104,9 +112,10 @@ void TaxDisplay::sRecalculate()
   if (_orderId < 0 || _mode == cView)
     return;
 
+  _recalculateTimer->stop();
   emit save(true);
   if (_x_taxIntegration)
-    _x_taxIntegration->calculateTax(_type, _orderId);
+    _x_taxIntegration->calculateTaxAsync(_type, _orderId);
 }
 
 void TaxDisplay::sOpen()
@@ -134,6 +143,12 @@ void TaxDisplay::sOpen()
     sRefresh();
 }
 
+void TaxDisplay::sUpdate(QString type, int orderId, double tax, QString error)
+{
+  if (type == _type && orderId == _orderId)
+    sUpdate(tax, error);
+}
+
 void TaxDisplay::sUpdate(double tax, QString error)
 {
   if (error.isEmpty())
@@ -183,6 +198,7 @@ void TaxDisplay::sRefresh()
 
 void TaxDisplay::save()
 {
+  _recalculateTimer->stop();
   if (_x_taxIntegration)
     _x_taxIntegration->calculateTax(_type, _orderId, true);
 }
@@ -208,7 +224,7 @@ void TaxDisplay::invalidate()
                          tax, __FILE__, __LINE__);
   }
   else
-    sRecalculate();
+    _recalculateTimer->start();
 }
 
 bool TaxDisplay::eventFilter(QObject *obj, QEvent *event)
@@ -15,6 +15,8 @@
 
 #include "currcluster.h"
 
+class QTimer;
+
 class XTUPLEWIDGETS_EXPORT TaxDisplay : public CurrDisplay
 {
   Q_OBJECT
@@ -38,6 +40,7 @@ class XTUPLEWIDGETS_EXPORT TaxDisplay : public CurrDisplay
     void sRecalculate();
     void sOpen();
     void sUpdate(double, QString);
+    void sUpdate(QString, int, double, QString);
     void sRefresh();
     void sUpdateMenu();
 
@@ -57,6 +60,7 @@ class XTUPLEWIDGETS_EXPORT TaxDisplay : public CurrDisplay
     QMenu*          _menu;
     QAction*        _recalculateAct;
     QAction*        _openAct;
+    QTimer*         _recalculateTimer;
 };
 
 #endif
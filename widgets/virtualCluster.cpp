@@ -25,6 +25,7 @@
 
 #include "errorReporter.h"
 #include "guiclientinterface.h"
+#include "queryprofiler.h"
 #include "shortcuts.h"
 #include "xcheckbox.h"
 #include "xdatawidgetmapper.h"
@@ -802,7 +803,9 @@ void VirtualClusterLineEdit::silentSetId(const int pId)
     XSqlQuery idQ;
     idQ.prepare(_query + _idClause + QString(";"));
     idQ.bindValue(":id", pId);
+    QueryProbe probe(this, __FILE__, __LINE__);
     idQ.exec();
+    probe.record(idQ);
     if (idQ.first())
     {
       if (_completer)
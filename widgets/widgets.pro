@@ -233,6 +233,7 @@ HEADERS += widgets.h \
     xtupleplugin.h \
     guiclientinterface.h \
     addresscluster.h \
+    addressclusterprivate.h \
     alarmMaint.h \
     alarms.h \
     apopencluster.h \
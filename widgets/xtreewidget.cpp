@@ -1653,6 +1653,8 @@ void XTreeWidget::sExport()
 
   if (!fi.filePath().isEmpty())
   {
+    emit aboutToExport();  // give the owner a chance to load any rows it held back
+
     QTextDocument       *doc = new QTextDocument();
     QTextDocumentWriter writer;
     if (fi.suffix().isEmpty())
@@ -275,6 +275,7 @@ class XTUPLEWIDGETS_EXPORT XTreeWidget : public QTreeWidget
     void  sToggleForgetfulness();
 
   signals:
+    void  aboutToExport();
     void  valid(bool);
     void  newId(int);
     void  currentItemChanged(XTreeWidgetItem *, XTreeWidgetItem *);